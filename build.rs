@@ -36,6 +36,15 @@ fn main() {
         .file("view3d.c")
         .file("viewpp.c")
         .file("common.c")
+        .file("viewmt.c")
+        .file("session.c")
+        .file("journal.c")
+        .file("bvh.c")
+        .file("viewvec.c")
+        .file("viewray.c")
+        .file("viewhemi.c")
+        .file("viewfar.c")
+        .file("viewexact.c")
         .file("view2d.c")
         .file("test2d.c")
         .file("misc.c")
@@ -43,6 +52,7 @@ fn main() {
         .file("v3main.c")
         .include(".")
         .define("LIBONLY", Some("1"))
+        .define("V3D_STATIC", None)
         .compile("view3d");
 
     cc::Build::new()
@@ -59,6 +69,15 @@ fn main() {
         .file("view3d.c")
         .file("viewpp.c")
         .file("common.c")
+        .file("viewmt.c")
+        .file("session.c")
+        .file("journal.c")
+        .file("bvh.c")
+        .file("viewvec.c")
+        .file("viewray.c")
+        .file("viewhemi.c")
+        .file("viewfar.c")
+        .file("viewexact.c")
         .file("view2d.c")
         .file("test2d.c")
         .file("misc.c")
@@ -66,6 +85,7 @@ fn main() {
         // .file("v3main.c")
         .include(".")
         .define("LIBONLY", Some("1"))
+        .define("V3D_STATIC", None)
         .compile("view2d");
 }
 
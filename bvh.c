@@ -0,0 +1,562 @@
+/*subfile:  BVH.c  ***********************************************************/
+
+/*  Bounding volume hierarchies of the surfaces and vertices.
+ *
+ *  ObstrBVH: hierarchy (BVH) of the possible view obstructing
+ *  surfaces.  It is built once from the list set by SetPosObstr3D()
+ *  and replaces the linear pass over that list for each pair of
+ *  surfaces:  QueryObstrBVH() skips whole groups of surfaces which
+ *  lie outside the box of BoxTest() or the cone or cylinder of
+ *  ConeRadiusTest().  The node tests are conservative; the surfaces
+ *  returned are still checked by those functions, so the set of
+ *  probable obstructions and its order are not changed.
+ *
+ *  VertexTree: k-d tree of the vertices of all surfaces.  It lets
+ *  SetPosObstr3D() decide whether a plane has vertices on both sides
+ *  without testing every vertex:  a node is skipped when the box of
+ *  its vertices is entirely on the other side of the plane.  */
+
+#ifdef _DEBUG
+# define DEBUG 1
+#else
+# define DEBUG 0
+#endif
+
+#define V3D_BUILD
+#include "bvh.h"
+
+#include <stdio.h>
+#include <stdlib.h> /* prototype: qsort */
+#include <math.h>   /* prototypes: sqrt, fabs */
+#include "types.h"
+#include "misc.h"
+#include "heap.h"
+
+#define LEAFSIZE 4      /* max number of surfaces in a leaf */
+#define MAXDEPTH 64     /* size of the traversal stack */
+
+/*  VSHIFT:  vector C = vector B minus scalar D times vector A.  */
+#define VSHIFT(b,d,a,c)  \
+    c->x = b->x - d * a->x; \
+    c->y = b->y - d * a->y; \
+    c->z = b->z - d * a->z;
+
+static double Coord( const Vec3 *v, int axis );
+static void BuildNode( ObstrBVH *bvh, SRFDAT3D *srf, int iNode,
+  int first, int count );
+static void SelectItem( ObstrBVH *bvh, SRFDAT3D *srf, int lo, int hi,
+  int k, int axis );
+static int RankCompare( const void *p1, const void *p2 );
+static void BuildVtxNode( VertexTree *tree, int iNode, int first, int count );
+static void SelectVertex( Vec3 *pt, int lo, int hi, int k, int axis );
+static int PlaneSide( const VertexTree *tree, const DirCos *dc,
+  double eps, int side );
+
+/***  Coord.c  ***************************************************************/
+
+static double Coord( const Vec3 *v, int axis )
+  {
+  if( axis == 0 ) return v->x;
+  if( axis == 1 ) return v->y;
+  return v->z;
+
+  }  /* end Coord */
+
+/***  BuildObstrBVH.c  *******************************************************/
+
+/*  Build the hierarchy of the NPOSSOBSTR surfaces in POSSIBLEOBSTR.  */
+
+ObstrBVH *BuildObstrBVH( SRFDAT3D *srf, int nAllSrf, const int *possibleObstr,
+  int nPossObstr )
+  {
+  ObstrBVH *bvh;
+  BVHNode *root;
+  int i;
+
+  bvh = V3D_NEW( ObstrBVH );
+  bvh->obstr = possibleObstr;
+  bvh->nObstr = nPossObstr;
+  bvh->nAllSrf = nAllSrf;
+  bvh->rank = Alc_V( 1, nAllSrf, sizeof(int), __FILE__, __LINE__ );
+  bvh->item = Alc_V( 0, nPossObstr, sizeof(int), __FILE__, __LINE__ );
+  for( i=1; i<=nPossObstr; i++ )
+    {
+    bvh->rank[possibleObstr[i]] = i;
+    bvh->item[i-1] = i;
+    }
+  bvh->maxNode = 2 * nPossObstr;
+  bvh->node = Alc_V( 0, bvh->maxNode, sizeof(BVHNode), __FILE__, __LINE__ );
+  bvh->nNode = 1;
+  BuildNode( bvh, srf, 0, 0, nPossObstr );
+
+  root = bvh->node;
+  bvh->slack = 1.0e-8 * (sqrt( VDOT( (&root->ctr), (&root->ctr) ) ) + root->rad);
+#ifdef LOGGING
+  fprintf( _ulog, "BuildObstrBVH: %d surfaces, %d nodes\n",
+    nPossObstr, bvh->nNode );
+#endif
+
+  return bvh;
+
+  }  /* end BuildObstrBVH */
+
+/***  BuildNode.c  ***********************************************************/
+
+/*  Set node INODE for items FIRST to FIRST+COUNT-1; split it at the
+ *  median centroid along the longest axis until leaves are small.  */
+
+static void BuildNode( ObstrBVH *bvh, SRFDAT3D *srf, int iNode,
+  int first, int count )
+  {
+  BVHNode *node = bvh->node + iNode;
+  Vec3 cmin, cmax;  /* box enclosing the centroids */
+  double d, extent;
+  int i, j, k, axis, mid;
+
+  k = bvh->obstr[bvh->item[first]];
+  node->min = node->max = *srf[k].v[0];
+  cmin = cmax = srf[k].ctd;
+  for( i=first; i<first+count; i++ )
+    {
+    k = bvh->obstr[bvh->item[i]];
+    for( j=0; j<srf[k].nv; j++ )
+      {
+      Vec3 *v = srf[k].v[j];
+      if( v->x < node->min.x ) node->min.x = v->x;
+      if( v->x > node->max.x ) node->max.x = v->x;
+      if( v->y < node->min.y ) node->min.y = v->y;
+      if( v->y > node->max.y ) node->max.y = v->y;
+      if( v->z < node->min.z ) node->min.z = v->z;
+      if( v->z > node->max.z ) node->max.z = v->z;
+      }
+    if( srf[k].ctd.x < cmin.x ) cmin.x = srf[k].ctd.x;
+    if( srf[k].ctd.x > cmax.x ) cmax.x = srf[k].ctd.x;
+    if( srf[k].ctd.y < cmin.y ) cmin.y = srf[k].ctd.y;
+    if( srf[k].ctd.y > cmax.y ) cmax.y = srf[k].ctd.y;
+    if( srf[k].ctd.z < cmin.z ) cmin.z = srf[k].ctd.z;
+    if( srf[k].ctd.z > cmax.z ) cmax.z = srf[k].ctd.z;
+    }
+
+  node->ctr.x = 0.5 * (cmin.x + cmax.x);
+  node->ctr.y = 0.5 * (cmin.y + cmax.y);
+  node->ctr.z = 0.5 * (cmin.z + cmax.z);
+  for( node->rad=0.0,i=first; i<first+count; i++ )
+    {
+    Vec3 a;
+    k = bvh->obstr[bvh->item[i]];
+    VECTOR( (&node->ctr), (&srf[k].ctd), (&a) );
+    d = sqrt( VDOT( (&a), (&a) ) ) + srf[k].rc;
+    if( d > node->rad ) node->rad = d;
+    }
+
+  for( extent=0.0,axis=i=0; i<3; i++ )
+    {
+    d = Coord( &cmax, i ) - Coord( &cmin, i );
+    if( d > extent )
+      {
+      extent = d;
+      axis = i;
+      }
+    }
+  if( count <= LEAFSIZE || extent <= 0.0 )
+    {
+    node->first = first;
+    node->count = count;
+    return;
+    }
+
+  mid = first + count / 2;
+  SelectItem( bvh, srf, first, first+count-1, mid, axis );
+  node->first = bvh->nNode;
+  node->count = 0;
+  bvh->nNode += 2;
+  if( bvh->nNode > bvh->maxNode )
+    error( 3, __FILE__, __LINE__, "BVH node space exceeded", "" );
+  BuildNode( bvh, srf, node->first, first, mid-first );
+  BuildNode( bvh, srf, node->first+1, mid, first+count-mid );
+
+  }  /* end BuildNode */
+
+/***  SelectItem.c  **********************************************************/
+
+/*  Partially sort items LO to HI so that item K has the median centroid
+ *  coordinate on AXIS:  items before K are not greater, items after K
+ *  are not less (Hoare's selection).  */
+
+static void SelectItem( ObstrBVH *bvh, SRFDAT3D *srf, int lo, int hi,
+  int k, int axis )
+  {
+  int *item = bvh->item;
+  const int *obstr = bvh->obstr;
+  double pivot;
+  int i, j, t;
+
+  while( lo < hi )
+    {
+    pivot = Coord( &srf[obstr[item[(lo+hi)/2]]].ctd, axis );
+    i = lo;
+    j = hi;
+    while( i <= j )
+      {
+      while( Coord( &srf[obstr[item[i]]].ctd, axis ) < pivot ) i++;
+      while( Coord( &srf[obstr[item[j]]].ctd, axis ) > pivot ) j--;
+      if( i <= j )
+        {
+        t = item[i];
+        item[i++] = item[j];
+        item[j--] = t;
+        }
+      }
+    if( k <= j )
+      hi = j;
+    else if( k >= i )
+      lo = i;
+    else
+      break;
+    }
+
+  }  /* end SelectItem */
+
+/***  QueryObstrBVH.c  *******************************************************/
+
+/*  Copy to PROBABLEOBSTR the possible obstructions which may be inside
+ *  both the box around srfN and srfM and the cone or cylinder between
+ *  them, limited to those with MARK[rank] == ROW.  They are returned
+ *  in the order of the possibleObstr list.  Return their number.  */
+
+int QueryObstrBVH( const ObstrBVH *bvh, SRFDATNM *srfN, SRFDATNM *srfM,
+  double distNM, const int *mark, int row, int *probableObstr )
+  {
+  double xmax, xmin, ymax, ymin, zmax, zmin;  /* limits of box enclosing N & M */
+  int mode=0; /* 0 = cylinder; -1 = cone from srfM; +1 = cone from srfN */
+  double radCylndr=0.0, radSmall, radLarge;
+  double distSmall=0.0, distLarge=0.0, tanA=0.0;
+  double distK, rad, d, e;
+  DirCos dcNM;    /* direction cosines of line between srfN and srfM */
+  Vec3 apex;  /* coordinates of apex of cone */
+  Vec3 a, b;  /* vectors */
+  int stack[MAXDEPTH];
+  int nStack=0, nProb=0;
+  int i, n;
+
+  xmax = xmin = srfN->v[0].x;      /* box as in BoxTest() */
+  ymax = ymin = srfN->v[0].y;
+  zmax = zmin = srfN->v[0].z;
+  for( n=1; n<srfN->nv; n++ )
+    {
+    if( srfN->v[n].x > xmax ) xmax = srfN->v[n].x;
+    if( srfN->v[n].x < xmin ) xmin = srfN->v[n].x;
+    if( srfN->v[n].y > ymax ) ymax = srfN->v[n].y;
+    if( srfN->v[n].y < ymin ) ymin = srfN->v[n].y;
+    if( srfN->v[n].z > zmax ) zmax = srfN->v[n].z;
+    if( srfN->v[n].z < zmin ) zmin = srfN->v[n].z;
+    }
+  for( n=0; n<srfM->nv; n++ )
+    {
+    if( srfM->v[n].x > xmax ) xmax = srfM->v[n].x;
+    if( srfM->v[n].x < xmin ) xmin = srfM->v[n].x;
+    if( srfM->v[n].y > ymax ) ymax = srfM->v[n].y;
+    if( srfM->v[n].y < ymin ) ymin = srfM->v[n].y;
+    if( srfM->v[n].z > zmax ) zmax = srfM->v[n].z;
+    if( srfM->v[n].z < zmin ) zmin = srfM->v[n].z;
+    }
+
+  if( srfN->rc < 0.7071*srfM->rc ) mode = +1;   /* as in ConeRadiusTest() */
+  if( srfM->rc < 0.7071*srfN->rc ) mode = -1;
+  if( mode<0 )
+    {
+    VECTOR( (&srfM->ctd), (&srfN->ctd), (&a) );
+    radSmall = srfM->rc;
+    radLarge = srfN->rc;
+    }
+  else
+    {
+    VECTOR( (&srfN->ctd), (&srfM->ctd), (&a) );
+    radSmall = srfN->rc;
+    radLarge = srfM->rc;
+    }
+  d = 1.0f / distNM;
+  VSCALE( d, (&a), (&dcNM) );
+  if( mode )
+    if( distNM<radLarge ) mode = 0;
+  if( mode )
+    {
+    e = radSmall / (radLarge - radSmall);
+    distSmall = e * distNM;
+    distLarge = distSmall + distNM;
+    tanA = radSmall / sqrt( distSmall*distSmall - radSmall*radSmall );
+    if( mode < 0 )
+      { VSHIFT( (&srfM->ctd), e, (&a), (&apex) ); }
+    else
+      { VSHIFT( (&srfN->ctd), e, (&a), (&apex) ); }
+    }
+  else
+    {
+    radCylndr = MAX( srfN->rc, srfM->rc );
+    apex = srfN->ctd;
+    }
+
+  stack[nStack++] = 0;
+  while( nStack )
+    {
+    const BVHNode *node = bvh->node + stack[--nStack];
+                    /* all vertices beyond one side of the box */
+    if( node->min.x >= xmax || node->max.x <= xmin ) continue;
+    if( node->min.y >= ymax || node->max.y <= ymin ) continue;
+    if( node->min.z >= zmax || node->max.z <= zmin ) continue;
+    rad = node->rad + bvh->slack;
+    if( mode )      /* sphere outside the cone */
+      {
+      VECTOR( (&apex), (&node->ctr), (&a) );
+      distK = VDOT( (&a), (&dcNM) );
+      if( distK + rad <= distSmall - radSmall ) continue;
+      if( distK - rad >= distLarge + radLarge ) continue;
+      VCROSS( (&dcNM), (&a), (&b) );
+      d = distK * tanA + rad * (1.0 + tanA);
+      if( d < 0.0 || VDOT( (&b), (&b) ) > d*d ) continue;
+      }
+    else            /* sphere outside the cylinder */
+      {
+      VECTOR( (&srfN->ctd), (&node->ctr), (&a) );
+      VCROSS( (&dcNM), (&a), (&b) );
+      d = radCylndr + rad;
+      if( VDOT( (&b), (&b) ) > d*d ) continue;
+      }
+
+    if( node->count )
+      {
+      for( i=node->first; i<node->first+node->count; i++ )
+        if( mark[bvh->item[i]] == row )
+          probableObstr[++nProb] = bvh->item[i];
+      }
+    else
+      {
+      stack[nStack++] = node->first;
+      stack[nStack++] = node->first + 1;
+      }
+    }
+
+  if( nProb > 1 )
+    qsort( probableObstr+1, nProb, sizeof(int), RankCompare );
+  for( i=1; i<=nProb; i++ )
+    probableObstr[i] = bvh->obstr[probableObstr[i]];
+
+  return nProb;
+
+  }  /* end QueryObstrBVH */
+
+/***  RankCompare.c  *********************************************************/
+
+static int RankCompare( const void *p1, const void *p2 )
+  {
+  return *(const int *)p1 - *(const int *)p2;
+
+  }  /* end RankCompare */
+
+/***  FreeObstrBVH.c  ********************************************************/
+
+void FreeObstrBVH( ObstrBVH *bvh )
+  {
+  Fre_V( bvh->node, 0, bvh->maxNode, sizeof(BVHNode), __FILE__, __LINE__ );
+  Fre_V( bvh->item, 0, bvh->nObstr, sizeof(int), __FILE__, __LINE__ );
+  Fre_V( bvh->rank, 1, bvh->nAllSrf, sizeof(int), __FILE__, __LINE__ );
+  V3D_FREE( ObstrBVH, bvh );
+
+  }  /* end FreeObstrBVH */
+
+/***  BuildVertexTree.c  *****************************************************/
+
+/*  Build the k-d tree of the vertices of surfaces 1 to NSRF.
+ *  A vertex shared by several surfaces appears once per surface.  */
+
+VertexTree *BuildVertexTree( SRFDAT3D *srf, int nSrf )
+  {
+  VertexTree *tree;
+  int n, j, k;
+
+  tree = V3D_NEW( VertexTree );
+  tree->nPt = 0;
+  for( n=1; n<=nSrf; n++ )
+    tree->nPt += srf[n].nv;
+  tree->pt = Alc_V( 0, tree->nPt, sizeof(Vec3), __FILE__, __LINE__ );
+  tree->scale = 0.0;
+  for( k=0,n=1; n<=nSrf; n++ )
+    for( j=0; j<srf[n].nv; j++ )
+      {
+      Vec3 *v = srf[n].v[j];
+      tree->pt[k++] = *v;
+      if( fabs( v->x ) > tree->scale ) tree->scale = fabs( v->x );
+      if( fabs( v->y ) > tree->scale ) tree->scale = fabs( v->y );
+      if( fabs( v->z ) > tree->scale ) tree->scale = fabs( v->z );
+      }
+  tree->maxNode = 2 * tree->nPt;
+  tree->node = Alc_V( 0, tree->maxNode, sizeof(VtxNode), __FILE__, __LINE__ );
+  tree->nNode = 1;
+  if( tree->nPt )
+    BuildVtxNode( tree, 0, 0, tree->nPt );
+
+  return tree;
+
+  }  /* end BuildVertexTree */
+
+/***  BuildVtxNode.c  ********************************************************/
+
+/*  Set node INODE for vertices FIRST to FIRST+COUNT-1; split it at the
+ *  median along the longest axis until leaves are small.  */
+
+static void BuildVtxNode( VertexTree *tree, int iNode, int first, int count )
+  {
+  VtxNode *node = tree->node + iNode;
+  double d, extent;
+  int i, axis, mid;
+
+  node->min = node->max = tree->pt[first];
+  for( i=first+1; i<first+count; i++ )
+    {
+    Vec3 *v = tree->pt + i;
+    if( v->x < node->min.x ) node->min.x = v->x;
+    if( v->x > node->max.x ) node->max.x = v->x;
+    if( v->y < node->min.y ) node->min.y = v->y;
+    if( v->y > node->max.y ) node->max.y = v->y;
+    if( v->z < node->min.z ) node->min.z = v->z;
+    if( v->z > node->max.z ) node->max.z = v->z;
+    }
+
+  for( extent=0.0,axis=i=0; i<3; i++ )
+    {
+    d = Coord( &node->max, i ) - Coord( &node->min, i );
+    if( d > extent )
+      {
+      extent = d;
+      axis = i;
+      }
+    }
+  if( count <= 2*LEAFSIZE || extent <= 0.0 )
+    {
+    node->first = first;
+    node->count = count;
+    return;
+    }
+
+  mid = first + count / 2;
+  SelectVertex( tree->pt, first, first+count-1, mid, axis );
+  node->first = tree->nNode;
+  node->count = 0;
+  tree->nNode += 2;
+  if( tree->nNode > tree->maxNode )
+    error( 3, __FILE__, __LINE__, "Vertex tree node space exceeded", "" );
+  BuildVtxNode( tree, node->first, first, mid-first );
+  BuildVtxNode( tree, node->first+1, mid, first+count-mid );
+
+  }  /* end BuildVtxNode */
+
+/***  SelectVertex.c  ********************************************************/
+
+/*  Partially sort vertices LO to HI about vertex K on AXIS
+ *  (as SelectItem).  */
+
+static void SelectVertex( Vec3 *pt, int lo, int hi, int k, int axis )
+  {
+  double pivot;
+  Vec3 t;
+  int i, j;
+
+  while( lo < hi )
+    {
+    pivot = Coord( pt+(lo+hi)/2, axis );
+    i = lo;
+    j = hi;
+    while( i <= j )
+      {
+      while( Coord( pt+i, axis ) < pivot ) i++;
+      while( Coord( pt+j, axis ) > pivot ) j--;
+      if( i <= j )
+        {
+        t = pt[i];
+        pt[i++] = pt[j];
+        pt[j--] = t;
+        }
+      }
+    if( k <= j )
+      hi = j;
+    else if( k >= i )
+      lo = i;
+    else
+      break;
+    }
+
+  }  /* end SelectVertex */
+
+/***  PlaneStraddle.c  *******************************************************/
+
+/*  Return 1 if some vertex is more than EPS in front of plane DC and
+ *  some vertex is more than EPS behind it.  */
+
+int PlaneStraddle( const VertexTree *tree, const DirCos *dc, double eps )
+  {
+  if( !tree->nPt )
+    return 0;
+  return PlaneSide( tree, dc, eps, 1 ) && PlaneSide( tree, dc, eps, -1 );
+
+  }  /* end PlaneStraddle */
+
+/***  PlaneSide.c  ***********************************************************/
+
+/*  Return 1 if some vertex is more than EPS in front of plane DC
+ *  (SIDE > 0) or behind it (SIDE < 0).  The vertex distances are
+ *  computed as in SetPosObstr3D(); the node bounds allow for round-off
+ *  so that no such vertex is skipped.  */
+
+static int PlaneSide( const VertexTree *tree, const DirCos *dc,
+  double eps, int side )
+  {
+  int stack[MAXDEPTH];
+  int nStack=0;
+  double slack, hi, lo, dot;
+  int i;
+
+  slack = 1.0e-12 * (fabs( dc->w ) + 2.0 * tree->scale);
+  stack[nStack++] = 0;
+  while( nStack )
+    {
+    const VtxNode *node = tree->node + stack[--nStack];
+    lo = hi = dc->w;   /* range of distances over the node box */
+    if( dc->x > 0.0 ) { hi += dc->x * node->max.x; lo += dc->x * node->min.x; }
+    else              { hi += dc->x * node->min.x; lo += dc->x * node->max.x; }
+    if( dc->y > 0.0 ) { hi += dc->y * node->max.y; lo += dc->y * node->min.y; }
+    else              { hi += dc->y * node->min.y; lo += dc->y * node->max.y; }
+    if( dc->z > 0.0 ) { hi += dc->z * node->max.z; lo += dc->z * node->min.z; }
+    else              { hi += dc->z * node->min.z; lo += dc->z * node->max.z; }
+    if( side > 0 && hi + slack <= eps ) continue;
+    if( side < 0 && lo - slack >= -eps ) continue;
+
+    if( node->count )
+      {
+      for( i=node->first; i<node->first+node->count; i++ )
+        {
+        const Vec3 *v = tree->pt + i;
+        dot = VDOTW( v, dc );
+        if( side > 0 && dot > eps ) return 1;
+        if( side < 0 && dot < -eps ) return 1;
+        }
+      }
+    else
+      {
+      stack[nStack++] = node->first;
+      stack[nStack++] = node->first + 1;
+      }
+    }
+
+  return 0;
+
+  }  /* end PlaneSide */
+
+/***  FreeVertexTree.c  ******************************************************/
+
+void FreeVertexTree( VertexTree *tree )
+  {
+  Fre_V( tree->node, 0, tree->maxNode, sizeof(VtxNode), __FILE__, __LINE__ );
+  Fre_V( tree->pt, 0, tree->nPt, sizeof(Vec3), __FILE__, __LINE__ );
+  V3D_FREE( VertexTree, tree );
+
+  }  /* end FreeVertexTree */
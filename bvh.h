@@ -0,0 +1,53 @@
+#ifndef V3D_BVH_H
+#define V3D_BVH_H
+
+#include "view3d.h"
+
+/*  Bounding volume hierarchies of the possible view obstructing surfaces
+ *  and of the surface vertices; see bvh.c.  */
+
+typedef struct{         /* node of the hierarchy */
+  Vec3 min, max;        /* box enclosing the vertices of its surfaces */
+  Vec3 ctr;             /* center and radius of a sphere enclosing */
+  double rad;           /*   the (ctd, rc) spheres of its surfaces */
+  int first;            /* leaf: first item; interior: first child */
+  int count;            /* leaf: number of items; 0 = interior node */
+} BVHNode;
+
+typedef struct{         /* hierarchy of possible obstructions */
+  const int *obstr;     /* possible obstructions [1:nObstr] */
+  int nObstr;           /* number of possible obstructions */
+  int *rank;            /* rank[k] = position of surface k in obstr [1:nAllSrf] */
+  int nAllSrf;          /* number of surfaces */
+  int *item;            /* ranks sorted into leaves [0:nObstr-1] */
+  BVHNode *node;        /* nodes [0:maxNode-1]; node 0 is the root */
+  int nNode;            /* number of nodes used */
+  int maxNode;          /* number of nodes allocated */
+  double slack;         /* allowance for round-off in the sphere tests */
+} ObstrBVH;
+
+typedef struct{         /* node of a vertex tree */
+  Vec3 min, max;        /* box enclosing its vertices */
+  int first;            /* leaf: first vertex; interior: first child */
+  int count;            /* leaf: number of vertices; 0 = interior node */
+} VtxNode;
+
+typedef struct{         /* k-d tree of the vertices of all surfaces */
+  Vec3 *pt;             /* vertex coordinates [0:nPt-1] */
+  int nPt;              /* number of vertices */
+  VtxNode *node;        /* nodes [0:maxNode-1]; node 0 is the root */
+  int nNode;            /* number of nodes used */
+  int maxNode;          /* number of nodes allocated */
+  double scale;         /* largest absolute coordinate */
+} VertexTree;
+
+ObstrBVH *BuildObstrBVH( SRFDAT3D *srf, int nAllSrf, const int *possibleObstr,
+  int nPossObstr );
+int QueryObstrBVH( const ObstrBVH *bvh, SRFDATNM *srfN, SRFDATNM *srfM,
+  double distNM, const int *mark, int row, int *probableObstr );
+void FreeObstrBVH( ObstrBVH *bvh );
+VertexTree *BuildVertexTree( SRFDAT3D *srf, int nSrf );
+int PlaneStraddle( const VertexTree *tree, const DirCos *dc, double eps );
+void FreeVertexTree( VertexTree *tree );
+
+#endif
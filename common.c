@@ -4,12 +4,14 @@
 /* nasty global variables used in a range of places... */
 
 const char *methods[7]={"2AI","1AI","2LI","1LI","ALI","Adapt","Blocked"}; /* abbreviations */
-char _string[LINELEN + 1];  /* buffer for a character string */
-int _maxNVT=12;   /* maximum number of temporary polygon overlap vertices */
-FILE *_unxt; /* input file */
-FILE *_ulog; /* log file */
-int _echo=0;  /* true = echo input file */
-int _list=0;  /* output control, higher value = more output:
+/* thread-local: a new thread starts with these initial values;
+ * see v3d_session and View3DParallel for how they are passed on */
+V3D_TLS char _string[LINELEN + 1];  /* buffer for a character string */
+V3D_TLS int _maxNVT=12;   /* maximum number of temporary polygon overlap vertices */
+V3D_TLS FILE *_unxt=NULL; /* input file */
+V3D_TLS FILE *_ulog=NULL; /* log file */
+V3D_TLS int _echo=0;  /* true = echo input file */
+V3D_TLS int _list=0;  /* output control, higher value = more output:
                 0 = summary;
                 1 = list view factors;
                 2 = echo input, note calculations;
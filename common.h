@@ -1,9 +1,15 @@
 #ifndef V3D_COMMON_H
 #define V3D_COMMON_H
 
-#ifdef __WIN32__
-# define V3D_EXPORT __declspec(dllexport)
-# define V3D_IMPORT __declspec(dllimport)
+/* The working globals below are thread-local.  Windows can not import
+ * thread-local variables from a DLL, so there the library is built and
+ * linked as a static library with V3D_STATIC defined.  */
+#if defined(_WIN32) || defined(__WIN32__)
+# ifndef V3D_STATIC
+#  error "On Windows View3D must be linked statically: define V3D_STATIC"
+# endif
+# define V3D_EXPORT
+# define V3D_IMPORT
 #else
 # ifdef HAVE_GCCVISIBILITY
 #  define V3D_EXPORT __attribute__ ((visibility("default")))
@@ -24,14 +30,30 @@
 
 #define LINELEN 256
 
+/* thread-local storage for the working globals: one set per thread so that
+ * View3DParallel workers and v3d_session jobs do not share them */
+#if defined(_MSC_VER)
+# define V3D_TLS __declspec(thread)
+#else
+# define V3D_TLS __thread
+#endif
+
+/* strtok() keeps its position in a static pointer shared by all threads;
+ * V3D_STRTOK( str, delim, &next ) keeps it in char *next instead */
+#if defined(_MSC_VER)
+# define V3D_STRTOK(s,d,p) strtok_s( s, d, p )
+#else
+# define V3D_STRTOK(s,d,p) strtok_r( s, d, p )
+#endif
+
 #include <stdio.h>
 V3D_API const char *methods[7]; /* method abbreviations */
-V3D_API char _string[LINELEN + 1]; /* buffer for a character string */
-V3D_API int _maxNVT;   /* maximum number of temporary polygon overlap vertices */
-extern FILE *_unxt; /* input file */
-V3D_API FILE *_ulog; /* log file */
-V3D_API int _echo;  /* true = echo input file */
-V3D_API int _list;  /* output control, higher value = more output:
+V3D_API V3D_TLS char _string[LINELEN + 1]; /* buffer for a character string */
+V3D_API V3D_TLS int _maxNVT;   /* maximum number of temporary polygon overlap vertices */
+extern V3D_TLS FILE *_unxt; /* input file */
+V3D_API V3D_TLS FILE *_ulog; /* log file */
+V3D_API V3D_TLS int _echo;  /* true = echo input file */
+V3D_API V3D_TLS int _list;  /* output control, higher value = more output:
                 0 = summary;
                 1 = list view factors;
                 2 = echo input, note calculations;
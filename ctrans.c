@@ -16,6 +16,10 @@
 #include "misc.h" 
 #include "test3d.h"
 #include "common.h"
+#include "heap.h"
+
+     /* local functions */
+static void SetSrfSet3X( SRFDAT3X *srfOT, int n, SRFSET3X *set );
 
 /***  CTIdent.c  *************************************************************/
 
@@ -291,6 +295,9 @@ void CoordTrans3D( SRFDAT3D *srf, SRFDATNM *srf1, SRFDATNM *srf2,
       }
     }
 
+  if( vfCtrl->setOT )
+    SetSrfSet3X( vfCtrl->srfOT, vfCtrl->nProbObstr, vfCtrl->setOT );
+
 #if( DEBUG > 1 )
   Dump3X( "Surface 1", srf1T );
   Dump3X( "Surface 2", srf2T );
@@ -302,6 +309,100 @@ void CoordTrans3D( SRFDAT3D *srf, SRFDATNM *srf1, SRFDATNM *srf2,
 
   }  /*  end of CoordTrans3D  */
 
+/***  SetSrfSet3X.c  *********************************************************/
+
+/*  Copy the N transformed obstructions SRFOT to the structure of arrays
+ *  SET.  Vertices beyond the last are copies of the last vertex;
+ *  obstructions after the last, to fill a block of SETLANES, are zero.  */
+
+static void SetSrfSet3X( SRFDAT3X *srfOT, int n, SRFSET3X *set )
+  {
+  int j, k, nv;
+
+  set->n = n;
+  set->maxNv = 0;
+  for( j=0; j<n; j++,srfOT++ )
+    {
+    nv = set->nv[j] = srfOT->nv;
+    if( nv > set->maxNv )
+      set->maxNv = nv;
+    set->dx[j] = srfOT->dc.x;
+    set->dy[j] = srfOT->dc.y;
+    set->dz[j] = srfOT->dc.z;
+    set->dw[j] = srfOT->dc.w;
+    set->zmax[j] = srfOT->v[0].z;
+    for( k=0; k<MAXNV1; k++ )
+      {
+      Vec3 *v = srfOT->v + (k < nv ? k : nv-1);
+      set->vx[k][j] = v->x;
+      set->vy[k][j] = v->y;
+      set->vz[k][j] = v->z;
+      if( v->z > set->zmax[j] )
+        set->zmax[j] = v->z;
+      }
+    }
+  for( ; j%SETLANES; j++ )
+    {
+    set->nv[j] = 0;
+    set->dx[j] = set->dy[j] = set->dz[j] = set->dw[j] = set->zmax[j] = 0.0;
+    for( k=0; k<MAXNV1; k++ )
+      set->vx[k][j] = set->vy[k][j] = set->vz[k][j] = 0.0;
+    }
+
+  }  /*  end of SetSrfSet3X  */
+
+/***  AlcSrfSet3X.c  *********************************************************/
+
+/*  Allocate a structure of arrays for MAX obstructions.  */
+
+SRFSET3X *AlcSrfSet3X( int max )
+  {
+  SRFSET3X *set;
+  double *a;  /* one block for all double arrays */
+  int k;
+
+  max = (max + SETLANES - 1) / SETLANES * SETLANES;
+  set = V3D_NEW( SRFSET3X );
+  set->max = max;
+  set->nv = Alc_V( 0, max-1, sizeof(int), __FILE__, __LINE__ );
+  set->clip = Alc_V( 0, max-1, sizeof(int), __FILE__, __LINE__ );
+  set->limit = Alc_V( 0, max-1, sizeof(int), __FILE__, __LINE__ );
+  a = Alc_V( 0, (6+5*MAXNV1)*max-1, sizeof(double), __FILE__, __LINE__ );
+  set->dx = a;  a += max;
+  set->dy = a;  a += max;
+  set->dz = a;  a += max;
+  set->dw = a;  a += max;
+  set->zmax = a;  a += max;
+  set->dot = a;  a += max;
+  for( k=0; k<MAXNV1; k++ )
+    {
+    set->vx[k] = a;  a += max;
+    set->vy[k] = a;  a += max;
+    set->vz[k] = a;  a += max;
+    set->px[k] = a;  a += max;
+    set->py[k] = a;  a += max;
+    }
+
+  return set;
+
+  }  /*  end of AlcSrfSet3X  */
+
+/***  FreSrfSet3X.c  *********************************************************/
+
+/*  Free a structure of arrays allocated by AlcSrfSet3X().  */
+
+void FreSrfSet3X( SRFSET3X *set )
+  {
+  int max = set->max;
+
+  Fre_V( set->dx, 0, (6+5*MAXNV1)*max-1, sizeof(double), __FILE__, __LINE__ );
+  Fre_V( set->limit, 0, max-1, sizeof(int), __FILE__, __LINE__ );
+  Fre_V( set->clip, 0, max-1, sizeof(int), __FILE__, __LINE__ );
+  Fre_V( set->nv, 0, max-1, sizeof(int), __FILE__, __LINE__ );
+  V3D_FREE( SRFSET3X, set );
+
+  }  /*  end of FreSrfSet3X  */
+
 /***  DumpSrf3D.c  ***********************************************************/
 
 /*  Dump SRFDAT3D structure.  */
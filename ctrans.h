@@ -6,6 +6,8 @@
      /* vector functions */
 void CoordTrans3D( SRFDAT3D *srfAll, SRFDATNM *srf1, SRFDATNM *srf2,
   int *probableObstr, View3DControlData *vfCtrl );
+SRFSET3X *AlcSrfSet3X( int max );
+void FreSrfSet3X( SRFSET3X *set );
 void DumpSrf3D( char *title, SRFDAT3D *srf );
 void DumpSrfNM( char *title, SRFDATNM *srf );
 void Dump3X( char *tittle, SRFDAT3X *srfT );
@@ -43,14 +43,14 @@ static void TestSubSrf( SRFDAT3D *srf, const int *baseSrf, View3DControlData *vf
 	Process simulation control values.
 */
 void GetCtrl( char *str, View3DControlData *vfCtrl){
-  char *p;
+  char *p, *next;  /* next: position of V3D_STRTOK */
   int i;
   float r;
 
-  p = strtok( str, "= ," );
+  p = V3D_STRTOK( str, "= ,", &next );
   while( p ){
     if( streqli( p, "eps" ) ){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( FltCon( p, &r ) )
         error( 2, __FILE__, __LINE__, "Bad float value: ", p, "" );
       else{
@@ -62,13 +62,13 @@ void GetCtrl( char *str, View3DControlData *vfCtrl){
       }
     }
     else if( streqli( p, "list" )){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
       else
         _list = i;
     }else if( streqli( p, "out" ) ){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
       else
@@ -77,19 +77,19 @@ void GetCtrl( char *str, View3DControlData *vfCtrl){
         else
           vfCtrl->outFormat = i;
     }else if( streqli( p, "encl" )){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
       else
         if( i ) vfCtrl->enclosure = 1;
     }else if( streqli( p, "emit" )){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
       else
         if( i ) vfCtrl->emittances = 1;
     }else if( streqli( p, "maxU" ) ){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
       else{
@@ -104,7 +104,7 @@ void GetCtrl( char *str, View3DControlData *vfCtrl){
         vfCtrl->maxRecursALI = i;
       }
     }else if( streqli( p, "maxO" )){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
       else{
@@ -119,7 +119,7 @@ void GetCtrl( char *str, View3DControlData *vfCtrl){
         vfCtrl->maxRecursion = i;
       }
     }else if( streqli( p, "minO" )){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
       else{
@@ -131,7 +131,7 @@ void GetCtrl( char *str, View3DControlData *vfCtrl){
         vfCtrl->minRecursion = i;
       }
     }else if( streqli( p, "row" ) ){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
       else{
@@ -140,7 +140,7 @@ void GetCtrl( char *str, View3DControlData *vfCtrl){
         vfCtrl->row = i;
       }
     }else if( streqli( p, "col" ) ){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
       else{
@@ -149,27 +149,141 @@ void GetCtrl( char *str, View3DControlData *vfCtrl){
         vfCtrl->col = i;
       }
     }else if( streqli( p, "prjD" ) ){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
       else
         if( i ) vfCtrl->prjReverse = 1;
     }else if( streqli( p, "maxV" ) ){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
       else
         _maxNVT = i;
+    }else if( streqli( p, "threads" ) ){
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( IntCon( p, &i ) )
+        error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
+      else{
+        if( i < 1 )
+          i = 1;
+        vfCtrl->nThreads = i;
+      }
+    }else if( streqli( p, "rows" ) ){   /* rows=a-b */
+      int i2;
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( sscanf( p, "%d-%d", &i, &i2 ) != 2 || i < 1 || i2 < i )
+        error( 2, __FILE__, __LINE__, "Bad row range: ", p, "" );
+      else{
+        vfCtrl->row1 = i;
+        vfCtrl->row2 = i2;
+      }
+    }else if( streqli( p, "shard" ) ){   /* shard=k/n */
+      int i2;
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( sscanf( p, "%d/%d", &i, &i2 ) != 2 || i < 1 || i > i2 )
+        error( 2, __FILE__, __LINE__, "Bad shard: ", p, "" );
+      else{
+        vfCtrl->shard = i;
+        vfCtrl->nShards = i2;
+      }
+    }else if( streqli( p, "shaft" ) ){
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( IntCon( p, &i ) )
+        error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
+      else
+        vfCtrl->shaft = i ? 1 : 0;
+    }else if( streqli( p, "nest" ) ){
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( IntCon( p, &i ) )
+        error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
+      else
+        vfCtrl->nest = i ? 1 : 0;
+    }else if( streqli( p, "union" ) ){
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( IntCon( p, &i ) )
+        error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
+      else
+        vfCtrl->unite = i ? 1 : 0;
+    }else if( streqli( p, "far" ) ){
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( IntCon( p, &i ) )
+        error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
+      else
+        vfCtrl->farField = i ? 1 : 0;
+    }else if( streqli( p, "adapt" ) ){
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( IntCon( p, &i ) )
+        error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
+      else
+        vfCtrl->adapt = i ? 1 : 0;
+    }else if( streqli( p, "budget" ) ){
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( IntCon( p, &i ) || i < 1 )
+        error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
+      else
+        vfCtrl->budget = i;
+    }else if( streqli( p, "rect" ) ){
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( IntCon( p, &i ) )
+        error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
+      else
+        vfCtrl->rect = i ? 1 : 0;
+    }else if( streqli( p, "fp32" ) ){
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( IntCon( p, &i ) )
+        error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
+      else
+        vfCtrl->fp32 = i ? 1 : 0;
+    }else if( streqli( p, "unob" ) ){   /* unob=numeric|exact */
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( streqli( p, "exact" ) )
+        vfCtrl->unob = EXACT;
+      else if( streqli( p, "numeric" ) )
+        vfCtrl->unob = NUMERIC;
+      else
+        error( 2, __FILE__, __LINE__, "Bad unob: ", p, "" );
+    }else if( streqli( p, "engine" ) ){   /* engine=shadow|ray|hemi */
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( streqli( p, "ray" ) )
+        vfCtrl->engine = RAYS;
+      else if( streqli( p, "shadow" ) )
+        vfCtrl->engine = SHADOWS;
+      else if( streqli( p, "hemi" ) )
+        vfCtrl->engine = HEMI;
+      else
+        error( 2, __FILE__, __LINE__, "Bad engine: ", p, "" );
+    }else if( streqli( p, "journal" ) ){
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( strlen( p ) >= sizeof(vfCtrl->journal) )
+        error( 2, __FILE__, __LINE__, "Journal name too long: ", p, "" );
+      else
+        strcpy( vfCtrl->journal, p );
+    }else if( streqli( p, "jtime" ) ){
+      p = V3D_STRTOK( NULL, "= ,", &next );
+      if( IntCon( p, &i ) )
+        error( 2, __FILE__, __LINE__, "Bad integer value: ", p, "" );
+      else{
+        if( i < 0 )
+          i = 0;
+        vfCtrl->jnlTime = i;
+      }
     }else{
       error( 1, __FILE__, __LINE__, "Invalid control word: ", p, "" );
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
     }
 
-    p = strtok( NULL, "= ," );    // get next word
+    p = V3D_STRTOK( NULL, "= ,", &next );    // get next word
   }
 
   if( vfCtrl->col && !vfCtrl->row )
     error( 2, __FILE__, __LINE__, "Must set row before setting column", "" );
+  if( vfCtrl->row && (vfCtrl->row1 || vfCtrl->shard) )
+    error( 2, __FILE__, __LINE__, "Can not combine row with rows or shard", "" );
+  if( vfCtrl->row1 && vfCtrl->shard )
+    error( 2, __FILE__, __LINE__, "Can not combine rows and shard", "" );
+  if( vfCtrl->row && vfCtrl->journal[0] )
+    error( 2, __FILE__, __LINE__, "Can not combine row with journal", "" );
 
 }  /* end GetCtrl */
 
@@ -234,6 +348,9 @@ finish:
   if(vfCtrl->col > vfCtrl->nRadSrf){
 	error( 2, __FILE__, __LINE__, "\"row\" value too large", "" );
   }
+  if(vfCtrl->row2 > vfCtrl->nRadSrf){
+	error( 2, __FILE__, __LINE__, "\"rows\" range too large", "" );
+  }
   if(error( -1, __FILE__, __LINE__, "" )>0){
     error( 3, __FILE__, __LINE__, "Fix errors in input data", "" );
   }
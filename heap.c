@@ -20,11 +20,18 @@
 #include "types.h"  // define unsigned char, short, etc.
 #include "misc.h"  // miscellaneous function prototypes
 
-char _heapmsg[256];     // buffer for heap messages
+V3D_TLS char _heapmsg[256];     // buffer for heap messages
 
 long _bytesAllocated=0L;  // through Alc_E()
 long _bytesFreed=0L;      // through Fre_E()
 
+// The byte counters are shared by all View3DParallel worker threads.
+#ifdef __GNUC__
+# define HEAP_COUNT(c,n) __sync_fetch_and_add( &(c), (n) )
+#else
+# define HEAP_COUNT(c,n) ((c) += (n))
+#endif
+
 /*------------------------------------------------------------------------------
   ELEMENTS ('E')
 */
@@ -48,7 +55,7 @@ void *Alc_E( long length, const char *file, int line ){
   // TODO use 'calloc' instead?
 
   p = (unsigned char *)malloc( length );
-  _bytesAllocated += length;
+  HEAP_COUNT( _bytesAllocated, length );
 
   if( p == NULL ){
     MemNet( "Alc_E error" );
@@ -84,7 +91,7 @@ int Chk_E( void *pm, unsigned length, const char *file, int line ){
 */
 void *Fre_E( void *pm, unsigned length, const char *file, int line ){
   unsigned char *p=pm;     // pointer to allocated memory
-  _bytesFreed += length;
+  HEAP_COUNT( _bytesFreed, (long)length );
   free( p );
   return (NULL);
 }  /*  end of Fre_E  */
@@ -130,16 +137,41 @@ void MemRem( char *msg ){
  *  because the entire block is freed. Cannot free the individual structures.
  *  Based on idea and code by Steve Weller, "The C Users Journal",
  *  April 1990, pp 103 - 107.
- *  Must begin with Alc_ECI for initialization; free with Fre_EC.  */
+ *  Must begin with Alc_ECI for initialization; free with Fre_EC.
+ *  The structures are not cleared; Rst_EC() makes the blocks available
+ *  again in constant time.  */
 
 typedef struct memblock   // block of memory for Alc_EC() allocation
   {
   struct memblock *prevBlock;  // pointer to previous block
   struct memblock *nextBlock;  // pointer to next block
+  struct memblock *firstBlock; // pointer to first block in list
   long blockSize;   // number of bytes in block
   long dataOffset;  // offset to free space
+  long peak;        // most bytes used before a reset (first block only)
 } MEMBLOCK;
 
+/*  Allocate a block for Alc_EC() without clearing it.  */
+
+static MEMBLOCK *AlcBlock( long size, const char *file, int line ){
+  MEMBLOCK *mb = (MEMBLOCK *)malloc( size );
+
+  if( mb == NULL ){
+    MemNet( "AlcBlock error" );
+    sprintf( _heapmsg, "Memory allocation failed for %ld bytes\n", size );
+    error( 3, file, line, _heapmsg, "" );
+  }
+  HEAP_COUNT( _bytesAllocated, size );
+  mb->prevBlock = NULL;
+  mb->nextBlock = NULL;
+  mb->firstBlock = mb;
+  mb->blockSize = size;
+  mb->dataOffset = sizeof(MEMBLOCK);
+  mb->peak = 0;
+
+  return mb;
+}  /*  end of AlcBlock  */
+
 void *Alc_EC( char **block, long size, const char *file, int line ){
 /*  block;  pointer to current memory block.
  *  size;   size (bytes) of structure being allocated.
@@ -168,15 +200,16 @@ void *Alc_EC( char **block, long size, const char *file, int line ){
   if( mb->dataOffset + size > mb->blockSize )
     {
     if( mb->nextBlock )
+      {
       nb = mb->nextBlock;     // next block already exists
+      nb->dataOffset = sizeof(MEMBLOCK);
+      }
     else
       {                       // else create next block
-      nb = (MEMBLOCK *)Alc_E( mb->blockSize, file, line );
+      nb = AlcBlock( mb->blockSize, file, line );
       nb->prevBlock = mb;     // back linked list
       mb->nextBlock = nb;     // forward linked list
-      nb->nextBlock = NULL;
-      nb->blockSize = mb->blockSize;
-      nb->dataOffset = sizeof(MEMBLOCK);
+      nb->firstBlock = mb->firstBlock;
       }
     mb = nb;
     *block = (void *)nb;
@@ -199,21 +232,13 @@ void *Alc_ECI( long size, const char *file, int line )
  *  file;   name of file for originating call.
  *  line;   line in file. */
   {
-  MEMBLOCK *mb;
-
   if( size > UINT_MAX )
     {
     sprintf( _heapmsg, "Requested size (%ld) larger than unsigned int", size );
     error( 3, file, line, _heapmsg, "" );
     }
 
-  mb = Alc_E( size, file, line );
-  mb->prevBlock = NULL;
-  mb->nextBlock = NULL;
-  mb->blockSize = size;
-  mb->dataOffset = sizeof(MEMBLOCK);
-
-  return mb;
+  return AlcBlock( size, file, line );
 
   }  /*  end of Alc_ECI  */
 
@@ -243,6 +268,56 @@ void *Clr_EC( void *block, const char *file, int line )
 
   }  /*  end of Clr_EC  */
 
+/***  Rst_EC.c  **************************************************************/
+
+/*  Reset (but do not clear) blocks allocated by Alc_EC.
+ *  If more than the first block was used since the last reset, the blocks
+ *  are replaced by one block large enough for the most bytes used.
+ *  Return pointer to first block in linked list.  */
+
+void *Rst_EC( void *block, const char *file, int line )
+/*  block;  pointer to current memory block. */
+  {
+  MEMBLOCK *mb=block, *fb=mb->firstBlock;
+  long used = mb->dataOffset - sizeof(MEMBLOCK);
+
+  if( mb != fb )  // add the bytes in the earlier blocks
+    for( mb=mb->prevBlock; mb; mb=mb->prevBlock )
+      used += mb->dataOffset - sizeof(MEMBLOCK);
+  if( used > fb->peak )
+    fb->peak = used;
+
+  if( fb->nextBlock && block != fb )  // replace by a larger block
+    {
+    long size = fb->blockSize, peak = fb->peak;
+    while( size - (long)sizeof(MEMBLOCK) < peak )
+      size *= 2;
+    Fre_EC( fb, file, line );
+    fb = AlcBlock( size, file, line );
+    fb->peak = peak;
+    }
+  fb->dataOffset = sizeof(MEMBLOCK);
+
+  return (void *)fb;
+
+  }  /*  end of Rst_EC  */
+
+/***  Pk_EC.c  ***************************************************************/
+
+/*  Return the most bytes used in blocks allocated by Alc_EC.  */
+
+long Pk_EC( void *block )
+  {
+  MEMBLOCK *mb=block, *fb=mb->firstBlock;
+  long used = mb->dataOffset - sizeof(MEMBLOCK);
+
+  for( mb=mb->prevBlock; mb; mb=mb->prevBlock )
+    used += mb->dataOffset - sizeof(MEMBLOCK);
+
+  return used > fb->peak ? used : fb->peak;
+
+  }  /*  end of Pk_EC  */
+
 /***  Fre_EC.c  **************************************************************/
 
 /*  Free blocks allocated by Alc_EC.  */
@@ -24,6 +24,8 @@ void *Alc_EC( char **block, long size, const char *file, int line );
 void *Alc_ECI( long size, const char *, int );
 void Chk_EC( void *block, const char *, int );
 void *Clr_EC( void *block, const char *, int );
+void *Rst_EC( void *block, const char *, int );
+long Pk_EC( void *block );
 void *Fre_EC( void *block, const char *, int );
 
 /*
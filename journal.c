@@ -0,0 +1,275 @@
+/*subfile:  Journal.c  *******************************************************/
+
+/*  Checkpoint journal for long View3D runs.
+ *
+ *  Completed rows of AF are appended to the journal file at intervals of
+ *  vfCtrl->jnlTime seconds.  A run of the same input with the same
+ *  journal reads the completed rows and computes only the others.
+ *  The journal is tied to its input by a hash of the surface data and
+ *  the control values that affect AF; a journal of other input is
+ *  rejected.  The file is binary in the byte order of the computer:
+ *    header:  "V3DJRN01", hash, nRadSrf
+ *    record:  row N, AF[N][1] ... AF[N][N-1], check
+ *  where check is a hash of the record.  A record cut short by the end
+ *  of a failed run is ignored and removed from the file.  */
+
+#ifdef _DEBUG
+# define DEBUG 1
+#else
+# define DEBUG 0
+#endif
+
+#define V3D_BUILD
+#include "journal.h"
+
+#include <stdio.h>
+#include <string.h> /* prototype: memcmp, memcpy */
+#include <time.h>   /* prototype: time */
+#include "types.h"
+#include "misc.h"
+#include "heap.h"
+
+#define JMAGIC "V3DJRN01"
+#define FNV_BASIS 2166136261U
+#define FNV_PRIME 16777619U
+
+static unsigned int HashBytes( unsigned int h, const void *p, size_t n );
+static unsigned int InputHash( SRFDAT3D *srf, const int *base,
+  View3DControlData *vfCtrl );
+static void TruncateJournal( const char *fileName, long size );
+
+/***  HashBytes.c  ***********************************************************/
+
+/*  Add N bytes at P to FNV-1a hash H.  */
+
+static unsigned int HashBytes( unsigned int h, const void *p, size_t n )
+  {
+  const unsigned char *c = p;
+
+  while( n-- )
+    {
+    h ^= *c++;
+    h *= FNV_PRIME;
+    }
+
+  return h;
+
+  }  /* end HashBytes */
+
+/***  InputHash.c  ***********************************************************/
+
+/*  Hash of the surface data and the control values which determine AF.
+ *  The number of threads and the row range are not included.  */
+
+static unsigned int InputHash( SRFDAT3D *srf, const int *base,
+  View3DControlData *vfCtrl )
+  {
+  unsigned int h = FNV_BASIS;
+  int n, j;
+
+  h = HashBytes( h, &vfCtrl->nAllSrf, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->nRadSrf, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->nMaskSrf, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->epsAdap, sizeof(double) );
+  h = HashBytes( h, &vfCtrl->maxRecursALI, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->maxRecursion, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->minRecursion, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->prjReverse, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->shaft, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->nest, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->unite, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->engine, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->farField, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->adapt, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->budget, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->rect, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->unob, sizeof(int) );
+  h = HashBytes( h, &vfCtrl->fp32, sizeof(int) );
+  for( n=1; n<=vfCtrl->nAllSrf; n++ )
+    {
+    h = HashBytes( h, &srf[n].nv, sizeof(int) );
+    h = HashBytes( h, &srf[n].shape, sizeof(int) );
+    h = HashBytes( h, &srf[n].type, sizeof(int) );
+    h = HashBytes( h, &srf[n].area, sizeof(double) );
+    h = HashBytes( h, &srf[n].dc, sizeof(DirCos) );
+    for( j=0; j<srf[n].nv; j++ )
+      h = HashBytes( h, srf[n].v[j], sizeof(Vec3) );
+    if( n <= vfCtrl->nRadSrf )
+      h = HashBytes( h, base+n, sizeof(int) );
+    }
+
+  return h;
+
+  }  /* end InputHash */
+
+/***  JournalOpen.c  *********************************************************/
+
+/*  Open journal FILENAME for rows N1 to NN of AF.  Rows found in an
+ *  existing journal are copied to AF and marked done.  */
+
+V3DJournal *JournalOpen( const char *fileName, int interval, SRFDAT3D *srf,
+  const int *base, View3DControlData *vfCtrl, double **AF, int n1, int nn )
+  {
+  V3DJournal *jnl;
+  FILE *file;
+  double *row;        /* values of one record */
+  long good=0;        /* size of the valid part of the journal */
+  int nSrf = vfCtrl->nRadSrf;
+
+  jnl = V3D_NEW( V3DJournal );
+  jnl->hash = InputHash( srf, base, vfCtrl );
+  jnl->n1 = n1;
+  jnl->nn = nn;
+  jnl->done = Alc_V( n1, nn, sizeof(char), __FILE__, __LINE__ );
+  jnl->pending = Alc_V( 0, nn-n1, sizeof(int), __FILE__, __LINE__ );
+  jnl->nPending = 0;
+  jnl->interval = interval;
+  jnl->nLoaded = 0;
+
+  file = fopen( fileName, "rb" );
+  if( file )         /* read existing journal */
+    {
+    char magic[8];
+    unsigned int hash, check;
+    int n, k;
+
+    if( fread( magic, 1, 8, file ) != 8 || memcmp( magic, JMAGIC, 8 ) ||
+        fread( &hash, sizeof(unsigned int), 1, file ) != 1 ||
+        fread( &k, sizeof(int), 1, file ) != 1 )
+      error( 3, __FILE__, __LINE__, "Not a View3D journal: ", fileName, "" );
+    if( hash != jnl->hash || k != nSrf )
+      error( 3, __FILE__, __LINE__, "Journal ", fileName,
+        " is for other input data; remove it to start again", "" );
+    good = ftell( file );
+
+    row = Alc_V( 0, nSrf, sizeof(double), __FILE__, __LINE__ );
+    while( fread( &n, sizeof(int), 1, file ) == 1 )
+      {
+      if( n < 1 || n > nSrf ) break;
+      if( fread( row+1, sizeof(double), n-1, file ) != (size_t)(n-1) ) break;
+      if( fread( &check, sizeof(unsigned int), 1, file ) != 1 ) break;
+      if( check != HashBytes( HashBytes( FNV_BASIS, &n, sizeof(int) ),
+          row+1, (n-1)*sizeof(double) ) ) break;
+      good = ftell( file );
+      if( n >= n1 && n <= nn && !jnl->done[n] )
+        {
+        memcpy( AF[n]+1, row+1, (n-1)*sizeof(double) );
+        AF[n][n] = 0.0;
+        jnl->done[n] = 1;
+        jnl->nLoaded++;
+        }
+      }
+    Fre_V( row, 0, nSrf, sizeof(double), __FILE__, __LINE__ );
+    fseek( file, 0L, SEEK_END );
+    if( ftell( file ) > good )
+      {
+      fclose( file );
+      error( 1, __FILE__, __LINE__, "Removing incomplete record from journal ",
+        fileName, "" );
+      TruncateJournal( fileName, good );
+      }
+    else
+      fclose( file );
+    jnl->file = fopen( fileName, "ab" );
+    }
+  else               /* new journal */
+    {
+    jnl->file = fopen( fileName, "wb" );
+    if( jnl->file )
+      {
+      fwrite( JMAGIC, 1, 8, jnl->file );
+      fwrite( &jnl->hash, sizeof(unsigned int), 1, jnl->file );
+      fwrite( &nSrf, sizeof(int), 1, jnl->file );
+      fflush( jnl->file );
+      }
+    }
+  if( !jnl->file )
+    error( 3, __FILE__, __LINE__, "Could not open journal: ", fileName, "" );
+  jnl->lastWrite = time( NULL );
+#ifdef LOGGING
+  fprintf( _ulog, "JournalOpen: %s, %d rows done\n", fileName, jnl->nLoaded );
+#endif
+
+  return jnl;
+
+  }  /* end JournalOpen */
+
+/***  TruncateJournal.c  *****************************************************/
+
+/*  Keep only the first SIZE bytes of the journal; ANSI C has no
+ *  truncate(), so copy them to a new file.  */
+
+static void TruncateJournal( const char *fileName, long size )
+  {
+  char tmpName[LINELEN+8];
+  char buf[4096];
+  FILE *in, *out;
+  size_t k;
+
+  sprintf( tmpName, "%.*s.tmp", LINELEN, fileName );
+  in = fopen( fileName, "rb" );
+  out = fopen( tmpName, "wb" );
+  if( !in || !out )
+    error( 3, __FILE__, __LINE__, "Could not rewrite journal: ", fileName, "" );
+  while( size > 0 )
+    {
+    k = size < (long)sizeof(buf) ? (size_t)size : sizeof(buf);
+    if( fread( buf, 1, k, in ) != k || fwrite( buf, 1, k, out ) != k )
+      error( 3, __FILE__, __LINE__, "Could not rewrite journal: ", fileName, "" );
+    size -= (long)k;
+    }
+  fclose( in );
+  if( fclose( out ) || remove( fileName ) || rename( tmpName, fileName ) )
+    error( 3, __FILE__, __LINE__, "Could not rewrite journal: ", fileName, "" );
+
+  }  /* end TruncateJournal */
+
+/***  JournalRow.c  **********************************************************/
+
+/*  Note that row N of AF is complete; write the completed rows if
+ *  the interval has passed.  */
+
+void JournalRow( V3DJournal *jnl, double **AF, int n )
+  {
+  jnl->pending[jnl->nPending++] = n;
+  if( time( NULL ) - jnl->lastWrite >= jnl->interval )
+    JournalWrite( jnl, AF );
+
+  }  /* end JournalRow */
+
+/***  JournalWrite.c  ********************************************************/
+
+/*  Append the completed rows to the journal.  */
+
+void JournalWrite( V3DJournal *jnl, double **AF )
+  {
+  int j, n;
+
+  for( j=0; j<jnl->nPending; j++ )
+    {
+    unsigned int check;
+    n = jnl->pending[j];
+    check = HashBytes( HashBytes( FNV_BASIS, &n, sizeof(int) ),
+      AF[n]+1, (n-1)*sizeof(double) );
+    fwrite( &n, sizeof(int), 1, jnl->file );
+    fwrite( AF[n]+1, sizeof(double), n-1, jnl->file );
+    fwrite( &check, sizeof(unsigned int), 1, jnl->file );
+    }
+  if( fflush( jnl->file ) )
+    error( 2, __FILE__, __LINE__, "Failed to write journal", "" );
+  jnl->nPending = 0;
+  jnl->lastWrite = time( NULL );
+
+  }  /* end JournalWrite */
+
+/***  JournalClose.c  ********************************************************/
+
+void JournalClose( V3DJournal *jnl, double **AF )
+  {
+  JournalWrite( jnl, AF );
+  fclose( jnl->file );
+  Fre_V( jnl->pending, 0, jnl->nn-jnl->n1, sizeof(int), __FILE__, __LINE__ );
+  Fre_V( jnl->done, jnl->n1, jnl->nn, sizeof(char), __FILE__, __LINE__ );
+  V3D_FREE( V3DJournal, jnl );
+
+  }  /* end JournalClose */
@@ -0,0 +1,28 @@
+#ifndef V3D_JOURNAL_H
+#define V3D_JOURNAL_H
+
+/*  Checkpoint journal of completed AF rows; see journal.c.  */
+
+#include <stdio.h>
+#include <time.h>
+#include "view3d.h"
+
+typedef struct{         /* checkpoint journal */
+  FILE *file;           /* journal file, open for appending */
+  unsigned int hash;    /* hash of the surfaces and control values */
+  int n1, nn;           /* rows of AF being computed */
+  char *done;           /* done[n] = 1 if row n is complete [n1:nn] */
+  int *pending;         /* completed rows not yet written [0:nn-n1] */
+  int nPending;         /* number of pending rows */
+  int interval;         /* seconds between writes */
+  time_t lastWrite;     /* time of last write */
+  int nLoaded;          /* number of rows read at start */
+} V3DJournal;
+
+V3DJournal *JournalOpen( const char *fileName, int interval, SRFDAT3D *srf,
+  const int *base, View3DControlData *vfCtrl, double **AF, int n1, int nn );
+void JournalRow( V3DJournal *jnl, double **AF, int n );
+void JournalWrite( V3DJournal *jnl, double **AF );
+void JournalClose( V3DJournal *jnl, double **AF );
+
+#endif
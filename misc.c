@@ -22,6 +22,8 @@
 #define ANSIC 1     // 1 to use only ANSI C code for Path functions
 
 int _emode=1;   /* error message mode: 0=logFile, 1=DOS console, 2=Windows */
+V3D_TLS jmp_buf *_fatalJmp=NULL;  /* if not NULL, a fatal error longjmp()s here
+                                     instead of calling exit(); see v3d_session */
 
 /* forward decsl */
 
@@ -115,7 +117,7 @@ int error( int severity, const char *file, const int line, ... ){
   va_list argp;        /* variable argument list */
   char start[]=" ";      /* leading blank in message */
   char *msg, *s;
-  static int count=0;   /* count of severe errors */
+  static V3D_TLS int count=0;   /* count of severe errors */
   static const char *head[4] = { "NOTE", "WARNING", "ERROR", "FATAL" };
   int n=1;
 
@@ -149,6 +151,8 @@ int error( int severity, const char *file, const int line, ... ){
       errora( head[severity], message, source );
     if( severity>2 )
       {
+      if( _fatalJmp )
+        longjmp( *_fatalJmp, 1 );
       if( _ulog )
         fclose( _ulog );  // exit() closes files
       exit( 1 );
@@ -205,8 +209,11 @@ static void errorc( int severity, char *message ){
     fprintf( _ulog, "%s %s\n", head[severity], message );
     fflush( _ulog );
   }
-  if( severity > 2 )
+  if( severity > 2 ){
+    if( _fatalJmp )
+      longjmp( *_fatalJmp, 1 );
     exit( 1 );
+  }
 
 }  /*  end of errorc  */
 
@@ -398,9 +405,9 @@ void PathCWD( char *path, int szp ){
 
 }  /* end PathCWD */
 
-extern FILE *_unxt = NULL;   /* NXT input file */
-extern int _echo;      /* if true, echo NXT input file */
-char *_nxtbuf;   /* large buffer for NXT input file */
+extern V3D_TLS FILE *_unxt;   /* NXT input file; defined in common.c */
+extern V3D_TLS int _echo;      /* if true, echo NXT input file */
+V3D_TLS char *_nxtbuf;   /* large buffer for NXT input file */
 
 
 
@@ -699,9 +706,9 @@ int FltCon( char *str, float *f )
 
 char *FltStr( double f, int n )
   {
-  static char string[NMAX][32];  /* string long enough for any practical value */
+  static V3D_TLS char string[NMAX][32];  /* string long enough for any practical value */
   char format[8];
-  static int index=0;
+  static V3D_TLS int index=0;
 
   if( ++index == NMAX )
     index = 0;
@@ -810,8 +817,8 @@ int IntCon( char *str, int *i )
 
 char *IntStr( long i )
   {
-  static char string[NMAX][12];  // strings long enough for 32-bit integers
-  static int index=0;
+  static V3D_TLS char string[NMAX][12];  // strings long enough for 32-bit integers
+  static V3D_TLS int index=0;
 
   if( ++index == NMAX )
     index = 0;
@@ -1,8 +1,11 @@
 #ifndef V3D_MISC_H
 #define V3D_MISC_H
 
+#include <setjmp.h>
 #include "common.h"
 
+V3D_API V3D_TLS jmp_buf *_fatalJmp;
+
 V3D_API int error(int severity, const char *file, const int line,...);
 
 V3D_API void PathMerge(char *fullpath, int szfp, char *drv, char *path, char *name, char *ext);
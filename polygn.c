@@ -1,11 +1,15 @@
 /*subfile:  Polygn.c  ********************************************************/
 
 /* The functions in this file maintain:
- *   a stack of free vertex/edge structures,
+ *   contiguous arrays of vertex/edge data,
  *   a stack of free polygon structures, and
  *   one or more stacks of defined polygon structures.
  * Only one defined polygon stack may be created at a time.
- * However, multiple stacks may be saved by using external pointers. */
+ * However, multiple stacks may be saved by using external pointers.
+ * The vertices and edges of a polygon are a contiguous section of the
+ * _vx, _vy, _ea, _eb, _ec arrays.  Sections are taken from the top of
+ * the arrays and are reused only when InitPolygonMem() clears them or
+ * when the polygon at the top is freed. */
 
 #ifdef _DEBUG
 # define DEBUG 1
@@ -26,17 +30,32 @@
 #include "heap.h"
 
 static int TransferVrt(Vec2 *toVrt, const Vec2 *fromVrt, int nFromVrt);
-
-char *_memPoly=NULL; /* memory block for polygon descriptions; must start NULL */
-PolygonVertexEdge *_nextFreeVE; /* pointer to next free vertex/edge */
-Polygon *_nextFreePD; /* pointer to next free polygon descripton */
-Polygon *_nextUsedPD; /* pointer to top-of-stack used polygon */
-double _epsDist;   /* minimum distance between vertices */
-double _epsArea;   /* minimum surface area */
-Vec2 *_leftVrt;  /* coordinates of vertices to left of edge */
-Vec2 *_rightVrt; /* coordinates of vertices to right of edge */
-Vec2 *_tempVrt;  /* coordinates of temporary polygon */
-int *_u=NULL;  /* +1 = vertex left of edge; -1 = vertex right of edge */
+static void ReservePolygonVrt( const int nVrt );
+static void ReserveUnionMem( const int nShade, const int nEnd );
+
+/* One set of these per thread; each View3DParallel worker calls
+ * InitTmpVertMem() and InitPolygonMem() for its own copy. */
+V3D_TLS char *_memPoly=NULL; /* memory block for polygon descriptions; must start NULL */
+V3D_TLS double *_memVE=NULL; /* memory block for vertex/edge arrays */
+V3D_TLS int _maxVE=0;   /* capacity of the vertex/edge arrays */
+V3D_TLS int _nextFreeVE; /* index of next free vertex/edge */
+V3D_TLS int _peakVE=0;   /* most vertices/edges used before a reset */
+V3D_TLS double *_vx, *_vy; /* X and Y coordinates of the vertices */
+V3D_TLS double *_ea, *_eb, *_ec; /* A, B & C homogeneous coordinates of the edges */
+V3D_TLS Polygon *_nextFreePD; /* pointer to next free polygon descripton */
+V3D_TLS Polygon *_nextUsedPD; /* pointer to top-of-stack used polygon */
+V3D_TLS double _epsDist;   /* minimum distance between vertices */
+V3D_TLS double _epsArea;   /* minimum surface area */
+V3D_TLS Vec2 *_leftVrt;  /* coordinates of vertices to left of edge */
+V3D_TLS Vec2 *_rightVrt; /* coordinates of vertices to right of edge */
+V3D_TLS Vec2 *_tempVrt;  /* coordinates of temporary polygon */
+V3D_TLS int *_u=NULL;  /* +1 = vertex left of edge; -1 = vertex right of edge */
+V3D_TLS int _maxShade=0; /* capacity of the UnshadedEdges() shade arrays */
+V3D_TLS const Polygon **_shadeList=NULL; /* shade polygons */
+V3D_TLS double *_shadeBox;   /* shade bounding boxes: xmin, xmax, ymin, ymax */
+V3D_TLS double *_shadeCover; /* covered portions of an edge */
+V3D_TLS int _maxEnd=0;   /* capacity of _edgeEnd */
+V3D_TLS Vec2 *_edgeEnd=NULL; /* start and end of unshaded edge pieces */
 
 /*  Extensive use is made of 'homogeneous coordinates' (HC) which are not 
  *  familiar to most engineers.  The important properties of HC are 
@@ -74,7 +93,8 @@ int *_u=NULL;  /* +1 = vertex left of edge; -1 = vertex right of edge */
 int PolygonOverlap(const Polygon *p1, Polygon *p2, const int savePD, int freeP2){
   Polygon *pp;     /* pointer to polygon */
   Polygon *initUsedPD;  /* initial top-of-stack pointer */
-  PolygonVertexEdge *pv1;    /* pointer to edge of P1 */
+  const double *ea, *eb, *ec;  /* HC of the edges of P1 */
+  int e1;        /* index of edge of P1 */
   int nLeftVrt;  /* number of vertices to left of edge */
   int nRightVrt; /* number of vertices to right of edge */
   int nTempVrt;  /* number of vertices of temporary polygon */
@@ -91,13 +111,18 @@ int PolygonOverlap(const Polygon *p1, Polygon *p2, const int savePD, int freeP2)
 
   initUsedPD = _nextUsedPD;
   nTempVrt = GetPolygonVrt2D( p2, _tempVrt );
+      /* space for the overlap polygon and one outside polygon per edge;
+       * the arrays are not moved by SetPolygonHC() within this loop */
+  ReservePolygonVrt( (p1->nVE + 1) * _maxNVT );
+  ea = _ea + p1->firstVE;
+  eb = _eb + p1->firstVE;
+  ec = _ec + p1->firstVE;
 
 #if( DEBUG > 1 )
   DumpP2D( "P2:", nTempVrt, _tempVrt );
 #endif
 
-  pv1 = p1->firstVE;
-  do{  /*  process tempVrt against each edge of P1 (long loop) */
+  for( e1=0; e1<p1->nVE; e1++ ){  /*  process tempVrt against each edge of P1 (long loop) */
        /*  transfer tempVrt into leftVrt and/or rightVrt  */
     double a1, b1, c1; /* HC for current edge of P1 */
 //    int u[MAXNVT];  /* +1 = vertex left of edge; -1 = vertex right of edge */
@@ -108,8 +133,7 @@ int PolygonOverlap(const Polygon *p1, Polygon *p2, const int savePD, int freeP2)
 #endif
  
         /* compute and save u[j] - relations of vertices to edge */
-    a1 = pv1->a; b1 = pv1->b; c1 = pv1->c;
-    pv1 = pv1->next;
+    a1 = ea[e1]; b1 = eb[e1]; c1 = ec[e1];
     for( j=0; j<nTempVrt; j++ )
       {
       double dot = _tempVrt[j].x * a1 + _tempVrt[j].y * b1 + c1;
@@ -216,7 +240,7 @@ int PolygonOverlap(const Polygon *p1, Polygon *p2, const int savePD, int freeP2)
     if( nTempVrt < 2 ) /* 2 instead of 3 allows degenerate P2; espArea = 0 */
       goto p2_outside_p1;
 
-    }  while( pv1 != p1->firstVE );    /* end of P1 long loop */
+    }  /* end of P1 long loop */
 
   /* At this point tempVrt contains the overlap of P1 and P2. */
 
@@ -249,20 +273,20 @@ p2_outside_p1:     /* no overlap between P1 and P2 */
       }
     else                 /* copy P2 to new stack */
       {
-      PolygonVertexEdge *pv, *pv2;
+      size_t size = p2->nVE * sizeof(double);
+      int j2 = p2->firstVE;
       pp = GetPolygonHC();      /* get cleared polygon data area */
       pp->area = p2->area;      /* copy P2 data */
       pp->trns = p2->trns;
-      pv2 = p2->firstVE;
-      do{
-        if( pp->firstVE )
-          pv = pv->next = GetVrtEdgeHC();
-        else
-          pv = pp->firstVE = GetVrtEdgeHC();
-        memcpy( pv, pv2, sizeof(PolygonVertexEdge) );   /* copy vertex/edge data */
-        pv2 = pv2->next;
-        } while( pv2 != p2->firstVE );
-      pv->next = pp->firstVE;   /* complete circular list */
+      ReservePolygonVrt( p2->nVE );
+      pp->firstVE = j = _nextFreeVE;
+      pp->nVE = p2->nVE;
+      _nextFreeVE += p2->nVE;
+      memcpy( _vx+j, _vx+j2, size );   /* copy vertex/edge data */
+      memcpy( _vy+j, _vy+j2, size );
+      memcpy( _ea+j, _ea+j2, size );
+      memcpy( _eb+j, _eb+j2, size );
+      memcpy( _ec+j, _ec+j2, size );
 #if( DEBUG > 1 )
     DumpHC( "COPIED SURFACE:", pp, pp );
 #endif
@@ -326,11 +350,20 @@ Polygon *SetPolygonHC( const int nVrt, const Vec2 *polyVrt, const double trns )
              index from 0 to nVrt-1. */
   {
   Polygon *pp;    /* pointer to polygon */
-  PolygonVertexEdge *pv;    /* pointer to HC vertices/edges */
+  double *vx, *vy, *ea, *eb, *ec;  /* HC vertices/edges of the polygon */
   double area=0.0; /* polygon area */
   int j, jm1;   /* vertex indices;  jm1 = j - 1 */
 
   pp = GetPolygonHC();      /* get cleared polygon data area */
+  ReservePolygonVrt( nVrt );
+  pp->firstVE = _nextFreeVE;
+  pp->nVE = nVrt;
+  _nextFreeVE += nVrt;
+  vx = _vx + pp->firstVE;
+  vy = _vy + pp->firstVE;
+  ea = _ea + pp->firstVE;
+  eb = _eb + pp->firstVE;
+  ec = _ec + pp->firstVE;
 #if( DEBUG > 1 )
   fprintf( _ulog, " SetPolygonHC:  pp [%p]  nv %d\n", pp, nVrt );
 #endif
@@ -338,18 +371,13 @@ Polygon *SetPolygonHC( const int nVrt, const Vec2 *polyVrt, const double trns )
   jm1 = nVrt - 1;
   for( j=0; j<nVrt; jm1=j++ )  /* loop through vertices */
     {
-    if( pp->firstVE )
-      pv = pv->next = GetVrtEdgeHC();
-    else
-      pv = pp->firstVE = GetVrtEdgeHC();
-    pv->x = polyVrt[j].x;
-    pv->y = polyVrt[j].y;
-    pv->a = polyVrt[jm1].y - polyVrt[j].y; /* compute HC values */
-    pv->b = polyVrt[j].x - polyVrt[jm1].x;
-    pv->c = polyVrt[j].y * polyVrt[jm1].x - polyVrt[j].x * polyVrt[jm1].y;
-    area -= pv->c;
+    vx[j] = polyVrt[j].x;
+    vy[j] = polyVrt[j].y;
+    ea[j] = polyVrt[jm1].y - polyVrt[j].y; /* compute HC values */
+    eb[j] = polyVrt[j].x - polyVrt[jm1].x;
+    ec[j] = polyVrt[j].y * polyVrt[jm1].x - polyVrt[j].x * polyVrt[jm1].y;
+    area -= ec[j];
     }
-  pv->next = pp->firstVE;    /* complete circular list */
 
   pp->area = 0.5 * area;
   pp->trns = trns;
@@ -388,36 +416,53 @@ Polygon *GetPolygonHC( void )
     {
     pp = _nextFreePD;
     _nextFreePD = _nextFreePD->next;
-    memset( pp, 0, sizeof(Polygon) );  /* clear pointers */
     }
   else
     pp = Alc_EC( &_memPoly, sizeof(Polygon), __FILE__, __LINE__ );
+  memset( pp, 0, sizeof(Polygon) );  /* clear pointers */
 
   return pp;
 
   }  /* end GetPolygonHC */
 
-/***  GetVrtEdgeHC.c  ********************************************************/
+/***  ReservePolygonVrt.c  ***************************************************/
 
-/*  Return pointer to an uncleared vertex/edge structure.  
- *  This is taken from the list of unused structures if possible.  
- *  Otherwise, a new structure will be allocated.  */
+/*  Make room for NVRT more vertices/edges at the top of the polygon arrays.
+ *  The arrays are enlarged when necessary, which moves them; polygons
+ *  refer to their vertices by index, so the polygons are not changed.
+ *  Each array starts on a 64-byte boundary.  */
 
-PolygonVertexEdge *GetVrtEdgeHC( void )
+static void ReservePolygonVrt( const int nVrt )
   {
-  PolygonVertexEdge *pv;  /* pointer to vertex/edge structure */
+  double *mem, *vx;
+  int max;
 
-  if( _nextFreeVE )
+  if( _nextFreeVE + nVrt <= _maxVE ) return;
+
+  for( max=_maxVE>0 ? 2*_maxVE : 1024; max<_nextFreeVE+nVrt; max*=2 )
+    ;
+  mem = Alc_V( 0, 5*max+7, sizeof(double), __FILE__, __LINE__ );
+  vx = (double *)(((size_t)mem + 63) & ~(size_t)63);
+  if( _nextFreeVE > 0 )
     {
-    pv = _nextFreeVE;
-    _nextFreeVE = _nextFreeVE->next;
+    size_t size = _nextFreeVE * sizeof(double);
+    memcpy( vx, _vx, size );
+    memcpy( vx+max, _vy, size );
+    memcpy( vx+2*max, _ea, size );
+    memcpy( vx+3*max, _eb, size );
+    memcpy( vx+4*max, _ec, size );
     }
-  else
-    pv = Alc_EC( &_memPoly, sizeof(PolygonVertexEdge), __FILE__, __LINE__ );
-
-  return pv;
-
-  }  /* end GetVrtEdgeHC */
+  if( _memVE )
+    Fre_V( _memVE, 0, 5*_maxVE+7, sizeof(double), __FILE__, __LINE__ );
+  _memVE = mem;
+  _maxVE = max;
+  _vx = vx;
+  _vy = vx + max;
+  _ea = vx + 2*max;
+  _eb = vx + 3*max;
+  _ec = vx + 4*max;
+
+  }  /* end ReservePolygonVrt */
 
 /***  FreePolygons.c  ********************************************************/
 
@@ -428,19 +473,15 @@ void FreePolygons( Polygon *first, Polygon *last )
  * last;   - pointer to polygon AFTER last one freed (NULL = complete list). */
   {
   Polygon *pp; /* pointer to polygon */
-  PolygonVertexEdge *pv; /* pointer to edge/vertex */
 
   for( pp=first; ; pp=pp->next )
     {
 #if( DEBUG > 0 )
     if( !pp ) error( 3, __FILE__, __LINE__, "Polygon PP not defined", "" );
-    if( !pp->firstVE ) error( 3, __FILE__, __LINE__, "FirstVE not defined", "" );
+    if( pp->nVE < 1 ) error( 3, __FILE__, __LINE__, "FirstVE not defined", "" );
 #endif
-    pv = pp->firstVE->next;           /* free vertices (circular list) */
-    while( pv->next != pp->firstVE )  /* find "end" of vertex list */
-      pv = pv->next;
-    pv->next = _nextFreeVE;           /* reset vertex links */
-    _nextFreeVE = pp->firstVE;
+    if( pp->firstVE + pp->nVE == _nextFreeVE )  /* free vertices at top */
+      _nextFreeVE = pp->firstVE;
     if( pp->next == last ) break;
     }
   pp->next = _nextFreePD;       /* reset polygon links */
@@ -475,15 +516,14 @@ Polygon *TopOfPolygonStack( void )
 
 int GetPolygonVrt2D( const Polygon *pp, Vec2 *polyVrt )
   {
-  PolygonVertexEdge *pv;    /* pointer to HC vertices/edges */
-  int j=0;      /* vertex counter */
+  const double *vx = _vx + pp->firstVE, *vy = _vy + pp->firstVE;
+  int j;        /* vertex counter */
 
-  pv = pp->firstVE;
-  do{
-    polyVrt[j].x = pv->x;
-    polyVrt[j++].y = pv->y;
-    pv = pv->next;
-    } while( pv != pp->firstVE );
+  for( j=0; j<pp->nVE; j++ )
+    {
+    polyVrt[j].x = vx[j];
+    polyVrt[j].y = vy[j];
+    }
 
   return j;
 
@@ -496,31 +536,57 @@ int GetPolygonVrt2D( const Polygon *pp, Vec2 *polyVrt )
 
 int GetPolygonVrt3D( const Polygon *pp, Vec3 *polyVrt )
   {
-  PolygonVertexEdge *pv;    /* pointer to HC vertices/edges */
-  int j=0;      /* vertex counter */
+  const double *vx = _vx + pp->firstVE, *vy = _vy + pp->firstVE;
+  int j;        /* vertex counter */
 
-  pv = pp->firstVE;
-  do{
-    polyVrt[j].x = pv->x;
-    polyVrt[j].y = pv->y;
-    polyVrt[j++].z = 0.0;
-    pv = pv->next;
-    } while( pv != pp->firstVE );
+  for( j=0; j<pp->nVE; j++ )
+    {
+    polyVrt[j].x = vx[j];
+    polyVrt[j].y = vy[j];
+    polyVrt[j].z = 0.0;
+    }
 
   return j;
 
   }  /*  end of GetPolygonVrt3D  */
 
+/***  GetPolygonEdges.c  *****************************************************/
+
+/*  Get edges FIRST to FIRST+NE-1 of a polygon relative to point (X,Y).
+ *  Edge j runs from (AX[j],AY[j]) to (BX[j],BY[j]), from vertex j-1 to
+ *  vertex j as in V1AIpart().  Return number of edges.  */
+
+int GetPolygonEdges( const Polygon *pp, const int first, const int ne,
+  const double x, const double y, double ax[], double ay[], double bx[], double by[] )
+  {
+  const double *vx = _vx + pp->firstVE, *vy = _vy + pp->firstVE;
+  int j, k;     /* edge counter, vertex index */
+
+  for( j=0,k=first; j<ne; j++,k++ )
+    {
+    int i = k > 0 ? k - 1 : pp->nVE - 1;
+    ax[j] = vx[i] - x;
+    ay[j] = vy[i] - y;
+    bx[j] = vx[k] - x;
+    by[j] = vy[k] - y;
+    }
+
+  return j;
+
+  }  /*  end of GetPolygonEdges  */
+
 /***  FreeTmpVertMem.c  ******************************************************/
 
 /*  Free vectors for temporary overlap vertices.  */
 
 void FreeTmpVertMem( void )
   {
+  if( !_u ) return;  /* not allocated */
   Fre_V( _u, 0, _maxNVT, sizeof(int), __FILE__, __LINE__ );
   Fre_V( _tempVrt, 0, _maxNVT, sizeof(Vec2), __FILE__, __LINE__ );
   Fre_V( _rightVrt, 0, _maxNVT, sizeof(Vec2), __FILE__, __LINE__ );
   Fre_V( _leftVrt, 0, _maxNVT, sizeof(Vec2), __FILE__, __LINE__ );
+  _u = NULL;  /* allow InitTmpVertMem() again on this thread */
 
   }  /*  end FreeTmpVertMem  */
 
@@ -541,18 +607,21 @@ void InitTmpVertMem( void )
 
 /***  InitPolygonMem.c  ******************************************************/
 
-/*  Initialize polygon processing memory and globals.  */
+/*  Initialize polygon processing memory and globals.
+ *  This is called for every view point; the memory is reset, not cleared.  */
 
 void InitPolygonMem( const double epsdist, const double epsarea )
   {
-  if( _memPoly )  /* clear existing polygon structures data */
-    _memPoly = Clr_EC( _memPoly, __FILE__, __LINE__ );
+  if( _memPoly )  /* reuse existing polygon structures memory */
+    _memPoly = Rst_EC( _memPoly, __FILE__, __LINE__ );
   else            /* allocate polygon structures heap pointer */
     _memPoly = Alc_ECI( 8000, __FILE__, __LINE__ );
 
   _epsDist = epsdist;
   _epsArea = epsarea;
-  _nextFreeVE = NULL;
+  if( _nextFreeVE > _peakVE )
+    _peakVE = _nextFreeVE;
+  _nextFreeVE = 0;
   _nextFreePD = NULL;
   _nextUsedPD = NULL;
 #if( DEBUG > 1 )
@@ -569,10 +638,272 @@ void InitPolygonMem( const double epsdist, const double epsarea )
 void FreePolygonMem( void )
   {
   if( _memPoly )
+    {
+#ifdef LOGGING
+    if( _list > 1 )
+      fprintf( _ulog, "Polygon memory:  %ld bytes of structures, %d vertices\n",
+        Pk_EC( _memPoly ), MAX( _peakVE, _nextFreeVE ) );
+#endif
     _memPoly = (char *)Fre_EC( _memPoly, __FILE__, __LINE__ );
+    }
+  _peakVE = 0;
+  if( _shadeList )
+    {
+    Fre_V( _shadeBox, 0, 4*_maxShade, sizeof(double), __FILE__, __LINE__ );
+    Fre_V( _shadeCover, 0, 2*_maxShade, sizeof(double), __FILE__, __LINE__ );
+    Fre_V( _shadeList, 0, _maxShade, sizeof(Polygon *), __FILE__, __LINE__ );
+    _shadeList = NULL;
+    _maxShade = 0;
+    }
+  if( _edgeEnd )
+    {
+    Fre_V( _edgeEnd, 0, _maxEnd, sizeof(Vec2), __FILE__, __LINE__ );
+    _edgeEnd = NULL;
+    _maxEnd = 0;
+    }
+  if( _memVE )
+    {
+    Fre_V( _memVE, 0, 5*_maxVE+7, sizeof(double), __FILE__, __LINE__ );
+    _memVE = NULL;
+    _maxVE = 0;
+    _nextFreeVE = 0;
+    }
 
   }  /* end FreePolygonMem */
 
+/***  PolygonEncloses.c  *****************************************************/
+
+/*  Return 1 if polygon P2 is within convex polygon P1; otherwise 0.  */
+
+int PolygonEncloses( const Polygon *p1, const Polygon *p2 )
+  {
+  const double *vx = _vx + p2->firstVE, *vy = _vy + p2->firstVE;
+  int e, j;
+
+  for( e=p1->firstVE; e<p1->firstVE+p1->nVE; e++ )
+    for( j=0; j<p2->nVE; j++ )
+      if( vx[j] * _ea[e] + vy[j] * _eb[e] + _ec[e] > _epsArea )
+        return 0;
+
+  return 1;
+
+  }  /* end PolygonEncloses */
+
+/***  ClipEdge.c  ************************************************************/
+
+/*  Determine the portion of the directed edge from (X0,Y0) to (X1,Y1)
+ *  within the interior of convex polygon PP.  The portion is T[0] to
+ *  T[1] as fractions of the edge.  An edge lying on an edge of PP in
+ *  the same direction is inside if TIE is true;  an edge lying on an
+ *  edge of PP in the opposite direction is always outside.  Edges of
+ *  PP between duplicate vertices are ignored.
+ *  Return 1 if a portion of the edge is inside PP; otherwise 0.  */
+
+static int ClipEdge( const double x0, const double y0, const double x1,
+  const double y1, const Polygon *pp, const int tie, double t[2] )
+  {
+  double t0=0.0, t1=1.0;
+  int e;
+
+  for( e=pp->firstVE; e<pp->firstVE+pp->nVE; e++ )
+    {
+    double d0 = x0 * _ea[e] + y0 * _eb[e] + _ec[e];
+    double d1 = x1 * _ea[e] + y1 * _eb[e] + _ec[e];
+    double eps = fabs(_ea[e]) + fabs(_eb[e]);  /* ~ length of edge */
+    if( eps <= _epsDist )  /* duplicate vertex */
+      continue;
+    eps *= _epsDist;       /* distance tolerance */
+    if( fabs(d0) <= eps && fabs(d1) <= eps )  /* on the edge */
+      {
+      if( tie && (x1-x0) * _eb[e] - (y1-y0) * _ea[e] > 0.0 )
+        continue;
+      return 0;
+      }
+    if( d0 >= -eps && d1 >= -eps )  /* on or left of edge */
+      return 0;
+    if( d0 < -eps && d1 < -eps )    /* right of edge */
+      continue;
+    if( d0 < d1 )      /* leaves PP */
+      {
+      double t = d0 / (d0 - d1);
+      if( t < t1 ) t1 = t;
+      }
+    else               /* enters PP */
+      {
+      double t = d0 / (d0 - d1);
+      if( t > t0 ) t0 = t;
+      }
+    if( t0 >= t1 )
+      return 0;
+    }
+  t[0] = t0;
+  t[1] = t1;
+
+  return 1;
+
+  }  /* end ClipEdge */
+
+/***  ReserveUnionMem.c  *****************************************************/
+
+/*  Make room for NSHADE shadows and NEND edge ends in the UnshadedEdges()
+ *  work arrays.  */
+
+static void ReserveUnionMem( const int nShade, const int nEnd )
+  {
+  if( nShade > _maxShade )
+    {
+    if( _shadeList )
+      {
+      Fre_V( _shadeBox, 0, 4*_maxShade, sizeof(double), __FILE__, __LINE__ );
+      Fre_V( _shadeCover, 0, 2*_maxShade, sizeof(double), __FILE__, __LINE__ );
+      Fre_V( _shadeList, 0, _maxShade, sizeof(Polygon *), __FILE__, __LINE__ );
+      }
+    _maxShade = 2 * nShade;
+    _shadeBox = Alc_V( 0, 4*_maxShade, sizeof(double), __FILE__, __LINE__ );
+    _shadeCover = Alc_V( 0, 2*_maxShade, sizeof(double), __FILE__, __LINE__ );
+    _shadeList = Alc_V( 0, _maxShade, sizeof(Polygon *), __FILE__, __LINE__ );
+    }
+  if( nEnd > _maxEnd )
+    {
+    Vec2 *ends;
+    int max = 2 * nEnd;
+    ends = Alc_V( 0, max, sizeof(Vec2), __FILE__, __LINE__ );
+    if( _edgeEnd )
+      {
+      memcpy( ends, _edgeEnd, _maxEnd * sizeof(Vec2) );
+      Fre_V( _edgeEnd, 0, _maxEnd, sizeof(Vec2), __FILE__, __LINE__ );
+      }
+    _edgeEnd = ends;
+    _maxEnd = max;
+    }
+
+  }  /* end ReserveUnionMem */
+
+/***  AddEdgePieces.c  *******************************************************/
+
+/*  Add to _edgeEnd the portions of edge (X0,Y0) to (X1,Y1) within LO to HI
+ *  that are not covered by the NCOVER intervals in COVER, reversing the
+ *  direction if REV is true.  Return the new number of edge ends, N.  */
+
+static int AddEdgePieces( int n, const double x0, const double y0,
+  const double x1, const double y1, double lo, const double hi,
+  double *cover, const int nCover, const int rev )
+  {
+  int i, j;
+
+  for( i=1; i<nCover; i++ )  /* sort intervals by start */
+    {
+    double s = cover[2*i], e = cover[2*i+1];
+    for( j=i; j>0 && cover[2*j-2] > s; j-- )
+      {
+      cover[2*j] = cover[2*j-2];
+      cover[2*j+1] = cover[2*j-1];
+      }
+    cover[2*j] = s;
+    cover[2*j+1] = e;
+    }
+
+  for( i=0; lo<hi; i++ )
+    {
+    double s = i<nCover ? cover[2*i] : hi;
+    if( s > lo )   /* uncovered piece from lo to s */
+      {
+      double t0 = lo, t1 = s < hi ? s : hi;
+      ReserveUnionMem( 0, n+2 );
+      if( rev )
+        { double t = t0; t0 = t1; t1 = t; }
+      _edgeEnd[n].x = x0 + t0 * (x1 - x0);
+      _edgeEnd[n++].y = y0 + t0 * (y1 - y0);
+      _edgeEnd[n].x = x0 + t1 * (x1 - x0);
+      _edgeEnd[n++].y = y0 + t1 * (y1 - y0);
+      }
+    if( i >= nCover ) break;
+    if( cover[2*i+1] > lo ) lo = cover[2*i+1];
+    }
+
+  return n;
+
+  }  /* end AddEdgePieces */
+
+/***  UnshadedEdges.c  *******************************************************/
+
+/*  Determine the boundary of the portion of convex polygon BASE not
+ *  covered by the union of the convex polygons in the stack SHADES.
+ *  The boundary is the portions of the edges of BASE outside all shades
+ *  plus the portions of the edges of the shades inside BASE and outside
+ *  all other shades, the latter reversed.  Where edges of two shades
+ *  coincide in the same direction only the first is used.  The contours
+ *  are not assembled:  the view factor contour integral is a sum over
+ *  the directed edges, so the pieces are all that is needed.
+ *  Return the number of edge pieces;  *ENDS is set to the start and end
+ *  of each piece, valid until the next call.  */
+
+int UnshadedEdges( const Polygon *base, const Polygon *shades, Vec2 **ends )
+  {
+  const Polygon *pp;
+  double t[2];
+  int nShade, nCover;
+  int n=0, i, j, e, em1;
+
+  for( nShade=0,pp=shades; pp; pp=pp->next )
+    nShade++;
+  ReserveUnionMem( nShade, 2*base->nVE );
+  for( i=0,pp=shades; pp; pp=pp->next,i++ )  /* shade bounding boxes */
+    {
+    double *box = _shadeBox + 4*i;
+    _shadeList[i] = pp;
+    box[0] = box[1] = _vx[pp->firstVE];
+    box[2] = box[3] = _vy[pp->firstVE];
+    for( e=pp->firstVE+1; e<pp->firstVE+pp->nVE; e++ )
+      {
+      if( _vx[e] < box[0] ) box[0] = _vx[e];
+      if( _vx[e] > box[1] ) box[1] = _vx[e];
+      if( _vy[e] < box[2] ) box[2] = _vy[e];
+      if( _vy[e] > box[3] ) box[3] = _vy[e];
+      }
+    }
+
+  for( i=-1; i<nShade; i++ )  /* base (-1) and shade edges */
+    {
+    pp = i<0 ? base : _shadeList[i];
+    em1 = pp->firstVE + pp->nVE - 1;
+    for( e=pp->firstVE; e<pp->firstVE+pp->nVE; em1=e++ )
+      {
+      double x0=_vx[em1], y0=_vy[em1], x1=_vx[e], y1=_vy[e];
+      double lo=0.0, hi=1.0;
+      if( i >= 0 )    /* portion of shade edge inside base */
+        {
+        if( !ClipEdge( x0, y0, x1, y1, base, 0, t ) ) continue;
+        lo = t[0];
+        hi = t[1];
+        }
+      for( nCover=j=0; j<nShade; j++ )
+        {
+        const double *box = _shadeBox + 4*j;
+        if( j == i ) continue;
+        if( MAX(x0,x1) < box[0] - _epsDist || MIN(x0,x1) > box[1] + _epsDist ||
+            MAX(y0,y1) < box[2] - _epsDist || MIN(y0,y1) > box[3] + _epsDist )
+          continue;
+        if( ClipEdge( x0, y0, x1, y1, _shadeList[j], i<0 || j<i, t ) &&
+            t[1] > lo && t[0] < hi )
+          {
+          if( t[0] <= lo && t[1] >= hi )  /* edge entirely covered */
+            break;
+          _shadeCover[2*nCover] = t[0];
+          _shadeCover[2*nCover+1] = t[1];
+          nCover++;
+          }
+        }
+      if( j < nShade ) continue;
+      n = AddEdgePieces( n, x0, y0, x1, y1, lo, hi, _shadeCover, nCover, i>=0 );
+      }
+    }
+  *ends = _edgeEnd;
+
+  return n / 2;
+
+  }  /* end UnshadedEdges */
+
 /***  LimitPolygon.c  ********************************************************/
 
 /*  This function limits the polygon coordinates to a rectangle which encloses
@@ -738,7 +1069,6 @@ int LimitPolygon( int nVrt, Vec2 polyVrt[],
 void DumpHC( char *title, const Polygon *pfp, const Polygon *plp ){
 /*  pfp, plp; pointers to first and last (NULL acceptable) polygons  */
   const Polygon *pp;
-  PolygonVertexEdge *pv;
   int i, j;
 
   fprintf( _ulog, "%s\n", title );
@@ -748,17 +1078,13 @@ void DumpHC( char *title, const Polygon *pfp, const Polygon *plp ){
     fprintf( _ulog, "  area %.4g", pp->area );
     fprintf( _ulog, "  trns %.3g", pp->trns );
     fprintf( _ulog, "  next [%p]", pp->next );
-    fprintf( _ulog, "  fve [%p]\n", pp->firstVE );
+    fprintf( _ulog, "  fve %d  nve %d\n", pp->firstVE, pp->nVE );
     if( ++i >= 100 ) error( 3, __FILE__, __LINE__, "Too many surfaces", "" );
+    if( pp->nVE >= _maxNVT ) error( 3, __FILE__, __LINE__, "Too many vertices", "" );
 
-    j = 0;
-    pv = pp->firstVE;
-    do{                  /* vertex/edge loop */
-      fprintf( _ulog, "  ve [%p] %10.7f %10.7f %10.7f %10.7f %13.8f\n",
-               pv, pv->x, pv->y, pv->a, pv->b, pv->c );
-      pv = pv->next;
-      if( ++j >= _maxNVT ) error( 3, __FILE__, __LINE__, "Too many vertices", "" );
-      } while( pv != pp->firstVE );
+    for( j=pp->firstVE; j<pp->firstVE+pp->nVE; j++ )  /* vertex/edge loop */
+      fprintf( _ulog, "  ve %d %10.7f %10.7f %10.7f %10.7f %13.8f\n",
+               j, _vx[j], _vy[j], _ea[j], _eb[j], _ec[j] );
 
     if( pp==plp ) break;
     }
@@ -775,15 +1101,6 @@ void DumpFreePolygons( void ){
   fprintf( _ulog, "\n" );
 }  /* end DumpFreePolygons */
 
-
-void DumpFreeVertices( void ){
-  PolygonVertexEdge *pv;
-
-  fprintf( _ulog, "FREE VERTICES:" );
-  for( pv=_nextFreeVE; pv; pv=pv->next )
-    fprintf( _ulog, " [%p]", pv );
-  fprintf( _ulog, "\n" );
-}  /* end DumpFreeVertices */
 #endif  /* end DEBUG > 0 */
 
 /***  DumpP3D.c  *************************************************************/
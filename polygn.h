@@ -10,10 +10,13 @@ void FreePolygons( Polygon *first, Polygon *last );
 Polygon *SetPolygonHC( const int nVrt, const Vec2 *polyVrt, const double trns );
 int GetPolygonVrt2D( const Polygon *pp, Vec2 *polyVrt );
 int GetPolygonVrt3D( const Polygon *pp, Vec3 *srfVrt );
+int GetPolygonEdges( const Polygon *pp, const int first, const int ne,
+  const double x, const double y, double ax[], double ay[], double bx[], double by[] );
 Polygon *GetPolygonHC( void );
-PolygonVertexEdge *GetVrtEdgeHC( void );
 void NewPolygonStack( void );
 Polygon *TopOfPolygonStack( void );
+int PolygonEncloses( const Polygon *p1, const Polygon *p2 );
+int UnshadedEdges( const Polygon *base, const Polygon *shades, Vec2 **ends );
 V3D_API void InitTmpVertMem( void );
 V3D_API void FreeTmpVertMem( void );
 V3D_API void InitPolygonMem( const double epsDist, const double epsArea );
@@ -22,7 +25,6 @@ int LimitPolygon( int nVrt, Vec2 polyVrt[],
   const double maxX, const double minX, const double maxY, const double minY );
 void DumpHC( char *title, const Polygon *pfp, const Polygon *plp );
 void DumpFreePolygons( void );
-void DumpFreeVertices( void );
 void DumpP2D( char *title, const int nvs, Vec2 *vs );
 void DumpP3D( char *title, const int nvs, Vec3 *vs );
 
@@ -9,6 +9,7 @@
 #include "heap.h"
 
 #include <stdio.h>
+#include <math.h>   /* prototype: fabs */
 
 /***  ReadF0s.c  *************************************************************/
 
@@ -190,3 +191,46 @@ void view_factors_destroy(ViewFactors *V){
 }
 
 
+
+/***  ReadAFRows.c  **********************************************************/
+
+/*  Read a block of AF rows saved by SaveAFRows().  */
+
+int ReadAFRows(const char *fileName, const int nSrf, const float *area
+		, double **AF, int *count
+){
+  FILE *vfin;
+  char version[36];
+  double sumA=0.0, fileSumA;
+  int nSrfF, row1, row2;
+  int n, m, k;
+
+  vfin = fopen( fileName, "r" );
+  if( !vfin )
+    error( 3, __FILE__, __LINE__, "Could not open file: ", fileName, "" );
+  if( fscanf( vfin, " View3D-rows %35s %d %d %d %lf",
+      version, &nSrfF, &row1, &row2, &fileSumA ) != 5 )
+    error( 3, __FILE__, __LINE__, "Not a View3D rows file: ", fileName, "" );
+  for( n=1; n<=nSrf; n++ )
+    sumA += area[n];
+  if( nSrfF != nSrf || fabs( fileSumA - sumA ) > 1.0e-9 * sumA )
+    error( 3, __FILE__, __LINE__, "Rows file does not match input data: ",
+      fileName, "" );
+  if( row2 > nSrf )
+    error( 3, __FILE__, __LINE__, "Bad row range in file: ", fileName, "" );
+
+  for( n=row1; n<=row2; n++ ){
+    if( fscanf( vfin, "%d", &k ) != 1 || k != n )
+      error( 3, __FILE__, __LINE__, "Missing row ", IntStr(n), " in file: ",
+        fileName, "" );
+    for( m=1; m<n; m++ )
+      if( fscanf( vfin, "%lf", &AF[n][m] ) != 1 )
+        error( 3, __FILE__, __LINE__, "Short row ", IntStr(n), " in file: ",
+          fileName, "" );
+    AF[n][n] = 0.0;
+    count[n] += 1;
+  }
+  fclose( vfin );
+
+  return row2 >= row1 ? row2 - row1 + 1 : 0;
+}  /* end of ReadAFRows */
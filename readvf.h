@@ -50,5 +50,19 @@ V3D_API ViewFactors *read_view_factors(
 
 V3D_API void view_factors_destroy(ViewFactors *V);
 
+/**
+	Read a block of rows of the triangular AF array written by SaveAFRows.
+	@param fileName name of file to be read
+	@param nSrf number of surfaces; must match the file
+	@param area surface areas; their sum must match the file
+	@param AF full triangular array [1:nSrf][] which receives the rows
+	@param count count[n] is incremented for each row n read
+
+	Returns the number of rows read.
+*/
+V3D_API int ReadAFRows(const char *fileName, const int nSrf, const float *area
+		, double **AF, int *count
+);
+
 #endif
 
@@ -18,9 +18,9 @@
 	reused in larger programs.
 */
 
-extern FILE *_unxt;   /* NXT input file */
-extern  int _echo;      /* if true, echo NXT input file */
-extern char *_nxtbuf;   /* large buffer for NXT input file */
+extern V3D_TLS FILE *_unxt;   /* NXT input file */
+extern V3D_TLS int _echo;      /* if true, echo NXT input file */
+extern V3D_TLS char *_nxtbuf;   /* large buffer for NXT input file */
 
 int LongCon( char *str, long *i);
 
@@ -238,14 +238,14 @@ static float ReadR4(FILE *inHandle){
 	reimplement it perhaps using a flex/bison approach.
 */
 static void GetCtrl( char *str, View3DControlData *vfCtrl){
-  char *p;
+  char *p, *next;  /* next: position of V3D_STRTOK */
   int i;
   float r;
 
-  p = strtok( str, "= ," );
+  p = V3D_STRTOK( str, "= ,", &next );
   while( p ){
     if( streqli( p, "eps" ) ){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( FltCon( p, &r )){
         ERROR2("Bad float value: '%s'", p);
       }else{
@@ -259,13 +259,13 @@ static void GetCtrl( char *str, View3DControlData *vfCtrl){
       }
     }
     else if( streqli( p, "list" )){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) ){
         BAD_INTEGER_VALUE(p);
       }else
         _list = i;
     }else if( streqli( p, "out" ) ){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) ){
         BAD_INTEGER_VALUE(p);
       }else{
@@ -276,21 +276,21 @@ static void GetCtrl( char *str, View3DControlData *vfCtrl){
 		}
 	  }
     }else if( streqli( p, "encl" )){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) ){
         BAD_INTEGER_VALUE(p);
       }else{
         if( i ) vfCtrl->enclosure = 1;
 	  }
     }else if( streqli( p, "emit" )){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) ){
         BAD_INTEGER_VALUE(p);
       }else{
         if( i ) vfCtrl->emittances = 1;
 	  }
     }else if( streqli( p, "maxU" ) ){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) ){
         BAD_INTEGER_VALUE(p);
       }else{
@@ -303,7 +303,7 @@ static void GetCtrl( char *str, View3DControlData *vfCtrl){
         vfCtrl->maxRecursALI = i;
       }
     }else if( streqli( p, "maxO" )){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) ){
         BAD_INTEGER_VALUE(p);
       }else{
@@ -316,7 +316,7 @@ static void GetCtrl( char *str, View3DControlData *vfCtrl){
         vfCtrl->maxRecursion = i;
       }
     }else if( streqli( p, "minO" )){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         BAD_INTEGER_VALUE(p);
       else{
@@ -327,7 +327,7 @@ static void GetCtrl( char *str, View3DControlData *vfCtrl){
         vfCtrl->minRecursion = i;
       }
     }else if( streqli( p, "row" ) ){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         BAD_INTEGER_VALUE(p);
       else{
@@ -336,7 +336,7 @@ static void GetCtrl( char *str, View3DControlData *vfCtrl){
         vfCtrl->row = i;
       }
     }else if( streqli( p, "col" ) ){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         BAD_INTEGER_VALUE(p);
       else{
@@ -345,23 +345,23 @@ static void GetCtrl( char *str, View3DControlData *vfCtrl){
         vfCtrl->col = i;
       }
     }else if( streqli( p, "prjD" ) ){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         BAD_INTEGER_VALUE(p);
       else
         if( i ) vfCtrl->prjReverse = 1;
     }else if( streqli( p, "maxV" ) ){
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
       if( IntCon( p, &i ) )
         BAD_INTEGER_VALUE(p);
       else
         _maxNVT = i;
     }else{
       ERROR1("Invalid control word: '%s'", p);
-      p = strtok( NULL, "= ," );
+      p = V3D_STRTOK( NULL, "= ,", &next );
     }
 
-    p = strtok( NULL, "= ," );    // get next word
+    p = V3D_STRTOK( NULL, "= ,", &next );    // get next word
   }
 
   if( vfCtrl->col && !vfCtrl->row )
@@ -169,3 +169,30 @@ typedef struct {
   double **AF;
 } VFResults;
 
+
+/***  SaveAFRows.c  **********************************************************/
+
+/*  Save rows ROW1 through ROW2 of the triangular AF array (area * F,
+ *  before any adjustments) for view3d-merge.  Text format:
+ *    header:  View3D-rows version nSrf row1 row2 sum(area)
+ *    one line per row N:  N AF[N][1] ... AF[N][N-1]
+ *  Values are written with 17 digits so that the merged file gives the
+ *  same results as a single run.  An empty block has row1 > row2.  */
+
+void SaveAFRows( FILE *file, char *version, int nSrf,
+                 int row1, int row2, float *area, double **AF
+){
+  double sumA=0.0;
+  int n, m;
+
+  for( n=1; n<=nSrf; n++ )
+    sumA += area[n];
+  fprintf( file, "View3D-rows %s %d %d %d %.17g\n",
+    version, nSrf, row1, row2, sumA );
+  for( n=row1; n<=row2; n++ ){
+    fprintf( file, "%d", n );
+    for( m=1; m<n; m++ )
+      fprintf( file, " %.17g", AF[n][m] );
+    fprintf( file, "\n" );
+  }
+} /* end SaveAFRows */
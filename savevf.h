@@ -8,5 +8,9 @@ V3D_API void SaveVF( FILE *file, char *program, char *version,
 		float *area, float *emit, double **AF, float *vtmp
 );
 
+V3D_API void SaveAFRows( FILE *file, char *version, int nSrf,
+		int row1, int row2, float *area, double **AF
+);
+
 #endif
 
@@ -0,0 +1,157 @@
+/*subfile:  Session.c  *******************************************************/
+
+/*  Sessions: one job's set of the thread-local library globals.
+ *  See session.h.  */
+
+#ifdef _DEBUG
+# define DEBUG 1
+#else
+# define DEBUG 0
+#endif
+
+#define V3D_BUILD
+#include "session.h"
+
+#include <stdio.h>
+#include <stdlib.h> /* prototype: free */
+#include <setjmp.h>
+#include "types.h"
+#include "misc.h"
+#include "heap.h"
+#include "polygn.h"
+#include "viewunob.h"
+
+struct v3d_session{   /* values of the globals for one job */
+  FILE *ulog;         /* log file; NULL = stderr */
+  int list;           /* output control */
+  int echo;           /* true = echo input file */
+  int maxNVT;         /* maximum number of temporary polygon vertices */
+  int status;         /* 0 = last job OK; 1 = last job failed */
+};
+
+static void SwapGlobals( v3d_session *ses );
+
+/***  v3d_session_new.c  *****************************************************/
+
+/*  Create a session with the default global values.  */
+
+v3d_session *v3d_session_new( void )
+  {
+  v3d_session *ses;
+
+  ses = V3D_NEW( v3d_session );
+  ses->ulog = NULL;
+  ses->list = 0;
+  ses->echo = 0;
+  ses->maxNVT = 12;
+  ses->status = 0;
+
+  return ses;
+
+  }  /* end v3d_session_new */
+
+/***  v3d_session_free.c  ****************************************************/
+
+void v3d_session_free( v3d_session *ses )
+  {
+  if( ses )
+    V3D_FREE( v3d_session, ses );
+
+  }  /* end v3d_session_free */
+
+/***  v3d_session_set_log.c  *************************************************/
+
+/*  Set the log file of the session; NULL for stderr.
+ *  The file is not closed by the library.  */
+
+void v3d_session_set_log( v3d_session *ses, FILE *ulog )
+  {
+  ses->ulog = ulog;
+
+  }  /* end v3d_session_set_log */
+
+/***  v3d_session_set_list.c  ************************************************/
+
+/*  Set the amount of output:  0 = summary;  1 = list view factors;
+ *  2 = echo input, note calculations;  3 = note obstructions.  */
+
+void v3d_session_set_list( v3d_session *ses, int list )
+  {
+  ses->list = list;
+
+  }  /* end v3d_session_set_list */
+
+/***  v3d_session_call.c  ****************************************************/
+
+/*  Run JOB(ARG) in the calling thread with the globals of session SES.
+ *  Return 0 if the job completed, 1 if it ended with a fatal error.  */
+
+int v3d_session_call( v3d_session *ses, void (*job)( void *arg ), void *arg )
+  {
+  jmp_buf fatal;
+  jmp_buf *prevJmp = _fatalJmp;  /* allow nested calls */
+
+  SwapGlobals( ses );
+  if( !_ulog )
+    _ulog = stderr;
+  error( -2, __FILE__, __LINE__, "" );   /* clear error count */
+  ses->status = 0;
+  if( setjmp( fatal ) == 0 )
+    {
+    _fatalJmp = &fatal;
+    job( arg );
+    }
+  else
+    {
+    _fatalJmp = NULL;   /* recover memory held by globals */
+    NxtClose();
+    FreePolygonMem();
+    FreeTmpVertMem();
+    ViewsInit( 4, 0 );
+    ses->status = 1;
+    }
+  _fatalJmp = prevJmp;
+  if( _ulog == stderr )
+    _ulog = NULL;
+  SwapGlobals( ses );
+
+  return ses->status;
+
+  }  /* end v3d_session_call */
+
+/***  v3d_results_free.c  ****************************************************/
+
+/*  Free the arrays of RES returned by processPaths() or
+ *  v3d_session_process_paths();  they are set to NULL.  */
+
+void v3d_results_free( VFResultsC *res )
+  {
+  free( res->area );
+  free( res->emit );
+  free( res->values );
+  res->area = res->emit = NULL;
+  res->values = NULL;
+
+  }  /* end v3d_results_free */
+
+/***  SwapGlobals.c  *********************************************************/
+
+/*  Exchange the thread-local globals with the values in SES.  */
+
+static void SwapGlobals( v3d_session *ses )
+  {
+  FILE *ulog = _ulog;
+  int list = _list;
+  int echo = _echo;
+  int maxNVT = _maxNVT;
+
+  _ulog = ses->ulog;
+  _list = ses->list;
+  _echo = ses->echo;
+  _maxNVT = ses->maxNVT;
+  ses->ulog = ulog;
+  ses->list = list;
+  ses->echo = echo;
+  ses->maxNVT = maxNVT;
+
+  }  /* end SwapGlobals */
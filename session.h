@@ -0,0 +1,41 @@
+#ifndef V3D_SESSION_H
+#define V3D_SESSION_H
+
+/*  Reentrant interface to the View3D library.
+ *
+ *  The library keeps its working state in thread-local globals (_ulog,
+ *  _list, the polygon memory of polygn.c, ...).  A v3d_session holds the
+ *  values of those globals belonging to one job.  v3d_session_call()
+ *  installs them in the calling thread for the duration of the job, so
+ *  jobs on different threads do not interfere.  A session may be used
+ *  by one thread at a time.
+ *
+ *  A fatal error in a job returns 1 from v3d_session_call() instead of
+ *  ending the program.  Polygon and integration memory of the failed job
+ *  is freed; arrays allocated by the job itself are not.  */
+
+#include <stdio.h>
+#include "common.h"
+
+typedef struct v3d_session v3d_session;
+
+typedef struct  {   /* results of v3d_session_process_paths() */
+    int n_surfs;
+    int encl;
+    float *area;
+    float *emit;
+    double *values;
+} VFResultsC;
+
+V3D_DLL v3d_session *v3d_session_new( void );
+V3D_DLL void v3d_session_free( v3d_session *ses );
+V3D_DLL void v3d_session_set_log( v3d_session *ses, FILE *ulog );
+V3D_DLL void v3d_session_set_list( v3d_session *ses, int list );
+V3D_DLL int v3d_session_call( v3d_session *ses, void (*job)( void *arg ), void *arg );
+V3D_DLL void v3d_results_free( VFResultsC *res );
+
+/* in v3main.c */
+int v3d_session_process_paths( v3d_session *ses, char *inFile, char *outFile,
+  VFResultsC *res );
+
+#endif
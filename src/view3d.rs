@@ -28,7 +28,13 @@ fn main() {
     // understand that it means direct to stdout
     let outfile = matches.value_of("OUTFILE").unwrap_or("");
 
-    let vf_results = process_paths(infile.to_string(), outfile.to_string());
+    let vf_results = match process_paths(infile.to_string(), outfile.to_string()) {
+        Ok(vf_results) => vf_results,
+        Err(msg) => {
+            eprintln!("{}", msg);
+            return;
+        }
+    };
     print_vf_results(&vf_results);
     println!("1->8: {:}", vf_results.vf(1,8));
     println!("8->1: {:}", vf_results.vf(8,1));
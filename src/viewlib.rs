@@ -13,47 +13,117 @@ use std::slice;
 #[link(name = "view3d", kind = "static")]
 extern "C" {
     fn processPaths(infile: *const c_char, outfile: *const c_char) -> VFResultsC;
+    fn v3d_session_new() -> *mut SessionC;
+    fn v3d_session_free(ses: *mut SessionC);
+    fn v3d_session_set_list(ses: *mut SessionC, list: i32);
+    fn v3d_session_process_paths(ses: *mut SessionC, infile: *const c_char,
+        outfile: *const c_char, res: *mut VFResultsC) -> i32;
+    fn v3d_results_free(res: *mut VFResultsC);
 }
 
-pub fn process_paths(infile: String, outfile: String) -> VFResults {
+// Opaque C session; see session.h
+#[repr(C)]
+pub struct SessionC {
+    _private: [u8; 0],
+}
+
+/// A View3D session. Each session holds its own copy of the library's
+/// working state, so sessions on different threads may run at the same
+/// time. A fatal error in the calculation is returned as Err rather than
+/// ending the process.
+pub struct Session {
+    ptr: *mut SessionC,
+}
+
+// The C state of a session is only touched by the thread that is using it.
+unsafe impl Send for Session {}
+
+impl Session {
+    pub fn new() -> Session {
+        Session { ptr: unsafe { v3d_session_new() } }
+    }
+
+    /// Set the amount of log output (0 to 3).
+    pub fn set_list(&mut self, list: i32) {
+        unsafe { v3d_session_set_list(self.ptr, list) }
+    }
+
+    pub fn process_paths(&mut self, infile: String, outfile: String) -> Result<VFResults, String> {
+        let infile_c = CString::new(infile.clone()).expect("CString::new failed");
+        let outfile_c = CString::new(outfile).expect("CString::new failed");
+        let mut vf_res = VFResultsC {
+            n_surfs: 0,
+            encl: 0,
+            area: std::ptr::null_mut(),
+            emit: std::ptr::null_mut(),
+            values: std::ptr::null_mut(),
+        };
+        let status = unsafe {
+            v3d_session_process_paths(self.ptr, infile_c.as_ptr(), outfile_c.as_ptr(), &mut vf_res)
+        };
+        if status != 0 {
+            return Err(format!("fatal error while processing {}", infile));
+        }
+        unsafe { convert_results(&mut vf_res) }
+    }
+}
+
+impl Drop for Session {
+    fn drop(&mut self) {
+        unsafe { v3d_session_free(self.ptr) }
+    }
+}
+
+/// With rows= or shard= only those rows are computed and written to the
+/// output file, for view3d-merge; there are no results to return, so the
+/// result is Err.
+pub fn process_paths(infile: String, outfile: String) -> Result<VFResults, String> {
     // Convert these arguments to C strings to use in FFI
     let infile_c = CString::new(infile).expect("CString::new failed");
     let outfile_c = CString::new(outfile).expect("CString::new failed");
     unsafe {
-        let vf_res = processPaths(infile_c.as_ptr(), outfile_c.as_ptr());
-
-        // Convert the view factor values to a vector
-        let af_arr_ptr = vf_res.values;
-        assert!(!af_arr_ptr.is_null());
-        let res: &[f64] = slice::from_raw_parts(af_arr_ptr, (vf_res.n_surfs*vf_res.n_surfs) as usize);
-        let res2 = res.clone();
-        let vec = res2.to_vec();
-
-        // Convert the area values to a vector
-        let area_ptr = vf_res.area;
-        assert!(!area_ptr.is_null());
-        let area_raw: &[f32] = slice::from_raw_parts(area_ptr, vf_res.n_surfs as usize);
-        let area_raw2 = area_raw.clone();
-        let areas = area_raw2.to_vec();
-
-        // Convert the emissivity values to a vector
-        let emit_ptr = vf_res.emit;
-        assert!(!emit_ptr.is_null());
-        let emit_raw: &[f32] = slice::from_raw_parts(emit_ptr, vf_res.n_surfs as usize);
-        let emit_raw2 = emit_raw.clone();
-        let emit = emit_raw2.to_vec();
-
-        // Convert the enclosure flag to a bool
-        let encl = if vf_res.encl == 0 { false } else { true };
-
-        VFResults {
-            n_surfs: vf_res.n_surfs as u32,
-            encl,
-            areas,
-            emit,
-            values: vec,
-        }
+        let mut vf_res = processPaths(infile_c.as_ptr(), outfile_c.as_ptr());
+        convert_results(&mut vf_res)
+    }
+}
+
+// Copy the C results into a VFResults and free the C arrays
+unsafe fn convert_results(vf_res: &mut VFResultsC) -> Result<VFResults, String> {
+    // A run of rows= or shard= returns no arrays; its rows are in the output file
+    if vf_res.values.is_null() || vf_res.area.is_null() || vf_res.emit.is_null() {
+        v3d_results_free(vf_res);
+        return Err("partial rows written to the output file; combine them with view3d-merge".to_string());
     }
+
+    // Convert the view factor values to a vector
+    let af_arr_ptr = vf_res.values;
+    let res: &[f64] = slice::from_raw_parts(af_arr_ptr, (vf_res.n_surfs*vf_res.n_surfs) as usize);
+    let res2 = res.clone();
+    let vec = res2.to_vec();
+
+    // Convert the area values to a vector
+    let area_ptr = vf_res.area;
+    let area_raw: &[f32] = slice::from_raw_parts(area_ptr, vf_res.n_surfs as usize);
+    let area_raw2 = area_raw.clone();
+    let areas = area_raw2.to_vec();
+
+    // Convert the emissivity values to a vector
+    let emit_ptr = vf_res.emit;
+    let emit_raw: &[f32] = slice::from_raw_parts(emit_ptr, vf_res.n_surfs as usize);
+    let emit_raw2 = emit_raw.clone();
+    let emit = emit_raw2.to_vec();
+
+    // Convert the enclosure flag to a bool
+    let encl = if vf_res.encl == 0 { false } else { true };
+
+    v3d_results_free(vf_res);
+    Ok(VFResults {
+        n_surfs: vf_res.n_surfs as u32,
+        encl,
+        areas,
+        emit,
+        values: vec,
+    })
 }
 
 #[derive(Debug)]
@@ -61,9 +131,9 @@ pub fn process_paths(infile: String, outfile: String) -> VFResults {
 pub struct VFResultsC {
     pub n_surfs: i32,
     pub encl: i32,
-    pub area: *const c_float,
-    pub emit: *const c_float,
-    pub values: *const c_double,
+    pub area: *mut c_float,
+    pub emit: *mut c_float,
+    pub values: *mut c_double,
 }
 
 #[derive(Debug)]
@@ -139,3 +209,49 @@ pub fn analytic_1(width: f64, height: f64) -> f64 {
     let f12 = (1_f64/(f64::consts::PI*w.powi(2)))*((x.powi(4)/(1_f64+2_f64*w.powi(2))).ln()+4_f64*w*y);
     f12
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::{Arc, Barrier};
+    use std::thread;
+
+    fn run(infile: &str, outfile: &str) -> VFResults {
+        let mut ses = Session::new();
+        ses.process_paths(infile.to_string(), outfile.to_string())
+            .expect("View3D job failed")
+    }
+
+    // Sessions on separate threads start together, reading different
+    // control lines and geometry at the same time; each must give the
+    // results of a run on its own.
+    #[test]
+    fn concurrent_sessions() {
+        let dir = std::env::temp_dir();
+        let inputs = ["test/3d/test.vs3", "examples/facet.vs3",
+                      "examples/wdwdoor.vs3", "test/3d/pinney.vs3"];
+        let out = |tag: &str, i: usize| {
+            dir.join(format!("v3d-{}-{}.txt", tag, i)).to_string_lossy().into_owned()
+        };
+        let alone: Vec<VFResults> = inputs.iter().enumerate()
+            .map(|(i, f)| run(f, &out("alone", i)))
+            .collect();
+        for _ in 0..50 {
+            let start = Arc::new(Barrier::new(inputs.len()));
+            let jobs: Vec<_> = inputs.iter().enumerate()
+                .map(|(i, f)| {
+                    let (f, o, start) = (f.to_string(), out("thread", i), start.clone());
+                    thread::spawn(move || {
+                        start.wait();
+                        run(&f, &o)
+                    })
+                })
+                .collect();
+            for (job, a) in jobs.into_iter().zip(alone.iter()) {
+                let r = job.join().expect("session thread panicked");
+                assert_eq!(r.n_surfs, a.n_surfs);
+                assert_eq!(r.values, a.values);
+            }
+        }
+    }
+}
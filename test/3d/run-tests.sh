@@ -0,0 +1,110 @@
+#!/bin/sh
+# Regression tests of the view3d control words.
+#
+# Usage, from the top directory:
+#   sh test/3d/run-tests.sh [VIEW3D [VIEW3D-MERGE]]
+#
+# Each case adds control words to the C line of a geometry file and
+# compares the output with a run of the geometry with reference words
+# instead ("-" = none).  The check is one of:
+#   0        identical output
+#   T        every value within T
+#   merge    the rows of this run and the reference run, combined by
+#            view3d-merge, identical to a run of all rows
+#   resume   identical output, also when the journal (@J in the words)
+#            is cut short and the run repeated
+
+V3D=${1:-./view3d.exe}
+MERGE=${2:-./view3d-merge.exe}
+case $V3D in /*) ;; *) V3D=$PWD/$V3D ;; esac
+case $MERGE in /*) ;; *) MERGE=$PWD/$MERGE ;; esac
+T=${TMPDIR:-/tmp}/v3dtest.$$
+mkdir "$T" || exit 1
+trap 'rm -rf "$T"' 0
+
+# input GEOMETRY WORDS:  GEOMETRY with WORDS added to its control line
+input() {
+  awk -v w="$2" '{ sub( /\r$/, "" ) }
+    /^C[ \t]/ && !done { $0 = $0 " " w; done = 1 }
+    { print }' "$1"
+}
+
+# run NAME GEOMETRY WORDS:  run view3d, output in $T/NAME.out
+run() {
+  input "$2" "$3" > "$T/$1.vs3"
+  ( cd "$T" && "$V3D" "$1.vs3" "$1.out" > "$1.log" 2>&1 )
+}
+
+# maxdiff A B:  largest difference between the values after the first
+# line of two output files;  "shape" if their lines do not match
+maxdiff() {
+  awk 'NR == FNR { n[FNR] = NF; for( i=1; i<=NF; i++ ) a[FNR,i] = $i; na = FNR; next }
+    { if( NF != n[FNR] ) bad = 1 }
+    FNR > 1 { for( i=1; i<=NF; i++ ) {
+        d = $i - a[FNR,i]; if( d < 0 ) d = -d; if( d > m ) m = d } }
+    END { if( bad || FNR != na ) print "shape"; else printf "%g\n", m }' "$1" "$2"
+}
+
+pass=0 fail=0
+while read geom check ref words; do
+  case $geom in ''|\#*) continue ;; esac
+  [ "$ref" = - ] && ref=
+  name=$(basename "$geom" .vs3)-$(echo "$words" | tr -c 'a-z0-9\n' '_')
+  rm -f "$T"/*.out
+  run ref "$geom" "$ref"
+  case=$words
+  words=$(echo "$words" | sed "s|@J|$T/$name.jnl|g")
+  msg=
+  case $check in
+  merge)
+    run "$name" "$geom" "$words"
+    ( cd "$T" && "$MERGE" "$name.vs3" merged.out "$name.out" ref.out > merge.log 2>&1 )
+    run all "$geom" ""
+    cmp -s "$T/all.out" "$T/merged.out" || msg="merged rows differ" ;;
+  resume)
+    run "$name" "$geom" "$words"
+    cmp -s "$T/ref.out" "$T/$name.out" || msg="output differs"
+    size=$(wc -c < "$T/$name.jnl")
+    dd if="$T/$name.jnl" of="$T/cut.jnl" bs=$((size / 3)) count=1 2> /dev/null
+    mv "$T/cut.jnl" "$T/$name.jnl"
+    run "$name" "$geom" "$words"
+    cmp -s "$T/ref.out" "$T/$name.out" || msg="${msg:-resumed output differs}" ;;
+  0)
+    run "$name" "$geom" "$words"
+    cmp -s "$T/ref.out" "$T/$name.out" || msg="output differs" ;;
+  *)
+    run "$name" "$geom" "$words"
+    d=$(maxdiff "$T/ref.out" "$T/$name.out")
+    [ "$d" != shape ] && awk "BEGIN { exit !($d <= $check) }" ||
+      msg="max difference $d > $check" ;;
+  esac
+  if [ -z "$msg" ]; then
+    pass=$((pass + 1))
+    echo "PASS $geom $case"
+  else
+    fail=$((fail + 1))
+    echo "FAIL $geom $case: $msg"
+  fi
+done <<EOF
+# geometry             check   reference   control words
+test/3d/test.vs3       0       -           threads=4
+test/3d/test.vs3       merge   shard=2/2   rows=1-17
+test/3d/test.vs3       resume  -           journal=@J
+test/3d/test.vs3       resume  -           journal=@J jtime=0
+examples/box345.vs3    1e-4    -           shaft=1
+examples/box345.vs3    1e-4    -           nest=1
+examples/box345.vs3    0       -           union=1
+examples/box345.vs3    1e-4    -           engine=ray
+test/3d/test.vs3       0.02    -           engine=hemi
+examples/box345.vs3    0.02    -           engine=hemi
+examples/gunter1.vs3   0.02    -           engine=hemi
+test/3d/box5.vs3       5e-3    -           far=1
+examples/box345.vs3    1e-4    -           adapt=1
+examples/box345.vs3    1e-4    -           adapt=1 budget=8
+test/3d/box5.vs3       0       eps=1e-8    eps=1e-4 rect=1
+test/3d/box5.vs3       0       eps=1e-8    eps=1e-4 unob=exact
+test/3d/box5.vs3       1e-4    eps=1e-4    eps=1e-4 fp32=1
+EOF
+
+echo "$pass passed, $fail failed"
+[ $fail -eq 0 ]
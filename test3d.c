@@ -11,12 +11,16 @@
 
 #include <stdio.h>
 #include <string.h> /* prototype: memcpy */
+#include <stdlib.h> /* prototype: qsort */
 #include <math.h>   /* prototype: fabs */
 #include "types.h" 
 #include "view3d.h"
 #include "misc.h"
 #include "viewobs.h"
 #include "polygn.h"
+#include "heap.h"
+#include "bvh.h"
+#include "viewmt.h"
 
 /*  VSHIFT:  vector C = vector B minus scalar D times vector A.  */
 #define VSHIFT(b,d,a,c)  \
@@ -369,6 +373,167 @@ int OrientationTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
 
   }  /*  end of OrientationTest  */
 
+/***  ShaftTest.c  ***********************************************************/
+
+/*  Shaft culling:  the shaft is the convex hull of srfN and srfM, which
+ *  contains every line of sight between them.  Remove from the list the
+ *  surfaces which lie outside the shaft, i.e. beyond one of its faces
+ *  or with the whole shaft on one side of their plane.  Set *BLOCKED
+ *  to the first surface which cuts every line of sight:  N and M are
+ *  on opposite sides of its plane and the section of the shaft in that
+ *  plane is inside it.  The tests are conservative to within a
+ *  distance of 1.0e-6 times the sum of the radii of N and M.
+ *  Return the new number of possible obstructions.  */
+
+#define MAXFACE (2*MAXNV1*MAXNV1+2)  /* max number of shaft faces */
+
+int ShaftTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
+  View3DControlData *vfCtrl, int *possibleObstr, int nPossObstr, int *blocked )
+/* srf  - data for all surfaces.
+ * srfN - data for surface N.
+ * srfM - data for surface M.
+ * possibleObstr  - list of possible obstructing surfaces (input/output).
+ * nPossObstr  - number of possible obstructing surfaces
+ * blocked  - surface which blocks all views; 0 = none (output).
+ */
+  {
+  Vec3 pt[2*MAXNV1];     /* vertices of N, then of M */
+  DirCos face[MAXFACE+1]; /* shaft faces; outward normals */
+  int nPt, nFace=0;
+  double tol;            /* distance tolerance */
+  double d, len;
+  int i, j, k, n, a, b, nv, inside;
+
+  *blocked = 0;
+  tol = 1.0e-6 * (srfN->rc + srfM->rc);
+  for( nPt=n=0; n<srfN->nv; n++ )
+    pt[nPt++] = srfN->v[n];
+  for( n=0; n<srfM->nv; n++ )
+    pt[nPt++] = srfM->v[n];
+
+                 /* faces: the plane of an edge of one surface and a
+                    vertex of the other, or of one of the surfaces,
+                    with all vertices of N and M on one side */
+  for( i=0; i<2; i++ )
+    {
+    SRFDATNM *s1 = i ? srfM : srfN;
+    SRFDATNM *s2 = i ? srfN : srfM;
+    for( a=0; a<s1->nv; a++ )
+      for( j=-1; j<s2->nv; j++ )
+        {
+        Vec3 e, f;
+        DirCos *pl = face + nFace;
+        b = (a + 1) % s1->nv;
+        VECTOR( (s1->v+a), (s1->v+b), (&e) );
+        if( j < 0 )
+          {
+          if( a ) continue;    /* plane of s1 */
+          VECTOR( (s1->v+a), (s1->v+(a+2)%s1->nv), (&f) );
+          }
+        else
+          {
+          VECTOR( (s1->v+a), (s2->v+j), (&f) );
+          }
+        VCROSS( (&e), (&f), pl );
+        len = VLEN( pl );
+        if( len <= 1.0e-9 * VDOT( (&e), (&e) ) ) continue;  /* degenerate */
+        pl->x /= len;
+        pl->y /= len;
+        pl->z /= len;
+        pl->w = -VDOT( (s1->v+a), pl );
+        for( inside=0,k=0; k<nPt; k++ )
+          {
+          d = VDOTW( (pt+k), pl );
+          if( d > tol ) inside |= 1;
+          if( d < -tol ) inside |= 2;
+          }
+        if( inside == 3 || inside == 0 ) continue;  /* not a face */
+        if( inside == 1 )     /* make the normal point out of the shaft */
+          {
+          pl->x = -pl->x; pl->y = -pl->y; pl->z = -pl->z; pl->w = -pl->w;
+          }
+        if( nFace < MAXFACE ) nFace++;
+        }
+    }
+
+  for( n=0,i=1; i<=nPossObstr; i++ )
+    {
+    int sideN=0, sideM=0;  /* 1 = in front, 2 = behind, 3 = both */
+    k = possibleObstr[i];
+    nv = srf[k].nv;
+    if( k == srfN->nr || k == srfM->nr )
+      {
+      possibleObstr[++n] = k;
+      continue;
+      }
+
+    for( j=0; j<nFace; j++ )   /* K beyond a face of the shaft */
+      {
+      for( a=0; a<nv; a++ )
+        if( VDOTW( (srf[k].v[a]), (face+j) ) < -tol ) break;
+      if( a == nv ) break;
+      }
+    if( j < nFace ) continue;
+
+    for( a=0; a<srfN->nv; a++ )   /* sides of N and M relative to K */
+      {
+      d = VDOTW( (srfN->v+a), (&srf[k].dc) );
+      sideN |= d > tol ? 1 : (d < -tol ? 2 : 3);
+      }
+    for( a=0; a<srfM->nv; a++ )
+      {
+      d = VDOTW( (srfM->v+a), (&srf[k].dc) );
+      sideM |= d > tol ? 1 : (d < -tol ? 2 : 3);
+      }
+    if( (sideN | sideM) == 1 || (sideN | sideM) == 2 )
+      continue;                /* shaft on one side of K */
+
+    if( !*blocked && sideN + sideM == 3 )  /* N and M strictly separated */
+      {
+      for( a=0; a<srfN->nv; a++ )   /* shaft section in the plane of K */
+        {
+        double dN = VDOTW( (srfN->v+a), (&srf[k].dc) );
+        for( b=0; b<srfM->nv; b++ )
+          {
+          double dM = VDOTW( (srfM->v+b), (&srf[k].dc) );
+          double t = dN / (dN - dM);
+          Vec3 x, e, f, c;
+          int sgn=0;
+          x.x = srfN->v[a].x + t * (srfM->v[b].x - srfN->v[a].x);
+          x.y = srfN->v[a].y + t * (srfM->v[b].y - srfN->v[a].y);
+          x.z = srfN->v[a].z + t * (srfM->v[b].z - srfN->v[a].z);
+          for( j=0; j<nv; j++ )     /* X inside the edges of K */
+            {
+            VECTOR( (srf[k].v[j]), (srf[k].v[(j+1)%nv]), (&e) );
+            VECTOR( (srf[k].v[j]), (&x), (&f) );
+            VCROSS( (&e), (&f), (&c) );
+            d = VDOT( (&c), (&srf[k].dc) ) / VLEN( (&e) );
+            if( d > tol ) sgn |= 1;
+            else if( d < -tol ) sgn |= 2;
+            else sgn |= 3;
+            }
+          if( sgn == 3 ) break;
+          }
+        if( b < srfM->nv ) break;
+        }
+      if( a == srfN->nv )
+        *blocked = k;
+      }
+
+    possibleObstr[++n] = k;
+    }
+
+  if( vfCtrl->col && _list>3 )
+    {
+    DumpOS( "ShaftTest LOS:", n, possibleObstr );
+    if( *blocked )
+      fprintf( _ulog, "ShaftTest: view blocked by surface %d\n", *blocked );
+    }
+
+  return n;
+
+  }  /*  end of ShaftTest  */
+
 /***  OrientationTestN.c  *********************************************************/
 
 /*  Remove possible obstructions behind N from list.  */
@@ -700,52 +865,89 @@ void DumpOS( char *title, const int nos, int *listObstr )
 /***  SetPosObstr3D.c  *******************************************************/
 
 /*  Set list of possible view obstructing surfaces.
- *  Return number of possible view obstructing surfaces.  */
+ *  Return number of possible view obstructing surfaces.
+ *  Surface NS may obstruct a view if some vertex of the model is in
+ *  front of its plane and some vertex is behind it.  The vertices are
+ *  searched through a k-d tree, the surfaces are tested by NTHREADS
+ *  threads, and the list is sorted largest surfaces first; for equal
+ *  areas the higher surface number is first.  */
+
+typedef struct{         /* data for ClassifyPlanes() */
+  SRFDAT3D *srf;
+  const VertexTree *tree;
+  char *straddle;       /* straddle[ns] = 1 if NS may obstruct [1:nSrf] */
+} PlaneData;
+
+typedef struct{         /* sort key of a possible obstruction */
+  double area;
+  int ns;
+} ObstrKey;
+
+/***  ClassifyPlanes.c  ******************************************************/
+
+/*  Test planes NS1 to NS2 for SetPosObstr3D().  */
+
+static void ClassifyPlanes( void *arg, int ns1, int ns2 )
+  {
+  PlaneData *pd = arg;
+  SRFDAT3D *srf = pd->srf;
+  int ns;
+
+  for( ns=ns1; ns<=ns2; ns++ )
+    {
+    if( srf[ns].type != RSRF &&
+        srf[ns].type != OBSO ) continue;
+    pd->straddle[ns] = (char)PlaneStraddle( pd->tree, &srf[ns].dc,
+      1.0e-5f * srf[ns].rc );
+    }
 
-int SetPosObstr3D( int nSrf, SRFDAT3D *srf, int *possibleObstr )
+  }  /* end ClassifyPlanes */
+
+/***  ObstrKeyCompare.c  *****************************************************/
+
+static int ObstrKeyCompare( const void *p1, const void *p2 )
+  {
+  const ObstrKey *k1 = p1, *k2 = p2;
+
+  if( k1->area > k2->area ) return -1;
+  if( k1->area < k2->area ) return 1;
+  return k2->ns - k1->ns;
+
+  }  /* end ObstrKeyCompare */
+
+/***  SetPosObstr3D.c  *******************************************************/
+
+int SetPosObstr3D( int nSrf, SRFDAT3D *srf, int *possibleObstr, int nThreads )
 /* nSrf;  total number of surfaces (RSRF and OBSO)
  * srf;   vector of surface data [1:nSrf]
  * possibleObstr;  vector of possible view obtructions [1:nSrf]
+ * nThreads;  number of threads
  */
   {
+  PlaneData pd;
+  ObstrKey *key;
   int ns;       /* surface number */
-  int n;        /* surface number */
-  int j;        /* vertex number */
-  int infront;  /* true if a vertex is in front of surface ns */
-  int behind;   /* true if a vertex is behind surface ns */
-  double dot, eps; /* dot product and test value */
   int npos=0;   /* number of possible view obstructing surfaces */
 
-  for( ns=nSrf; ns; ns-- )  /* reverse order for obstruction surfaces first */
-    {
-    if( srf[ns].type != RSRF &&
-        srf[ns].type != OBSO ) continue;
-    eps = 1.0e-5f * srf[ns].rc;
-    infront = behind = 0;
-    for( n=nSrf; n; n-- )
+  pd.srf = srf;
+  pd.tree = BuildVertexTree( srf, nSrf );
+  pd.straddle = Alc_V( 1, nSrf, sizeof(char), __FILE__, __LINE__ );
+  ParallelFor( 1, nSrf, nThreads, ClassifyPlanes, &pd );
+
+  key = Alc_V( 1, nSrf, sizeof(ObstrKey), __FILE__, __LINE__ );
+  for( ns=1; ns<=nSrf; ns++ )
+    if( pd.straddle[ns] )
       {
-      if( srf[ns].type != RSRF &&
-          srf[ns].type != OBSO ) continue;
-      for( j=0; j<srf[n].nv; j++ )
-        {
-        dot = VDOTW( (srf[n].v[j]), (&srf[ns].dc) );
-        if( dot > eps ) infront = 1;
-        if( dot < -eps ) behind = 1;
-        }
-      if( infront && behind ) break;
-      }  /* end n loop */
-
-    if( n )                    /* some vertices in front and some behind */
-      {                        /* surface ns ==> ns may obstruct a view. */
-      npos += 1;
-      for( n=npos; n>1; n-- )  /* insertion sort: largest surfaces first */
-        if( srf[possibleObstr[n-1]].area < srf[ns].area )
-          possibleObstr[n] = possibleObstr[n-1];
-        else
-          break;
-      possibleObstr[n] = ns;
+      key[++npos].area = srf[ns].area;
+      key[npos].ns = ns;
       }
-    }
+  qsort( key+1, npos, sizeof(ObstrKey), ObstrKeyCompare );
+  for( ns=1; ns<=npos; ns++ )
+    possibleObstr[ns] = key[ns].ns;
+
+  Fre_V( key, 1, nSrf, sizeof(ObstrKey), __FILE__, __LINE__ );
+  Fre_V( pd.straddle, 1, nSrf, sizeof(char), __FILE__, __LINE__ );
+  FreeVertexTree( (VertexTree *)pd.tree );
 
   return npos;
 
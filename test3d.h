@@ -17,6 +17,8 @@ int CylinderRadiusTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
   int *los, double distNM, int nProb );
 int OrientationTest( SRFDAT3D *srf, SRFDATNM *srfn, SRFDATNM *srfm, 
   View3DControlData *vfCtrl, int *los, int nProb );
+int ShaftTest( SRFDAT3D *srf, SRFDATNM *srfN, SRFDATNM *srfM,
+  View3DControlData *vfCtrl, int *los, int nProb, int *blocked );
 int OrientationTestN( SRFDAT3D *srf, int N, View3DControlData *vfCtrl,
   int *possibleObstr, int nPossObstr );
 void SelfObstructionClip( SRFDATNM *srfn );
@@ -26,7 +28,7 @@ void IntersectionTest( SRFDATNM *srfn, SRFDATNM *srfm );
 
 V3D_API void DumpOS( char *title, const int nos, int *los );
 
-V3D_API int SetPosObstr3D( int nSrf, SRFDAT3D *srf, int *lpos );
+V3D_API int SetPosObstr3D( int nSrf, SRFDAT3D *srf, int *lpos, int nThreads );
 
 #endif
 
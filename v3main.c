@@ -26,17 +26,11 @@
 #include "viewpp.h"
 #include "getdat.h"
 #include "test3d.h"
+#include "session.h"
+#include "v3main.h"
 
 /* forward decls */
 
-typedef struct  {
-    int n_surfs;
-    int encl;
-    float *area;
-    float *emit;
-    double *values;
-} VFResultsC;
-
 void FindFile(char *msg, char *name, char *type);
 void CheckFileWritable(char *fileName);
 void CheckFileReadable(char *fileName);
@@ -157,20 +151,6 @@ int main( int argc, char **argv ){
 }
 #endif
 
-typedef struct {
-  View3DControlData vfCtrl;
-  char **name;
-  float *area;
-  float *emit;
-  float *vtmp;
-  char title[LINELEN]; /* project title */
-  int test;
-  int *base;
-  int *cmbn;
-  Vec3 *xyz;
-  SRFDAT3D *srf;
-} InData;
-
 
 // Read the file into a data structure, heap allocate it and return a pointer to
 // it. There is no point allocating it before this as we don't know the size of
@@ -204,6 +184,8 @@ InData readFileHandle(FILE *inHandle) {
   vfCtrl.epsAdap = 1.0e-4f; // convergence for adaptive integration
   vfCtrl.maxRecursALI = 12; // maximum number of recursion levels
   vfCtrl.maxRecursion = 8;  // maximum number of recursion levels
+  vfCtrl.jnlTime = 60;      // seconds between journal writes
+  vfCtrl.budget = 4096;     // subsurface integrations per pair for adapt=1
 
   /* read Vertex/Surface data file */
   // FILE *inHandle = NxtOpenHndl(inFile, __FILE__, __LINE__ );
@@ -243,6 +225,34 @@ InData readFileHandle(FILE *inHandle) {
 
   if(vfCtrl.prjReverse)fprintf(_ulog, "\n      Reverse projections. **" );
 
+  if(vfCtrl.nThreads > 1)fprintf(_ulog, "\n           Worker threads: %d *", vfCtrl.nThreads );
+
+  if(vfCtrl.row1)fprintf(_ulog, "\n             Solving rows: %d to %d *", vfCtrl.row1, vfCtrl.row2 );
+
+  if(vfCtrl.shard)fprintf(_ulog, "\n                    Shard: %d of %d *", vfCtrl.shard, vfCtrl.nShards );
+
+  if(vfCtrl.shaft)fprintf(_ulog, "\n            Shaft culling: on *" );
+
+  if(vfCtrl.nest)fprintf(_ulog, "\n           Embedded rules: on *" );
+
+  if(vfCtrl.unite)fprintf(_ulog, "\n         Union of shadows: on *" );
+
+  if(vfCtrl.farField)fprintf(_ulog, "\n        Far-field estimates: on *" );
+
+  if(vfCtrl.adapt)fprintf(_ulog, "\n      Global adaptive views: on, budget %d *", vfCtrl.budget );
+
+  if(vfCtrl.rect)fprintf(_ulog, "\n   Closed form (rectangles): on *" );
+
+  if(vfCtrl.unob==EXACT)fprintf(_ulog, "\n    Unobstructed views: closed form *" );
+
+  if(vfCtrl.fp32)fprintf(_ulog, "\n       Single precision 2AI: on, verified *" );
+
+  if(vfCtrl.engine==RAYS)fprintf(_ulog, "\n       Obstruction engine: rays *" );
+
+  if(vfCtrl.engine==HEMI)fprintf(_ulog, "\n       View factor engine: hemicubes *" );
+
+  if(vfCtrl.journal[0])fprintf(_ulog, "\n                  Journal: %s, every %d s *", vfCtrl.journal, vfCtrl.jnlTime );
+
   fprintf(_ulog, "\n Output control parameter: %d\n", _list );
 
   fprintf(_ulog, "\n" );
@@ -252,6 +262,7 @@ InData readFileHandle(FILE *inHandle) {
 
   nSrf = nSrf0 = vfCtrl.nRadSrf;
   encl = vfCtrl.enclosure;
+  inData.nSrf = nSrf0;
 
   if(vfCtrl.format == 4)vfCtrl.nVertices = 4 * vfCtrl.nAllSrf;
   // Allocate memory for all of the surfaces. These will need to be resized as
@@ -397,7 +408,8 @@ VFResultsC processHandles(FILE *inHandle, FILE *outHandle){
   possibleObstr = Alc_V( 1, vfCtrl.nAllSrf, sizeof(int), __FILE__, __LINE__ );
   // Find the number of possible obstructing surfaces. The index list of these
   // surfaces is stored in possibleObstr.
-  vfCtrl.nPossObstr = SetPosObstr3D( vfCtrl.nAllSrf, srf, possibleObstr );
+  vfCtrl.nPossObstr = SetPosObstr3D( vfCtrl.nAllSrf, srf, possibleObstr,
+    vfCtrl.nThreads );
   // Print diagnostics on finding possibly obstructing surfaces
   sprintf( _string, "\n %.2f seconds to determine %d possible view obstructing surfaces",
            CPUtime(time1), vfCtrl.nPossObstr
@@ -510,7 +522,7 @@ VFResultsC processHandles(FILE *inHandle, FILE *outHandle){
 
   for( n=nSrf; n; n-- ){  /* clear base pointers to OBSO & MASK srfs */
 	// FIXME should the following line say 'srf[n]'??
-	if( srf[base[n]].type == OBSO )  /* Base is used for several things. */
+	if( base[n] && srf[base[n]].type == OBSO )  /* Base is used for several things. */
       base[n] = 0;                   /* It must be progressively cleared */
 
 	// FIXME should the following line say 'base[n]'??
@@ -599,7 +611,7 @@ VFResultsC processHandles(FILE *inHandle, FILE *outHandle){
 
   fprintf( _ulog, "\nFinal view factors:" );
   // Copy the values into single contigious array
-  int ret_len = nSrf0*nSrf0;
+  int ret_len = nSrf*nSrf;  /* nSrf < nSrf0 after combining surfaces */
   fprintf( stderr, "\nret_len: %d\n", ret_len);
   double *ret = malloc(sizeof(double)*ret_len);
 
@@ -617,19 +629,19 @@ VFResultsC processHandles(FILE *inHandle, FILE *outHandle){
   }
 
   // zero-based array for areas
-  float *areas0 = malloc(sizeof(float)*nSrf0);
+  float *areas0 = malloc(sizeof(float)*nSrf);
   for (int n = 1; n <= nSrf; n++) {
     areas0[n-1] = area[n];
   }
 
   //zero-based array for emissivities
-  float *emit0 = malloc(sizeof(float)*nSrf0);
+  float *emit0 = malloc(sizeof(float)*nSrf);
   for (int n = 1; n <= nSrf; n++) {
     emit0[n-1] = emit[n];
   }
 
   VFResultsC res_struct;
-  res_struct.n_surfs = nSrf0;
+  res_struct.n_surfs = nSrf;
   res_struct.encl = encl;
   res_struct.area = areas0;
   res_struct.emit = emit0;
@@ -714,25 +726,22 @@ double getEnclosureVolume(View3DControlData vfCtrl, SRFDAT3D *srf) {
 /*----------------------------------------------------------------------------*/
 // This is modified to be the simplest possible (and with little logging).
 VFResultsC processHandlesSimple(FILE *inHandle, FILE *outHandle){
-// #ifdef LOGGING
-  _ulog = stderr;
-// #endif
+  if(_ulog==NULL) {
+    _ulog = stderr;
+  }
   char *types[]={"rsrf","subs","mask","nuls","obso"};
   double **AF;         /* triangular array of area*view factor values [1:nSrf][] */
   int *possibleObstr;  /* list of possible view obstructing surfaces */
 
   InData inData = readFileHandle(inHandle);
 
-  int encl = inData.vfCtrl.enclosure; /* 1 = surfaces form enclosure */
   int nSrf0 = inData.vfCtrl.nRadSrf; /* initial number of surfaces */
   int nSrf = nSrf0;            /* current number of surfaces */
   View3DControlData vfCtrl = inData.vfCtrl; /* VF calculation control parameters - avoid globals */
-  char **name = inData.name;
   float *area = inData.area; /* the areas of each surface */
   float *emit = inData.emit;  /* vector of surface emittances [1:nSrf] */
   float *vtmp = inData.vtmp;/* temporary vector [1:nSrf] */
   int *base = inData.base;/* vector of base surface numbers [1:nSrf] */
-  int *cmbn = inData.cmbn;/* vector of combine surface numbers [1:nSrf] */
   Vec3 *xyz = inData.xyz; /* vector of vertces [1:nVrt] */
   SRFDAT3D *srf = inData.srf; /* the surface data */
 
@@ -741,11 +750,29 @@ VFResultsC processHandlesSimple(FILE *inHandle, FILE *outHandle){
   possibleObstr = Alc_V( 1, vfCtrl.nAllSrf, sizeof(int), __FILE__, __LINE__ );
   // Find the number of possible obstructing surfaces. The index list of these
   // surfaces is stored in possibleObstr.
-  vfCtrl.nPossObstr = SetPosObstr3D( vfCtrl.nAllSrf, srf, possibleObstr );
+  vfCtrl.nPossObstr = SetPosObstr3D( vfCtrl.nAllSrf, srf, possibleObstr,
+    vfCtrl.nThreads );
+
+  // A shard of the rows is chosen by estimated cost; see View3DShard().
+  if( vfCtrl.shard ){
+    View3DShard( srf, base, possibleObstr, &vfCtrl );
+  }
 
   // If row is specified (i.e. we are only interested in the view factors of
   // one surface) then we allocate an array big enough for those values.
-  if( vfCtrl.row ){  // may not work with some compilers. GNW 2008/01/22
+  if( vfCtrl.row1 ){
+    // For a block of rows, only those rows are allocated; they are written
+    // to a partial file for view3d-merge.
+    if( vfCtrl.row1 <= vfCtrl.row2 ){
+      AF = Alc_MC( vfCtrl.row1, vfCtrl.row2, 1, nSrf0, sizeof(double), __FILE__, __LINE__ );
+    } else {
+      AF = NULL;  // empty shard
+    }
+#ifdef LOGGING
+    fprintf( _ulog, "\nComputing view factors for rows %d to %d\n\n",
+      vfCtrl.row1, vfCtrl.row2 );
+#endif
+  }else if( vfCtrl.row ){  // may not work with some compilers. GNW 2008/01/22
     AF = Alc_MC( vfCtrl.row, vfCtrl.row, 1, nSrf0, sizeof(double), __FILE__, __LINE__ );
   // Otherwise we want every surface to every surface and must allocate a
   // sufficiently sized array.
@@ -761,7 +788,9 @@ VFResultsC processHandlesSimple(FILE *inHandle, FILE *outHandle){
   }
 
   /*----- view factor calculation -----*/
-  View3D( srf, base, possibleObstr, AF, &vfCtrl );
+  if( AF ){
+    View3D( srf, base, possibleObstr, AF, &vfCtrl );
+  }
   // The view factors have now been calculated and stored in AF.
 
   // The possibly obstruction surface information is no longer needed after
@@ -770,11 +799,75 @@ VFResultsC processHandlesSimple(FILE *inHandle, FILE *outHandle){
   FreeTmpVertMem();  /* free polygon overlap vertices */
   FreePolygonMem();
   Fre_V( xyz, 1, vfCtrl.nVertices, sizeof(Vec3), __FILE__, __LINE__ );
+  inData.xyz = NULL;
+
+  // For a block of rows, save the rows as computed; the adjustments below
+  // need all rows and are done by view3d-merge.
+  if( vfCtrl.row1 ){
+    VFResultsC res_struct;
+    memset(&res_struct, 0, sizeof(VFResultsC));
+    SaveAFRows( outHandle, V3D_VERSION, nSrf0, vfCtrl.row1, vfCtrl.row2, area, AF );
+    fflush(outHandle);
+    if( AF ){
+      Fre_MC( AF, vfCtrl.row1, vfCtrl.row2, 1, nSrf0, sizeof(double), __FILE__, __LINE__ );
+    }
+    FreeInData( &inData );
+    return res_struct;
+  }
+
+  VFResultsC res_struct = FinishAF( &inData, AF );
+  nSrf = inData.nSrf;
+
+  fflush(stdout);
+  fflush(stderr);
+  fflush(outHandle);
+
+  // This where we would normally output the values, but we don't want to do
+  // that in library mode.
+#ifdef LOGGING
+  SaveVF( outHandle, "View3D", "3.5", vfCtrl.outFormat, vfCtrl.enclosure,
+          vfCtrl.emittances, nSrf, area, emit, AF, vtmp );
+#endif
+
+  /* Begin: Free memory of data structures */
+  if( vfCtrl.row ){
+    Fre_MC( AF, vfCtrl.row, vfCtrl.row, 1, nSrf0, sizeof(double), __FILE__, __LINE__ );
+  }else{
+#ifdef __TURBOC__
+    Fre_MSR( (void **)AF, 1, nSrf0, sizeof(double), __FILE__, __LINE__ );
+#else
+    Fre_MSC( (void **)AF, 1, nSrf0, sizeof(double), __FILE__, __LINE__ );
+#endif
+  }
+  FreeInData( &inData );
+  /* End: Free memory of data structures */
+
+  return res_struct;
+
+} /* end of processHandlesSimple() */
+
+/*----------------------------------------------------------------------------*/
+// Adjust the computed view factors (remove null surfaces, separate subsurfaces,
+// combine surfaces, normalize, apply emissivities) and copy the results into
+// zero-based arrays. AF must hold all rows; in->nSrf is set to the final number
+// of surfaces. Used by processHandlesSimple() and by view3d-merge.
+VFResultsC FinishAF(InData *in, double **AF) {
+  int encl = in->vfCtrl.enclosure; /* 1 = surfaces form enclosure */
+  int nSrf0 = in->vfCtrl.nRadSrf; /* initial number of surfaces */
+  int nSrf = nSrf0;            /* current number of surfaces */
+  View3DControlData vfCtrl = in->vfCtrl;
+  char **name = in->name;
+  float *area = in->area; /* the areas of each surface */
+  float *emit = in->emit;  /* vector of surface emittances [1:nSrf] */
+  float *vtmp = in->vtmp;/* temporary vector [1:nSrf] */
+  int *base = in->base;/* vector of base surface numbers [1:nSrf] */
+  int *cmbn = in->cmbn;/* vector of combine surface numbers [1:nSrf] */
+  SRFDAT3D *srf = in->srf; /* the surface data */
 
   // TODO: what does this do
   for(int n = nSrf; n; n-- ){  /* clear base pointers to OBSO & MASK srfs */
 	// FIXME should the following line say 'srf[n]'??
-	if( srf[base[n]].type == OBSO )  /* Base is used for several things. */
+	if( base[n] && srf[base[n]].type == OBSO )  /* Base is used for several things. */
       base[n] = 0;                   /* It must be progressively cleared */
 
 	// FIXME should the following line say 'base[n]'??
@@ -849,7 +942,7 @@ VFResultsC processHandlesSimple(FILE *inHandle, FILE *outHandle){
 
   // These are some conversions to make the external interface simpler
   // Copy the values into single contigious array
-  int ret_len = nSrf0*nSrf0;
+  int ret_len = nSrf*nSrf;  /* nSrf < nSrf0 after combining surfaces */
   double *ret = malloc(sizeof(double)*ret_len);
 
   for(int n = 1; n <= nSrf; n++) {
@@ -866,57 +959,46 @@ VFResultsC processHandlesSimple(FILE *inHandle, FILE *outHandle){
   }
 
   // zero-based array for areas
-  float *areas0 = malloc(sizeof(float)*nSrf0);
+  float *areas0 = malloc(sizeof(float)*nSrf);
   for (int n = 1; n <= nSrf; n++) {
     areas0[n-1] = area[n];
   }
 
   //zero-based array for emissivities
-  float *emit0 = malloc(sizeof(float)*nSrf0);
+  float *emit0 = malloc(sizeof(float)*nSrf);
   for (int n = 1; n <= nSrf; n++) {
     emit0[n-1] = emit[n];
   }
 
   VFResultsC res_struct;
-  res_struct.n_surfs = nSrf0;
+  res_struct.n_surfs = nSrf;
   res_struct.encl = encl;
   res_struct.area = areas0;
   res_struct.emit = emit0;
   res_struct.values = ret;
+  in->nSrf = nSrf;
 
-  fflush(stdout);
-  fflush(stderr);
-  fflush(outHandle);
+  return res_struct;
 
-  // This where we would normally output the values, but we don't want to do
-  // that in library mode.
-#ifdef LOGGING
-  SaveVF( outHandle, "View3D", "3.5", vfCtrl.outFormat, vfCtrl.enclosure,
-          vfCtrl.emittances, nSrf, area, emit, AF, vtmp );
-#endif
+} /* end of FinishAF() */
 
-  /* Begin: Free memory of data structures */
-  if( vfCtrl.row ){
-    Fre_MC( AF, vfCtrl.row, vfCtrl.row, 1, nSrf0, sizeof(double), __FILE__, __LINE__ );
-  }else{
-#ifdef __TURBOC__
-    Fre_MSR( (void **)AF, 1, nSrf0, sizeof(double), __FILE__, __LINE__ );
-#else
-    Fre_MSC( (void **)AF, 1, nSrf0, sizeof(double), __FILE__, __LINE__ );
-#endif
+/*----------------------------------------------------------------------------*/
+// Free the data read by readFileHandle().
+void FreeInData(InData *in) {
+  int nSrf0 = in->vfCtrl.nRadSrf;
+  if( in->xyz ){
+    Fre_V( in->xyz, 1, in->vfCtrl.nVertices, sizeof(Vec3), __FILE__, __LINE__ );
+    in->xyz = NULL;
   }
-  Fre_V( srf, 1, vfCtrl.nAllSrf, sizeof(SRFDAT3D), __FILE__, __LINE__ );
-  Fre_V( cmbn, 1, nSrf0, sizeof(int), __FILE__, __LINE__ );
-  Fre_V( base, 1, nSrf0, sizeof(int), __FILE__, __LINE__ );
-  Fre_V( vtmp, 1, nSrf0, sizeof(float), __FILE__, __LINE__ );
-  Fre_V( emit, 1, nSrf0, sizeof(float), __FILE__, __LINE__ );
-  Fre_V( area, 1, nSrf0, sizeof(float), __FILE__, __LINE__ );
-  Fre_MC( (void **)name, 1, nSrf0, 0, NAMELEN, sizeof(char), __FILE__, __LINE__ );
-  /* End: Free memory of data structures */
-
-  return res_struct;
+  Fre_V( in->srf, 1, in->vfCtrl.nAllSrf, sizeof(SRFDAT3D), __FILE__, __LINE__ );
+  Fre_V( in->cmbn, 1, nSrf0, sizeof(int), __FILE__, __LINE__ );
+  Fre_V( in->base, 1, nSrf0, sizeof(int), __FILE__, __LINE__ );
+  Fre_V( in->vtmp, 1, nSrf0, sizeof(float), __FILE__, __LINE__ );
+  Fre_V( in->emit, 1, nSrf0, sizeof(float), __FILE__, __LINE__ );
+  Fre_V( in->area, 1, nSrf0, sizeof(float), __FILE__, __LINE__ );
+  Fre_MC( (void **)in->name, 1, nSrf0, 0, NAMELEN, sizeof(char), __FILE__, __LINE__ );
+}
 
-} /* end of processHandlesSimple() */
 
 VFResultsC processPaths(char *inFile, char *outFile) {
   FILE *inHandle = NxtOpenHndl(inFile, __FILE__, __LINE__ );
@@ -932,6 +1014,32 @@ VFResultsC processPaths(char *inFile, char *outFile) {
   return processHandlesSimple(inHandle, outHandle);
 }
 
+typedef struct{       /* arguments of PathsJob() */
+  char *inFile;
+  char *outFile;
+  VFResultsC res;
+} PathsJobData;
+
+static void PathsJob( void *arg ) {
+  PathsJobData *pj = arg;
+  pj->res = processPaths(pj->inFile, pj->outFile);
+}
+
+// Reentrant version of processPaths(): run it within session ses, so that
+// several files may be processed at once on different threads. Returns 0 and
+// the results in res, or 1 after a fatal error (res is then empty).
+int v3d_session_process_paths(v3d_session *ses, char *inFile, char *outFile,
+    VFResultsC *res) {
+  PathsJobData pj;
+  int status;
+  pj.inFile = inFile;
+  pj.outFile = outFile;
+  memset(&pj.res, 0, sizeof(VFResultsC));
+  status = v3d_session_call(ses, PathsJob, &pj);
+  *res = pj.res;
+  return status;
+}
+
 int processStrings(char *inString, char *outFile) {
   // Windows does not support fmemopen, so write to a temporary file and open
   // that.
@@ -0,0 +1,30 @@
+#ifndef V3D_V3MAIN_H
+#define V3D_V3MAIN_H
+
+/*  Input data and processing steps of v3main.c; shared with v3merge.c.  */
+
+#include <stdio.h>
+#include "view3d.h"
+#include "session.h"
+
+typedef struct {
+  View3DControlData vfCtrl;
+  char **name;
+  float *area;
+  float *emit;
+  float *vtmp;
+  char title[LINELEN]; /* project title */
+  int test;
+  int *base;
+  int *cmbn;
+  Vec3 *xyz;
+  SRFDAT3D *srf;
+  int nSrf;            /* number of surfaces after FinishAF() */
+} InData;
+
+InData readFileHandle( FILE *inHandle );
+InData readFilePath( char *inFile );
+VFResultsC FinishAF( InData *in, double **AF );
+void FreeInData( InData *in );
+
+#endif
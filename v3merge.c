@@ -0,0 +1,95 @@
+/*subfile:  V3Merge.c  *******************************************************/
+
+/*  Main program to merge view factor rows computed by separate View3D runs.
+ *
+ *  A large model may be split across processes with the control word
+ *  rows=a-b or shard=k/n; each run then writes its block of rows of the
+ *  AF array to its output file instead of the view factors.  This
+ *  program reads the same input file and all the blocks, checks that
+ *  every row is present once, and does the remaining steps of a single
+ *  run:  DelNull, Separate, Combine, NormAF, IntFac and SaveVF.  */
+
+#ifdef _DEBUG
+# define DEBUG 1
+#else
+# define DEBUG 0
+#endif
+
+#include <stdio.h>
+#include <stdlib.h> /* prototype: exit, free */
+
+#include "config.h"
+#include "types.h"
+#include "view3d.h"
+#include "misc.h"
+#include "heap.h"
+#include "polygn.h"
+#include "readvf.h"
+#include "savevf.h"
+#include "v3main.h"
+
+/*----------------------------------------------------------------------------*/
+int main( int argc, char **argv ){
+  InData inData;       /* surface data from the input file */
+  VFResultsC res;      /* zero-based copy of the results */
+  double **AF;         /* triangular array of area*view factor values [1:nSrf][] */
+  int *count;          /* number of times each row was read [1:nSrf] */
+  FILE *outHandle;     /* view factor file */
+  int nSrf0;           /* initial number of surfaces */
+  int n, i;
+
+  _ulog = stderr;
+  if( argc < 4 ){
+    fprintf(stderr,"\n"
+		"VIEW3D-MERGE - merge rows computed with rows= or shard=. Version %s.\n\n"
+		"Usage: %s INFILE.vs3 OUTFILE.txt ROWS1 [ROWS2 ...]\n\n"
+		, V3D_VERSION, argv[0]
+	);
+    exit( 1 );
+  }
+
+  inData = readFilePath( argv[1] );
+  FreeTmpVertMem();  /* polygon memory is used only while reading */
+  FreePolygonMem();
+  nSrf0 = inData.vfCtrl.nRadSrf;
+
+  AF = Alc_MSC( 1, nSrf0, sizeof(double), __FILE__, __LINE__ );
+  count = Alc_V( 1, nSrf0, sizeof(int), __FILE__, __LINE__ );
+  for( i=3; i<argc; i++ ){
+    n = ReadAFRows( argv[i], nSrf0, inData.area, AF, count );
+    fprintf( _ulog, "%s: %d rows\n", argv[i], n );
+  }
+  error( -2, __FILE__, __LINE__, "" );  /* clear error count */
+  for( n=1; n<=nSrf0; n=i ){   /* report runs of bad rows */
+    for( i=n+1; i<=nSrf0 && count[i] == count[n]; i++ )
+      ;
+    if( count[n] == 0 )
+      error( 2, __FILE__, __LINE__, "Missing rows ", IntStr(n), " to ", IntStr(i-1), "" );
+    else if( count[n] > 1 )
+      error( 2, __FILE__, __LINE__, "Rows ", IntStr(n), " to ", IntStr(i-1),
+        " read more than once", "" );
+  }
+  if( error( -1, __FILE__, __LINE__, "" ) > 0 )
+    error( 3, __FILE__, __LINE__, "Rows do not match the input data", "" );
+
+  res = FinishAF( &inData, AF );
+
+  outHandle = fopen( argv[2], "w" );
+  if( !outHandle )
+    error( 3, __FILE__, __LINE__, "Could not open file: ", argv[2], "" );
+  SaveVF( outHandle, "View3D", V3D_VERSION, inData.vfCtrl.outFormat,
+    inData.vfCtrl.enclosure, inData.vfCtrl.emittances, inData.nSrf,
+    inData.area, inData.emit, AF, inData.vtmp );
+  fclose( outHandle );
+
+  free( res.values );
+  free( res.area );
+  free( res.emit );
+  Fre_V( count, 1, nSrf0, sizeof(int), __FILE__, __LINE__ );
+  Fre_MSC( (void **)AF, 1, nSrf0, sizeof(double), __FILE__, __LINE__ );
+  FreeInData( &inData );
+  if( MemNet( "\nAfter merging view factors" ) )
+    MemList();
+
+  return 0;
+}
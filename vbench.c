@@ -0,0 +1,147 @@
+/*  VBench  Microbenchmark of the view factor contour and area integral
+ *  kernels.  */
+
+/* Usage:
+	VBench [edges per view point] [repetitions]
+*/
+
+#include <stdio.h>
+#include <stdlib.h> /* prototypes: atoi, rand */
+#include <math.h>   /* prototypes: sin, cos, fabs */
+#include <time.h>   /* prototype: clock */
+#include "types.h"
+#include "viewvec.h"
+
+#define MAXVPT 256  /* number of view points */
+#define MAXNE 4096  /* maximum edges per view point */
+
+static double ax[MAXNE], ay[MAXNE], bx[MAXNE], by[MAXNE];
+static double z[MAXVPT];
+static DirCos u[MAXVPT];
+static double px[2][MAXSS], py[2][MAXSS], pz[2][MAXSS], pw[2][MAXSS];
+
+/***  Random.c  **************************************************************/
+
+/*  Return a uniform random number in [lo, hi).  */
+
+static double Random( double lo, double hi ){
+  return lo + (hi - lo) * (double)rand() / ((double)RAND_MAX + 1.0);
+}  /* end Random */
+
+/***  SetEdges.c  ************************************************************/
+
+/*  Set NE edges of random clockwise polygons of 3 to 8 vertices in
+ *  the unit square, and MAXVPT view points above the plane with random
+ *  directions facing it.  */
+
+static void SetEdges( int ne ){
+  int n, k;
+
+  for( n=0; n<ne; ){
+    int nv = 3 + rand() % 6;
+    double cx = Random( 0.0, 1.0 ), cy = Random( 0.0, 1.0 );
+    double r = Random( 0.01, 0.2 ), a0 = Random( 0.0, 6.2831853 );
+    for( k=0; k<nv && n<ne; k++,n++ ){
+      double a1 = a0 - 6.2831853 * k / nv, a2 = a0 - 6.2831853 * (k+1) / nv;
+      ax[n] = cx + r * cos( a1 );
+      ay[n] = cy + r * sin( a1 );
+      bx[n] = cx + r * cos( a2 );
+      by[n] = cy + r * sin( a2 );
+    }
+  }
+  for( n=0; n<MAXVPT; n++ ){
+    double t = Random( 0.0, 1.4 ), p = Random( 0.0, 6.2831853 );
+    z[n] = -Random( 0.001, 2.0 );   /* plane below the view point */
+    u[n].x = sin( t ) * cos( p );
+    u[n].y = sin( t ) * sin( p );
+    u[n].z = -cos( t );
+  }
+}  /* end SetEdges */
+
+/***  SetPoints.c  ***********************************************************/
+
+/*  Set N random points with random weights on each of two facing
+ *  unit squares one unit apart.  */
+
+static void SetPoints( int n ){
+  int k;
+
+  for( k=0; k<n; k++ ){
+    px[0][k] = Random( 0.0, 1.0 );  py[0][k] = Random( 0.0, 1.0 );
+    px[1][k] = Random( 0.0, 1.0 );  py[1][k] = Random( 0.0, 1.0 );
+    pz[0][k] = 0.0;  pz[1][k] = 1.0;
+    pw[0][k] = Random( 0.0, 0.2 );  pw[1][k] = Random( 0.0, 0.2 );
+  }
+}  /* end SetPoints */
+
+/***  BenchV2AI.c  ***********************************************************/
+
+/*  Time V2AIsum() for N x N points with each version up to BEST.  */
+
+static void BenchV2AI( int n, int best, int nrep ){
+  static const DirCos u1={0.0,0.0,1.0}, u2={0.0,0.0,-1.0};
+  double ref, err, sec[4], chk;
+  int isa, rep;
+
+  SetPoints( n );
+  ref = V2AIscalar( n, px[0], py[0], pz[0], pw[0], &u1,
+    n, px[1], py[1], pz[1], pw[1], &u2 );
+  for( isa=V1AI_SCALAR; isa<=best; isa++ ){
+    clock_t t0;
+    V1AIsetISA( isa );
+    err = fabs( V2AIsum( n, px[0], py[0], pz[0], pw[0], &u1,
+      n, px[1], py[1], pz[1], pw[1], &u2 ) - ref );
+    t0 = clock();
+    for( chk=0.0,rep=0; rep<nrep*MAXVPT; rep++ )
+      chk += V2AIsum( n, px[0], py[0], pz[0], pw[0], &u1,
+        n, px[1], py[1], pz[1], pw[1], &u2 );
+    sec[isa] = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    printf( "%-8s %2d x %-2d %8.2f ns/pair  speedup %5.2f  error %.2e  (%g)\n",
+      V1AIname( isa ), n, n, 1.0e9 * sec[isa] / ((double)nrep * MAXVPT * n * n),
+      sec[V1AI_SCALAR] / sec[isa], err, chk );
+  }
+}  /* end BenchV2AI */
+
+/***  main.c  ****************************************************************/
+
+int main( int argc, char **argv ){
+  int ne = argc > 1 ? atoi( argv[1] ) : 32;
+  int nrep = argc > 2 ? atoi( argv[2] ) : 2000;
+  static double ref[MAXVPT];
+  double maxErr[4] = { 0.0, 0.0, 0.0, 0.0 };
+  double sec[4], chk;
+  int isa, best, n, rep;
+
+  if( ne < 1 || ne > MAXNE || nrep < 1 ){
+    fprintf( stderr, "VBench  [edges 1..%d]  [repetitions]\n", MAXNE );
+    exit( 1 );
+  }
+  SetEdges( ne );
+  for( n=0; n<MAXVPT; n++ )
+    ref[n] = V1AIscalar( ne, ax, ay, bx, by, z[n], u+n );
+
+  best = V1AIsetISA( -1 );
+  printf( "%d edges, %d view points, %d repetitions\n", ne, MAXVPT, nrep );
+  for( isa=V1AI_SCALAR; isa<=best; isa++ ){
+    clock_t t0;
+    V1AIsetISA( isa );
+    for( n=0; n<MAXVPT; n++ ){  /* error relative to the scalar loop */
+      double err = fabs( V1AIsum( ne, ax, ay, bx, by, z[n], u+n ) - ref[n] );
+      if( err > maxErr[isa] ) maxErr[isa] = err;
+    }
+    t0 = clock();
+    for( chk=0.0,rep=0; rep<nrep; rep++ )
+      for( n=0; n<MAXVPT; n++ )
+        chk += V1AIsum( ne, ax, ay, bx, by, z[n], u+n );
+    sec[isa] = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    printf( "%-8s %8.2f ns/edge  speedup %5.2f  max error %.2e  (%g)\n",
+      V1AIname( isa ), 1.0e9 * sec[isa] / ((double)nrep * MAXVPT * ne),
+      sec[V1AI_SCALAR] / sec[isa], maxErr[isa], chk );
+  }
+
+  printf( "double area integration, %d repetitions\n", nrep );
+  for( n=1; n*n<=MAXSS; n++ )
+    BenchV2AI( n*n, best, nrep / 10 + 1 );
+
+  return 0;
+}  /* end main */
@@ -23,9 +23,9 @@
 #endif
 
 #if 0
-extern IX _list;    /* output control, higher value = more output */
-extern FILE *_ulog; /* log file */
-extern I1 _string[]; /* buffer for a character string */
+extern V3D_TLS IX _list;    /* output control, higher value = more output */
+extern V3D_TLS FILE *_ulog; /* log file */
+extern V3D_TLS I1 _string[]; /* buffer for a character string */
 #endif
 
 /*  redefinition of C variable types and path parameters.  */
@@ -22,20 +22,28 @@
 #include "viewobs.h"
 #include "test3d.h"
 #include "ctrans.h"
+#include "viewmt.h"
+#include "viewhemi.h"
 
 void ViewMethod( SRFDATNM *srfN, SRFDATNM *srfM, double distNM, View3DControlData *vfCtrl );
 void InitViewMethod( View3DControlData *vfCtrl );
+static int ObstrCandidates( View3DWork *work, SRFDATNM *srfN, SRFDATNM *srfM,
+  double distNM );
+static void PairFinish( View3DWork *work, int n, int m );
+static void View3DBatch( View3DWork *work );
 
-extern int _list;    /* output control, higher value = more output */
-extern FILE *_ulog; /* log file */
+#define BVHMIN 32  /* min possible obstructions to use the BVH */
 
-int _row=0;  /* row number; save for errorf() */
-int _col=0;  /* column number; " */
-double _sli4;   /* use SLI if rcRatio > 4 and relSep > _sli4 */
-double _sai4;   /* use SAI if rcRatio > 4 and relSep > _sai4 */
-double _sai10;  /* use SAI if rcRatio > 10 and relSep > _sai10 */
-double _dai1;   /* use DAI if relSep > _dai1 */
-double _sli1;   /* use SLI if relSep > _sli1 */
+extern V3D_TLS int _list;    /* output control, higher value = more output */
+extern V3D_TLS FILE *_ulog; /* log file */
+
+V3D_TLS int _row=0;  /* row number; save for errorf() */
+V3D_TLS int _col=0;  /* column number; " */
+V3D_TLS double _sli4;   /* use SLI if rcRatio > 4 and relSep > _sli4 */
+V3D_TLS double _sai4;   /* use SAI if rcRatio > 4 and relSep > _sai4 */
+V3D_TLS double _sai10;  /* use SAI if rcRatio > 10 and relSep > _sai10 */
+V3D_TLS double _dai1;   /* use DAI if relSep > _dai1 */
+V3D_TLS double _sli1;   /* use SLI if relSep > _sli1 */
 
 /***  View3D.c  **************************************************************/
 
@@ -67,28 +75,10 @@ void View3D( SRFDAT3D *srf, const int *base, int *possibleObstr,
   int m;  /* column */
   int n1=1, nn;     /* first and last rows */
   int m1=1, mm;     /* first and last columns */
-  int *maskSrf;     /* list of mask and null surfaces */
-  int *possibleObstrN;  /* list of possible obstructions rel. to N */
-  int *probableObstr;   /* list of probable obstructions */
-  int nPossN;       /* number of possible obstructions rel. to N */
-  int nProb;        /* number of probable obstructions */
-  int mayView;      /* true if surfaces may view each other */
-  SRFDATNM srfN,   /* row N surface */
-           srfM,   /* column M surface */
-          *srf1,   /* view from srf1 to srf2 -- */
-          *srf2;   /*   one is srfN, the other is srfM. */
-  Vec3 vNM;    /* vector between centroids of srfN and srfM */
-  double distNM;       /* distance between centroids of srfN and srfM */
-  double minArea;      /* area of smaller surface */
-  unsigned long nAF0=0,       /* number of AF which must equal 0 */
-     nAFnO=0,      /* number of AF without obstructing surfaces */
-     nAFwO=0,      /* number of AF with obstructing surfaces */
-     nObstr=0;     /* total number of obstructions considered */
-  unsigned **bins;       /* for statistical summary */
+  int *maskSrf=NULL;  /* list of mask and null surfaces */
+  View3DWork work;  /* working data for the pair calculations */
   double nAFtot=1;     /* total number of view factors to compute */
-  int maxSrfT=4;    /* max number of participating (transformed) surfaces */
 
-  maxSrfT = vfCtrl->nPossObstr + 1;
   nn = vfCtrl->nRadSrf;
   if( nn>1 )
     nAFtot = (double)((nn-1)*nn);
@@ -98,15 +88,14 @@ void View3D( SRFDAT3D *srf, const int *base, int *possibleObstr,
     if( vfCtrl->col > 0 )
       m1 = vfCtrl->col;      /* or a single view factor, */
     }
+  else if( vfCtrl->row1 > 0 )
+    {
+    n1 = vfCtrl->row1;       /* or a block of rows */
+    nn = vfCtrl->row2;
+    }
 
   ViewsInit( 4, 1 );  /* initialize Gaussian integration coefficients */
   InitViewMethod( vfCtrl );
-
-  possibleObstrN = Alc_V( 1, vfCtrl->nAllSrf, sizeof(int), __FILE__, __LINE__ );
-  probableObstr = Alc_V( 1, vfCtrl->nAllSrf, sizeof(int), __FILE__, __LINE__ );
-
-  vfCtrl->srfOT = Alc_V( 0, maxSrfT, sizeof(SRFDAT3X), __FILE__, __LINE__ );
-  bins = Alc_MC( 0, 4, 1, 5, sizeof(unsigned), __FILE__, __LINE__ );
   vfCtrl->failConverge = 0;
 
   if( vfCtrl->nMaskSrf ) /* pre-process view masking surfaces */
@@ -136,20 +125,47 @@ void View3D( SRFDAT3D *srf, const int *base, int *possibleObstr,
       }
     }
 
+  memset( &work, 0, sizeof(View3DWork) );
+  work.srf = srf;
+  work.base = base;
+  work.possibleObstr = possibleObstr;
+  work.maskSrf = maskSrf;
+  work.AF = AF;
+  work.vfCtrl = vfCtrl;
+  if( vfCtrl->nPossObstr >= BVHMIN )
+    work.bvh = BuildObstrBVH( srf, vfCtrl->nAllSrf, possibleObstr,
+      vfCtrl->nPossObstr );
+  if( vfCtrl->farField && vfCtrl->nMaskSrf == 0 && vfCtrl->nRadSrf > 1 )
+    work.far = BuildFarField( srf, vfCtrl->nRadSrf );
+  View3DWorkInit( &work );
+  if( vfCtrl->journal[0] && vfCtrl->row == 0 )
+    {
+    work.journal = JournalOpen( vfCtrl->journal, vfCtrl->jnlTime, srf, base,
+      vfCtrl, AF, n1, nn );
+#ifdef LOGGING
+    fprintf( _ulog, "\nRows read from journal %s: %d\n", vfCtrl->journal,
+      work.journal->nLoaded );
+#endif
+    }
+
+  if( vfCtrl->engine == HEMI )
+    View3DHemi( &work, n1, nn );       /* whole rows by hemicubes */
+  else if( vfCtrl->nThreads > 1 && vfCtrl->row == 0 )
+    View3DParallel( &work, n1, nn );   /* rows shared by worker threads */
+  else
   for( n=n1; n<=nn; n++ )  /* process AF values for row N */
     {
-    _row = n;
     if( vfCtrl->row == 0 )  /* progress display - all surfaces */
       {
       double pctDone = 100 * (double)((n-1)*n) / nAFtot;
 #ifdef LOGGING
-      fprintf( stderr, "\rSurface: %d; ~ %.1f %% complete", _row, pctDone );
+      fprintf( stderr, "\rSurface: %d; ~ %.1f %% complete", n, pctDone );
 #endif
       }
+    if( work.journal && work.journal->done[n] )
+      continue;             /* row read from the journal */
     AF[n][n] = 0.0;
-    nPossN = vfCtrl->nPossObstr;  /* remove obstructions behind N */
-    memcpy( possibleObstrN+1, possibleObstr+1, nPossN*sizeof(int) );
-    nPossN = OrientationTestN( srf, n, vfCtrl, possibleObstrN, nPossN );
+    View3DRow( &work, n );
     if( vfCtrl->col )  /* set column limits */
       mm = m1 + 1;
     else if( vfCtrl->row > 0 )
@@ -157,273 +173,757 @@ void View3D( SRFDAT3D *srf, const int *base, int *possibleObstr,
     else
       mm = n;
 
-    for( m=m1; m<mm; m++ )   /* compute view factor: row N, columns M */
+    View3DPairs( &work, n, m1, mm );  /* row N, columns M */
+    if( work.journal )
+      JournalRow( work.journal, AF, n );
+
+    }  /* end of row N */
+#ifdef LOGGING
+  fputc( '\n', stderr );
+#endif
+  if( work.journal )
+    JournalClose( work.journal, AF );
+
+#ifdef LOGGING
+  fprintf( _ulog, "\nSurface pairs where F(i,j) must be zero: %8lu\n", work.nAF0 );
+  fprintf( _ulog, "\nSurface pairs without obstructed views:  %8lu\n", work.nAFnO );
+  if( work.far )
+    fprintf( _ulog, "Surface pairs by far-field estimates:    %8lu\n", work.nAFff );
+  if( vfCtrl->fp32 )
+    {
+    fprintf( _ulog, "Surface pairs by single precision 2AI:   %8lu\n", work.nAF32 );
+    fprintf( _ulog, "   redone in double precision:           %8lu\n", work.nAF32d );
+    }
+#endif
+  work.bins[4][5] = work.bins[0][5] + work.bins[1][5] + work.bins[2][5] + work.bins[3][5];
+#ifdef LOGGING
+  fprintf( _ulog, "   nd %7s %7s %7s %7s %7s\n",
+    methods[0], methods[1], methods[2], methods[3], methods[4] );
+  fprintf( _ulog, "    2 %7u %7u %7u %7u %7u direct\n",
+     work.bins[0][2], work.bins[1][2], work.bins[2][2], work.bins[3][2], work.bins[4][2] );
+  fprintf( _ulog, "    3 %7u %7u %7u %7u\n",
+     work.bins[0][3], work.bins[1][3], work.bins[2][3], work.bins[3][3] );
+  fprintf( _ulog, "    4 %7u %7u %7u %7u\n",
+     work.bins[0][4], work.bins[1][4], work.bins[2][4], work.bins[3][4] );
+  fprintf( _ulog, "  fix %7u %7u %7u %7u %7u fixes\n",
+     work.bins[0][5], work.bins[1][5], work.bins[2][5], work.bins[3][5], work.bins[4][5] );
+  if( vfCtrl->rect )
+    fprintf( _ulog, " rect %7u %7u %7u %7u %7u closed form\n",
+       work.bins[0][6], work.bins[1][6], work.bins[2][6], work.bins[3][6], work.bins[4][6] );
+  if( vfCtrl->unob == EXACT )
+    fprintf( _ulog, "exact %7u %7u %7u %7u %7u closed form\n",
+       work.bins[0][7], work.bins[1][7], work.bins[2][7], work.bins[3][7], work.bins[4][7] );
+#endif
+  ViewsInit( 4, 0 );
+#ifdef LOGGING
+  fprintf( _ulog, "Adaptive line integral evaluations used: %8lu\n",
+    vfCtrl->usedV1LIadapt );
+  if( vfCtrl->shaft )
+    {
+    fprintf( _ulog, "\nSurface pairs blocked by one surface:  %10lu\n", work.nAFsb );
+    fprintf( _ulog, "Obstructions outside the shaft:        %10lu\n", work.nShaftOut );
+    }
+  fprintf( _ulog, "\nSurface pairs with obstructed views:   %10lu\n", work.nAFwO );
+  if( work.nAFwO > 0 )
+    {
+    fprintf( _ulog, "Average number of obstructions per pair:   %6.2f\n",
+      (double)work.nObstr / (double)work.nAFwO );
+    if( vfCtrl->engine == RAYS )
       {
-      if( vfCtrl->nMaskSrf && AF[n][m] >= 0.0 ) continue;
-      if( m == n ) continue;
-      _col = m;
-      if( vfCtrl->row > 0 && vfCtrl->col == 0)  /* progress display - single surface */
-        {
+      fprintf( _ulog, "Rays traced:                           %10lu\n",
+        vfCtrl->totRays );
+      fprintf( _ulog, "Pairs redone by projection:            %10lu\n",
+        work.nAFrp );
+      }
+    fprintf( _ulog, "Adaptive viewpoint evaluations used:   %10lu\n",
+      vfCtrl->usedVObs );
+    fprintf( _ulog, "Adaptive viewpoint evaluations lost:   %10lu\n",
+      vfCtrl->wastedVObs );
+    fprintf( _ulog, "Non-zero viewpoint evaluations:        %10lu\n",
+      vfCtrl->totVpt );
+/***fprintf( _ulog, "Number of 1AI point-polygon evaluations: %8u\n",
+      vfCtrl->totPoly );***/
+    if( vfCtrl->totVpt > 0 )  /* none if all by ray casting */
+      fprintf( _ulog, "Average number of polygons per viewpoint:  %6.2f\n",
+        (double)vfCtrl->totPoly / (double)vfCtrl->totVpt );
+    fprintf( _ulog, "\n" );
+    }
+#endif
+
+  if( vfCtrl->failConverge ) error( 1, __FILE__, __LINE__,
+    "Some calculations did not converge, see VIEW3D.LOG", "" );
+
+#if( DEBUG > 1 )
+  MemRem( "After View3D() calculations" );
+#endif
+  View3DWorkFree( &work );
+  if( work.bvh )
+    FreeObstrBVH( work.bvh );
+  if( work.far )
+    FreeFarField( work.far );
+  if( vfCtrl->nMaskSrf )
+    Fre_V( maskSrf, 1, vfCtrl->nMaskSrf, sizeof(int), __FILE__, __LINE__ );
+
+  }  /* end of View3D */
+
+/***  View3DShard.c  *********************************************************/
+
+/*  Set the block of rows, vfCtrl->row1 to vfCtrl->row2, for shard
+ *  vfCtrl->shard of vfCtrl->nShards.  The blocks have about equal
+ *  estimated cost.  The cost of row N is N-1 times the mean of
+ *  View3DPairCost() at up to SHARDCOLS evenly spaced columns;
+ *  it is the same in every process, so the blocks of the shards cover
+ *  all rows exactly once.  A shard may be empty:  row1 > row2.  */
+
+#define SHARDCOLS 16
+
+void View3DShard( SRFDAT3D *srf, const int *base, int *possibleObstr,
+  View3DControlData *vfCtrl )
+  {
+  View3DControlData ctrl;  /* copy of vfCtrl for View3DPairCost() */
+  View3DWork work;
+  double *cost;  /* cost[n] = estimated cost of rows 1 to n */
+  double lo, hi; /* cost limits of the shard */
+  int nn = vfCtrl->nRadSrf;
+  int n, m, k, step;
+
+  memcpy( &ctrl, vfCtrl, sizeof(View3DControlData) );
+  ctrl.nMaskSrf = 0;     /* mask pairs are skipped below; AF not needed */
+  memset( &work, 0, sizeof(View3DWork) );
+  work.srf = srf;
+  work.base = base;
+  work.possibleObstr = possibleObstr;
+  work.vfCtrl = &ctrl;
+  if( ctrl.nPossObstr >= BVHMIN )
+    work.bvh = BuildObstrBVH( srf, ctrl.nAllSrf, possibleObstr,
+      ctrl.nPossObstr );
+  if( ctrl.farField && vfCtrl->nMaskSrf == 0 && ctrl.nRadSrf > 1 )
+    work.far = BuildFarField( srf, ctrl.nRadSrf );
+  View3DWorkInit( &work );
+  InitViewMethod( &ctrl );
+
+  cost = Alc_V( 0, nn, sizeof(double), __FILE__, __LINE__ );
+  for( n=1; n<=nn; n++ )
+    {
+    double sum=0.0;
+    cost[n] = cost[n-1];
+    if( n == 1 || srf[n].type == MASK || srf[n].type == NULS )
+      continue;
+    step = (n - 1 + SHARDCOLS - 1) / SHARDCOLS;
+    for( k=0,m=1; m<n; m+=step )
+      {
+      if( srf[m].type == MASK || srf[m].type == NULS )
+        continue;
+      sum += View3DPairCost( &work, n, m );
+      k++;
+      }
+    if( k )
+      cost[n] += sum * (n - 1) / k;
+    }
+
+  /* shard k ends with the last row where cost[n] <= cost[nn]*k/nShards */
+  lo = cost[nn] * (vfCtrl->shard - 1) / vfCtrl->nShards;
+  hi = cost[nn] * vfCtrl->shard / vfCtrl->nShards;
+  n = 0;
+  if( vfCtrl->shard > 1 )
+    while( n<nn && cost[n+1] <= lo )
+      n++;
+  vfCtrl->row1 = n + 1;
+  while( n<nn && cost[n+1] <= hi )
+    n++;
+  if( vfCtrl->shard == vfCtrl->nShards )
+    n = nn;
+  vfCtrl->row2 = n;
 #ifdef LOGGING
-        fprintf( stderr, "\rSurface %d to surface %d", _row, _col );
+  fprintf( _ulog, "View3DShard: shard %d of %d, rows %d to %d\n",
+    vfCtrl->shard, vfCtrl->nShards, vfCtrl->row1, vfCtrl->row2 );
 #endif
+
+  Fre_V( cost, 0, nn, sizeof(double), __FILE__, __LINE__ );
+  View3DWorkFree( &work );
+  if( work.bvh )
+    FreeObstrBVH( work.bvh );
+  if( work.far )
+    FreeFarField( work.far );
+
+  }  /* end View3DShard */
+
+/***  View3DWorkInit.c  ******************************************************/
+
+/*  Allocate the working vectors of one View3D() calculation thread.
+ *  The calling function sets srf, base, possibleObstr, maskSrf, AF
+ *  and vfCtrl; the srfOT and setOT arrays are attached to vfCtrl.  */
+
+void View3DWorkInit( View3DWork *work )
+  {
+  View3DControlData *vfCtrl = work->vfCtrl;
+
+  work->maxSrfT = vfCtrl->nPossObstr + 1;
+  work->possibleObstrN = Alc_V( 1, vfCtrl->nAllSrf, sizeof(int), __FILE__, __LINE__ );
+  work->probableObstr = Alc_V( 1, vfCtrl->nAllSrf, sizeof(int), __FILE__, __LINE__ );
+  vfCtrl->srfOT = Alc_V( 0, work->maxSrfT, sizeof(SRFDAT3X), __FILE__, __LINE__ );
+  vfCtrl->setOT = AlcSrfSet3X( work->maxSrfT+1 );
+  if( vfCtrl->adapt )
+    vfCtrl->adaptElem = Alc_V( 0, vfCtrl->budget+ADAPTINIT, sizeof(AdaptElem),
+      __FILE__, __LINE__ );
+  work->bins = Alc_MC( 0, 4, 1, 7, sizeof(unsigned), __FILE__, __LINE__ );
+  if( work->bvh )
+    work->markN = Alc_V( 1, vfCtrl->nPossObstr, sizeof(int), __FILE__, __LINE__ );
+  if( work->far )
+    work->farN = Alc_V( 1, vfCtrl->nRadSrf, sizeof(int), __FILE__, __LINE__ );
+  work->rays = vfCtrl->engine == RAYS ? NewRayScene() : NULL;
+  work->batch = vfCtrl->row == 0 && vfCtrl->col == 0 ?
+    Alc_V( 0, UNOBBATCH-1, sizeof(UnobPair), __FILE__, __LINE__ ) : NULL;
+  work->nBatch = work->batching = 0;
+  work->rowN = 0;
+
+  }  /* end View3DWorkInit */
+
+/***  View3DWorkFree.c  ******************************************************/
+
+/*  Free the working vectors allocated by View3DWorkInit().  */
+
+void View3DWorkFree( View3DWork *work )
+  {
+  View3DControlData *vfCtrl = work->vfCtrl;
+
+  if( work->batch )
+    Fre_V( work->batch, 0, UNOBBATCH-1, sizeof(UnobPair), __FILE__, __LINE__ );
+  if( work->rays )
+    FreeRayScene( work->rays );
+  if( work->farN )
+    Fre_V( work->farN, 1, vfCtrl->nRadSrf, sizeof(int), __FILE__, __LINE__ );
+  if( work->markN )
+    Fre_V( work->markN, 1, vfCtrl->nPossObstr, sizeof(int), __FILE__, __LINE__ );
+  Fre_MC( work->bins, 0, 4, 1, 7, sizeof(unsigned), __FILE__, __LINE__ );
+  if( vfCtrl->adaptElem )
+    Fre_V( vfCtrl->adaptElem, 0, vfCtrl->budget+ADAPTINIT, sizeof(AdaptElem),
+      __FILE__, __LINE__ );
+  FreSrfSet3X( vfCtrl->setOT );
+  Fre_V( vfCtrl->srfOT, 0, work->maxSrfT, sizeof(SRFDAT3X), __FILE__, __LINE__ );
+  Fre_V( work->probableObstr, 1, vfCtrl->nAllSrf, sizeof(int), __FILE__, __LINE__ );
+  Fre_V( work->possibleObstrN, 1, vfCtrl->nAllSrf, sizeof(int), __FILE__, __LINE__ );
+
+  }  /* end View3DWorkFree */
+
+/***  View3DRow.c  ***********************************************************/
+
+/*  Prepare to compute the view factors of row N:
+ *  remove possible obstructions behind surface N.  */
+
+void View3DRow( View3DWork *work, int n )
+  {
+  _row = n;
+  work->nPossN = work->vfCtrl->nPossObstr;  /* remove obstructions behind N */
+  memcpy( work->possibleObstrN+1, work->possibleObstr+1, work->nPossN*sizeof(int) );
+  work->nPossN = OrientationTestN( work->srf, n, work->vfCtrl,
+    work->possibleObstrN, work->nPossN );
+  if( work->bvh )     /* mark the obstructions of row N */
+    {
+    int j;
+    for( j=1; j<=work->nPossN; j++ )
+      work->markN[work->bvh->rank[work->possibleObstrN[j]]] = n;
+    }
+  if( work->far )     /* mark the well separated columns of row N */
+    FarFieldRow( work->far, work->srf, n, work->vfCtrl->epsAdap, work->bvh,
+      work->markN, work->possibleObstrN, work->nPossN, work->farN );
+  work->rowN = n;
+
+  }  /* end View3DRow */
+
+/***  PairSurfaces.c  ********************************************************/
+
+/*  Set srfN and srfM for the view between surfaces N and M;
+ *  clip either one that lies partly behind the other.
+ *  Return 0 if the surfaces cannot view each other, 2 if either
+ *  was clipped, otherwise 1.  */
+
+static int PairSurfaces( SRFDAT3D *srf, int n, int m,
+  SRFDATNM *srfN, SRFDATNM *srfM )
+  {
+  int mayView;      /* true if surfaces may view each other */
+
+  mayView = SelfObstructionTest3D( srf+n, srf+m, srfM );
+  if( mayView )
+    mayView = SelfObstructionTest3D( srf+m, srf+n, srfN );
+  if( mayView )
+    {
+    if( srfN->area * srfM->area == 0.0 )  /* must clip one or both surfces */
+      {
+      if( srfN->area + srfM->area == 0.0 )
+        {
+        IntersectionTest( srfN, srfM );  /* check invalid geometry */
+        SelfObstructionClip( srfN );
+        SelfObstructionClip( srfM );
         }
-      if( _list>0 && vfCtrl->row )
+      else if( srfN->area == 0.0 )
+        SelfObstructionClip( srfN );
+      else if( srfM->area == 0.0 )
+        SelfObstructionClip( srfM );
+      mayView = 2;
+      }
+    }
+
+  return mayView;
+
+  }  /* end PairSurfaces */
+
+/***  View3DPairCost.c  ******************************************************/
+
+/*  Estimate the relative cost of computing the view factor of
+ *  row N, column M.  The unit is roughly one direct 2AI calculation.
+ *  Only the inexpensive obstruction tests are applied:  the estimate
+ *  uses the number of obstructions left by ConeRadiusTest() and
+ *  BoxTest(), the area ratio of the surfaces and the rcRatio/relSep
+ *  values used by ViewMethod() to choose the integration method.
+ *  View3DRow() must have been called for row N.  */
+
+double View3DPairCost( View3DWork *work, int n, int m )
+  {
+  SRFDAT3D *srf = work->srf;
+  View3DControlData *vfCtrl = work->vfCtrl;
+  int *probableObstr = work->probableObstr;
+  SRFDATNM srfN, srfM;
+  Vec3 vNM;    /* vector between centroids of srfN and srfM */
+  double distNM;       /* distance between centroids of srfN and srfM */
+  double areaRatio;    /* area of larger surface / smaller surface */
+  double cost;
+  int nProb;        /* number of probable obstructions */
+
+  if( vfCtrl->nMaskSrf && work->AF[n][m] >= 0.0 ) return 0.0;
+  if( m == n ) return 0.0;
+  if( work->rowN != n )
+    View3DRow( work, n );
+  if( work->far && m <= vfCtrl->nRadSrf && work->farN[m] == n )
+    return 0.05;       /* far-field estimate */
+  _col = m;
+  if( !PairSurfaces( srf, n, m, &srfN, &srfM ) )
+    return 0.05;       /* view not possible */
+
+  VECTOR( (&srfN.ctd), (&srfM.ctd), (&vNM) );
+  distNM = VLEN( (&vNM) );
+  nProb = work->nPossN;
+  if( srfN.area < 1.0e-4*srf[n].area ||
+      srfM.area < 1.0e-4*srf[m].area )
+    nProb = 0;
+  if( nProb )
+    nProb = ObstrCandidates( work, &srfN, &srfM, distNM );
+  if( nProb )
+    nProb = ConeRadiusTest( srf, &srfN, &srfM,
+      vfCtrl, probableObstr, nProb, distNM );
+  if( nProb )
+    nProb = BoxTest( srf, &srfN, &srfM, vfCtrl, probableObstr, nProb );
+  if( nProb && vfCtrl->shaft )
+    {
+    int blocked;
+    nProb = ShaftTest( srf, &srfN, &srfM, vfCtrl, probableObstr, nProb,
+      &blocked );
+    if( blocked )
+      return 0.05;     /* view blocked */
+    }
+
+  if( srfN.area > srfM.area )
+    areaRatio = srfN.area / srfM.area;
+  else
+    areaRatio = srfM.area / srfN.area;
+
+  if( nProb )      /* obstructed: adaptive viewpoints */
+    cost = (10.0 + 2.0 * nProb) * (1.0 + 0.5 * log( areaRatio ));
+  else                            /* unobstructed: by ViewMethod() */
+    {
+    ViewMethod( &srfN, &srfM, distNM, vfCtrl );
+    if( vfCtrl->method == ALI )
+      cost = 8.0 + vfCtrl->rcRatio;
+    else if( vfCtrl->method == DAI )
+      cost = 1.0 + 4.0 / (vfCtrl->relSep * vfCtrl->relSep);
+    else
+      cost = 2.0 + 2.0 / vfCtrl->relSep;
+    }
+
+  return cost;
+
+  }  /* end View3DPairCost */
+
+/***  ObstrCandidates.c  *****************************************************/
+
+/*  Copy to work->probableObstr the possible obstructions of row N
+ *  which may lie between srfN and srfM, in the order of possibleObstrN.
+ *  Return their number.  */
+
+static int ObstrCandidates( View3DWork *work, SRFDATNM *srfN, SRFDATNM *srfM,
+  double distNM )
+  {
+  if( work->bvh )
+    return QueryObstrBVH( work->bvh, srfN, srfM, distNM,
+      work->markN, work->rowN, work->probableObstr );
+
+  memcpy( work->probableObstr+1, work->possibleObstrN+1,
+    work->nPossN*sizeof(int) );
+  return work->nPossN;
+
+  }  /* end ObstrCandidates */
+
+/***  View3DPair.c  **********************************************************/
+
+/*  Compute the view factor of row N, column M.  */
+
+void View3DPair( View3DWork *work, int n, int m )
+  {
+  SRFDAT3D *srf = work->srf;
+  double **AF = work->AF;
+  View3DControlData *vfCtrl = work->vfCtrl;
+  int *probableObstr = work->probableObstr;
+  int nProb;        /* number of probable obstructions */
+  int mayView;      /* true if surfaces may view each other */
+  SRFDATNM srfN,   /* row N surface */
+           srfM,   /* column M surface */
+          *srf1,   /* view from srf1 to srf2 -- */
+          *srf2;   /*   one is srfN, the other is srfM. */
+  Vec3 vNM;    /* vector between centroids of srfN and srfM */
+  double distNM;       /* distance between centroids of srfN and srfM */
+  double minArea;      /* area of smaller surface */
+  int blocked;         /* surface blocking all views; 0 = none */
+  int farPair;         /* true if AF by FarFieldAF() */
+  double rectAF;       /* closed form AF; -1 if not aligned rectangles */
+  double rayAF;        /* ray casting AF; -1 if not used or not converged */
+
+  if( vfCtrl->nMaskSrf && AF[n][m] >= 0.0 ) return;
+  if( m == n ) return;
+  if( work->rowN != n )
+    View3DRow( work, n );
+  _col = m;
+  if( vfCtrl->row > 0 && vfCtrl->col == 0)  /* progress display - single surface */
+    {
 #ifdef LOGGING
-        fprintf( _ulog, "*ROW %d, COL %d\n", _row, _col );
+    fprintf( stderr, "\rSurface %d to surface %d", _row, _col );
 #endif
-      if( vfCtrl->col )
-        {
+    }
+  if( _list>0 && vfCtrl->row )
 #ifdef LOGGING
-        DumpSrf3D( "  srf", srf+_row );
-        DumpSrf3D( "  srf", srf+_col );
-        fflush( _ulog );
+    fprintf( _ulog, "*ROW %d, COL %d\n", _row, _col );
 #endif
-        }
+  if( vfCtrl->col )
+    {
+#ifdef LOGGING
+    DumpSrf3D( "  srf", srf+_row );
+    DumpSrf3D( "  srf", srf+_col );
+    fflush( _ulog );
+#endif
+    }
 
-      minArea = MIN( srf[n].area, srf[m].area );
-      mayView = SelfObstructionTest3D( srf+n, srf+m, &srfM );
-      if( mayView )
-        mayView = SelfObstructionTest3D( srf+m, srf+n, &srfN );
-      if( mayView )
-        {
-        if( srfN.area * srfM.area == 0.0 )  /* must clip one or both surfces */
-          {
-          if( srfN.area + srfM.area == 0.0 )
-            {
-            IntersectionTest( &srfN, &srfM );  /* check invalid geometry */
-            SelfObstructionClip( &srfN );
-            SelfObstructionClip( &srfM );
-            }
-          else if( srfN.area == 0.0 )
-            SelfObstructionClip( &srfN );
-          else if( srfM.area == 0.0 )
-            SelfObstructionClip( &srfM );
-          }
-        if( vfCtrl->col )
-          {
+  minArea = MIN( srf[n].area, srf[m].area );
+  farPair = work->far && m <= vfCtrl->nRadSrf && work->farN[m] == n;
+  mayView = farPair ? 0 : PairSurfaces( srf, n, m, &srfN, &srfM );
+  if( farPair )               /*** well separated: centroid estimate ***/
+    {
+    AF[n][m] = FarFieldAF( srf, n, m );
+    work->nAFff += 1;
+    vfCtrl->method = DAI;
+    }
+  else if( mayView )
+    {
+    if( vfCtrl->col )
+      {
 #ifdef LOGGING
-          DumpSrfNM( "srfN", &srfN );
-          DumpSrfNM( "srfM", &srfM );
-          fflush( _ulog );
+      DumpSrfNM( "srfN", &srfN );
+      DumpSrfNM( "srfM", &srfM );
+      fflush( _ulog );
 #endif
-          }
-        VECTOR( (&srfN.ctd), (&srfM.ctd), (&vNM) );
-        distNM = VLEN( (&vNM) );
-        if( distNM < 1.0e-5 * (srfN.rc + srfM.rc) )
-          errorf( 3, __FILE__, __LINE__, "Surfaces have same centroids", "" );
-
-        nProb = nPossN;
-        memcpy( probableObstr+1, possibleObstrN+1, nProb*sizeof(int) );
-
-        /* special test for extreme clipping; clipped surface amost
-           in the plane of the other surface.  */
-        if( srfN.area < 1.0e-4*srf[n].area ||
-            srfM.area < 1.0e-4*srf[m].area )
-          {
-          nProb = 0;
-          if( vfCtrl->col )
-            fprintf( _ulog, "Extreme Clipping\n" );
-          }
+      }
+    VECTOR( (&srfN.ctd), (&srfM.ctd), (&vNM) );
+    distNM = VLEN( (&vNM) );
+    if( distNM < 1.0e-5 * (srfN.rc + srfM.rc) )
+      errorf( 3, __FILE__, __LINE__, "Surfaces have same centroids", "" );
+
+    nProb = work->nPossN;
+
+    /* special test for extreme clipping; clipped surface amost
+       in the plane of the other surface.  */
+    if( srfN.area < 1.0e-4*srf[n].area ||
+        srfM.area < 1.0e-4*srf[m].area )
+      {
+      nProb = 0;
+      if( vfCtrl->col )
+        fprintf( _ulog, "Extreme Clipping\n" );
+      }
 
-        if( nProb )
-          nProb = ConeRadiusTest( srf, &srfN, &srfM,
-            vfCtrl, probableObstr, nProb, distNM );
+    if( nProb )   /* candidates near the line of sight */
+      nProb = ObstrCandidates( work, &srfN, &srfM, distNM );
+
+    if( nProb )
+      nProb = ConeRadiusTest( srf, &srfN, &srfM,
+        vfCtrl, probableObstr, nProb, distNM );
 //DumpOS( " Rad LOS:", nProb, probableObstr );
 
-        if( nProb )
-          nProb = BoxTest( srf, &srfN, &srfM, vfCtrl, probableObstr, nProb );
+    if( nProb )
+      nProb = BoxTest( srf, &srfN, &srfM, vfCtrl, probableObstr, nProb );
 //DumpOS( " Box LOS:", nProb, probableObstr );
 
-        if( nProb )   /* test/set obstruction orientations */
-          nProb = OrientationTest( srf, &srfN, &srfM,
-            vfCtrl, probableObstr, nProb );
+    if( nProb )   /* test/set obstruction orientations */
+      nProb = OrientationTest( srf, &srfN, &srfM,
+        vfCtrl, probableObstr, nProb );
 //DumpOS( " Orn LOS:", nProb, probableObstr );
 
-        if( vfCtrl->nMaskSrf ) /* add masking surfaces */
-          nProb = AddMaskSrf( srf, &srfN, &srfM, maskSrf, base,
-            vfCtrl, probableObstr, nProb );
-        vfCtrl->nProbObstr = nProb;
+    blocked = 0;
+    if( nProb && vfCtrl->shaft )   /* shaft culling */
+      {
+      int nOrn = nProb;
+      nProb = ShaftTest( srf, &srfN, &srfM, vfCtrl, probableObstr, nProb,
+        &blocked );
+      work->nShaftOut += nOrn - nProb;
+      }
+
+    if( vfCtrl->nMaskSrf ) /* add masking surfaces */
+      nProb = AddMaskSrf( srf, &srfN, &srfM, work->maskSrf, work->base,
+        vfCtrl, probableObstr, nProb );
+    vfCtrl->nProbObstr = nProb;
+
+    {
+    int j, k=0;
+    for( j=1; j<=nProb; j++ )
+      if( probableObstr[j] != _row && probableObstr[j] != _col )
+        probableObstr[++k] = probableObstr[j];
+    nProb = k;
+    }
+//DumpOS( " Msk LOS:", nProb, probableObstr );
 
+    rayAF = -1.0;
+    if( !blocked && vfCtrl->nProbObstr && work->rays )  /* ray casting */
+      {
+      double AF0;          /* unobstructed view factor */
+      vfCtrl->failViewALI = 0;
+      ViewMethod( &srfN, &srfM, distNM, vfCtrl );
+      vfCtrl->epsAF = minArea * vfCtrl->epsAdap;
+      AF0 = ViewUnobstructed( vfCtrl, _row, _col );
+      rayAF = ViewRays( work->rays, vfCtrl, srf, &srfN, &srfM,
+        probableObstr, nProb, AF0, 65599u * n + m );
+      if( rayAF < 0.0 )    /* not converged: redo by projection */
         {
-        int j, k=0;
-        for( j=1; j<=nProb; j++ )
-          if( probableObstr[j] != _row && probableObstr[j] != _col )
-            probableObstr[++k] = probableObstr[j];
-        nProb = k;
+        work->nAFrp += 1;
+#ifdef LOGGING
+        fprintf( _ulog, " row %d, col %d,  rays did not converge, AF0 %g\n",
+          _row, _col, AF0 );
+#endif
         }
-//DumpOS( " Msk LOS:", nProb, probableObstr );
+      }
 
-        if( vfCtrl->nProbObstr )    /*** obstructed view factors ***/
-          {
-          SRFDAT3X subs[5];    /* subsurfaces of surface 1  */
-          int j, nSubSrf;       /* count / number of subsurfaces */
-          double calcAF = 0.0;
-                               /* set direction of projection */
-          if( ProjectionDirection( srf, &srfN, &srfM,
-              probableObstr, vfCtrl ) > 0 )
-            { srf1 = &srfN; srf2 = &srfM; }
-          else
-            { srf1 = &srfM; srf2 = &srfN; }
+    if( blocked )               /*** view blocked by one surface ***/
+      {
+      AF[n][m] = 0.0;
+      work->nAFsb += 1;
+      vfCtrl->method = 6;
+      }
+
+    else if( rayAF >= 0.0 )     /*** by ray casting ***/
+      {
+      AF[n][m] = rayAF;
+      work->nObstr += vfCtrl->nProbObstr;
+      work->nAFwO += 1;
+      vfCtrl->method = 5;
+      }
+
+    else if( vfCtrl->nProbObstr )    /*** obstructed view factors ***/
+      {
+      SRFDAT3X subs[5];    /* subsurfaces of surface 1  */
+      int j, nSubSrf;       /* count / number of subsurfaces */
+      double calcAF = 0.0;
+                           /* set direction of projection */
+      if( ProjectionDirection( srf, &srfN, &srfM,
+          probableObstr, vfCtrl ) > 0 )
+        { srf1 = &srfN; srf2 = &srfM; }
+      else
+        { srf1 = &srfM; srf2 = &srfN; }
 
 #ifdef LOGGING
-          if( vfCtrl->col )
-            {
-            fprintf( _ulog, " Project rays from srf %d to srf %d\n",
-              srf1->nr, srf2->nr );
-//          DumpSrfNM( "from srf", srf1 );
-//          DumpSrfNM( "  to srf", srf2 );
-            fprintf( _ulog, " %d probable obtructions:\n", vfCtrl->nProbObstr );
-            for( j=1; j<=vfCtrl->nProbObstr; j++ )
-              DumpSrf3D( "   surface", srf+probableObstr[j] );
-            }
-          else if( _list>0 && vfCtrl->row )
-            fprintf( _ulog, " %d probable obtructions\n", vfCtrl->nProbObstr );
+      if( vfCtrl->col )
+        {
+        fprintf( _ulog, " Project rays from srf %d to srf %d\n",
+          srf1->nr, srf2->nr );
+//      DumpSrfNM( "from srf", srf1 );
+//      DumpSrfNM( "  to srf", srf2 );
+        fprintf( _ulog, " %d probable obtructions:\n", vfCtrl->nProbObstr );
+        for( j=1; j<=vfCtrl->nProbObstr; j++ )
+          DumpSrf3D( "   surface", srf+probableObstr[j] );
+        }
+      else if( _list>0 && vfCtrl->row )
+        fprintf( _ulog, " %d probable obtructions\n", vfCtrl->nProbObstr );
 #endif
 
-          if( vfCtrl->nProbObstr > maxSrfT ) /* expand srfOT array */
-            {
-            Fre_V( vfCtrl->srfOT, 0, maxSrfT, sizeof(SRFDAT3X), __FILE__, __LINE__ );
-            maxSrfT = vfCtrl->nProbObstr + 4;
-            vfCtrl->srfOT = Alc_V( 0, maxSrfT, sizeof(SRFDAT3X), __FILE__, __LINE__ );
-            }
-          CoordTrans3D( srf, srf1, srf2, probableObstr, vfCtrl );
-
-          nSubSrf = Subsurface( &vfCtrl->srf1T, subs );
-          for( vfCtrl->failRecursion=j=0; j<nSubSrf; j++ )
-            {
-//          minArea = MIN( subs[j].area, vfCtrl->srf2T.area );
-            vfCtrl->epsAF = minArea * vfCtrl->epsAdap;
-            if( subs[j].nv == 3 )
-              calcAF += ViewTP( subs[j].v, subs[j].area, 0, vfCtrl );
-            else
-              calcAF += ViewRP( subs[j].v, subs[j].area, 0, vfCtrl );
-            }
-          AF[n][m] = calcAF * srf2->rc * srf2->rc;   /* area scaling factor */
-          if( vfCtrl->failRecursion )
-            {
-            fprintf( _ulog, " row %d, col %d,  recursion did not converge, AF %g\n",
-              _row, _col, AF[n][m] );
-            vfCtrl->failConverge = 1;
-            }
-          nObstr += vfCtrl->nProbObstr;
-          nAFwO += 1;
-          vfCtrl->method = 5;
-          }
+      if( vfCtrl->nProbObstr > work->maxSrfT ) /* expand srfOT array */
+        {
+        Fre_V( vfCtrl->srfOT, 0, work->maxSrfT, sizeof(SRFDAT3X), __FILE__, __LINE__ );
+        work->maxSrfT = vfCtrl->nProbObstr + 4;
+        vfCtrl->srfOT = Alc_V( 0, work->maxSrfT, sizeof(SRFDAT3X), __FILE__, __LINE__ );
+        }
+      CoordTrans3D( srf, srf1, srf2, probableObstr, vfCtrl );
 
-        else                      /*** unobstructed view factors ***/
-          {
-          SRFDATNM *srf1;  /* pointer to surface 1 (smaller surface) */
-          SRFDATNM *srf2;  /* pointer to surface 2 */
-          vfCtrl->method = 5;
-          vfCtrl->failViewALI = 0;
-          if( srfN.rc >= srfM.rc )
-            { srf1 = &srfM; srf2 = &srfN; }
-          else
-            { srf1 = &srfN; srf2 = &srfM; }
-          ViewMethod( &srfN, &srfM, distNM, vfCtrl );
-//        minArea = MIN( srfN.area, srfM.area );
-          vfCtrl->epsAF = minArea * vfCtrl->epsAdap;
-          AF[n][m] = ViewUnobstructed( vfCtrl, _row, _col );
-          if( vfCtrl->failViewALI )
-            {
-            fprintf( _ulog, " row %d, col %d,  line integral did not converge, AF %g\n",
-              _row, _col, AF[n][m] );
-            vfCtrl->failConverge = 1;
-            }
-          if( vfCtrl->method<5 ) // ???
-            bins[vfCtrl->method][vfCtrl->nEdgeDiv] += 1;   /* count edge divisions */
-          nAFnO += 1;
-          }
+      nSubSrf = Subsurface( &vfCtrl->srf1T, subs );
+      vfCtrl->failRecursion = 0;
+      if( vfCtrl->adapt )     /* one error budget for all subsurfaces */
+        {
+        vfCtrl->epsAF = minArea * vfCtrl->epsAdap;
+        calcAF = ViewAdaptive( subs, nSubSrf, vfCtrl );
         }
       else
-        {                         /* view not possible */
-        AF[n][m] = 0.0;
-        nAF0 += 1;
-        vfCtrl->method = 6;
+      for( j=0; j<nSubSrf; j++ )
+        {
+//      minArea = MIN( subs[j].area, vfCtrl->srf2T.area );
+        vfCtrl->epsAF = minArea * vfCtrl->epsAdap;
+        if( subs[j].nv == 3 )
+          calcAF += ViewTP( subs[j].v, subs[j].area, 0, vfCtrl );
+        else
+          calcAF += ViewRP( subs[j].v, subs[j].area, 0, vfCtrl );
         }
+      AF[n][m] = calcAF * srf2->rc * srf2->rc;   /* area scaling factor */
+      if( vfCtrl->failRecursion )
+        {
+        fprintf( _ulog, " row %d, col %d,  recursion did not converge, AF %g\n",
+          _row, _col, AF[n][m] );
+        vfCtrl->failConverge = 1;
+        }
+      work->nObstr += vfCtrl->nProbObstr;
+      work->nAFwO += 1;
+      vfCtrl->method = 5;
+      }
 
-      if( srf[n].area > srf[m].area )  /* remove very small values */
+    else                      /*** unobstructed view factors ***/
+      {
+      vfCtrl->method = 5;
+      vfCtrl->failViewALI = 0;
+      ViewMethod( &srfN, &srfM, distNM, vfCtrl );
+//    minArea = MIN( srfN.area, srfM.area );
+      vfCtrl->epsAF = minArea * vfCtrl->epsAdap;
+      rectAF = -1.0;
+      if( vfCtrl->rect )      /* aligned rectangles: closed form */
+        rectAF = ViewRect( &vfCtrl->srf1T, &vfCtrl->srf2T, vfCtrl->epsAF );
+      if( rectAF >= 0.0 )
         {
-        if( AF[n][m] < 1.0e-12 * srf[n].area )
-          AF[n][m] = 0.0;
+        AF[n][m] = rectAF;
+        work->bins[vfCtrl->method][6] += 1;
+        }
+      else if( work->batching && mayView == 1 && vfCtrl->method == DAI
+        && vfCtrl->unob != EXACT )   /* AF[n][m] set by View3DBatch() */
+        {
+        UnobPair *p = work->batch + work->nBatch++;
+        memcpy( &p->srf1, &vfCtrl->srf1T, sizeof(SRFDAT3X) );
+        memcpy( &p->srf2, &vfCtrl->srf2T, sizeof(SRFDAT3X) );
+        p->epsAF = vfCtrl->epsAF;
+        p->rcRatio = vfCtrl->rcRatio;
+        p->relSep = vfCtrl->relSep;
+        p->row = n;
+        p->col = m;
+        work->nAFnO += 1;
+        if( work->nBatch == UNOBBATCH )
+          View3DBatch( work );
+        return;
         }
       else
-        if( AF[n][m] < 1.0e-12 * srf[m].area )
-          AF[n][m] = 0.0;
-#ifdef XXX
-#endif
-
-#ifdef LOGGING
-      if( _list>0 && vfCtrl->row )
         {
-        fprintf( _ulog, " AF(%d,%d): %.7e %.7e %.7e %s\n", _row, _col,
-          AF[n][m], AF[n][m] / srf[n].area, AF[n][m] / srf[m].area,
-          methods[vfCtrl->method] );
-        fflush( _ulog );
+        AF[n][m] = ViewUnobstructed( vfCtrl, _row, _col );
+        if( vfCtrl->failViewALI )
+          {
+          fprintf( _ulog, " row %d, col %d,  line integral did not converge, AF %g\n",
+            _row, _col, AF[n][m] );
+          vfCtrl->failConverge = 1;
+          }
+        if( vfCtrl->method<5 ) // ???
+          work->bins[vfCtrl->method][vfCtrl->nEdgeDiv] += 1;   /* count edge divisions */
         }
-#endif
+      work->nAFnO += 1;
+      }
+    }
+  else
+    {                         /* view not possible */
+    AF[n][m] = 0.0;
+    work->nAF0 += 1;
+    vfCtrl->method = 6;
+    }
 
-      }  /* end of element M of row N */
+  PairFinish( work, n, m );
 
-    }  /* end of row N */
-#ifdef LOGGING
-  fputc( '\n', stderr );
-#endif
+  }  /* end View3DPair */
+
+/***  PairFinish.c  **********************************************************/
+
+/*  Complete AF[n][m] of View3DPair().  */
+
+static void PairFinish( View3DWork *work, int n, int m )
+  {
+  SRFDAT3D *srf = work->srf;
+  double **AF = work->AF;
+
+  if( srf[n].area > srf[m].area )  /* remove very small values */
+    {
+    if( AF[n][m] < 1.0e-12 * srf[n].area )
+      AF[n][m] = 0.0;
+    }
+  else
+    if( AF[n][m] < 1.0e-12 * srf[m].area )
+      AF[n][m] = 0.0;
 
 #ifdef LOGGING
-  fprintf( _ulog, "\nSurface pairs where F(i,j) must be zero: %8lu\n", nAF0 );
-  fprintf( _ulog, "\nSurface pairs without obstructed views:  %8lu\n", nAFnO );
-#endif
-  bins[4][5] = bins[0][5] + bins[1][5] + bins[2][5] + bins[3][5];
-#ifdef LOGGING
-  fprintf( _ulog, "   nd %7s %7s %7s %7s %7s\n",
-    methods[0], methods[1], methods[2], methods[3], methods[4] );
-  fprintf( _ulog, "    2 %7u %7u %7u %7u %7u direct\n",
-     bins[0][2], bins[1][2], bins[2][2], bins[3][2], bins[4][2] );
-  fprintf( _ulog, "    3 %7u %7u %7u %7u\n",
-     bins[0][3], bins[1][3], bins[2][3], bins[3][3] );
-  fprintf( _ulog, "    4 %7u %7u %7u %7u\n",
-     bins[0][4], bins[1][4], bins[2][4], bins[3][4] );
-  fprintf( _ulog, "  fix %7u %7u %7u %7u %7u fixes\n",
-     bins[0][5], bins[1][5], bins[2][5], bins[3][5], bins[4][5] );
-#endif
-  ViewsInit( 4, 0 );
-#ifdef LOGGING
-  fprintf( _ulog, "Adaptive line integral evaluations used: %8lu\n",
-    vfCtrl->usedV1LIadapt );
-  fprintf( _ulog, "\nSurface pairs with obstructed views:   %10lu\n", nAFwO );
-  if( nAFwO > 0 )
+  if( _list>0 && work->vfCtrl->row )
     {
-    fprintf( _ulog, "Average number of obstructions per pair:   %6.2f\n",
-      (double)nObstr / (double)nAFwO );
-    fprintf( _ulog, "Adaptive viewpoint evaluations used:   %10lu\n",
-      vfCtrl->usedVObs );
-    fprintf( _ulog, "Adaptive viewpoint evaluations lost:   %10lu\n",
-      vfCtrl->wastedVObs );
-    fprintf( _ulog, "Non-zero viewpoint evaluations:        %10lu\n",
-      vfCtrl->totVpt );
-/***fprintf( _ulog, "Number of 1AI point-polygon evaluations: %8u\n",
-      vfCtrl->totPoly );***/
-    fprintf( _ulog, "Average number of polygons per viewpoint:  %6.2f\n\n",
-      (double)vfCtrl->totPoly / (double)vfCtrl->totVpt );
+    fprintf( _ulog, " AF(%d,%d): %.7e %.7e %.7e %s\n", _row, _col,
+      AF[n][m], AF[n][m] / srf[n].area, AF[n][m] / srf[m].area,
+      methods[work->vfCtrl->method] );
+    fflush( _ulog );
     }
 #endif
 
-  if( vfCtrl->failConverge ) error( 1, __FILE__, __LINE__,
-    "Some calculations did not converge, see VIEW3D.LOG", "" );
+  }  /* end PairFinish */
 
-#if( DEBUG > 1 )
-  MemRem( "After View3D() calculations" );
-#endif
-  if( vfCtrl->nMaskSrf )
-    Fre_V( maskSrf, 1, vfCtrl->nMaskSrf, sizeof(int), __FILE__, __LINE__ );
-  Fre_MC( bins, 0, 4, 1, 5, sizeof(int), __FILE__, __LINE__ );
-  Fre_V( vfCtrl->srfOT, 0, maxSrfT, sizeof(SRFDAT3X), __FILE__, __LINE__ );
-  Fre_V( probableObstr, 1, vfCtrl->nAllSrf, sizeof(int), __FILE__, __LINE__ );
-  Fre_V( possibleObstrN, 1, vfCtrl->nAllSrf, sizeof(int), __FILE__, __LINE__ );
+/***  View3DPairs.c  *********************************************************/
+
+/*  Compute the view factors of row N, columns M1 to M2-1.  The
+ *  unobstructed 2AI pairs are collected and computed together by
+ *  ViewUnobBatch().  */
+
+void View3DPairs( View3DWork *work, int n, int m1, int m2 )
+  {
+  int m;
+
+  work->batching = work->batch != NULL;
+  for( m=m1; m<m2; m++ )
+    View3DPair( work, n, m );
+  if( work->nBatch )
+    View3DBatch( work );
+  work->batching = 0;
+
+  }  /* end View3DPairs */
+
+/***  View3DBatch.c  *********************************************************/
+
+/*  Compute the pairs collected by View3DPair() and complete them.  */
+
+static void View3DBatch( View3DWork *work )
+  {
+  View3DControlData *vfCtrl = work->vfCtrl;
+  UnobPair *p;
+
+  ViewUnobBatch( vfCtrl, work->batch, work->nBatch );
+  vfCtrl->method = DAI;
+  for( p=work->batch; p<work->batch+work->nBatch; p++ )
+    {
+    _col = p->col;
+    work->AF[p->row][p->col] = p->AF;
+    if( p->failViewALI )
+      {
+      fprintf( _ulog, " row %d, col %d,  line integral did not converge, AF %g\n",
+        p->row, p->col, p->AF );
+      vfCtrl->failConverge = 1;
+      }
+    work->bins[DAI][p->nEdgeDiv] += 1;   /* count edge divisions */
+    if( p->fp32 == 1 )
+      work->nAF32 += 1;
+    else if( p->fp32 == 2 )
+      work->nAF32d += 1;
+    PairFinish( work, p->row, p->col );
+    }
+  work->nBatch = 0;
+
+  }  /* end View3DBatch */
 
-  }  /* end of View3D */
 
 /***  ProjectionDirection.c  *************************************************/
 
@@ -657,6 +1157,7 @@ int errorf( int severity, char *file, int line, ... ){
  * ...;       string variables (up to 80 char total) */
 
   va_list argp;     /* variable argument list */
+  char string[LINELEN+1];  /* message buffer; local for worker threads */
   char start[]=" ";
   char *msg, *s;
   static char *head[4] = { "  *** note *** ",
@@ -670,18 +1171,18 @@ int errorf( int severity, char *file, int line, ... ){
     {
     if( severity>3 ) severity = 3;
 //    PathSplit( file, _string, _string, name, _string );
-    sprintf( _string, "%s  (file %s, line %d)\n", head[severity], sfname( file ), line );
+    sprintf( string, "%s  (file %s, line %d)\n", head[severity], sfname( file ), line );
     fputs( "\n", stderr );
-    fputs( _string, stderr );
+    fputs( string, stderr );
     if( _ulog != NULL && _ulog != stderr )
       {
-      fputs( _string, _ulog );
+      fputs( string, _ulog );
       fflush( _ulog );
       }
 
     msg = start;   /* merge message strings */
-    sprintf( _string, "row %d, col %d; ", _row, _col );
-    s = _string;
+    sprintf( string, "row %d, col %d; ", _row, _col );
+    s = string;
     while( *s )
       s++;
     va_start( argp, line );
@@ -695,12 +1196,17 @@ int errorf( int severity, char *file, int line, ... ){
     *s = '\0';
     va_end( argp );
 
-    fputs( _string, stderr );
+    fputs( string, stderr );
     if( _ulog != NULL && _ulog != stderr )
-      fputs( _string, _ulog );
+      fputs( string, _ulog );
     }
 
-  if( severity>2 ) exit( 1 );
+  if( severity>2 )
+    {
+    if( _fatalJmp )
+      longjmp( *_fatalJmp, 1 );
+    exit( 1 );
+    }
 
   return 0;
 
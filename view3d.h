@@ -13,6 +13,7 @@
 #define MAXNV 4     /* max number of vertices for an initial surface */
 #define MAXNV1 5    /* max number of vertices after 1 clip */
 #define MAXNV2 12   /* max number of vertices clipped projection */
+#define MAXSS 16    /* max Gaussian points per surface; SubSrf() */
 //#define NAMELEN 12  /* length of a name */
 #ifdef XXX
 #define PI       3.141592653589793238
@@ -124,7 +125,8 @@ typedef struct srfdat2d       /* structure for 2D surface data */
 typedef struct Line_struct{           /* structure for 1-D lines */
   struct Line_struct *next; /* pointer to next line */
   double xl;   /* minimum X-coordinate */
-  double xr;   /* maximum X-coordinate */} LINE;
+  double xr;   /* maximum X-coordinate */
+} LINE;
 
 
 typedef struct srf2d          /* structure for limited surface data */
@@ -165,6 +167,28 @@ typedef struct srfdat3x{       /* structure for 3D surface data */
   Vec3 v[MAXNV1]; /* coordinates of vertices */
 } SRFDAT3X;
 
+#if defined(__AVX512F__)  /* obstructions per block of SRFSET3X arrays: */
+# define SETLANES 8       /* the number of doubles in a vector register */
+#elif defined(__AVX__)
+# define SETLANES 4
+#else
+# define SETLANES 2
+#endif
+
+typedef struct{        /* transformed obstructions as structure of arrays */
+  int n;               /* number of obstructions */
+  int max;             /* dimension of the arrays; multiple of SETLANES */
+  int maxNv;           /* max number of vertices of the obstructions */
+  int *nv;             /* number of vertices */
+  double *dx, *dy, *dz, *dw;  /* direction cosines & w of the plane */
+  double *zmax;        /* maximum Z-coordinate of the vertices */
+  double *vx[MAXNV1], *vy[MAXNV1], *vz[MAXNV1];  /* vertices */
+  double *dot;         /* VDOTW of the current view point */
+  int *clip;           /* 1 = vertex above the view point clip height */
+  int *limit;          /* projection vs limits: 1 = inside, -1 = outside */
+  double *px[MAXNV1], *py[MAXNV1];  /* vertices projected to z=0 */
+} SRFSET3X;
+
 typedef struct{    /* structure for direction cosines of polygon edge */
   double  x;  /* X-direction cosine */
   double  y;  /* Y-direction cosine */
@@ -195,6 +219,23 @@ typedef struct{          /* view factor calculation control values */
   int nPossObstr;    /* number of possible view obstructing surfaces */
   int nProbObstr;    /* number of probable view obstructing surfaces */
   int prjReverse;    /* projection control; 0 = normal, 1 = reverse */
+  int nThreads;      /* number of worker threads; 0 or 1 = single thread */
+  int row1;          /* first row of a block of rows; 0 = all rows */
+  int row2;          /* last row of the block */
+  int shard;         /* shard=k/n: compute block k of n; 0 = no shards */
+  int nShards;       /* number of shards, n */
+  char journal[256]; /* checkpoint journal file; "" = none */
+  int jnlTime;       /* seconds between journal writes */
+  int shaft;         /* 1 = shaft culling of obstructions */
+  int nest;          /* 1 = embedded rules for obstructed views */
+  int unite;         /* 1 = union of shadows for each view point */
+  int engine;        /* view factor engine: SHADOWS, RAYS or HEMI */
+  int farField;      /* 1 = centroid estimates for well separated pairs */
+  int adapt;         /* 1 = global adaptive integration of obstructed views */
+  int budget;        /* max subsurface integrations per pair for adapt */
+  int rect;          /* 1 = closed form AF for aligned rectangles */
+  int unob;          /* unobstructed view factors: NUMERIC or EXACT */
+  int fp32;          /* 1 = single precision 2AI estimates, verified */
   double epsAdap;       /* convergence for adaptive integration */
   double rcRatio;       /* rRatio of surface radii */
   double relSep;        /* surface separation / sum of radii */
@@ -211,6 +252,7 @@ typedef struct{          /* view factor calculation control values */
   unsigned long usedVObs;      /* number of ViewObstructed() calculations used */
   unsigned long totPoly;       /* total number of polygon view factors */
   unsigned long totVpt;        /* total number of view points */
+  unsigned long totRays;       /* total number of rays traced */
   int failConverge;  /* 1 if any calculation failed to converge */
   SRFDAT3X srf1T;   /* participating surface; transformed coordinates */
   SRFDAT3X srf2T;   /* participating surface; transformed coordinates;
@@ -218,6 +260,9 @@ typedef struct{          /* view factor calculation control values */
   SRFDAT3X *srfOT;  /* pointer to array of view obstrucing surfaces;
                        dimensioned from 0 to maxSrfT in View3d();
                        coordinates transformed relative to srf2T. */
+  SRFSET3X *setOT;  /* srfOT as structure of arrays */
+  struct adaptelem *adaptElem;  /* elements for adapt=1;
+                       dimensioned from 0 to budget+ADAPTINIT. */
 } View3DControlData;
 
 typedef struct{         /* view factor calculation control values */
@@ -255,17 +300,17 @@ typedef struct{         /* view factor calculation control values */
 #define SLI 3   /* single line integration */
 #define ALI 4   /* adaptive line integration */
 
-typedef struct PolygonVertexEdge_struct{   /* homogeneous coordinate description of vertex/edge */
-  struct PolygonVertexEdge_struct *next;  /* pointer to next vertex/edge */
-  int buffer;          /* for structure alignment */
-  double x, y;    /* X and Y coordinates of the vertex */
-  double a, b;    /* A, B */
-  double c;       /*  & C homogeneous coordinates of the edge */
-} PolygonVertexEdge;
+#define SHADOWS 0  /* obstructed views by shadow polygons */
+#define RAYS    1  /* obstructed views by ray casting */
+#define HEMI    2  /* all views by hemicubes */
+
+#define NUMERIC 0  /* unobstructed views by numerical integration */
+#define EXACT   1  /* unobstructed views in closed form */
 
 typedef struct Polygon_struct{   /* description of a polygon */
   struct Polygon_struct *next;  /* pointer to next polygon */
-  PolygonVertexEdge *firstVE;      /* pointer to first vertex of polygon */
+  int firstVE;            /* index of first vertex/edge in the polygon arrays */
+  int nVE;                /* number of vertices/edges */
   double trns;            /* (0.0 <= transparency <= 1.0) */
   double area;            /* area of the polygon */
 } Polygon;
@@ -280,6 +325,9 @@ typedef struct Polygon_struct{   /* description of a polygon */
 V3D_API void View3D( SRFDAT3D *srf, const int *base, int *possibleObstr
 	, double **AF, View3DControlData *vfCtrl
 );
+V3D_API void View3DShard( SRFDAT3D *srf, const int *base, int *possibleObstr
+	, View3DControlData *vfCtrl
+);
 
 int ProjectionDirection( SRFDAT3D *srf, SRFDATNM *srfn, SRFDATNM *srfm,
   int *los, View3DControlData *vfCtrl );
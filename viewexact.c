@@ -0,0 +1,413 @@
+/*subfile:  ViewExact.c  *****************************************************/
+
+/*  Closed form unobstructed view factors (unob=exact).
+ *
+ *  As in ViewALI(), AF = 1/(4 pi) * sum over edges i of polygon 1 and
+ *  j of polygon 2 of  cos(i,j) * G(i,j),  where G is the integral of
+ *  ln(r^2) along both edges.  For edges which are not parallel, with
+ *  unit directions u and v, c = u . v, s = |u x v| and d the distance
+ *  between the lines of the edges,  x = (p - p0) - c (q - q0) and
+ *  y = s (q - q0), relative to the closest points p0 and q0 of the
+ *  lines, take the rectangle of edge positions (p, q) to a
+ *  parallelogram and
+ *
+ *     G = 1/s * integral over the parallelogram of ln(x^2 + y^2 + d^2).
+ *
+ *  By the divergence theorem the area integral is a sum over the four
+ *  sides of the parallelogram of logarithms, arctangents and Clausen
+ *  functions -- the dilogarithms of Schroder & Hanrahan (1993).  A side
+ *  at distance h from the origin with ends at l0 and l1 along it
+ *  contributes, from l0 to l1,
+ *
+ *     h/2 * (L(l) - l)  +  d^2/2 * sign(h) * K(atan(l/|h|)),
+ *
+ *     L(l) = l ln(l^2 + a^2) - 2 l + 2 a atan(l/a),  a^2 = h^2 + d^2,
+ *     K(f) = integral of ln(1 + h^2 / (d^2 cos(f)^2)) df
+ *          = f ln((a+|h|)^2 / d^2) - Im Li2(k e^(i(pi+2f))) - Cl2(pi-2f),
+ *     k = (a - |h|) / (a + |h|).
+ *
+ *  Parallel edges have an elementary form, the double antiderivative of
+ *  ln(x^2 + d^2).  For nearly parallel edges 1/s magnifies rounding
+ *  errors, so G is interpolated, quadratic in the angle, between the
+ *  parallel form and the general form for edge j rotated about its
+ *  midpoint to angles of +/- EXACTROT.
+ *
+ *  The sides of all edge pairs are collected as structure of arrays and
+ *  evaluated in one batch.  There is no convergence loop:  the cost of
+ *  a pair depends only on the numbers of edges.  Coordinates are scaled
+ *  by the distance between the polygons so that the terms are of order
+ *  1;  even so the rounding error grows as the polygons become small
+ *  relative to their separation, and ViewExact() declines (returns 0)
+ *  when its estimate of that error exceeds epsAF.  */
+
+#ifdef _DEBUG
+# define DEBUG 1
+#else
+# define DEBUG 0
+#endif
+
+#define V3D_BUILD
+#include "viewexact.h"
+
+#include <stdio.h>
+#include <math.h>   /* prototypes: atan, atan2, cos, fabs, floor, log, sin, sqrt */
+#include "types.h"
+#include "misc.h"
+
+#define MAXSIDE  (8*MAXNV1*MAXNV1)  /* parallelogram sides per pair */
+#define EXACTROT 1.0e-3   /* rotation for nearly parallel edges, radians */
+#define EXACTEPS 1.0e-14  /* relative rounding error of the terms */
+#define PI       3.141592653589793238   /* pi */
+#define PIt2     6.283185307179586477   /* 2 * pi */
+#define PIt4inv  0.079577471545947673   /* 1 / (4 * pi) */
+#define LN2      0.693147180559945309   /* ln(2) */
+
+typedef struct{        /* parallelogram sides as structure of arrays */
+  double x0[MAXSIDE], y0[MAXSIDE];  /* start of side */
+  double x1[MAXSIDE], y1[MAXSIDE];  /* end of side */
+  double d2[MAXSIDE];    /* square of distance between the edge lines */
+  double wt[MAXSIDE];    /* weight of the side */
+  int n;                 /* number of sides */
+} ExactSides;
+
+static void ExactPair( ExactSides *sd, const Vec3 *a0, const Vec3 *u,
+  double a, const Vec3 *b0, const Vec3 *v, double b, double wt );
+static double ExactParallel( const Vec3 *a0, const Vec3 *u, double a,
+  const Vec3 *b0, double b, double sgn, double *mag );
+static double ExactPhi( double x, double d2 );
+static double ExactSide( double x0, double y0, double x1, double y1,
+  double d2 );
+static double ExactK( double l, double ah, double cst, double k );
+static double Clausen( double t );
+
+/***  ViewExact.c  ***********************************************************/
+
+/*  Compute AF of polygons V1 and V2 in closed form.  Return 1 if the
+ *  rounding error is within EPSAF, else 0.  */
+
+int ViewExact( const int nv1, const Vec3 *v1, const int nv2, const Vec3 *v2,
+  double epsAF, double *AF )
+  {
+  ExactSides sd;
+  Vec3 p1[MAXNV1], p2[MAXNV1];  /* scaled vertices */
+  Vec3 A[MAXNV1], B[MAXNV1];    /* unit edge directions */
+  double a[MAXNV1], b[MAXNV1];  /* edge lengths */
+  Vec3 c1, c2, V;
+  double scale, sum=0.0, mag=0.0;
+  int i, im1, j, jm1, k;
+
+#if( DEBUG > 0 )
+  if( nv1 > MAXNV1 || nv2 > MAXNV1 )
+    errorf( 3, __FILE__, __LINE__, "MAXNV1 too small", "" );
+#endif
+  c1.x = c1.y = c1.z = c2.x = c2.y = c2.z = 0.0;
+  for( i=0; i<nv1; i++ )
+    {
+    c1.x += v1[i].x;  c1.y += v1[i].y;  c1.z += v1[i].z;
+    }
+  for( j=0; j<nv2; j++ )
+    {
+    c2.x += v2[j].x;  c2.y += v2[j].y;  c2.z += v2[j].z;
+    }
+  VSCALE( (1.0/nv1), (&c1), (&c1) );
+  VSCALE( (1.0/nv2), (&c2), (&c2) );
+  VECTOR( (&c1), (&c2), (&V) );
+  scale = VLEN( (&V) );
+  if( scale <= 0.0 ) scale = 1.0;
+
+  for( i=0; i<nv1; i++ )
+    {
+    VECTOR( (&c1), (v1+i), (&V) );
+    VSCALE( (1.0/scale), (&V), (p1+i) );
+    }
+  for( j=0; j<nv2; j++ )
+    {
+    VECTOR( (&c1), (v2+j), (&V) );
+    VSCALE( (1.0/scale), (&V), (p2+j) );
+    }
+  im1 = nv1 - 1;
+  for( i=0; i<nv1; im1=i++ )
+    {
+    VECTOR( (p1+im1), (p1+i), (A+i) );
+    a[i] = VLEN( (A+i) );
+    VSCALE( (1.0/a[i]), (A+i), (A+i) );
+    }
+  jm1 = nv2 - 1;
+  for( j=0; j<nv2; jm1=j++ )
+    {
+    VECTOR( (p2+jm1), (p2+j), (B+j) );
+    b[j] = VLEN( (B+j) );
+    VSCALE( (1.0/b[j]), (B+j), (B+j) );
+    }
+
+  sd.n = 0;
+  jm1 = nv2 - 1;
+  for( j=0; j<nv2; jm1=j++ )
+    {
+    im1 = nv1 - 1;
+    for( i=0; i<nv1; im1=i++ )
+      {
+      double c = VDOT( (A+i), (B+j) );
+      double s, sgn, t, r;
+      Vec3 u0, q, m, vr, br;
+
+      if( fabs(c) <= EPS ) continue;
+      VCROSS( (A+i), (B+j), (&V) );
+      s = VLEN( (&V) );
+      if( s >= EXACTROT )
+        {
+        ExactPair( &sd, p1+im1, A+i, a[i], p2+jm1, B+j, b[j], c );
+        continue;
+        }
+                 /* nearly parallel edges */
+      sgn = c > 0.0 ? 1.0 : -1.0;
+      t = atan2( s, fabs(c) ) / EXACTROT;
+      VSCALE( sgn, (A+i), (&u0) );
+      m.x = p2[jm1].x + 0.5 * b[j] * B[j].x;   /* midpoint of edge j */
+      m.y = p2[jm1].y + 0.5 * b[j] * B[j].y;
+      m.z = p2[jm1].z + 0.5 * b[j] * B[j].z;
+      br.x = m.x - 0.5 * b[j] * u0.x;          /* edge j made parallel */
+      br.y = m.y - 0.5 * b[j] * u0.y;
+      br.z = m.z - 0.5 * b[j] * u0.z;
+      sum += c * (1.0 - t*t)
+        * ExactParallel( p1+im1, A+i, a[i], &br, b[j], sgn, &mag );
+      if( s == 0.0 ) continue;
+      r = VDOT( (B+j), (&u0) );
+      q.x = (B[j].x - r * u0.x) / s;
+      q.y = (B[j].y - r * u0.y) / s;
+      q.z = (B[j].z - r * u0.z) / s;
+      for( k=-1; k<=1; k+=2 )    /* edge j rotated to -/+ EXACTROT */
+        {
+        vr.x = cos( EXACTROT ) * u0.x + k * sin( EXACTROT ) * q.x;
+        vr.y = cos( EXACTROT ) * u0.y + k * sin( EXACTROT ) * q.y;
+        vr.z = cos( EXACTROT ) * u0.z + k * sin( EXACTROT ) * q.z;
+        br.x = m.x - 0.5 * b[j] * vr.x;
+        br.y = m.y - 0.5 * b[j] * vr.y;
+        br.z = m.z - 0.5 * b[j] * vr.z;
+        ExactPair( &sd, p1+im1, A+i, a[i], &br, &vr, b[j],
+          c * 0.5 * (t*t + k*t) );
+        }
+      }
+    }
+
+  for( k=0; k<sd.n; k++ )    /* all sides in one batch */
+    {
+    double e = sd.wt[k]
+      * ExactSide( sd.x0[k], sd.y0[k], sd.x1[k], sd.y1[k], sd.d2[k] );
+    sum += e;
+    mag += fabs( e );
+    }
+
+  scale *= scale;
+  *AF = sum * PIt4inv * scale;
+
+  return EXACTEPS * mag * PIt4inv * scale <= epsAF;
+
+  }  /* end ViewExact */
+
+/***  ExactPair.c  ***********************************************************/
+
+/*  Add the parallelogram sides of the edges from A0 (direction U,
+ *  length A) and from B0 (direction V, length B) to SD with weight
+ *  WT / |U x V|.  */
+
+static void ExactPair( ExactSides *sd, const Vec3 *a0, const Vec3 *u,
+  double a, const Vec3 *b0, const Vec3 *v, double b, double wt )
+  {
+  Vec3 W, R;
+  double c, s, s2, wu, wv, p0, q0, d2;
+  double x[4], y[4];
+  int k, n;
+
+  c = VDOT( u, v );
+  VCROSS( u, v, (&W) );
+  s2 = VDOT( (&W), (&W) );
+  s = sqrt( s2 );
+  VECTOR( b0, a0, (&W) );
+  wu = VDOT( (&W), u );
+  wv = VDOT( (&W), v );
+  p0 = (c * wv - wu) / s2;   /* closest points of the lines */
+  q0 = (wv - c * wu) / s2;
+  R.x = W.x + p0 * u->x - q0 * v->x;
+  R.y = W.y + p0 * u->y - q0 * v->y;
+  R.z = W.z + p0 * u->z - q0 * v->z;
+  d2 = VDOT( (&R), (&R) );
+
+  x[0] = -p0 + c * q0;       y[0] = -s * q0;        /* (0, 0) */
+  x[1] = x[0] + a;           y[1] = y[0];           /* (a, 0) */
+  x[2] = x[1] - c * b;       y[2] = y[0] + s * b;   /* (a, b) */
+  x[3] = x[0] - c * b;       y[3] = y[2];           /* (0, b) */
+
+  n = sd->n;
+  for( k=0; k<4; k++,n++ )
+    {
+    sd->x0[n] = x[k];
+    sd->y0[n] = y[k];
+    sd->x1[n] = x[(k+1)&3];
+    sd->y1[n] = y[(k+1)&3];
+    sd->d2[n] = d2;
+    sd->wt[n] = wt / s;
+    }
+  sd->n = n;
+
+  }  /* end ExactPair */
+
+/***  ExactParallel.c  *******************************************************/
+
+/*  Return the integral of ln(r^2) along the edge from A0 (direction U,
+ *  length A) and the parallel edge from B0 (direction SGN * U, length
+ *  B).  Add the magnitude of its terms to MAG.  */
+
+static double ExactParallel( const Vec3 *a0, const Vec3 *u, double a,
+  const Vec3 *b0, double b, double sgn, double *mag )
+  {
+  Vec3 W;
+  double e, d2, f[4];
+
+  VECTOR( b0, a0, (&W) );
+  e = VDOT( (&W), u );
+  W.x -= e * u->x;
+  W.y -= e * u->y;
+  W.z -= e * u->z;
+  d2 = VDOT( (&W), (&W) );
+
+  f[0] = ExactPhi( a - sgn * b + e, d2 );
+  f[1] = ExactPhi( a + e, d2 );
+  f[2] = ExactPhi( e - sgn * b, d2 );
+  f[3] = ExactPhi( e, d2 );
+  *mag += fabs(f[0]) + fabs(f[1]) + fabs(f[2]) + fabs(f[3]);
+
+  return -sgn * (f[0] - f[1] - f[2] + f[3]);
+
+  }  /* end ExactParallel */
+
+/***  ExactPhi.c  ************************************************************/
+
+/*  Double antiderivative of ln(x^2 + d2).  */
+
+static double ExactPhi( double x, double d2 )
+  {
+  double r2 = x*x + d2;
+  double f = -1.5 * x * x;
+
+  if( r2 > 0.0 )
+    f += 0.5 * (x*x - d2) * log( r2 );
+  if( d2 > 0.0 )
+    {
+    double d = sqrt( d2 );
+    f += 2.0 * d * x * atan( x / d );
+    }
+
+  return f;
+
+  }  /* end ExactPhi */
+
+/***  ExactSide.c  ***********************************************************/
+
+/*  Integral of ln(x^2 + y^2 + D2) over the parallelogram:  contribution
+ *  of the side from (X0, Y0) to (X1, Y1).  */
+
+static double ExactSide( double x0, double y0, double x1, double y1,
+  double d2 )
+  {
+  double ex = x1 - x0, ey = y1 - y0;
+  double len = sqrt( ex*ex + ey*ey );
+  double h, l0, l1, a2, a, e;
+
+  ex /= len;
+  ey /= len;
+  h = x0 * ey - y0 * ex;     /* > 0 if the origin is inside the side */
+  if( h == 0.0 ) return 0.0;
+  l0 = x0 * ex + y0 * ey;
+  l1 = x1 * ex + y1 * ey;
+  a2 = h*h + d2;
+  a = sqrt( a2 );
+
+  e = 0.5 * h * ( l1 * log( l1*l1 + a2 ) - l0 * log( l0*l0 + a2 )
+    - 3.0 * (l1 - l0) + 2.0 * a * (atan( l1 / a ) - atan( l0 / a )) );
+  if( d2 > 0.0 )
+    {
+    double ah = fabs( h );
+    double s = a + ah;
+    double k = d2 / (s * s);  /* (a - |h|) / (a + |h|) */
+    double cst = log( s * s / d2 );
+    double dk = ExactK( l1, ah, cst, k ) - ExactK( l0, ah, cst, k );
+    e += 0.5 * d2 * (h > 0.0 ? dk : -dk);
+    }
+
+  return e;
+
+  }  /* end ExactSide */
+
+/***  ExactK.c  **************************************************************/
+
+/*  K(phi) at phi = atan(L/AH), with CST = ln((a+|h|)^2 / d^2) = -ln(K).
+ *  Im Li2(k e^(i t)) = w ln k + (Cl2(2t) + Cl2(2w) - Cl2(2w+2t)) / 2,
+ *  w = atan2(k sin t, 1 - k cos t)  (Lewin, Polylogarithms and
+ *  Associated Functions, 1981, eq 5.26), with t = pi + 2 phi.  */
+
+static double ExactK( double l, double ah, double cst, double k )
+  {
+  double phi = atan( l / ah );
+  double r2 = l*l + ah*ah;
+  double sn = 2.0 * l * ah / r2,    /* sin(2 phi) */
+         cs = (ah*ah - l*l) / r2;   /* cos(2 phi) */
+  double w = atan2( -k * sn, 1.0 + k * cs );
+
+  return (phi + w) * cst - Clausen( PI - 2.0 * phi )
+    - 0.5 * (Clausen( 4.0 * phi ) + Clausen( 2.0 * w )
+           - Clausen( 2.0 * (w + 2.0 * phi) ));
+
+  }  /* end ExactK */
+
+/***  Clausen.c  *************************************************************/
+
+/*  Clausen function Cl2(t) = -integral from 0 to t of ln|2 sin(x/2)|.
+ *  For |t| <= 2 pi / 3 by the series
+ *     Cl2(t) = t - t ln|t| + sum |B2k| t^(2k+1) / (2k (2k+1)!),
+ *  otherwise with x = pi - |t| by the series
+ *     Cl2(pi - x) = x ln 2 - sum (2^2k - 1) |B2k| x^(2k+1) / (2k (2k+1)!).
+ *  14 terms give full double precision for both.  */
+
+static double Clausen( double t )
+  {
+  static const double cb[14] = {   /* |B2k| / (2k (2k+1)!) */
+    1.38888888888888881e-02, 6.94444444444444444e-05, 7.87351977828168297e-07,
+    1.14822163433274551e-08, 1.89788699889709990e-10, 3.38730137095352120e-12,
+    6.37263644318318076e-14, 1.24620599129506715e-15, 2.51054446089995455e-17,
+    5.17825880609062320e-19, 1.08873573683008492e-20, 2.32574411430208708e-22,
+    5.03519521314738965e-24, 1.10264992943812150e-25 };
+  static const double cp[14] = {   /* (2^2k - 1) |B2k| / (2k (2k+1)!) */
+    4.16666666666666644e-02, 1.04166666666666665e-03, 4.96031746031746031e-05,
+    2.92796516754850097e-06, 1.94153839987173309e-07, 1.38709991140546691e-08,
+    1.04402902848670035e-09, 8.16701096395222367e-11, 6.58121656613696748e-12,
+    5.42979272759647510e-13, 4.56648756719363559e-14, 3.90195090406306918e-15,
+    3.37906225737363958e-16, 2.95990335514440040e-17 };
+  double x, x2, p, sgn=1.0;
+  int k;
+
+  t -= PIt2 * floor( t / PIt2 + 0.5 );   /* -pi <= t <= pi */
+  if( t < 0.0 )
+    {
+    t = -t;
+    sgn = -1.0;
+    }
+  if( t == 0.0 ) return 0.0;
+
+  if( t <= PIt2 / 3.0 )
+    {
+    x2 = t * t;
+    for( p=0.0,k=13; k>=0; k-- )
+      p = p * x2 + cb[k];
+    return sgn * t * (1.0 - log( t ) + x2 * p);
+    }
+  else
+    {
+    x = PI - t;
+    x2 = x * x;
+    for( p=0.0,k=13; k>=0; k-- )
+      p = p * x2 + cp[k];
+    return sgn * x * (LN2 - x2 * p);
+    }
+
+  }  /* end Clausen */
@@ -0,0 +1,11 @@
+#ifndef V3D_VIEWEXACT_H
+#define V3D_VIEWEXACT_H
+
+#include "view3d.h"
+
+/*  Closed form unobstructed view factors; see viewexact.c.  */
+
+int ViewExact( const int nv1, const Vec3 *v1, const int nv2, const Vec3 *v2,
+  double epsAF, double *AF );
+
+#endif
@@ -0,0 +1,315 @@
+/*subfile:  ViewFar.c  *******************************************************/
+
+/*  Far-field view factors of well separated surfaces (far=1).
+ *
+ *  For surfaces N and M entirely in front of each other, with
+ *  centroids CN and CM, W = CM - CN, and radii RN and RM about the
+ *  centroids, AF(N,M) is estimated from the centroids:
+ *
+ *     AF ~ AN * AM * (W . nN) * (-W . nM) / (pi * |W|^4).
+ *
+ *  The kernel is homogeneous of degree -2 in W.  Its first order
+ *  Taylor terms integrate to zero over both surfaces about their
+ *  centroids, and the norm of its second derivatives is at most
+ *  38 / |W|^4.  With S = RN + RM and D = |W| the error is therefore
+ *  at most  AN * AM * 19 * S^2 / (pi * (D - S)^4).  The estimate is
+ *  used only when that is within epsAdap * min(AN, AM), the tolerance
+ *  of the exact calculations, and no possible obstruction of row N is
+ *  in the capsule around the (ctd, rc) spheres of N and M.
+ *
+ *  The radiating surfaces are grouped into clusters by a hierarchy
+ *  (the ObstrBVH of bvh.c built over all of them).  For row N a
+ *  cluster which passes the tests as a whole -- its sphere in front
+ *  of N, far enough for its largest surface and radius, and no
+ *  obstruction in the capsule around N and the cluster -- has its
+ *  surfaces accepted with only the test that N is in front of each.
+ *  Other clusters are opened down to single surfaces.  FarFieldRow()
+ *  marks the accepted columns;  View3DPair() then uses FarFieldAF()
+ *  instead of the obstruction tests and the integration.  */
+
+#ifdef _DEBUG
+# define DEBUG 1
+#else
+# define DEBUG 0
+#endif
+
+#define V3D_BUILD
+#include "viewfar.h"
+
+#include <stdio.h>
+#include <math.h>   /* prototype: sqrt */
+#include "types.h"
+#include "misc.h"
+#include "heap.h"
+
+#define MAXDEPTH 64     /* size of the traversal stack */
+#define PIinv    0.318309886183790672   /* 1 / pi */
+#define FARERR   (19.0 * PIinv)  /* error bound coefficient */
+
+static double FarBound( double area, double s, double gap );
+static int FarBlocked( const SRFDAT3D *srf, int n, int m,
+  const ObstrBVH *bvh, const int *markN, const int *possibleObstrN,
+  int nPossN, const Vec3 *p0, const Vec3 *p1, double rad );
+static double SegmentDist2( const Vec3 *p0, const Vec3 *p1, const Vec3 *q );
+
+/***  BuildFarField.c  *******************************************************/
+
+/*  Build the clusters of radiating surfaces 1 to NRADSRF.  */
+
+FarField *BuildFarField( SRFDAT3D *srf, int nRadSrf )
+  {
+  FarField *far;
+  ObstrBVH *tree;
+  int i, k;
+
+  far = V3D_NEW( FarField );
+  far->nRadSrf = nRadSrf;
+  far->srfList = Alc_V( 1, nRadSrf, sizeof(int), __FILE__, __LINE__ );
+  for( i=1; i<=nRadSrf; i++ )
+    far->srfList[i] = i;
+  tree = far->tree = BuildObstrBVH( srf, nRadSrf, far->srfList, nRadSrf );
+  far->maxArea = Alc_V( 0, tree->maxNode, sizeof(double), __FILE__, __LINE__ );
+  far->maxRc = Alc_V( 0, tree->maxNode, sizeof(double), __FILE__, __LINE__ );
+
+  for( k=tree->nNode-1; k>=0; k-- )  /* children follow their parents */
+    {
+    const BVHNode *node = tree->node + k;
+    if( node->count )
+      for( i=node->first; i<node->first+node->count; i++ )
+        {
+        const SRFDAT3D *s = srf + far->srfList[tree->item[i]];
+        far->maxArea[k] = MAX( far->maxArea[k], s->area );
+        far->maxRc[k] = MAX( far->maxRc[k], s->rc );
+        }
+    else
+      {
+      far->maxArea[k] = MAX( far->maxArea[node->first],
+        far->maxArea[node->first+1] );
+      far->maxRc[k] = MAX( far->maxRc[node->first],
+        far->maxRc[node->first+1] );
+      }
+    }
+
+  return far;
+
+  }  /* end BuildFarField */
+
+/***  FarFieldRow.c  *********************************************************/
+
+/*  Set farN[m] = N for the columns M whose AF(N,M) may be estimated by
+ *  FarFieldAF().  The possible obstructions of row N are the NPOSSN
+ *  surfaces in POSSIBLEOBSTRN;  with the obstruction hierarchy BVH
+ *  they are those with MARKN[rank] == N.  Return the number marked.  */
+
+int FarFieldRow( const FarField *far, const SRFDAT3D *srf, int n,
+  double epsAdap, const ObstrBVH *bvh, const int *markN,
+  const int *possibleObstrN, int nPossN, int *farN )
+  {
+  const ObstrBVH *tree = far->tree;
+  const SRFDAT3D *sn = srf + n;
+  const DirCos *dcN = &sn->dc;
+  int stack[MAXDEPTH];
+  int nStack=0, nFar=0;
+  int i, m;
+
+  stack[nStack++] = 0;
+  while( nStack )
+    {
+    int k = stack[--nStack];
+    const BVHNode *node = tree->node + k;
+    double h = VDOTW( (&node->ctr), dcN );  /* height above plane N */
+    Vec3 a;
+    double gap;
+
+    if( h <= -node->rad ) continue;   /* cluster behind surface N */
+    VECTOR( (&sn->ctd), (&node->ctr), (&a) );
+    gap = VLEN( (&a) ) - node->rad - sn->rc;
+    if( h > node->rad && gap > 0.0
+      && FarBound( MAX( sn->area, far->maxArea[k] ),
+        sn->rc + far->maxRc[k], gap ) <= epsAdap
+      && !FarBlocked( srf, n, 0, bvh, markN, possibleObstrN, nPossN,
+        &sn->ctd, &node->ctr, MAX( sn->rc, node->rad ) ) )
+      {                  /* whole cluster is far from N */
+      int top = nStack;
+      stack[nStack++] = k;
+      while( nStack > top )
+        {
+        node = tree->node + stack[--nStack];
+        if( node->count == 0 )
+          {
+          stack[nStack++] = node->first;
+          stack[nStack++] = node->first + 1;
+          continue;
+          }
+        for( i=node->first; i<node->first+node->count; i++ )
+          {
+          m = far->srfList[tree->item[i]];
+          if( m != n && VDOTW( (&sn->ctd), (&srf[m].dc) ) > sn->rc )
+            {
+            farN[m] = n;
+            nFar++;
+            }
+          }
+        }
+      }
+    else if( node->count )  /* test single surfaces */
+      {
+      for( i=node->first; i<node->first+node->count; i++ )
+        {
+        const SRFDAT3D *sm;
+        m = far->srfList[tree->item[i]];
+        sm = srf + m;
+        if( m == n ) continue;
+        if( VDOTW( (&sm->ctd), dcN ) <= sm->rc ) continue;
+        if( VDOTW( (&sn->ctd), (&sm->dc) ) <= sn->rc ) continue;
+        VECTOR( (&sn->ctd), (&sm->ctd), (&a) );
+        gap = VLEN( (&a) ) - sn->rc - sm->rc;
+        if( gap <= 0.0 ) continue;
+        if( FarBound( MAX( sn->area, sm->area ), sn->rc + sm->rc, gap )
+          > epsAdap ) continue;
+        if( FarBlocked( srf, n, m, bvh, markN, possibleObstrN, nPossN,
+          &sn->ctd, &sm->ctd, MAX( sn->rc, sm->rc ) ) ) continue;
+        farN[m] = n;
+        nFar++;
+        }
+      }
+    else
+      {
+      if( nStack + 2 > MAXDEPTH )
+        error( 3, __FILE__, __LINE__, "Far-field stack exceeded", "" );
+      stack[nStack++] = node->first;
+      stack[nStack++] = node->first + 1;
+      }
+    }
+
+  return nFar;
+
+  }  /* end FarFieldRow */
+
+/***  FarBound.c  ************************************************************/
+
+/*  Bound on |AF error| / min(AN, AM) of the centroid estimate for
+ *  larger area AREA, sum of radii S and gap D - S.  */
+
+static double FarBound( double area, double s, double gap )
+  {
+  double g2 = gap * gap;
+
+  return FARERR * area * s * s / (g2 * g2);
+
+  }  /* end FarBound */
+
+/***  FarBlocked.c  **********************************************************/
+
+/*  Return 1 if the (ctd, rc) sphere of a possible obstruction of row N,
+ *  other than N and M, may reach within RAD of the segment P0 to P1.  */
+
+static int FarBlocked( const SRFDAT3D *srf, int n, int m,
+  const ObstrBVH *bvh, const int *markN, const int *possibleObstrN,
+  int nPossN, const Vec3 *p0, const Vec3 *p1, double rad )
+  {
+  int stack[MAXDEPTH];
+  int nStack=0;
+  int i, j;
+
+  if( !bvh )
+    {
+    for( i=1; i<=nPossN; i++ )
+      {
+      const SRFDAT3D *s;
+      j = possibleObstrN[i];
+      if( j == n || j == m ) continue;
+      s = srf + j;
+      if( SegmentDist2( p0, p1, &s->ctd ) < (rad + s->rc) * (rad + s->rc) )
+        return 1;
+      }
+    return 0;
+    }
+
+  stack[nStack++] = 0;
+  while( nStack )
+    {
+    const BVHNode *node = bvh->node + stack[--nStack];
+    double r = rad + node->rad + bvh->slack;
+    if( SegmentDist2( p0, p1, &node->ctr ) >= r * r ) continue;
+    if( node->count )
+      {
+      for( i=node->first; i<node->first+node->count; i++ )
+        {
+        const SRFDAT3D *s;
+        if( markN[bvh->item[i]] != n ) continue;
+        j = bvh->obstr[bvh->item[i]];
+        if( j == n || j == m ) continue;
+        s = srf + j;
+        r = rad + s->rc + bvh->slack;
+        if( SegmentDist2( p0, p1, &s->ctd ) < r * r )
+          return 1;
+        }
+      }
+    else
+      {
+      if( nStack + 2 > MAXDEPTH )
+        error( 3, __FILE__, __LINE__, "Far-field stack exceeded", "" );
+      stack[nStack++] = node->first;
+      stack[nStack++] = node->first + 1;
+      }
+    }
+
+  return 0;
+
+  }  /* end FarBlocked */
+
+/***  SegmentDist2.c  ********************************************************/
+
+/*  Return the square of the distance from point Q to segment P0 P1.  */
+
+static double SegmentDist2( const Vec3 *p0, const Vec3 *p1, const Vec3 *q )
+  {
+  Vec3 d, a;
+  double len2, t;
+
+  VECTOR( p0, p1, (&d) );
+  VECTOR( p0, q, (&a) );
+  len2 = VDOT( (&d), (&d) );
+  t = len2 > 0.0 ? VDOT( (&a), (&d) ) / len2 : 0.0;
+  if( t < 0.0 ) t = 0.0;
+  if( t > 1.0 ) t = 1.0;
+  a.x -= t * d.x;
+  a.y -= t * d.y;
+  a.z -= t * d.z;
+
+  return VDOT( (&a), (&a) );
+
+  }  /* end SegmentDist2 */
+
+/***  FarFieldAF.c  **********************************************************/
+
+/*  Return the centroid estimate of AF(N,M).  */
+
+double FarFieldAF( const SRFDAT3D *srf, int n, int m )
+  {
+  const SRFDAT3D *sn = srf + n, *sm = srf + m;
+  Vec3 w;
+  double d2;
+
+  VECTOR( (&sn->ctd), (&sm->ctd), (&w) );
+  d2 = VDOT( (&w), (&w) );
+
+  return PIinv * sn->area * sm->area * VDOT( (&w), (&sn->dc) )
+    * -VDOT( (&w), (&sm->dc) ) / (d2 * d2);
+
+  }  /* end FarFieldAF */
+
+/***  FreeFarField.c  ********************************************************/
+
+void FreeFarField( FarField *far )
+  {
+  int maxNode = far->tree->maxNode;
+
+  Fre_V( far->maxRc, 0, maxNode, sizeof(double), __FILE__, __LINE__ );
+  Fre_V( far->maxArea, 0, maxNode, sizeof(double), __FILE__, __LINE__ );
+  FreeObstrBVH( far->tree );
+  Fre_V( far->srfList, 1, far->nRadSrf, sizeof(int), __FILE__, __LINE__ );
+  V3D_FREE( FarField, far );
+
+  }  /* end FreeFarField */
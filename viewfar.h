@@ -0,0 +1,24 @@
+#ifndef V3D_VIEWFAR_H
+#define V3D_VIEWFAR_H
+
+#include "view3d.h"
+#include "bvh.h"
+
+/*  Far-field view factors of well separated surfaces; see viewfar.c.  */
+
+typedef struct{         /* clusters of the radiating surfaces */
+  int *srfList;         /* radiating surfaces [1:nRadSrf] */
+  int nRadSrf;          /* number of radiating surfaces */
+  ObstrBVH *tree;       /* hierarchy of the clusters */
+  double *maxArea;      /* largest surface area in each node [0:nNode-1] */
+  double *maxRc;        /* largest surface radius in each node [0:nNode-1] */
+} FarField;
+
+FarField *BuildFarField( SRFDAT3D *srf, int nRadSrf );
+int FarFieldRow( const FarField *far, const SRFDAT3D *srf, int n,
+  double epsAdap, const ObstrBVH *bvh, const int *markN,
+  const int *possibleObstrN, int nPossN, int *farN );
+double FarFieldAF( const SRFDAT3D *srf, int n, int m );
+void FreeFarField( FarField *far );
+
+#endif
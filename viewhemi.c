@@ -0,0 +1,677 @@
+/*subfile:  ViewHemi.c  ******************************************************/
+
+/*  Whole rows of view factors by hemicubes (engine=hemi).
+ *
+ *  Every surface is projected onto a hemicube centered on each of the
+ *  sample points of a surface K:  a top face of HEMIRES by HEMIRES
+ *  pixels and four half side faces.  A z-buffer keeps the nearest
+ *  surface at each pixel and the delta form factors of the pixels give
+ *  F(K,M) for all M at once, so one pass replaces the pair calculations
+ *  of View3DPair().  The sample points lie on a grid over each triangle
+ *  of K with cells about HEMIDIV per side of a surface of mean area,
+ *  graded toward the edges.  AF(N,M) is taken from the hemicube of the
+ *  smaller of N and M, whose sample points cover it best, and the
+ *  larger one gets it by reciprocity.  The result is approximate;  the
+ *  error decreases with HEMIRES and HEMIDIV but does not depend on
+ *  epsAdap.  It is meant for quick estimates;  the default engine
+ *  remains the accurate one.
+ *
+ *  Surfaces are rasterized in tiles of HEMITILE by HEMITILE pixels:
+ *  a tile entirely outside one edge of the projected polygon is
+ *  skipped, and the pixels of a tile row are tested and written by
+ *  short loops which the compiler vectorizes.  Subsurfaces (base > 0)
+ *  lie on their base surface;  they are drawn into a second buffer,
+ *  so that a pixel counts for both the subsurface and its base, as the
+ *  later separation of subsurfaces expects.
+ *
+ *  With threads > 1 the hemicubes are shared by ParallelFor() threads,
+ *  each with its own hemicube.  */
+
+#ifdef _DEBUG
+# define DEBUG 1
+#else
+# define DEBUG 0
+#endif
+
+#define V3D_BUILD
+#include "viewhemi.h"
+
+#include <stdio.h>
+#include <string.h> /* prototype: memset */
+#include <math.h>   /* prototypes: sqrt, fabs */
+#include <pthread.h>
+#include "types.h"
+#include "misc.h"
+#include "heap.h"
+
+#define HEMIRES 128   /* pixels across the top face; even */
+#define HEMIDIV 2     /* min cells across a triangle; cells per mean side */
+#define HEMIMAXDIV 16 /* max cells across a triangle */
+#define HEMITILE 8    /* pixels per tile side */
+#define MAXHV (MAXNV+6)  /* max vertices of a clipped polygon */
+#define HEMIPIX (3*HEMIRES*HEMIRES)  /* pixels of a hemicube */
+#define HEMIFACE(f) ((f) ? (HEMIRES * HEMIRES * ((f)+1)) / 2 : 0)  /* first
+                         pixel of face F;  side faces are half height */
+#define PI       3.141592653589793238   /* pi */
+#define PIinv    0.318309886183790672   /* 1 / pi */
+
+extern V3D_TLS FILE *_ulog; /* log file */
+
+typedef struct{         /* hemicube of one thread */
+  int nSrf;             /* number of surfaces */
+  float *zbuf;          /* 1 / depth of the nearest surface; 0 = none */
+  int *item;            /* nearest surface; 0 = none, -1 = not counted */
+  int *over;            /* subsurface on the nearest surface; 0 = none */
+  int *level;           /* level of the subsurface in over */
+  double *dff;          /* delta form factors */
+  double *F;            /* view factors to surfaces [1:nSrf] */
+} Hemicube;
+
+typedef struct{         /* data shared by the View3DHemi() threads */
+  View3DWork *work;
+  int m1;               /* first column */
+  int n1, nn;           /* rows of AF to compute */
+  int *src;             /* surfaces whose hemicubes are needed [0:nSrc-1] */
+  int nSrc;             /* number of hemicubes */
+  int *left;            /* hemicubes still needed by row n [n1:nn] */
+  double lRef;          /* sample spacing of a surface of mean area */
+  int nDone;            /* number of hemicubes done */
+  FILE *ulog;           /* globals of the calling thread */
+  pthread_mutex_t lock; /* for nDone, left and the journal */
+} HemiPool;
+
+static void HemiRows( void *arg, int i1, int i2 );
+static int HemiLastCol( View3DControlData *vfCtrl, int m1, int n );
+static int HemiOpen( View3DWork *work, int n, int m );
+static int HemiSource( const SRFDAT3D *srf, int n, int m );
+static int HemiDivisions( double len, double lRef );
+static Hemicube *NewHemicube( int nSrf );
+static void FreeHemicube( Hemicube *hc );
+static void HemiPoint( Hemicube *hc, SRFDAT3D *srf, const int *base,
+  int nAllSrf, int nRadSrf, int n, const Vec3 *p, double wt );
+static void HemiSurface( Hemicube *hc, const SRFDAT3D *srf, const Vec3 *p,
+  const Vec3 axis[5][3], int id, int overlay );
+static int HemiClip( int nv, double v[][3], int face );
+static void HemiRaster( Hemicube *hc, int face, int nv, double v[][3],
+  double za, double zb, double zc, int id, int overlay );
+
+/***  View3DHemi.c  **********************************************************/
+
+/*  Compute rows N1 to NN of AF by hemicubes.  The columns are those of
+ *  the View3DPair() loop in View3D();  values already set for mask and
+ *  null surfaces are kept.  AF(N,M) is taken from the hemicubes of the
+ *  smaller of surfaces N and M, whose sample points are closer together
+ *  relative to the other surface;  a row is complete, and journaled,
+ *  when all of the hemicubes it needs are done.  */
+
+void View3DHemi( View3DWork *work, int n1, int nn )
+  {
+  View3DControlData *vfCtrl = work->vfCtrl;
+  SRFDAT3D *srf = work->srf;
+  HemiPool pool;
+  int *need;     /* need[k] = 1 if the hemicubes of surface k are needed */
+  int *stamp;    /* stamp[k] = N when counted in pool.left[N] */
+  int n, m, k;
+
+  pool.work = work;
+  pool.m1 = vfCtrl->col > 0 ? vfCtrl->col : 1;
+  pool.n1 = n1;
+  pool.nn = nn;
+  pool.nDone = 0;
+  pool.ulog = _ulog;
+  for( pool.lRef=0.0,n=1; n<=vfCtrl->nRadSrf; n++ )
+    pool.lRef += srf[n].area;
+  pool.lRef = sqrt( pool.lRef / vfCtrl->nRadSrf ) / HEMIDIV;
+  pthread_mutex_init( &pool.lock, NULL );
+
+  need = Alc_V( 1, vfCtrl->nRadSrf, sizeof(int), __FILE__, __LINE__ );
+  stamp = Alc_V( 1, vfCtrl->nRadSrf, sizeof(int), __FILE__, __LINE__ );
+  pool.left = Alc_V( n1, nn, sizeof(int), __FILE__, __LINE__ );
+  for( n=n1; n<=nn; n++ )
+    {
+    int mm = HemiLastCol( vfCtrl, pool.m1, n );
+    if( work->journal && work->journal->done[n] )
+      continue;             /* row read from the journal */
+    work->AF[n][n] = 0.0;
+    for( m=pool.m1; m<mm; m++ )
+      if( HemiOpen( work, n, m ) )
+        {
+        k = HemiSource( srf, n, m );
+        need[k] = 1;
+        if( stamp[k] != n )
+          {
+          stamp[k] = n;
+          pool.left[n] += 1;
+          }
+        }
+    if( pool.left[n] == 0 && work->journal )
+      JournalRow( work->journal, work->AF, n );
+    }
+  pool.src = Alc_V( 0, vfCtrl->nRadSrf, sizeof(int), __FILE__, __LINE__ );
+  for( pool.nSrc=0,k=1; k<=vfCtrl->nRadSrf; k++ )
+    if( need[k] )
+      pool.src[pool.nSrc++] = k;
+
+  if( vfCtrl->nThreads > 1 && vfCtrl->row == 0 )
+    ParallelFor( 0, pool.nSrc-1, vfCtrl->nThreads, HemiRows, &pool );
+  else if( pool.nSrc > 0 )
+    HemiRows( &pool, 0, pool.nSrc-1 );
+
+  pthread_mutex_destroy( &pool.lock );
+  Fre_V( pool.src, 0, vfCtrl->nRadSrf, sizeof(int), __FILE__, __LINE__ );
+  Fre_V( pool.left, n1, nn, sizeof(int), __FILE__, __LINE__ );
+  Fre_V( stamp, 1, vfCtrl->nRadSrf, sizeof(int), __FILE__, __LINE__ );
+  Fre_V( need, 1, vfCtrl->nRadSrf, sizeof(int), __FILE__, __LINE__ );
+
+  }  /* end View3DHemi */
+
+/***  HemiLastCol.c  *********************************************************/
+
+/*  Return the column after the last of row N, as in View3D().  */
+
+static int HemiLastCol( View3DControlData *vfCtrl, int m1, int n )
+  {
+  if( vfCtrl->col )
+    return m1 + 1;
+  else if( vfCtrl->row > 0 )
+    return vfCtrl->nRadSrf + 1;
+  else
+    return n;
+
+  }  /* end HemiLastCol */
+
+/***  HemiOpen.c  ************************************************************/
+
+/*  Return 1 if AF[N][M] is to be computed by hemicubes.  */
+
+static int HemiOpen( View3DWork *work, int n, int m )
+  {
+  if( m == n )
+    return 0;
+  if( work->vfCtrl->nMaskSrf && work->AF[n][m] >= 0.0 )
+    return 0;               /* set for a mask or null surface */
+  return 1;
+
+  }  /* end HemiOpen */
+
+/***  HemiSource.c  **********************************************************/
+
+/*  Return the surface, N or M, whose hemicubes give AF(N,M).  */
+
+static int HemiSource( const SRFDAT3D *srf, int n, int m )
+  {
+  if( srf[m].area < srf[n].area )
+    return m;
+  return n;
+
+  }  /* end HemiSource */
+
+/***  HemiDivisions.c  *******************************************************/
+
+/*  Return the number of cells across LEN:  one per LREF, at least
+ *  HEMIDIV and at most HEMIMAXDIV.  */
+
+static int HemiDivisions( double len, double lRef )
+  {
+  double nd = ceil( len / lRef );
+
+  if( nd < HEMIDIV )
+    return HEMIDIV;
+  if( nd > HEMIMAXDIV )
+    return HEMIMAXDIV;
+  return (int)nd;
+
+  }  /* end HemiDivisions */
+
+/***  HemiRows.c  ************************************************************/
+
+/*  Compute the hemicubes of surfaces pool->src[I1] to pool->src[I2] and
+ *  the AF values taken from them;  called by ParallelFor().  Each
+ *  triangle of the surface is sampled on a grid with cells about
+ *  pool->lRef across, so long thin surfaces are sampled along their
+ *  length and the number of points grows with the area.  */
+
+static void HemiRows( void *arg, int i1, int i2 )
+  {
+  HemiPool *pool = arg;
+  View3DWork *work = pool->work;
+  View3DControlData *vfCtrl = work->vfCtrl;
+  SRFDAT3D *srf = work->srf;
+  double **AF = work->AF;
+  Hemicube *hc;
+  int n, m, k, t, i, j, ii;
+
+  _ulog = pool->ulog;
+  hc = NewHemicube( vfCtrl->nAllSrf );
+  for( ii=i1; ii<=i2; ii++ )
+    {
+    SRFDAT3D *sk;
+    double sum=0.0, tri[MAXNV];
+    k = pool->src[ii];
+    sk = srf + k;
+
+    for( m=1; m<=vfCtrl->nAllSrf; m++ )
+      hc->F[m] = 0.0;
+    for( t=0; t<sk->nv-2; t++ )   /* areas of the triangle fan */
+      {
+      Vec3 a, b, c;
+      VECTOR( sk->v[0], sk->v[t+1], (&a) );
+      VECTOR( sk->v[0], sk->v[t+2], (&b) );
+      VCROSS( (&a), (&b), (&c) );
+      tri[t] = 0.5 * VLEN( (&c) );
+      sum += tri[t];
+      }
+    for( t=0; t<sk->nv-2 && sum>0.0; t++ )
+      {
+      const Vec3 *v0 = sk->v[0], *v1 = sk->v[t+1], *v2 = sk->v[t+2];
+      Vec3 e;
+      double len, ht;
+      int nr, ns;     /* divisions from v0 to edge v1-v2, along v1-v2 */
+      VECTOR( v1, v2, (&e) );
+      len = VLEN( (&e) );
+      ht = 2.0 * tri[t] / len;
+      nr = HemiDivisions( ht, pool->lRef );
+      ns = HemiDivisions( len, pool->lRef );
+      for( i=0; i<nr; i++ )      /* cells graded toward the edges */
+        for( j=0; j<ns; j++ )
+          {
+          double u = 0.5 * (1.0 - cos( PI * (i + 0.5) / nr ));
+          double du = 0.5 * (cos( PI * i / nr ) - cos( PI * (i + 1) / nr ));
+          double s = 0.5 * (1.0 - cos( PI * (j + 0.5) / ns ));
+          double ds = 0.5 * (cos( PI * j / ns ) - cos( PI * (j + 1) / ns ));
+          double r = sqrt( u );
+          Vec3 p;
+          p.x = v0->x + r * ((1.0 - s) * (v1->x - v0->x) + s * (v2->x - v0->x));
+          p.y = v0->y + r * ((1.0 - s) * (v1->y - v0->y) + s * (v2->y - v0->y));
+          p.z = v0->z + r * ((1.0 - s) * (v1->z - v0->z) + s * (v2->z - v0->z));
+          HemiPoint( hc, srf, work->base, vfCtrl->nAllSrf, vfCtrl->nRadSrf,
+            k, &p, du * ds * tri[t] / sum );
+          }
+      }
+
+    pthread_mutex_lock( &pool->lock );
+    for( n=pool->n1; n<=pool->nn; n++ )   /* rows with values from k */
+      {
+      int mm = HemiLastCol( vfCtrl, pool->m1, n ), used=0;
+      if( work->journal && work->journal->done[n] )
+        continue;
+      if( n == k )
+        {
+        for( m=pool->m1; m<mm; m++ )
+          if( HemiOpen( work, n, m ) && HemiSource( srf, n, m ) == k )
+            {
+            AF[n][m] = sk->area * hc->F[m];
+            if( AF[n][m] < 1.0e-12 * MAX( sk->area, srf[m].area ) )
+              AF[n][m] = 0.0;     /* remove very small values */
+            used = 1;
+            }
+        }
+      else if( k >= pool->m1 && k < mm && HemiOpen( work, n, k )
+        && HemiSource( srf, n, k ) == k )
+        {
+        AF[n][k] = sk->area * hc->F[n];   /* reciprocity */
+        if( AF[n][k] < 1.0e-12 * MAX( sk->area, srf[n].area ) )
+          AF[n][k] = 0.0;
+        used = 1;
+        }
+      if( used && --pool->left[n] == 0 && work->journal )
+        JournalRow( work->journal, AF, n );
+      }
+    pool->nDone += 1;
+#ifdef LOGGING
+    if( vfCtrl->row == 0 )
+      fprintf( stderr, "\rSurface: %d; ~ %.1f %% complete", k,
+        100.0 * pool->nDone / pool->nSrc );
+#endif
+    pthread_mutex_unlock( &pool->lock );
+    }
+  FreeHemicube( hc );
+
+  }  /* end HemiRows */
+
+/***  NewHemicube.c  *********************************************************/
+
+/*  Allocate the buffers of a hemicube and set the delta form factors:
+ *  dA / (pi * (1 + x^2 + y^2)^2) on the top face and, with height z,
+ *  z * dA / (pi * (1 + x^2 + z^2)^2) on the side faces.  */
+
+static Hemicube *NewHemicube( int nSrf )
+  {
+  Hemicube *hc;
+  int np = HEMIPIX;
+  double dA = 4.0 / ((double)HEMIRES * HEMIRES);
+  int f, i, j;
+
+  hc = V3D_NEW( Hemicube );
+  hc->nSrf = nSrf;
+  hc->zbuf = Alc_V( 0, np, sizeof(float), __FILE__, __LINE__ );
+  hc->item = Alc_V( 0, np, sizeof(int), __FILE__, __LINE__ );
+  hc->over = Alc_V( 0, np, sizeof(int), __FILE__, __LINE__ );
+  hc->level = Alc_V( 0, np, sizeof(int), __FILE__, __LINE__ );
+  hc->dff = Alc_V( 0, np, sizeof(double), __FILE__, __LINE__ );
+  hc->F = Alc_V( 0, nSrf, sizeof(double), __FILE__, __LINE__ );
+  for( f=0; f<5; f++ )
+    for( j=0; j<(f ? HEMIRES/2 : HEMIRES); j++ )
+      for( i=0; i<HEMIRES; i++ )
+        {
+        double x = -1.0 + (i + 0.5) * 2.0 / HEMIRES;
+        double y = (f ? 0.0 : -1.0) + (j + 0.5) * 2.0 / HEMIRES;
+        double d = 1.0 + x * x + y * y;
+        double *dff = hc->dff + HEMIFACE(f) + j * HEMIRES + i;
+        if( f == 0 )
+          *dff = PIinv * dA / (d * d);
+        else
+          *dff = PIinv * y * dA / (d * d);
+        }
+
+  return hc;
+
+  }  /* end NewHemicube */
+
+/***  FreeHemicube.c  ********************************************************/
+
+static void FreeHemicube( Hemicube *hc )
+  {
+  int np = HEMIPIX;
+
+  Fre_V( hc->F, 0, hc->nSrf, sizeof(double), __FILE__, __LINE__ );
+  Fre_V( hc->dff, 0, np, sizeof(double), __FILE__, __LINE__ );
+  Fre_V( hc->level, 0, np, sizeof(int), __FILE__, __LINE__ );
+  Fre_V( hc->over, 0, np, sizeof(int), __FILE__, __LINE__ );
+  Fre_V( hc->item, 0, np, sizeof(int), __FILE__, __LINE__ );
+  Fre_V( hc->zbuf, 0, np, sizeof(float), __FILE__, __LINE__ );
+  V3D_FREE( Hemicube, hc );
+
+  }  /* end FreeHemicube */
+
+/***  HemiPoint.c  ***********************************************************/
+
+/*  Add WT times the view factors from point P of surface N to all
+ *  surfaces to hc->F.  Surfaces after nRadSrf obstruct but are not
+ *  counted;  neither are the back sides of surfaces.  */
+
+static void HemiPoint( Hemicube *hc, SRFDAT3D *srf, const int *base,
+  int nAllSrf, int nRadSrf, int n, const Vec3 *p, double wt )
+  {
+  Vec3 axis[5][3];   /* x, y, depth axes of the faces */
+  const DirCos *w = &srf[n].dc;
+  Vec3 u, v;
+  double len;
+  int np = HEMIPIX;
+  int m, k, f;
+
+  if( fabs( w->x ) < 0.6 )   /* surface frame: u, v, w */
+    { u.x = 0.0; u.y = w->z; u.z = -w->y; }
+  else
+    { u.x = -w->z; u.y = 0.0; u.z = w->x; }
+  len = 1.0 / VLEN( (&u) );
+  VSCALE( len, (&u), (&u) );
+  VCROSS( w, (&u), (&v) );
+  for( f=0; f<5; f++ )
+    {
+    Vec3 *a = axis[f];
+    switch( f )
+      {
+      case 0: a[0] = u; a[1] = v; VCOPY( w, (a+2) ); break;
+      case 1: a[0] = v; VCOPY( w, (a+1) ); a[2] = u; break;
+      case 2: VSCALE( -1.0, (&v), (a+0) ); VCOPY( w, (a+1) );
+              VSCALE( -1.0, (&u), (a+2) ); break;
+      case 3: VSCALE( -1.0, (&u), (a+0) ); VCOPY( w, (a+1) ); a[2] = v; break;
+      default: a[0] = u; VCOPY( w, (a+1) ); VSCALE( -1.0, (&v), (a+2) );
+      }
+    }
+
+  memset( hc->zbuf, 0, np * sizeof(float) );
+  memset( hc->item, 0, np * sizeof(int) );
+  memset( hc->over, 0, np * sizeof(int) );
+  for( k=0; k<2; k++ )       /* surfaces, then subsurfaces */
+    for( m=1; m<=nAllSrf; m++ )
+      {
+      int overlay=0, id, b;
+      for( b=m; b<=nRadSrf && base[b]>0; b=base[b] )
+        overlay++;          /* nesting level of a subsurface */
+      if( m == n || (overlay > 0) != k ) continue;
+      if( m > nRadSrf || srf[m].type == OBSO )
+        id = -1;
+      else
+        id = m;
+      HemiSurface( hc, srf+m, p, (const Vec3 (*)[3])axis, id, overlay );
+      }
+
+  for( k=0; k<np; k++ )      /* sum the delta form factors */
+    {
+    if( hc->item[k] > 0 )
+      hc->F[hc->item[k]] += wt * hc->dff[k];
+    for( m=hc->over[k]; m>0 && m<=nRadSrf && base[m] > 0; m=base[m] )
+      hc->F[m] += wt * hc->dff[k];
+    }
+
+  }  /* end HemiPoint */
+
+/***  HemiSurface.c  *********************************************************/
+
+/*  Draw surface SRF seen from P on the five faces of the hemicube.
+ *  ID is the surface number to record, or -1 for an obstruction only;
+ *  the back side of a surface is recorded as -1.  */
+
+static void HemiSurface( Hemicube *hc, const SRFDAT3D *srf, const Vec3 *p,
+  const Vec3 axis[5][3], int id, int overlay )
+  {
+  const DirCos *dc = &srf->dc;
+  double c0;     /* distance of P from the plane of SRF */
+  double eps = 1.0e-9 * srf->rc;
+  int f, k, above=0;
+
+  c0 = VDOTW( p, dc );
+  if( fabs( c0 ) <= eps ) return;    /* seen edge on */
+  if( c0 < 0.0 )
+    id = -1;                          /* back side */
+  for( k=0; k<srf->nv; k++ )
+    {
+    Vec3 d;
+    VECTOR( p, srf->v[k], (&d) );
+    if( VDOT( (&d), (&axis[0][2]) ) > eps ) above = 1;
+    }
+  if( !above ) return;                /* below the hemicube */
+
+  for( f=0; f<5; f++ )
+    {
+    double v[MAXHV][3];
+    const Vec3 *a = axis[f];
+    double g = -1.0 / c0;
+    int nv = srf->nv;
+    for( k=0; k<nv; k++ )
+      {
+      Vec3 d;
+      VECTOR( p, srf->v[k], (&d) );
+      v[k][0] = VDOT( (&d), (a+0) );
+      v[k][1] = VDOT( (&d), (a+1) );
+      v[k][2] = VDOT( (&d), (a+2) );
+      }
+    nv = HemiClip( nv, v, f );
+    if( nv < 3 ) continue;
+      /* 1 / depth = za * sx + zb * sy + zc on the face plane */
+    HemiRaster( hc, f, nv, v, g * VDOT( dc, (a+0) ), g * VDOT( dc, (a+1) ),
+      g * VDOT( dc, (a+2) ), id, overlay );
+    }
+
+  }  /* end HemiSurface */
+
+/***  HemiClip.c  ************************************************************/
+
+/*  Clip polygon V (x, y, depth in the face frame) to the pyramid of
+ *  face FACE:  |x| <= depth and |y| <= depth for the top face,
+ *  |x| <= depth and 0 <= y <= depth for a side face.  Return the
+ *  number of vertices left.  */
+
+static int HemiClip( int nv, double v[][3], int face )
+  {
+  double w[MAXHV][3];
+  int k, i, j;
+
+  for( k=0; k<5 && nv>=3; k++ )
+    {
+    double d[MAXHV];
+    int n=0;
+    for( i=0; i<nv; i++ )
+      switch( k )
+        {
+        case 0: d[i] = v[i][2] - v[i][0]; break;
+        case 1: d[i] = v[i][2] + v[i][0]; break;
+        case 2: d[i] = v[i][2] - v[i][1]; break;
+        case 3: d[i] = face ? v[i][1] : v[i][2] + v[i][1]; break;
+        default: d[i] = v[i][2] - 1.0e-12 * (fabs(v[i][0]) + fabs(v[i][1]));
+        }
+    for( i=0; i<nv; i++ )
+      {
+      int i1 = (i + 1) % nv;
+      if( d[i] >= 0.0 && n < MAXHV )
+        {
+        w[n][0] = v[i][0]; w[n][1] = v[i][1]; w[n][2] = v[i][2];
+        n++;
+        }
+      if( ((d[i] >= 0.0) != (d[i1] >= 0.0)) && n < MAXHV )
+        {
+        double t = d[i] / (d[i] - d[i1]);
+        for( j=0; j<3; j++ )
+          w[n][j] = v[i][j] + t * (v[i1][j] - v[i][j]);
+        n++;
+        }
+      }
+    for( i=0; i<n; i++ )
+      for( j=0; j<3; j++ )
+        v[i][j] = w[i][j];
+    nv = n;
+    }
+
+  return nv;
+
+  }  /* end HemiClip */
+
+/***  HemiRaster.c  **********************************************************/
+
+/*  Fill the pixels of face FACE whose centers are inside polygon V
+ *  (clipped to the face) where it is nearer than the z-buffer.  The
+ *  1 / depth at face coordinates (sx, sy) is ZA * sx + ZB * sy + ZC.
+ *  An OVERLAY (subsurface) is recorded in hc->over where it is at
+ *  about the depth of the z-buffer;  a subsurface nested deeper wins.  */
+
+static void HemiRaster( Hemicube *hc, int face, int nv, double v[][3],
+  double za, double zb, double zc, int id, int overlay )
+  {
+  double ex[MAXHV], ey[MAXHV], ec[MAXHV];  /* edge functions */
+  int tl[MAXHV];                           /* top-left edges */
+  double X[MAXHV], Y[MAXHV], area=0.0;
+  double h = 0.5 * HEMIRES, oy = face ? 0.0 : 1.0;
+  double xmin, xmax, ymin, ymax;
+  int ny = face ? HEMIRES / 2 : HEMIRES;   /* pixel rows */
+  int i0, i1, j0, j1, ti, tj, i, j, k;
+  float *zbuf = hc->zbuf + HEMIFACE(face);
+  int *item = hc->item + HEMIFACE(face);
+  int *over = hc->over + HEMIFACE(face);
+  int *level = hc->level + HEMIFACE(face);
+  double a, b, c;    /* 1 / depth = a * i + b * j + c at pixel centers */
+
+  for( k=0; k<nv; k++ )      /* pixel coordinates */
+    {
+    X[k] = (v[k][0] / v[k][2] + 1.0) * h;
+    Y[k] = (v[k][1] / v[k][2] + oy) * h;
+    }
+  xmin = xmax = X[0];
+  ymin = ymax = Y[0];
+  for( k=0; k<nv; k++ )
+    {
+    int k1 = (k + 1) % nv;
+    area += X[k] * Y[k1] - X[k1] * Y[k];
+    xmin = MIN( xmin, X[k] ); xmax = MAX( xmax, X[k] );
+    ymin = MIN( ymin, Y[k] ); ymax = MAX( ymax, Y[k] );
+    }
+  if( area == 0.0 ) return;
+  for( k=0; k<nv; k++ )      /* E >= 0 inside */
+    {
+    int k1 = (k + 1) % nv;
+    double s = area > 0.0 ? 1.0 : -1.0;
+    ex[k] = s * (Y[k] - Y[k1]);
+    ey[k] = s * (X[k1] - X[k]);
+    ec[k] = s * (X[k] * Y[k1] - X[k1] * Y[k]);
+    tl[k] = ex[k] > 0.0 || (ex[k] == 0.0 && ey[k] > 0.0);
+    }
+  a = za / h;
+  b = zb / h;
+  c = zc - za - zb * oy + 0.5 * (a + b);    /* centers at i + 0.5 */
+
+  i0 = (int)floor( xmin - 0.5 );  if( i0 < 0 ) i0 = 0;
+  i1 = (int)ceil( xmax - 0.5 );   if( i1 > HEMIRES - 1 ) i1 = HEMIRES - 1;
+  j0 = (int)floor( ymin - 0.5 );  if( j0 < 0 ) j0 = 0;
+  j1 = (int)ceil( ymax - 0.5 );   if( j1 > ny - 1 ) j1 = ny - 1;
+  i0 -= i0 % HEMITILE;
+  j0 -= j0 % HEMITILE;
+
+  for( tj=j0; tj<=j1; tj+=HEMITILE )
+    for( ti=i0; ti<=i1; ti+=HEMITILE )
+      {
+      int out=0, full=1;
+      for( k=0; k<nv && !out; k++ )   /* tile outside one edge */
+        {
+        double e0 = ex[k] * (ti + 0.5) + ey[k] * (tj + 0.5) + ec[k];
+        double e1 = e0 + ex[k] * (HEMITILE - 1);
+        double e2 = e0 + ey[k] * (HEMITILE - 1);
+        double e3 = e1 + ey[k] * (HEMITILE - 1);
+        out = e0 < 0.0 && e1 < 0.0 && e2 < 0.0 && e3 < 0.0;
+        full &= e0 > 0.0 && e1 > 0.0 && e2 > 0.0 && e3 > 0.0;
+        }
+      if( out ) continue;
+      for( j=tj; j<tj+HEMITILE; j++ )
+        {
+        float z[HEMITILE];
+        int in[HEMITILE];
+        int n0 = j * HEMIRES + ti;
+        float z0 = (float)(a * ti + b * j + c), dz = (float)a;
+        for( i=0; i<HEMITILE; i++ )
+          {
+          z[i] = z0 + dz * i;
+          in[i] = 1;
+          }
+        for( k=0; k<nv && !full; k++ )  /* edge tests if not full */
+          {
+          float e0 = (float)(ex[k] * (ti + 0.5) + ey[k] * (j + 0.5) + ec[k]);
+          float de = (float)ex[k];
+          int t = tl[k];
+          for( i=0; i<HEMITILE; i++ )
+            {
+            float e = e0 + de * i;
+            in[i] &= (e > 0.0f) | ((e == 0.0f) & t);
+            }
+          }
+        if( overlay )
+          {
+          for( i=0; i<HEMITILE; i++ )
+            if( in[i] && z[i] >= zbuf[n0+i] * (1.0f - 1.0e-6f)
+              && (over[n0+i] == 0 || level[n0+i] <= overlay) )
+              {
+              over[n0+i] = id;
+              level[n0+i] = overlay;
+              }
+          }
+        else
+          {           /* copies let the depth test vectorize */
+          float zb[HEMITILE];
+          float tie = id > 0 ? 1.0f - 1.0e-6f : 1.0f;  /* front side wins
+                        a tie with a back side or obstruction */
+          int it[HEMITILE];
+          memcpy( zb, zbuf + n0, sizeof(zb) );
+          memcpy( it, item + n0, sizeof(it) );
+          for( i=0; i<HEMITILE; i++ )
+            {
+            int w = in[i] & ((z[i] > zb[i])
+              | ((it[i] == -1) & (z[i] >= zb[i] * tie)));
+            zb[i] = w ? z[i] : zb[i];
+            it[i] = w ? id : it[i];
+            }
+          memcpy( zbuf + n0, zb, sizeof(zb) );
+          memcpy( item + n0, it, sizeof(it) );
+          }
+        }
+      }
+
+  }  /* end HemiRaster */
@@ -0,0 +1,11 @@
+#ifndef V3D_VIEWHEMI_H
+#define V3D_VIEWHEMI_H
+
+#include "view3d.h"
+#include "viewmt.h"
+
+/*  Whole rows of view factors by hemicubes; see viewhemi.c.  */
+
+void View3DHemi( View3DWork *work, int n1, int nn );
+
+#endif
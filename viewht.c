@@ -37,7 +37,6 @@ float CPUtime(float t1);
 
 /* global vars */
 
-FILE *_ulog = NULL; /**< log file */
 FILE *_uout; /**< output file */
 
 /***  main.c  ****************************************************************/
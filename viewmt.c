@@ -0,0 +1,555 @@
+/*subfile:  ViewMT.c  ********************************************************/
+
+/*  Multi-threaded driver for the 3-D view factor calculations.
+ *  Each thread has its own copy of everything written while computing
+ *  a surface pair: the control structure (srf1T, srf2T, srfOT), the
+ *  NrelS / MrelS flags of the surface data, the polygon memory of
+ *  polygn.c and the edge divisions of viewunob.c (the latter two are
+ *  thread-local globals).
+ *
+ *  The cost of a pair ranges over several orders of magnitude, from a
+ *  failed SelfObstructionTest3D() to a deep ViewTP/ViewRP recursion.
+ *  The work is therefore done in two passes:
+ *  1. the threads estimate the cost of every pair (View3DPairCost) and
+ *     group adjacent columns of a row into tasks of similar cost;
+ *  2. the tasks are sorted, most costly first, and dealt to one
+ *     deque per thread.  A thread takes tasks from the front of its
+ *     own deque; when that is empty it steals from the back (the
+ *     least costly end) of the other deques.
+ *  Each AF element belongs to one task, so it is written by one thread.
+ *  The thread-local globals (_ulog, _list, _maxNVT) are copied from the
+ *  calling thread.  A fatal error in a thread stops all threads and is
+ *  then reported again by the calling thread.  */
+
+#ifdef _DEBUG
+# define DEBUG 1
+#else
+# define DEBUG 0
+#endif
+
+#define V3D_BUILD
+#include "viewmt.h"
+
+#include <stdio.h>
+#include <stdlib.h> /* prototype: qsort */
+#include <string.h> /* prototype: memcpy */
+#include <pthread.h>
+#include "types.h"
+#include "misc.h"
+#include "heap.h"
+#include "polygn.h"
+#include "viewunob.h"
+
+extern V3D_TLS FILE *_ulog; /* log file */
+
+#define TASKCOST 64.0   /* target cost of a task */
+#define TASKCOLS 256    /* max number of columns in a task */
+
+typedef struct{         /* block of pairs in one row of AF */
+  int row;              /* row N */
+  int col1;             /* first column */
+  int col2;             /* last column + 1 */
+  float cost;           /* estimated cost of the block */
+} PairTask;
+
+typedef struct{         /* task deque of one thread */
+  pthread_mutex_t lock; /* protects head and tail */
+  PairTask *task;       /* tasks [0:nTask-1]; most costly first */
+  int head;             /* next task taken by the owner */
+  int tail;             /* one past the next task taken by a thief */
+} TaskDeque;
+
+typedef struct{         /* data shared by all View3DParallel() threads */
+  pthread_mutex_t lock; /* protects nextRow, nAFstart, rowLeft, journal */
+  int nextRow;          /* next row for cost estimates; counts down */
+  int *rowLeft;         /* columns not yet computed in each row [n1:nn] */
+  int n1;               /* first row to be computed */
+  double nAFtot;        /* total number of view factors to compute */
+  double nAFstart;      /* number of view factors started */
+  int nThreads;         /* number of threads */
+  TaskDeque *deque;     /* deques [1:nThreads] */
+  FILE *ulog;           /* globals of the calling thread */
+  int list;
+  int maxNVT;
+  volatile int fatal;   /* true after a fatal error in any thread */
+} ThreadPool;
+
+typedef struct{         /* data for one View3DParallel() thread */
+  View3DWork work;      /* private working data */
+  View3DControlData vfCtrl;  /* private control values */
+  ThreadPool *pool;     /* shared values */
+  pthread_t tid;        /* thread identifier */
+  int id;               /* thread number; 1 to nThreads */
+  PairTask *task;       /* tasks created in the estimating pass */
+  int nTask;            /* number of tasks */
+  int maxTask;          /* size of task vector */
+} ThreadData;
+
+static void *EstimateThread( void *arg );
+static void *View3DThread( void *arg );
+static void AddTask( ThreadData *td, int n, int m1, int m2, double cost );
+static int TaskCompare( const void *p1, const void *p2 );
+static int RowCompare( const void *p1, const void *p2 );
+static int NextTask( ThreadPool *pool, int id, PairTask *task );
+static void ThreadGlobals( ThreadData *td );
+static void *ForThread( void *arg );
+
+#define FORCHUNK 64     /* items taken at a time by a ParallelFor() thread */
+
+typedef struct{         /* data shared by ParallelFor() threads */
+  pthread_mutex_t lock; /* protects next */
+  int next;             /* next item to be processed */
+  int nn;               /* last item */
+  void (*func)( void *arg, int i1, int i2 );
+  void *arg;
+} ForPool;
+
+/***  View3DParallel.c  ******************************************************/
+
+/*  Compute rows N1 through NN of the AF array using vfCtrl->nThreads
+ *  threads.  Statistics of the threads are added to WORK.  */
+
+void View3DParallel( View3DWork *work, int n1, int nn )
+  {
+  View3DControlData *vfCtrl = work->vfCtrl;
+  ThreadPool pool;
+  ThreadData *thrd;   /* data for each thread */
+  PairTask *task;     /* all tasks */
+  int nTask;          /* number of tasks */
+  int nThreads = vfCtrl->nThreads;
+  int i, j, k;
+
+  if( nThreads > nn - n1 + 1 )
+    nThreads = nn - n1 + 1;
+  for( i=n1; i<=nn; i++ )
+    work->AF[i][i] = 0.0;
+  pthread_mutex_init( &pool.lock, NULL );
+  pool.nextRow = nn;
+  pool.n1 = n1;
+  pool.nAFtot = (double)(nn-1) * (double)nn;
+  if( pool.nAFtot < 1.0 )
+    pool.nAFtot = 1.0;
+  pool.nAFstart = (double)(n1-1) * (double)n1;
+  pool.nThreads = nThreads;
+  pool.ulog = _ulog;
+  pool.list = _list;
+  pool.maxNVT = _maxNVT;
+  pool.fatal = 0;
+  pool.rowLeft = NULL;
+  if( work->journal )
+    {
+    pool.rowLeft = Alc_V( n1, nn, sizeof(int), __FILE__, __LINE__ );
+    for( i=n1; i<=nn; i++ )
+      {
+      pool.rowLeft[i] = i - 1;
+      if( i == 1 && !work->journal->done[i] )
+        JournalRow( work->journal, work->AF, i );  /* no columns */
+      }
+    }
+
+  thrd = Alc_V( 1, nThreads, sizeof(ThreadData), __FILE__, __LINE__ );
+  for( i=1; i<=nThreads; i++ )
+    {
+    View3DWork *tw = &thrd[i].work;
+    memcpy( &thrd[i].vfCtrl, vfCtrl, sizeof(View3DControlData) );
+    thrd[i].vfCtrl.usedV1LIadapt = 0;
+    thrd[i].vfCtrl.wastedVObs = 0;
+    thrd[i].vfCtrl.usedVObs = 0;
+    thrd[i].vfCtrl.totPoly = 0;
+    thrd[i].vfCtrl.totVpt = 0;
+    thrd[i].vfCtrl.totRays = 0;
+    thrd[i].vfCtrl.failConverge = 0;
+    memcpy( tw, work, sizeof(View3DWork) );
+    tw->vfCtrl = &thrd[i].vfCtrl;
+    tw->nAF0 = tw->nAFnO = tw->nAFwO = tw->nAFff = tw->nObstr = 0;
+    tw->nAF32 = tw->nAF32d = 0;
+    tw->nAFsb = tw->nShaftOut = tw->nAFrp = 0;
+    tw->srf = Alc_V( 1, vfCtrl->nAllSrf, sizeof(SRFDAT3D), __FILE__, __LINE__ );
+    memcpy( tw->srf+1, work->srf+1, vfCtrl->nAllSrf*sizeof(SRFDAT3D) );
+    View3DWorkInit( tw );
+    thrd[i].pool = &pool;
+    thrd[i].id = i;
+    }
+
+  for( i=1; i<=nThreads; i++ )    /* pass 1: estimate costs */
+    if( pthread_create( &thrd[i].tid, NULL, EstimateThread, thrd+i ) )
+      error( 3, __FILE__, __LINE__, "Failed to start thread ", IntStr(i), "" );
+  for( nTask=0,i=1; i<=nThreads; i++ )
+    {
+    pthread_join( thrd[i].tid, NULL );
+    nTask += thrd[i].nTask;
+    }
+
+  if( nTask > 0 )      /* sort tasks; deal them to the deques */
+    {
+    task = Alc_V( 0, nTask, sizeof(PairTask), __FILE__, __LINE__ );
+    for( k=0,i=1; i<=nThreads; i++ )
+      {
+      memcpy( task+k, thrd[i].task, thrd[i].nTask*sizeof(PairTask) );
+      k += thrd[i].nTask;
+      if( thrd[i].task )
+        Fre_V( thrd[i].task, 0, thrd[i].maxTask, sizeof(PairTask), __FILE__, __LINE__ );
+      }
+    qsort( task, nTask, sizeof(PairTask),
+      work->journal ? RowCompare : TaskCompare );
+    }
+  else
+    task = NULL;
+  pool.deque = Alc_V( 1, nThreads, sizeof(TaskDeque), __FILE__, __LINE__ );
+  for( i=1; i<=nThreads; i++ )
+    {
+    TaskDeque *dq = pool.deque + i;
+    pthread_mutex_init( &dq->lock, NULL );
+    dq->task = Alc_V( 0, nTask/nThreads + 1, sizeof(PairTask), __FILE__, __LINE__ );
+    dq->head = dq->tail = 0;
+    }
+  for( j=0,i=1; j<nTask; j++ )
+    {
+    TaskDeque *dq = pool.deque + i;
+    dq->task[dq->tail++] = task[j];
+    if( ++i > nThreads ) i = 1;
+    }
+  if( task )
+    Fre_V( task, 0, nTask, sizeof(PairTask), __FILE__, __LINE__ );
+#ifdef LOGGING
+  fprintf( _ulog, "View3DParallel: %d threads, %d tasks\n", nThreads, nTask );
+#endif
+
+  for( i=1; i<=nThreads; i++ )    /* pass 2: compute view factors */
+    if( pthread_create( &thrd[i].tid, NULL, View3DThread, thrd+i ) )
+      error( 3, __FILE__, __LINE__, "Failed to start thread ", IntStr(i), "" );
+  for( i=1; i<=nThreads; i++ )
+    pthread_join( thrd[i].tid, NULL );
+
+  for( i=1; i<=nThreads; i++ )   /* combine thread statistics */
+    {
+    View3DWork *tw = &thrd[i].work;
+    work->nAF0 += tw->nAF0;
+    work->nAFnO += tw->nAFnO;
+    work->nAFwO += tw->nAFwO;
+    work->nAFff += tw->nAFff;
+    work->nAF32 += tw->nAF32;
+    work->nAF32d += tw->nAF32d;
+    work->nObstr += tw->nObstr;
+    work->nAFsb += tw->nAFsb;
+    work->nAFrp += tw->nAFrp;
+    work->nShaftOut += tw->nShaftOut;
+    for( j=0; j<=4; j++ )
+      for( k=1; k<=7; k++ )
+        work->bins[j][k] += tw->bins[j][k];
+    vfCtrl->usedV1LIadapt += thrd[i].vfCtrl.usedV1LIadapt;
+    vfCtrl->wastedVObs += thrd[i].vfCtrl.wastedVObs;
+    vfCtrl->usedVObs += thrd[i].vfCtrl.usedVObs;
+    vfCtrl->totPoly += thrd[i].vfCtrl.totPoly;
+    vfCtrl->totVpt += thrd[i].vfCtrl.totVpt;
+    vfCtrl->totRays += thrd[i].vfCtrl.totRays;
+    if( thrd[i].vfCtrl.failConverge )
+      vfCtrl->failConverge = 1;
+    View3DWorkFree( tw );
+    Fre_V( tw->srf, 1, vfCtrl->nAllSrf, sizeof(SRFDAT3D), __FILE__, __LINE__ );
+    pthread_mutex_destroy( &pool.deque[i].lock );
+    Fre_V( pool.deque[i].task, 0, nTask/nThreads + 1, sizeof(PairTask), __FILE__, __LINE__ );
+    }
+  Fre_V( pool.deque, 1, nThreads, sizeof(TaskDeque), __FILE__, __LINE__ );
+  Fre_V( thrd, 1, nThreads, sizeof(ThreadData), __FILE__, __LINE__ );
+  if( pool.rowLeft )
+    Fre_V( pool.rowLeft, n1, nn, sizeof(int), __FILE__, __LINE__ );
+  pthread_mutex_destroy( &pool.lock );
+  if( pool.fatal )
+    error( 3, __FILE__, __LINE__, "Fatal error in a View3D thread", "" );
+
+  }  /* end View3DParallel */
+
+/***  EstimateThread.c  ******************************************************/
+
+/*  Pass 1 thread: estimate the cost of each pair in a row and group
+ *  adjacent columns into tasks.  A pair costing more than TASKCOST
+ *  is a task by itself.  */
+
+static void *EstimateThread( void *arg )
+  {
+  ThreadData *td = arg;
+  ThreadPool *pool = td->pool;
+  View3DWork *work = &td->work;
+  double cost, sum;  /* pair and task costs */
+  int n;  /* row */
+  int m, m1;  /* column, first column of task */
+  jmp_buf fatal;
+
+  td->nTask = 0;
+  td->maxTask = 0;
+  td->task = NULL;
+  ThreadGlobals( td );
+  if( setjmp( fatal ) )
+    {
+    pool->fatal = 1;
+    return NULL;
+    }
+  _fatalJmp = &fatal;
+  for( ;; )
+    {
+    pthread_mutex_lock( &pool->lock );
+    n = pool->nextRow--;
+    pthread_mutex_unlock( &pool->lock );
+    if( n < pool->n1 || pool->fatal ) break;
+    if( work->journal && work->journal->done[n] )
+      continue;             /* row read from the journal */
+
+    View3DRow( work, n );
+    for( sum=0.0,m1=m=1; m<n; m++ )
+      {
+      cost = View3DPairCost( work, n, m );
+      if( cost >= TASKCOST )   /* costly pair; separate task */
+        {
+        if( m > m1 )
+          AddTask( td, n, m1, m, sum );
+        AddTask( td, n, m, m+1, cost );
+        sum = 0.0;
+        m1 = m + 1;
+        continue;
+        }
+      sum += cost;
+      if( sum >= TASKCOST || m+1-m1 >= TASKCOLS )
+        {
+        AddTask( td, n, m1, m+1, sum );
+        sum = 0.0;
+        m1 = m + 1;
+        }
+      }
+    if( n > m1 )
+      AddTask( td, n, m1, n, sum );
+    }
+
+  _fatalJmp = NULL;
+  return NULL;
+
+  }  /* end EstimateThread */
+
+/***  AddTask.c  *************************************************************/
+
+/*  Add columns M1 through M2-1 of row N to the tasks of this thread.  */
+
+static void AddTask( ThreadData *td, int n, int m1, int m2, double cost )
+  {
+  PairTask *pt;
+
+  if( !td->task || td->nTask > td->maxTask )   /* expand task vector */
+    {
+    int maxTask = 2 * td->maxTask + 256;
+    pt = Alc_V( 0, maxTask, sizeof(PairTask), __FILE__, __LINE__ );
+    if( td->task )
+      {
+      memcpy( pt, td->task, td->nTask*sizeof(PairTask) );
+      Fre_V( td->task, 0, td->maxTask, sizeof(PairTask), __FILE__, __LINE__ );
+      }
+    td->task = pt;
+    td->maxTask = maxTask;
+    }
+  pt = td->task + td->nTask++;
+  pt->row = n;
+  pt->col1 = m1;
+  pt->col2 = m2;
+  pt->cost = (float)cost;
+
+  }  /* end AddTask */
+
+/***  TaskCompare.c  *********************************************************/
+
+/*  Task order for qsort():  decreasing cost, then increasing row
+ *  and column so that the order is the same for every run.  */
+
+static int TaskCompare( const void *p1, const void *p2 )
+  {
+  const PairTask *t1 = p1, *t2 = p2;
+
+  if( t1->cost > t2->cost ) return -1;
+  if( t1->cost < t2->cost ) return 1;
+  if( t1->row != t2->row ) return t1->row - t2->row;
+  return t1->col1 - t2->col1;
+
+  }  /* end TaskCompare */
+
+/***  RowCompare.c  **********************************************************/
+
+/*  Task order for qsort() with a journal:  decreasing row, then as
+ *  TaskCompare(), so that rows are completed (and journaled) steadily
+ *  rather than all near the end.  */
+
+static int RowCompare( const void *p1, const void *p2 )
+  {
+  const PairTask *t1 = p1, *t2 = p2;
+
+  if( t1->row != t2->row ) return t2->row - t1->row;
+  return TaskCompare( p1, p2 );
+
+  }  /* end RowCompare */
+
+/***  NextTask.c  ************************************************************/
+
+/*  Get the next task for thread ID:  the most costly task of its own
+ *  deque, or else the least costly task of another deque.
+ *  Return 0 when all deques are empty.  */
+
+static int NextTask( ThreadPool *pool, int id, PairTask *task )
+  {
+  TaskDeque *dq = pool->deque + id;
+  int i, j;
+
+  if( pool->fatal ) return 0;
+  pthread_mutex_lock( &dq->lock );
+  if( dq->head < dq->tail )
+    {
+    *task = dq->task[dq->head++];
+    pthread_mutex_unlock( &dq->lock );
+    return 1;
+    }
+  pthread_mutex_unlock( &dq->lock );
+
+  for( j=1; j<pool->nThreads; j++ )   /* steal from other threads */
+    {
+    i = id + j;
+    if( i > pool->nThreads ) i -= pool->nThreads;
+    dq = pool->deque + i;
+    pthread_mutex_lock( &dq->lock );
+    if( dq->head < dq->tail )
+      {
+      *task = dq->task[--dq->tail];
+      pthread_mutex_unlock( &dq->lock );
+      return 1;
+      }
+    pthread_mutex_unlock( &dq->lock );
+    }
+
+  return 0;
+
+  }  /* end NextTask */
+
+/***  View3DThread.c  ********************************************************/
+
+/*  Pass 2 thread: compute view factors until no tasks remain.  */
+
+static void *View3DThread( void *arg )
+  {
+  ThreadData *td = arg;
+  ThreadPool *pool = td->pool;
+  View3DWork *work = &td->work;
+  PairTask task;
+  jmp_buf fatal;
+
+  ThreadGlobals( td );
+  if( setjmp( fatal ) )
+    pool->fatal = 1;   /* free memory below, then quit */
+  else
+    {
+    _fatalJmp = &fatal;
+    ViewsInit( 4, 1 );        /* thread-local integration data */
+    InitTmpVertMem();         /* thread-local polygon memory */
+    InitPolygonMem( 0, 0 );
+    }
+
+  while( NextTask( pool, td->id, &task ) )
+    {
+#ifdef LOGGING
+    pthread_mutex_lock( &pool->lock );
+    pool->nAFstart += 2.0 * (task.col2 - task.col1);
+    if( td->id == 1 )
+      fprintf( stderr, "\rSurface: %d; ~ %.1f %% complete", task.row,
+        100.0 * pool->nAFstart / pool->nAFtot );
+    pthread_mutex_unlock( &pool->lock );
+#endif
+    View3DPairs( work, task.row, task.col1, task.col2 );
+    if( work->journal )    /* journal the row after its last task */
+      {
+      pthread_mutex_lock( &pool->lock );
+      pool->rowLeft[task.row] -= task.col2 - task.col1;
+      if( pool->rowLeft[task.row] == 0 )
+        JournalRow( work->journal, work->AF, task.row );
+      pthread_mutex_unlock( &pool->lock );
+      }
+    }
+
+  _fatalJmp = NULL;
+  FreePolygonMem();
+  FreeTmpVertMem();
+  ViewsInit( 4, 0 );
+
+  return NULL;
+
+  }  /* end View3DThread */
+
+/***  ThreadGlobals.c  *******************************************************/
+
+/*  Set the thread-local globals of a new thread from those of the
+ *  thread which called View3DParallel().  */
+
+static void ThreadGlobals( ThreadData *td )
+  {
+  ThreadPool *pool = td->pool;
+
+  _ulog = pool->ulog;
+  _list = pool->list;
+  _maxNVT = pool->maxNVT;
+  InitViewMethod( &td->vfCtrl );
+
+  }  /* end ThreadGlobals */
+
+/***  ParallelFor.c  *********************************************************/
+
+/*  Call FUNC( ARG, i1, i2 ) for blocks of items i1 to i2 covering items
+ *  N1 through NN using NTHREADS threads.  FUNC must not write data
+ *  shared between blocks nor call error().  */
+
+void ParallelFor( int n1, int nn, int nThreads,
+  void (*func)( void *arg, int i1, int i2 ), void *arg )
+  {
+  ForPool pool;
+  pthread_t *tid;
+  int i;
+
+  if( nThreads > (nn - n1) / FORCHUNK + 1 )
+    nThreads = (nn - n1) / FORCHUNK + 1;
+  if( nThreads <= 1 )
+    {
+    if( nn >= n1 )
+      func( arg, n1, nn );
+    return;
+    }
+
+  pthread_mutex_init( &pool.lock, NULL );
+  pool.next = n1;
+  pool.nn = nn;
+  pool.func = func;
+  pool.arg = arg;
+  tid = Alc_V( 1, nThreads, sizeof(pthread_t), __FILE__, __LINE__ );
+  for( i=1; i<=nThreads; i++ )
+    if( pthread_create( tid+i, NULL, ForThread, &pool ) )
+      error( 3, __FILE__, __LINE__, "Failed to start thread ", IntStr(i), "" );
+  for( i=1; i<=nThreads; i++ )
+    pthread_join( tid[i], NULL );
+  Fre_V( tid, 1, nThreads, sizeof(pthread_t), __FILE__, __LINE__ );
+  pthread_mutex_destroy( &pool.lock );
+
+  }  /* end ParallelFor */
+
+/***  ForThread.c  ***********************************************************/
+
+static void *ForThread( void *arg )
+  {
+  ForPool *pool = arg;
+  int i1, i2;
+
+  for( ;; )
+    {
+    pthread_mutex_lock( &pool->lock );
+    i1 = pool->next;
+    pool->next += FORCHUNK;
+    pthread_mutex_unlock( &pool->lock );
+    if( i1 > pool->nn ) break;
+    i2 = i1 + FORCHUNK - 1;
+    if( i2 > pool->nn ) i2 = pool->nn;
+    pool->func( pool->arg, i1, i2 );
+    }
+
+  return NULL;
+
+  }  /* end ForThread */
@@ -0,0 +1,58 @@
+#ifndef V3D_VIEWMT_H
+#define V3D_VIEWMT_H
+
+#include "view3d.h"
+#include "journal.h"
+#include "bvh.h"
+#include "viewray.h"
+#include "viewfar.h"
+#include "viewunob.h"
+
+typedef struct{         /* working data for one View3D() thread */
+  SRFDAT3D *srf;        /* surface data; NrelS & MrelS are written */
+  const int *base;      /* base surface numbers */
+  const int *possibleObstr;  /* list of possible view obstructing surfaces */
+  int *maskSrf;         /* list of mask and null surfaces */
+  double **AF;          /* array of Area * F values */
+  View3DControlData *vfCtrl;  /* control values and per-pair surfaces */
+  int maxSrfT;          /* max number of participating (transformed) surfaces */
+  int *possibleObstrN;  /* list of possible obstructions rel. to N */
+  int nPossN;           /* number of possible obstructions rel. to N */
+  int rowN;             /* row N for possibleObstrN; 0 = none */
+  ObstrBVH *bvh;        /* hierarchy of possibleObstr; NULL = linear search */
+  int *markN;           /* markN[rank] = N if in possibleObstrN [1:nPossObstr] */
+  int *probableObstr;   /* list of probable obstructions */
+  RayScene *rays;       /* obstructions for engine=ray; NULL = not used */
+  FarField *far;        /* clusters for far=1; NULL = not used */
+  int *farN;            /* farN[m] = N if AF(N,M) by FarFieldAF() [1:nRadSrf] */
+  unsigned long nAF0,   /* number of AF which must equal 0 */
+     nAFnO,        /* number of AF without obstructing surfaces */
+     nAFwO,        /* number of AF with obstructing surfaces */
+     nAFff,        /* number of AF by far-field estimates */
+     nAF32,        /* number of AF accepted in single precision */
+     nAF32d,       /* number of single precision AF redone in double */
+     nObstr,       /* total number of obstructions considered */
+     nAFsb,        /* number of AF blocked by the shaft test */
+     nAFrp,        /* number of ray AF redone by projection */
+     nShaftOut;    /* number of obstructions outside the shaft */
+  unsigned **bins;      /* for statistical summary */
+  V3DJournal *journal;  /* checkpoint journal; NULL = none */
+  UnobPair *batch;      /* unobstructed 2AI pairs of View3DPairs() [0:UNOBBATCH-1] */
+  int nBatch;           /* number of pairs in batch */
+  int batching;         /* 1 = View3DPair() may add to batch */
+} View3DWork;
+
+#define UNOBBATCH 256   /* max pairs per ViewUnobBatch() call */
+
+void View3DWorkInit( View3DWork *work );
+void View3DWorkFree( View3DWork *work );
+void View3DRow( View3DWork *work, int n );
+void View3DPair( View3DWork *work, int n, int m );
+void View3DPairs( View3DWork *work, int n, int m1, int m2 );
+double View3DPairCost( View3DWork *work, int n, int m );
+void View3DParallel( View3DWork *work, int n1, int nn );
+void InitViewMethod( View3DControlData *vfCtrl );
+void ParallelFor( int n1, int nn, int nThreads,
+  void (*func)( void *arg, int i1, int i2 ), void *arg );
+
+#endif
@@ -20,64 +20,142 @@
 #include "polygn.h"
 #include "test3d.h"
 #include "viewunob.h"
+#include "viewvec.h"
 
      /* local functions */
 void SubsrfRS( int n, Vec3 v[], Vec3 s[] );
 void SubsrfTS( int n, Vec3 v[], Vec3 s[] );
 
-extern FILE *_ulog; /* written output file */
+extern V3D_TLS FILE *_ulog; /* written output file */
 
 #define PId2     1.570796326794896619   /* pi / 2 */
 #define PIt2inv  0.159154943091895346   /* 1 / (2 * pi) */
+#define V1AICHUNK (8*V1AIBLOCK)  /* edges per call of V1AIsum() */
 
 /* forward decls */
+#if( DEBUG > 1 )
 static double V1AIpart( const int nv, const Vec3 p2[],
             const Vec3 *p1, const DirCos *u1 );
+#endif
+static double V1AIedges( const int ne, const Vec2 ends[],
+            const Vec3 *p1, const DirCos *u1 );
+static int AdaptEval( AdaptElem *e, View3DControlData *vfCtrl );
+static void AdaptSplit( AdaptElem *e, int k, AdaptElem *c );
+static void AdaptUp( AdaptElem heap[], int j );
+static void AdaptDown( AdaptElem heap[], int n, int j );
 
 /* NOT DEFINED: static void substs( int n, Vec3 v[], Vec3 s[] ); */
 
-/***  ViewObstructed.c  ******************************************************/
+/***  ProjectSet.c  **********************************************************/
+
+/*  For the block of SETLANES obstructions of SET starting at J compute
+ *  the plane test of view point VP, the test for vertices above the
+ *  clip height HC, the projection of the vertices from VP to the z=0
+ *  plane, and the position of the projection relative to the limits
+ *  LIM (xmin, xmax, ymin, ymax):  inside, where LimitPolygon() would
+ *  not change it, or outside one limit, where LimitPolygon() would
+ *  return 0.  The inner loops run across the block so that the
+ *  compiler can vectorize them; the results are identical to the
+ *  computations on one obstruction at a time.  The blocks are done
+ *  one at a time because the view is often totally obstructed by
+ *  the first few obstructions.  */
+
+static void ProjectSet( SRFSET3X *set, int j, const Vec3 *vp, double hc,
+  const double lim[4] )
+  {
+  double x=vp->x, y=vp->y, z=vp->z;
+  double a[SETLANES], b[SETLANES];
+  double x0[SETLANES], x1[SETLANES], y0[SETLANES], y1[SETLANES];
+  int c[SETLANES];
+  int i, k;
 
-/*  Compute view factor (AF), with view obstructions
- *  by computing views to unshaded polygons.  */
+  for( i=0; i<SETLANES; i++ )
+    {
+    a[i] = set->dw[j+i] + (x * set->dx[j+i] + y * set->dy[j+i] + z * set->dz[j+i]);
+    c[i] = set->zmax[j+i] > hc;
+    }
+  for( k=i=0; i<SETLANES; i++ )
+    {
+    set->dot[j+i] = a[i];
+    set->clip[j+i] = c[i];
+    k |= a[i] < 0.0 && !c[i];
+    }
+  if( !k ) return;    /* no obstruction needs the projection */
 
-double ViewObstructed( View3DControlData *vfCtrl, int nv1, Vec3 v1[], double area, int nDiv )
-/* nv1  - number of vertices of surface 1.
- * v1   - vertices of surface 1.
- * area - area of surface 1.
- * nDiv - division factor, 3 or 4. */
+  for( k=0; k<set->maxNv; k++ )
+    {
+    double *vx=set->vx[k]+j, *vy=set->vy[k]+j, *vz=set->vz[k]+j;
+    double *px=set->px[k]+j, *py=set->py[k]+j;
+    for( i=0; i<SETLANES; i++ )
+      {
+      double temp = z / (z - vz[i]);  /* projection factor */
+      a[i] = x - temp * (x - vx[i]);
+      b[i] = y - temp * (y - vy[i]);
+      }
+    if( k == 0 )
+      for( i=0; i<SETLANES; i++ )
+        {
+        x0[i] = x1[i] = a[i];
+        y0[i] = y1[i] = b[i];
+        }
+    else
+      for( i=0; i<SETLANES; i++ )
+        {
+        x0[i] = a[i] < x0[i] ? a[i] : x0[i];
+        x1[i] = a[i] > x1[i] ? a[i] : x1[i];
+        y0[i] = b[i] < y0[i] ? b[i] : y0[i];
+        y1[i] = b[i] > y1[i] ? b[i] : y1[i];
+        }
+    for( i=0; i<SETLANES; i++ )
+      {
+      px[i] = a[i];
+      py[i] = b[i];
+      }
+    }
+
+  for( i=0; i<SETLANES; i++ )
+    c[i] = (x0[i] >= lim[0] && x1[i] <= lim[1] && y0[i] >= lim[2] && y1[i] <= lim[3])
+      - (x0[i] > lim[1] || x1[i] < lim[0] || y0[i] > lim[3] || y1[i] < lim[2]);
+  for( i=0; i<SETLANES; i++ )
+    set->limit[j+i] = c[i];
+
+  }  /*  end of ProjectSet  */
+
+/***  ViewPoints.c  **********************************************************/
+
+/*  Compute the view factors, DFV, from each of NVPT view points to
+ *  the unshaded polygons of surface 2.  */
+
+static void ViewPoints( View3DControlData *vfCtrl, int nvpt, Vec3 vpt[], double dFp[] )
+/* nvpt - number of view points.
+ * vpt  - coordinates of view points.
+ * dFp  - F from each view point to all unshaded areas (output). */
   {
   Polygon *pp;     /* pointer to a polygon */
   Polygon *shade;  /* pointer to the obstruction shadow polygon */
   Polygon *stack;  /* pointer to stack of unobstructed polygons */
   Polygon *next;   /* pointer to next unobstructed polygons */
-  double dF,   /* F from a view point to an unshaded area */
-    dFv,   /* F from a view point to all unshaded areas */
-    AFu;   /* AF from all view points to all unshaded areas */
+  Polygon *base;   /* pointer to surface 2 polygon; union of shadows */
+  Vec2 *ends;      /* ends of unshaded edges; union of shadows */
+  int nShade;      /* number of shadows; union of shadows */
+  double dFv;  /* F from a view point to all unshaded areas */
+  double ax[V1AICHUNK], ay[V1AICHUNK], /* unshaded polygon edges */
+    bx[V1AICHUNK], by[V1AICHUNK];      /*   relative to view point */
   Vec3 v2[MAXNV2]; /* 3D vertices: obstruction */
   Vec3 *pv2; /* clipped obstruction */
   Vec2 vs[MAXNV2], vb[MAXNV1]; /* 2D vertices: shadow and base surface (2) */
   SRFDAT3X *srfT;  /* pointer to surface */
+  SRFSET3X *set = vfCtrl->setOT;  /* obstructions; structure of arrays */
   DirCos *dc1;  /* pointer to direction cosines of surface 1 */
   double xmin, xmax, ymin, ymax; /* clipping limits */
-  int clip; /* if true, clip to prevent upward projection */
+  double lim[4];  /* clipping limits for ProjectSet() */
   double epsDist, epsArea;
   double hc, zc[MAXNV1];  /* surface clipping test values */
-  Vec3 vpt[16];  /* vertices of view points */
-  double weight[16];     /* integration weighting factors */
-  int nvpt; /* number of view points */
   int np;   /* view point number */
-  int nv2, nvs, nvb;
+  int nvs, nvb;
+  int ne;   /* number of edges in ax, ay, bx, by */
   int j, k, n;
 
-#if( DEBUG > 1 )
-  fprintf( _ulog, "ViewObstructed:\n" );
-#endif
-#if( DEBUG > 2  )
-  for( j=0; j<nv1; j++ )
-    if( v1[j].z <=0 ) ;
-#endif
-
   dc1 = &vfCtrl->srf1T.dc;
   srfT = &vfCtrl->srf2T;
   nvb = srfT->nv;
@@ -101,13 +179,15 @@ double ViewObstructed( View3DControlData *vfCtrl, int nv1, Vec3 v1[], double are
 #endif
   epsDist = 1.0e-6 * sqrt( (xmax-xmin)*(xmax-xmin) + (ymax-ymin)*(ymax-ymin) );
   epsArea = 1.0e-6 * srfT->area;
-
-        /* determine Gaussian weights and view points of polygon 1 */
-  nvpt = SubSrf( nDiv, nv1, v1, area, vpt, weight );
+  lim[0] = xmin;
+  lim[1] = xmax;
+  lim[2] = ymin;
+  lim[3] = ymax;
 
         /* compute obstructed view from each view point of polygon 1 */
-  for( AFu=0.0,np=0; np<nvpt; np++ )        /* begin view points loop */
+  for( np=0; np<nvpt; np++ )        /* begin view points loop */
     {
+    dFp[np] = 0.0;
     hc = 0.9999f * vpt[np].z;
 #if( DEBUG > 1 )
     fprintf( _ulog, "view point: %f %f %f\n", vpt[np].x, vpt[np].y, vpt[np].z );
@@ -116,29 +196,30 @@ double ViewObstructed( View3DControlData *vfCtrl, int nv1, Vec3 v1[], double are
 #endif
         /* begin with cleared small structures area - memBlock */
     InitPolygonMem( epsDist, epsArea );
-    stack = SetPolygonHC( nvb, vb, 1.0 );  /* convert surface 2 to HC */
+    base = stack = SetPolygonHC( nvb, vb, 1.0 );  /* convert surface 2 to HC */
 #if( DEBUG > 1 )
     DumpHC( "BASE SURFACE:", stack, NULL );
 #endif
+    nShade = 0;
+    if( vfCtrl->unite )   /* stack the shadows */
+      NewPolygonStack( );
 
         /* project shadow of each view obstructing surface */
     srfT = vfCtrl->srfOT;
     for( dFv=0.0,j=0; j<vfCtrl->nProbObstr; j++,srfT++ )
       {                        /* CTD must be behind surface */
-      double dot = VDOTW ( (vpt+np), (&srfT->dc) );
+      if( j % SETLANES == 0 )
+        ProjectSet( set, j, vpt+np, hc, lim );
 #if( DEBUG > 1 )
-      fprintf( _ulog, "Surface %d;  dot %f\n", srfT->nr, dot );
+      fprintf( _ulog, "Surface %d;  dot %f\n", srfT->nr, set->dot[j] );
       fflush( _ulog );
 #endif
-      if( dot >= 0.0 ) continue;      /* no shadow polygon created */
+      if( set->dot[j] >= 0.0 ) continue;      /* no shadow polygon created */
       nvs = srfT->nv;
-      for( clip=n=0; n<nvs; n++ )
-        {
-        zc[n] = srfT->v[n].z - hc;
-        if( zc[n] > 0.0 ) clip = 1;
-        }
-      if( clip )        /* clip to prevent upward projection */
+      if( set->clip[j] )        /* clip to prevent upward projection */
         {
+        for( n=0; n<nvs; n++ )
+          zc[n] = srfT->v[n].z - hc;
 #if( DEBUG > 1 )
         fprintf( _ulog, "Clip M;  zc: %g %g %g %g\n",
           zc[0], zc[1], zc[2], zc[3] );
@@ -153,23 +234,30 @@ double ViewObstructed( View3DControlData *vfCtrl, int nv1, Vec3 v1[], double are
 #if( DEBUG > 1 )
         DumpP3D( "Clipped surface:", nvs, pv2 );
 #endif
-        }
-      else
-        pv2 = (void *)&srfT->v;
-
               /* project obstruction from centroid to z=0 plane */
-      for( n=0; n<nvs; n++,pv2++ )
+        for( n=0; n<nvs; n++,pv2++ )
+          {
+          double temp = vpt[np].z / (vpt[np].z - pv2->z);  /* projection factor */
+          vs[n].x = vpt[np].x - temp * (vpt[np].x - pv2->x);
+          vs[n].y = vpt[np].y - temp * (vpt[np].y - pv2->y);
+          }
+        }
+      else              /* projected by ProjectSet() */
         {
-        double temp = vpt[np].z / (vpt[np].z - pv2->z);  /* projection factor */
-        vs[n].x = vpt[np].x - temp * (vpt[np].x - pv2->x);
-        vs[n].y = vpt[np].y - temp * (vpt[np].y - pv2->y);
+        if( set->limit[j] < 0 ) continue;     /* no shadow polygon created */
+        for( n=0; n<nvs; n++ )
+          {
+          vs[n].x = set->px[n][j];
+          vs[n].y = set->py[n][j];
+          }
         }
               /* limit projected surface; avoid some HC problems */
 #if( DEBUG > 0 )
         if( nvs >= MAXNV2 || nvs < 0 ) errorf( 3, __FILE__, __LINE__,
           "Invalid number of vertices: ", IntStr(nvs), "" );
 #endif
-      nvs = LimitPolygon( nvs, vs, xmax, xmin, ymax, ymin );
+      if( set->clip[j] || !set->limit[j] )
+        nvs = LimitPolygon( nvs, vs, xmax, xmin, ymax, ymin );
       if( nvs < 3 ) continue;                  /* no shadow polygon created */
 #if( DEBUG > 0 )
              /* bounds check on projected surface */
@@ -184,6 +272,20 @@ double ViewObstructed( View3DControlData *vfCtrl, int nv1, Vec3 v1[], double are
         "Projected surface too large", "" );
       }
 #endif
+      if( vfCtrl->unite )   /* save shadow for the union */
+        {
+        shade = SetPolygonHC( nvs, vs, 0.0 );
+        if( !shade ) continue;
+        nShade += 1;
+        if( PolygonEncloses( shade, base ) ||     /* check the union */
+          ( nShade > 1 && (nShade & (nShade-1)) == 0 &&  /* at 2, 4, 8, ... */
+            UnshadedEdges( base, shade, &ends ) == 0 ) )
+          {
+          stack = NULL;              /* polygon 2 is totally obstructed. */
+          break;
+          }
+        continue;
+        }
       NewPolygonStack( );
       shade = SetPolygonHC( nvs, vs, 0.0 );
       if( shade )
@@ -216,47 +318,109 @@ double ViewObstructed( View3DControlData *vfCtrl, int nv1, Vec3 v1[], double are
       }  /* end of obstruction surfaces (J) loop */
     if( stack == NULL ) continue;
 
-        /* compute interchange area to each unshaded polygon */
+    if( vfCtrl->unite )   /* view to base less the union of shadows */
+      {
+      n = UnshadedEdges( base, TopOfPolygonStack(), &ends );
+      vfCtrl->totVpt += 1;
+      vfCtrl->totPoly += 1;
+      dFv = V1AIedges( n, ends, vpt+np, dc1 );
+      if( dFv < 0.0 )
+        {
+#if( DEBUG > 0 )
+        if( dFv < -1.0e-16 )
+          errorf( 1, __FILE__, __LINE__,
+            "Negative F (", FltStr(dFv,4), ") set to 0", "" );
+#endif
+        dFv = 0.0;
+        }
+      dFp[np] = dFv;
+      continue;
+      }
+
+        /* compute interchange area to the unshaded polygons;  their
+         * edges are gathered in chunks for the vector kernel */
     vfCtrl->totVpt += 1;
+    ne = 0;
     for( pp=stack; pp; pp=pp->next )
       {
       vfCtrl->totPoly += 1;
-      nv2 = GetPolygonVrt3D( pp, v2 );
 #if( DEBUG > 1 )
+      {
+      int nv2 = GetPolygonVrt3D( pp, v2 );
       DumpP3D( "Unshaded surface:", nv2, v2 );
+      fprintf( _ulog, " Partial view factor: %g\n",
+        V1AIpart( nv2, v2, vpt+np, dc1 ) );
+      }
 #endif
-      dF = V1AIpart( nv2, v2, vpt+np, dc1 );
-#if( DEBUG > 1 )
-      fprintf( _ulog, " Partial view factor: %g\n", dF );
-#endif
-#if( DEBUG > 0 )
-      if( dF < 0.0 )
+      for( k=0; k<pp->nVE; k+=n )
         {
-        if( dF < -1.0e-16 )
+        n = pp->nVE - k;
+        if( n > V1AICHUNK - ne ) n = V1AICHUNK - ne;
+        ne += GetPolygonEdges( pp, k, n, vpt[np].x, vpt[np].y,
+          ax+ne, ay+ne, bx+ne, by+ne );
+        if( ne == V1AICHUNK )
           {
-          errorf( 1, __FILE__, __LINE__,
-            "Negative F (", FltStr(dF,4), ") set to 0", "" );
-# if( DEBUG > 0 )     /* normally 1 */
-          DumpHC( " Polygon", pp, pp );
-          fprintf( _ulog, " View point: (%g, %g, %g)\n", vpt[np].x, vpt[np].y, vpt[np].z );
-          fprintf( _ulog, " Direction: (%g, %g, %g)\n", dc1->x, dc1->y, dc1->z );
-          V1AIpart( nv2, v2, vpt+np, dc1 );
-          fflush( _ulog );
-# endif
+          dFv += V1AIsum( ne, ax, ay, bx, by, -vpt[np].z, dc1 );
+          ne = 0;
           }
-        dF = 0.0;
+        }
+      }
+    if( ne > 0 )
+      dFv += V1AIsum( ne, ax, ay, bx, by, -vpt[np].z, dc1 );
+    if( dFv < 0.0 )
+      {
+#if( DEBUG > 0 )
+      if( dFv < -1.0e-16 )
+        {
+        errorf( 1, __FILE__, __LINE__,
+          "Negative F (", FltStr(dFv,4), ") set to 0", "" );
+        DumpHC( " Polygons", stack, NULL );
+        fprintf( _ulog, " View point: (%g, %g, %g)\n", vpt[np].x, vpt[np].y, vpt[np].z );
+        fprintf( _ulog, " Direction: (%g, %g, %g)\n", dc1->x, dc1->y, dc1->z );
+        fflush( _ulog );
         }
 #endif
-      dFv += dF;
+      dFv = 0.0;
       }
 
 #if( DEBUG > 1 )
     fprintf( _ulog, " SS: x %f, y %f, z %f, dFv %g\n",
       vpt[np].x, vpt[np].y, vpt[np].z, dFv );
 #endif
-    AFu += dFv * weight[np];
+    dFp[np] = dFv;
     }  /* end of view points (np) loop */
 
+  }  /*  end of ViewPoints  */
+
+/***  ViewObstructed.c  ******************************************************/
+
+/*  Compute view factor (AF), with view obstructions
+ *  by computing views to unshaded polygons.  */
+
+double ViewObstructed( View3DControlData *vfCtrl, int nv1, Vec3 v1[], double area, int nDiv )
+/* nv1  - number of vertices of surface 1.
+ * v1   - vertices of surface 1.
+ * area - area of surface 1.
+ * nDiv - division factor, 3 or 4. */
+  {
+  double AFu;   /* AF from all view points to all unshaded areas */
+  Vec3 vpt[16];  /* vertices of view points */
+  double weight[16];     /* integration weighting factors */
+  double dFv[16];   /* F from each view point to all unshaded areas */
+  int nvpt; /* number of view points */
+  int np;   /* view point number */
+
+#if( DEBUG > 1 )
+  fprintf( _ulog, "ViewObstructed:\n" );
+#endif
+        /* determine Gaussian weights and view points of polygon 1 */
+  nvpt = SubSrf( nDiv, nv1, v1, area, vpt, weight );
+
+        /* compute obstructed view from each view point of polygon 1 */
+  ViewPoints( vfCtrl, nvpt, vpt, dFv );
+  for( AFu=0.0,np=0; np<nvpt; np++ )
+    AFu += dFv[np] * weight[np];
+
 #if( DEBUG > 0 )
   if( AFu < 0.0 )  // due to negative weight; enly np=0
     {
@@ -276,6 +440,54 @@ double ViewObstructed( View3DControlData *vfCtrl, int nv1, Vec3 v1[], double are
 
   }  /*  end of ViewObstructed  */
 
+/***  ViewObstructedE.c  *****************************************************/
+
+/*  Compute view factor (AF), with view obstructions, by an embedded
+ *  rule:  the high and low order estimates of AF use the same view
+ *  points, so no view is computed twice.  Return the high order AF
+ *  and set *AFLO to the low order AF, or to the check AF if that is
+ *  farther from the high order AF.  */
+
+double ViewObstructedE( View3DControlData *vfCtrl, int nv1, Vec3 v1[], double area, double *AFlo )
+/* nv1  - number of vertices of surface 1, 3 or 4.
+ * v1   - vertices of surface 1.
+ * area - area of surface 1.
+ * AFlo - low order AF (output). */
+  {
+  double AFhi,  /* high order AF */
+    AFchk;      /* check AF */
+  Vec3 vpt[MAXEMB];  /* vertices of view points */
+  double wHi[MAXEMB], wLo[MAXEMB], wChk[MAXEMB];  /* weights */
+  double dFv[MAXEMB];   /* F from each view point to all unshaded areas */
+  int nvpt; /* number of view points */
+  int np;   /* view point number */
+
+  nvpt = SubSrfE( nv1, v1, area, vpt, wHi, wLo, wChk );
+  ViewPoints( vfCtrl, nvpt, vpt, dFv );
+  for( AFhi=*AFlo=AFchk=0.0,np=0; np<nvpt; np++ )
+    {
+    AFhi += dFv[np] * wHi[np];
+    *AFlo += dFv[np] * wLo[np];
+    AFchk += dFv[np] * wChk[np];
+    }
+  if( fabs(AFchk - AFhi) > fabs(*AFlo - AFhi) )
+    *AFlo = AFchk;
+
+  if( AFhi < 0.0 )      /* due to negative weights */
+    AFhi = 0.0;
+  if( *AFlo < 0.0 )
+    *AFlo = 0.0;
+
+#if( DEBUG > 1 )
+  fprintf( _ulog, "v_obst_e AF:  %g %g\n", AFhi, *AFlo );
+  fflush( _ulog );
+#endif
+
+  return AFhi;
+
+  }  /*  end of ViewObstructedE  */
+
+#if( DEBUG > 1 )
 /***  V1AIpart.c  ************************************************************/
 
 /*  Compute the radiation shape factor between infinitesimal surface
@@ -330,23 +542,53 @@ double V1AIpart( const int nv, const Vec3 p2[],
   return sum;
 
   }  /* end of V1AIpart */
+#endif
 
-/***  View1AI.c  *************************************************************/
+/***  V1AIedges.c  ************************************************************/
 
-/*  Estimate direct interchange area by single area integration.
- *  Surface 1 described by its direction cosines and NSS vertices
- *  and associated areas for numerical (Gaussian) integration.  */
+/*  Compute the radiation shape factor between infinitesimal surface
+ *  P1 and the z=0 plane region bounded by NE directed edges by the
+ *  contour integral method of V1AIpart().  The edges need not be
+ *  joined into contours;  each edge contributes independently.  */
 
-double View1AI( int nss, Vec3 *p1, double *area1, DirCos *dc1, SRFDAT3X *srf2 )
+static double V1AIedges( const int ne, const Vec2 ends[],
+           const Vec3 *p1, const DirCos *u1 )
+/*  ne   number of edges
+ *  ends coordinates of the start and end of each edge
+ *  p1   coordinates of surface (point) P1
+ *  u1   components of unit vector normal to surface P1 */
   {
-  int j;
-  double sum=0.0;
+  double ax[V1AICHUNK], ay[V1AICHUNK], bx[V1AICHUNK], by[V1AICHUNK];
+  double sum=0; /* sum of line integrals */
+  int n, k;  /* edge numbers */
 
-  for( j=0; j<nss; j++ )
-    sum += area1[j] * V1AIpart( srf2->nv, srf2->v, p1+j, dc1 );
+  for( n=0; n<ne; n+=k )   /* edges in chunks for V1AIsum() */
+    {
+    for( k=0; k<V1AICHUNK && n+k<ne; k++ )
+      {
+      ax[k] = ends[2*(n+k)].x - p1->x;
+      ay[k] = ends[2*(n+k)].y - p1->y;
+      bx[k] = ends[2*(n+k)+1].x - p1->x;
+      by[k] = ends[2*(n+k)+1].y - p1->y;
+      }
+    sum += V1AIsum( k, ax, ay, bx, by, -p1->z, u1 );
+    }
 
   return sum;
 
+  }  /* end of V1AIedges */
+
+/***  View1AI.c  *************************************************************/
+
+/*  Estimate direct interchange area by single area integration.
+ *  Surface 1 described by its direction cosines and NSS Gaussian points
+ *  (X, Y, Z) and associated areas for numerical integration.  */
+
+double View1AI( int nss, const double *x, const double *y, const double *z,
+  const double *area1, DirCos *dc1, SRFDAT3X *srf2 )
+  {
+  return V1AIarea( nss, x, y, z, area1, dc1, srf2->nv, srf2->v );
+
   }  /* end View1AI */
 
 /***  Subsurface.c  **********************************************************/
@@ -661,8 +903,13 @@ double ViewTP( Vec3 v1[], double area, int level, View3DControlData *vfCtrl )
 
   if( level >= vfCtrl->minRecursion )
     {
-    AF7 = ViewObstructed( vfCtrl, 3, v1, area, 3 );
-    AF13 = ViewObstructed( vfCtrl, 3, v1, area, 4 );
+    if( vfCtrl->nest )  /* embedded 19-point rule */
+      AF13 = ViewObstructedE( vfCtrl, 3, v1, area, &AF7 );
+    else
+      {
+      AF7 = ViewObstructed( vfCtrl, 3, v1, area, 3 );
+      AF13 = ViewObstructed( vfCtrl, 3, v1, area, 4 );
+      }
     }
   else
     {
@@ -681,11 +928,21 @@ double ViewTP( Vec3 v1[], double area, int level, View3DControlData *vfCtrl )
 
   if( level >= vfCtrl->minRecursion )
     {
-    vfCtrl->wastedVObs += 7;
-    if( cnvg )
-      vfCtrl->usedVObs += 13;
+    if( vfCtrl->nest )
+      {
+      if( cnvg )
+        vfCtrl->usedVObs += 19;
+      else
+        vfCtrl->wastedVObs += 19;
+      }
     else
-      vfCtrl->wastedVObs += 13;
+      {
+      vfCtrl->wastedVObs += 7;
+      if( cnvg )
+        vfCtrl->usedVObs += 13;
+      else
+        vfCtrl->wastedVObs += 13;
+      }
     }
 
   if( cnvg )      /* AF7 and AF13 are similar; */
@@ -740,8 +997,13 @@ double ViewRP( Vec3 v1[], double area, int level, View3DControlData *vfCtrl )
 
   if( level >= vfCtrl->minRecursion )
     {
-    AF9 = ViewObstructed( vfCtrl, 4, v1, area, 3 );
-    AF16 = ViewObstructed( vfCtrl, 4, v1, area, 4 );
+    if( vfCtrl->nest )  /* embedded 17-point rule */
+      AF16 = ViewObstructedE( vfCtrl, 4, v1, area, &AF9 );
+    else
+      {
+      AF9 = ViewObstructed( vfCtrl, 4, v1, area, 3 );
+      AF16 = ViewObstructed( vfCtrl, 4, v1, area, 4 );
+      }
     }
   else
     {
@@ -760,11 +1022,21 @@ double ViewRP( Vec3 v1[], double area, int level, View3DControlData *vfCtrl )
 
   if( level >= vfCtrl->minRecursion )
     {
-    vfCtrl->wastedVObs += 9;
-    if( cnvg )
-      vfCtrl->usedVObs += 16;
+    if( vfCtrl->nest )
+      {
+      if( cnvg )
+        vfCtrl->usedVObs += 17;
+      else
+        vfCtrl->wastedVObs += 17;
+      }
     else
-      vfCtrl->wastedVObs += 16;
+      {
+      vfCtrl->wastedVObs += 9;
+      if( cnvg )
+        vfCtrl->usedVObs += 16;
+      else
+        vfCtrl->wastedVObs += 16;
+      }
     }
 
   if( cnvg )      /* AF9 and AF16 are similar; */
@@ -784,3 +1056,163 @@ double ViewRP( Vec3 v1[], double area, int level, View3DControlData *vfCtrl )
 
   }  /* end ViewRP */
 
+
+/***  AdaptEval.c  ***********************************************************/
+
+/*  Set the AF and error estimate of element E by the rules of ViewTP()
+ *  and ViewRP().  Return the number of high order view points.  */
+
+static int AdaptEval( AdaptElem *e, View3DControlData *vfCtrl )
+  {
+  double AFlo;  /* low order AF */
+  int nHi;      /* number of high order view points */
+
+  if( vfCtrl->nest )  /* embedded 19- or 17-point rule */
+    {
+    e->AF = ViewObstructedE( vfCtrl, e->nv, e->v, e->area, &AFlo );
+    nHi = e->nv == 3 ? 19 : 17;
+    }
+  else
+    {
+    AFlo = ViewObstructed( vfCtrl, e->nv, e->v, e->area, 3 );
+    e->AF = ViewObstructed( vfCtrl, e->nv, e->v, e->area, 4 );
+    vfCtrl->wastedVObs += e->nv == 3 ? 7 : 9;
+    nHi = e->nv == 3 ? 13 : 16;
+    }
+  e->err = fabs( e->AF - AFlo );
+  vfCtrl->usedVObs += nHi;
+
+  return nHi;
+
+  }  /* end AdaptEval */
+
+/***  AdaptSplit.c  **********************************************************/
+
+/*  Set child K (0 to 3) of element E in C.  */
+
+static void AdaptSplit( AdaptElem *e, int k, AdaptElem *c )
+  {
+  if( e->nv == 3 )
+    SubsrfTS( k, e->v, c->v );
+  else
+    SubsrfRS( k, e->v, c->v );
+  c->nv = e->nv;
+  c->area = 0.25 * e->area;
+
+  }  /* end AdaptSplit */
+
+/***  ViewAdaptive.c  ********************************************************/
+
+/*  Compute the view from the NSUBSRF subsurfaces of surface 1 by global
+ *  adaptive integration (adapt=1).  Each element keeps the AF and error
+ *  estimate of ViewTP() / ViewRP(), and the element with the largest
+ *  error is divided in four until the sum of the errors is less than
+ *  vfCtrl->epsAF.  The number of element integrations is limited by
+ *  vfCtrl->budget instead of a recursion level;  failRecursion is set
+ *  if the budget ends first.  Elements are kept in a binary heap on
+ *  their errors in vfCtrl->adaptElem.  */
+
+double ViewAdaptive( SRFDAT3X subs[], int nSubSrf, View3DControlData *vfCtrl )
+  {
+  AdaptElem *heap = vfCtrl->adaptElem;
+  double AF, err;
+  int nElem, nEval;  /* numbers of elements and integrations */
+  int nHi=0;         /* high order view points per element */
+  int level, j, k;
+
+  for( nElem=j=0; j<nSubSrf; j++ )
+    {
+    AdaptElem *e = heap + nElem++;
+    memcpy( e->v, subs[j].v, subs[j].nv*sizeof(Vec3) );
+    e->nv = subs[j].nv;
+    e->area = subs[j].area;
+    }
+  for( level=0; level<vfCtrl->minRecursion && 4*nElem<=ADAPTINIT; level++ )
+    for( j=nElem-1; j>=0; j-- )    /* divide without integrating */
+      {
+      AdaptElem e = heap[j];
+      for( k=0; k<4; k++ )
+        AdaptSplit( &e, k, heap + (k ? nElem++ : j) );
+      }
+
+  for( AF=err=0.0,j=0; j<nElem; j++ )
+    {
+    AdaptEval( heap + j, vfCtrl );
+    AF += heap[j].AF;
+    err += heap[j].err;
+    }
+  nEval = nElem;
+  for( j=nElem/2-1; j>=0; j-- )    /* form the heap */
+    AdaptDown( heap, nElem, j );
+
+  while( err >= vfCtrl->epsAF )
+    {
+    AdaptElem e = heap[0];         /* element with the largest error */
+    if( nEval + 4 > vfCtrl->budget )
+      {
+      vfCtrl->failRecursion = 1;
+      break;
+      }
+    AF -= e.AF;
+    err -= e.err;
+    heap[0] = heap[--nElem];
+    AdaptDown( heap, nElem, 0 );
+    for( k=0; k<4; k++ )
+      {
+      AdaptElem *c = heap + nElem;
+      AdaptSplit( &e, k, c );
+      nHi = AdaptEval( c, vfCtrl );
+      AF += c->AF;
+      err += c->err;
+      AdaptUp( heap, nElem++ );
+      }
+    nEval += 4;
+    vfCtrl->usedVObs -= nHi;       /* the divided element is wasted */
+    vfCtrl->wastedVObs += nHi;
+    }
+
+  for( AF=0.0,j=0; j<nElem; j++ )  /* sum again without round-off */
+    AF += heap[j].AF;
+
+  return AF;
+
+  }  /* end ViewAdaptive */
+
+/***  AdaptUp.c  *************************************************************/
+
+/*  Move element J of the heap up to its place.  */
+
+static void AdaptUp( AdaptElem heap[], int j )
+  {
+  AdaptElem e = heap[j];
+
+  while( j > 0 && heap[(j-1)/2].err < e.err )
+    {
+    heap[j] = heap[(j-1)/2];
+    j = (j - 1) / 2;
+    }
+  heap[j] = e;
+
+  }  /* end AdaptUp */
+
+/***  AdaptDown.c  ***********************************************************/
+
+/*  Move element J of the N element heap down to its place.  */
+
+static void AdaptDown( AdaptElem heap[], int n, int j )
+  {
+  AdaptElem e = heap[j];
+  int c;
+
+  while( (c = 2 * j + 1) < n )
+    {
+    if( c + 1 < n && heap[c+1].err > heap[c].err )
+      c++;
+    if( heap[c].err <= e.err )
+      break;
+    heap[j] = heap[c];
+    j = c;
+    }
+  heap[j] = e;
+
+  }  /* end AdaptDown */
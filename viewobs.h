@@ -4,12 +4,25 @@
 #include "view3d.h"
 
 double ViewObstructed( View3DControlData *vfCtrl, int nv1, Vec3 v1[], double area, int nDiv );
-double View1AI( int nss, Vec3 *p1, double *area1, DirCos *dc1, SRFDAT3X *srf2 );
+double ViewObstructedE( View3DControlData *vfCtrl, int nv1, Vec3 v1[], double area, double *AFlo );
+double View1AI( int nss, const double *x, const double *y, const double *z,
+  const double *area1, DirCos *dc1, SRFDAT3X *srf2 );
 int Subsurface( SRFDAT3X *srf, SRFDAT3X sub[] );
 double SetCentroid( const int nv, Vec3 *vs, Vec3 *ctd );
 double Triangle( Vec3 *p1, Vec3 *p2, Vec3 *p3, void *dc, int dcflag );
 double ViewTP( Vec3 v1[], double area, int level, View3DControlData *vfCtrl );
 double ViewRP( Vec3 v1[], double area, int level, View3DControlData *vfCtrl );
+double ViewAdaptive( SRFDAT3X subs[], int nSubSrf, View3DControlData *vfCtrl );
+
+#define ADAPTINIT 80  /* max elements before refinement: 5 * 4^2 */
+
+typedef struct adaptelem{  /* element of the global adaptive integration */
+  Vec3 v[4];            /* vertices */
+  int nv;               /* number of vertices, 3 or 4 */
+  double area;          /* area */
+  double AF;            /* high order AF */
+  double err;           /* |high - low order AF| */
+} AdaptElem;
 
 #endif
 
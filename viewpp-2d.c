@@ -16,8 +16,8 @@
 #include "prtyp.h" 
 #include "view2d.h"
 
-extern FILE *_ulog; /* log file */
-extern IX _list;    /* output control, higher value = more output */
+extern V3D_TLS FILE *_ulog; /* log file */
+extern V3D_TLS IX _list;    /* output control, higher value = more output */
 
 void LUFactorSymm( const IX neq, R8 **a );
 void LUSolveSymm( const IX neq, R8 **a, R8 *b );
@@ -20,8 +20,8 @@
 #include "misc.h"
 #include "heap.h"
 
-extern FILE *_ulog; /* log file */
-extern int _list;    /* output control, higher value = more output */
+extern V3D_TLS FILE *_ulog; /* log file */
+extern V3D_TLS int _list;    /* output control, higher value = more output */
 
 /***  DelNull.c  *************************************************************/
 
@@ -0,0 +1,519 @@
+/*subfile:  ViewRay.c  *******************************************************/
+
+/*  Obstructed view factors by ray casting (engine=ray).
+ *
+ *  ViewRays() estimates the fraction of the unobstructed interchange
+ *  area AF0 of srfN and srfM which is not blocked by the probable
+ *  obstructions.  Points are taken in pairs, one on each surface, from
+ *  a 4-dimensional Sobol' sequence;  the segment between them is a
+ *  shadow ray weighted by the view factor kernel cos1 * cos2 / r^2:
+ *      AF = AF0 * sum( K * visible ) / sum( K ).
+ *  The estimate is exact when nothing blocks the view and its error
+ *  depends only on the visibility, not on the surface geometry.
+ *  RAYLANES replicates of the sequence with independent random digital
+ *  shifts give the standard error of the estimate;  the number of points
+ *  is doubled until RAYZ times that error times AF0 is less than
+ *  vfCtrl->epsAF at two successive tests.  After RAYMAX rays ViewRays()
+ *  gives up and returns -1;  the caller then computes the pair by
+ *  projection.  This happens mostly where the kernel is singular, at an
+ *  edge shared by the two surfaces.  Eight replicates give a rough error estimate and a large
+ *  enclosure has thousands of pairs, so one standard error is not enough
+ *  to keep every pair within epsAF;  testing only at doubled counts
+ *  limits the chance of stopping on a lucky estimate.  The shifts depend
+ *  only on the surface pair, so the results do not depend on the number
+ *  of threads.
+ *
+ *  The obstructions are sorted into a bounding volume hierarchy for
+ *  each pair.  The RAYLANES rays of one point (one per replicate) are
+ *  traced together as a packet:  the box and polygon tests are short
+ *  loops across the packet which the compiler vectorizes.  */
+
+#ifdef _DEBUG
+# define DEBUG 1
+#else
+# define DEBUG 0
+#endif
+
+#define V3D_BUILD
+#include "viewray.h"
+
+#include <stdio.h>
+#include <math.h>   /* prototypes: sqrt, fabs */
+#include "types.h"
+#include "misc.h"
+#include "heap.h"
+
+#define RAYLEAF 4       /* max number of obstructions in a leaf */
+#define RAYDEPTH 64     /* size of the traversal stack */
+#define RAYROUND 32     /* points per replicate before the first error test */
+#define RAYZ 4.0        /* standard errors allowed within epsAF */
+#define RAYMAX 65536    /* max number of rays per surface pair */
+
+static void SetRayObs( RayObs *ro, const SRFDAT3D *srf );
+static void BuildRayNode( RayScene *scene, int iNode, int first, int count );
+static void SelectRayObs( RayScene *scene, int lo, int hi, int k, int axis );
+static int SetFan( const SRFDATNM *s, double cum[] );
+static void FanPoint( const SRFDATNM *s, const double cum[], int nt,
+  double u, double v, Vec3 *p );
+static void TracePacket( const RayScene *scene, const double ox[],
+  const double oy[], const double oz[], const double dx[], const double dy[],
+  const double dz[], double tol, int hit[] );
+
+/***  NewRayScene.c  *********************************************************/
+
+/*  Allocate an empty scene and set the direction numbers of the first
+ *  four dimensions of the Sobol' sequence (Joe & Kuo).  */
+
+RayScene *NewRayScene( void )
+  {
+  static const int s[4] = { 0, 1, 2, 3 };   /* polynomial degree */
+  static const int a[4] = { 0, 0, 1, 1 };   /* polynomial coefficients */
+  static const unsigned m[4][3] = { {1,0,0}, {1,0,0}, {1,3,0}, {1,3,1} };
+  RayScene *scene;
+  int d, k, j;
+
+  scene = V3D_NEW( RayScene );
+  scene->obs = scene->tmp = NULL;
+  scene->item = NULL;
+  scene->node = NULL;
+  scene->nObs = scene->maxObs = scene->nNode = 0;
+  for( k=0; k<32; k++ )        /* dimension 0: van der Corput */
+    scene->sobol[0][k] = 1u << (31 - k);
+  for( d=1; d<4; d++ )
+    for( k=0; k<32; k++ )
+      {
+      unsigned *v = scene->sobol[d];
+      if( k < s[d] )
+        v[k] = m[d][k] << (31 - k);
+      else
+        {
+        v[k] = v[k-s[d]] ^ (v[k-s[d]] >> s[d]);
+        for( j=1; j<s[d]; j++ )
+          if( (a[d] >> (s[d] - 1 - j)) & 1 )
+            v[k] ^= v[k-j];
+        }
+      }
+
+  return scene;
+
+  }  /* end NewRayScene */
+
+/***  FreeRayScene.c  ********************************************************/
+
+void FreeRayScene( RayScene *scene )
+  {
+  if( scene->maxObs )
+    {
+    Fre_V( scene->node, 0, 2*scene->maxObs, sizeof(RayNode), __FILE__, __LINE__ );
+    Fre_V( scene->item, 0, scene->maxObs, sizeof(int), __FILE__, __LINE__ );
+    Fre_V( scene->tmp, 0, scene->maxObs, sizeof(RayObs), __FILE__, __LINE__ );
+    Fre_V( scene->obs, 0, scene->maxObs, sizeof(RayObs), __FILE__, __LINE__ );
+    }
+  V3D_FREE( RayScene, scene );
+
+  }  /* end FreeRayScene */
+
+/***  SetRayObs.c  ***********************************************************/
+
+/*  Set the plane, edge planes and box of obstruction SRF.  The edge
+ *  planes face the centroid, so the vertex order does not matter.  */
+
+static void SetRayObs( RayObs *ro, const SRFDAT3D *srf )
+  {
+  const DirCos *dc = &srf->dc;
+  int i;
+
+  ro->dc = srf->dc;
+  ro->nv = srf->nv;
+  ro->ctd = srf->ctd;
+  ro->min = ro->max = *srf->v[0];
+  for( i=0; i<srf->nv; i++ )
+    {
+    const Vec3 *v0 = srf->v[i], *v1 = srf->v[(i + 1) % srf->nv];
+    double x = v1->x - v0->x, y = v1->y - v0->y, z = v1->z - v0->z;
+    ro->ex[i] = dc->y * z - dc->z * y;     /* normal cross edge */
+    ro->ey[i] = dc->z * x - dc->x * z;
+    ro->ez[i] = dc->x * y - dc->y * x;
+    ro->ew[i] = ro->ex[i] * v0->x + ro->ey[i] * v0->y + ro->ez[i] * v0->z;
+    if( ro->ex[i] * srf->ctd.x + ro->ey[i] * srf->ctd.y
+      + ro->ez[i] * srf->ctd.z < ro->ew[i] )
+      {
+      ro->ex[i] = -ro->ex[i];
+      ro->ey[i] = -ro->ey[i];
+      ro->ez[i] = -ro->ez[i];
+      ro->ew[i] = -ro->ew[i];
+      }
+    ro->min.x = MIN( ro->min.x, v0->x );
+    ro->min.y = MIN( ro->min.y, v0->y );
+    ro->min.z = MIN( ro->min.z, v0->z );
+    ro->max.x = MAX( ro->max.x, v0->x );
+    ro->max.y = MAX( ro->max.y, v0->y );
+    ro->max.z = MAX( ro->max.z, v0->z );
+    }
+
+  }  /* end SetRayObs */
+
+/***  BuildRayNode.c  ********************************************************/
+
+/*  Set node INODE for items FIRST to FIRST+COUNT-1; split it at the
+ *  median centroid along the longest axis until leaves are small.  */
+
+static void BuildRayNode( RayScene *scene, int iNode, int first, int count )
+  {
+  RayNode *node = scene->node + iNode;
+  const RayObs *ro;
+  double dx, dy, dz;
+  int i, axis, half;
+
+  ro = scene->tmp + scene->item[first];
+  node->min = ro->min;
+  node->max = ro->max;
+  for( i=first+1; i<first+count; i++ )
+    {
+    ro = scene->tmp + scene->item[i];
+    node->min.x = MIN( node->min.x, ro->min.x );
+    node->min.y = MIN( node->min.y, ro->min.y );
+    node->min.z = MIN( node->min.z, ro->min.z );
+    node->max.x = MAX( node->max.x, ro->max.x );
+    node->max.y = MAX( node->max.y, ro->max.y );
+    node->max.z = MAX( node->max.z, ro->max.z );
+    }
+
+  if( count <= RAYLEAF )
+    {
+    node->first = first;
+    node->count = count;
+    return;
+    }
+
+  dx = node->max.x - node->min.x;
+  dy = node->max.y - node->min.y;
+  dz = node->max.z - node->min.z;
+  axis = (dx >= dy && dx >= dz) ? 0 : (dy >= dz ? 1 : 2);
+  half = count / 2;
+  SelectRayObs( scene, first, first+count-1, first+half, axis );
+
+  node->first = scene->nNode;
+  node->count = 0;
+  scene->nNode += 2;
+  BuildRayNode( scene, node->first, first, half );
+  BuildRayNode( scene, scene->node[iNode].first+1, first+half, count-half );
+
+  }  /* end BuildRayNode */
+
+/***  SelectRayObs.c  ********************************************************/
+
+/*  Partially sort items LO to HI so that item K has the median centroid
+ *  coordinate on AXIS (Hoare's selection).  */
+
+static void SelectRayObs( RayScene *scene, int lo, int hi, int k, int axis )
+  {
+  int *item = scene->item;
+  const RayObs *tmp = scene->tmp;
+  double pivot;
+  int i, j, t;
+
+#define RCOORD(n) (axis == 0 ? tmp[n].ctd.x : (axis == 1 ? tmp[n].ctd.y : tmp[n].ctd.z))
+  while( lo < hi )
+    {
+    pivot = RCOORD( item[(lo+hi)/2] );
+    i = lo;
+    j = hi;
+    while( i <= j )
+      {
+      while( RCOORD( item[i] ) < pivot ) i++;
+      while( RCOORD( item[j] ) > pivot ) j--;
+      if( i <= j )
+        {
+        t = item[i];
+        item[i++] = item[j];
+        item[j--] = t;
+        }
+      }
+    if( k <= j )
+      hi = j;
+    else if( k >= i )
+      lo = i;
+    else
+      break;
+    }
+#undef RCOORD
+
+  }  /* end SelectRayObs */
+
+/***  SetFan.c  **************************************************************/
+
+/*  Set CUM[t] = fraction of the area of convex polygon S in triangles
+ *  0 to t of the fan from vertex 0.  Return the number of triangles.  */
+
+static int SetFan( const SRFDATNM *s, double cum[] )
+  {
+  const Vec3 *v = s->v;
+  double sum=0.0;
+  int t, nt = s->nv - 2;
+
+  for( t=0; t<nt; t++ )
+    {
+    Vec3 a, b, c;
+    VECTOR( v, (v+t+1), (&a) );
+    VECTOR( v, (v+t+2), (&b) );
+    VCROSS( (&a), (&b), (&c) );
+    sum += VLEN( (&c) );
+    cum[t] = sum;
+    }
+  for( t=0; t<nt; t++ )
+    cum[t] = sum > 0.0 ? cum[t] / sum : (double)(t + 1) / nt;
+  cum[nt-1] = 1.0;
+
+  return nt;
+
+  }  /* end SetFan */
+
+/***  FanPoint.c  ************************************************************/
+
+/*  Map (U,V) in the unit square to point P of polygon S, uniformly by
+ *  area:  U selects the triangle of the fan and, rescaled, the distance
+ *  from vertex 0 (square root); V the position across the triangle.  */
+
+static void FanPoint( const SRFDATNM *s, const double cum[], int nt,
+  double u, double v, Vec3 *p )
+  {
+  const Vec3 *v0 = s->v, *v1, *v2;
+  double lo=0.0, r;
+  int t=0;
+
+  while( t < nt-1 && u >= cum[t] )
+    lo = cum[t++];
+  u = (u - lo) / (cum[t] - lo);
+  r = sqrt( u );
+  v1 = s->v + t + 1;
+  v2 = s->v + t + 2;
+  p->x = v0->x + r * ((1.0 - v) * (v1->x - v0->x) + v * (v2->x - v0->x));
+  p->y = v0->y + r * ((1.0 - v) * (v1->y - v0->y) + v * (v2->y - v0->y));
+  p->z = v0->z + r * ((1.0 - v) * (v1->z - v0->z) + v * (v2->z - v0->z));
+
+  }  /* end FanPoint */
+
+/***  TracePacket.c  *********************************************************/
+
+/*  Set HIT[i] = 1 if the segment from (OX,OY,OZ)[i] to that point plus
+ *  (DX,DY,DZ)[i] crosses an obstruction of SCENE.  A crossing must be
+ *  more than TOL from both end points, so surfaces in the plane of
+ *  either end do not block.  */
+
+static void TracePacket( const RayScene *scene, const double ox[],
+  const double oy[], const double oz[], const double dx[], const double dy[],
+  const double dz[], double tol, int hit[] )
+  {
+  double ix[RAYLANES], iy[RAYLANES], iz[RAYLANES];  /* 1 / direction */
+  int stack[RAYDEPTH];
+  int sp=0, i, nHit=0;
+
+  for( i=0; i<RAYLANES; i++ )
+    {
+    hit[i] = 0;
+    ix[i] = 1.0 / (fabs(dx[i]) > 1.0e-300 ? dx[i] : 1.0e-300);
+    iy[i] = 1.0 / (fabs(dy[i]) > 1.0e-300 ? dy[i] : 1.0e-300);
+    iz[i] = 1.0 / (fabs(dz[i]) > 1.0e-300 ? dz[i] : 1.0e-300);
+    }
+
+  stack[sp++] = 0;
+  while( sp > 0 && nHit < RAYLANES )
+    {
+    const RayNode *node = scene->node + stack[--sp];
+    int any=0;
+
+    for( i=0; i<RAYLANES; i++ )   /* slab test of the node box */
+      {
+      double t0 = (node->min.x - ox[i]) * ix[i], t1 = (node->max.x - ox[i]) * ix[i];
+      double tn = MIN( t0, t1 ), tf = MAX( t0, t1 );
+      t0 = (node->min.y - oy[i]) * iy[i];
+      t1 = (node->max.y - oy[i]) * iy[i];
+      tn = MAX( tn, MIN( t0, t1 ) );
+      tf = MIN( tf, MAX( t0, t1 ) );
+      t0 = (node->min.z - oz[i]) * iz[i];
+      t1 = (node->max.z - oz[i]) * iz[i];
+      tn = MAX( tn, MIN( t0, t1 ) );
+      tf = MIN( tf, MAX( t0, t1 ) );
+      any += (!hit[i] && MAX( tn, 0.0 ) <= MIN( tf, 1.0 ));
+      }
+    if( !any ) continue;
+
+    if( node->count )             /* leaf: test the obstructions */
+      {
+      int j, k;
+      for( j=node->first; j<node->first+node->count; j++ )
+        {
+        const RayObs *ro = scene->obs + j;
+        double qx[RAYLANES], qy[RAYLANES], qz[RAYLANES];
+        int in[RAYLANES];
+        for( i=0; i<RAYLANES; i++ )
+          {
+          double d1 = ro->dc.x * ox[i] + ro->dc.y * oy[i] + ro->dc.z * oz[i] + ro->dc.w;
+          double dd = ro->dc.x * dx[i] + ro->dc.y * dy[i] + ro->dc.z * dz[i];
+          double d2 = d1 + dd;      /* distances of the ends from the plane */
+          double t;
+          in[i] = (d1 > tol && d2 < -tol) || (d1 < -tol && d2 > tol);
+          t = in[i] ? -d1 / dd : 0.0;
+          qx[i] = ox[i] + t * dx[i];
+          qy[i] = oy[i] + t * dy[i];
+          qz[i] = oz[i] + t * dz[i];
+          }
+        for( k=0; k<ro->nv; k++ )   /* crossing inside the polygon */
+          for( i=0; i<RAYLANES; i++ )
+            in[i] &= ro->ex[k] * qx[i] + ro->ey[k] * qy[i] + ro->ez[k] * qz[i]
+              >= ro->ew[k];
+        for( nHit=i=0; i<RAYLANES; i++ )
+          {
+          hit[i] |= in[i];
+          nHit += hit[i];
+          }
+        }
+      }
+    else if( sp < RAYDEPTH - 1 )
+      {
+      stack[sp++] = node->first + 1;
+      stack[sp++] = node->first;
+      }
+    else
+      error( 3, __FILE__, __LINE__, "Ray traversal stack overflow", "" );
+    }
+
+  }  /* end TracePacket */
+
+/***  ViewRays.c  ************************************************************/
+
+/*  Estimate the interchange area of srfN and srfM with the NPROB
+ *  obstructions in PROBABLEOBSTR by ray casting.  AF0 is the
+ *  unobstructed interchange area;  SEED selects the random shifts.
+ *  Return -1.0 if the estimate is not within epsAF after RAYMAX rays. */
+
+double ViewRays( RayScene *scene, View3DControlData *vfCtrl, SRFDAT3D *srf,
+  SRFDATNM *srfN, SRFDATNM *srfM, const int *probableObstr, int nProb,
+  double AF0, unsigned seed )
+  {
+  double sumK[RAYLANES], sumKV[RAYLANES];  /* sums for each replicate */
+  unsigned shift[RAYLANES][4];  /* random digital shifts */
+  unsigned x[4]={0,0,0,0};      /* Sobol' point, index ip */
+  double cumN[MAXNV1], cumM[MAXNV1];
+  double tol, mean, var, varLast=1.0;  /* varLast: previous test */
+  int ntN, ntM;
+  unsigned ip=0;
+  int nRays=0, nRound=RAYROUND, i, j, d;  /* nRound: points per round */
+
+  if( nProb == 0 || AF0 <= 0.0 )
+    return AF0;
+
+  if( nProb > scene->maxObs )    /* allocate space for the hierarchy */
+    {
+    if( scene->maxObs )
+      {
+      Fre_V( scene->node, 0, 2*scene->maxObs, sizeof(RayNode), __FILE__, __LINE__ );
+      Fre_V( scene->item, 0, scene->maxObs, sizeof(int), __FILE__, __LINE__ );
+      Fre_V( scene->tmp, 0, scene->maxObs, sizeof(RayObs), __FILE__, __LINE__ );
+      Fre_V( scene->obs, 0, scene->maxObs, sizeof(RayObs), __FILE__, __LINE__ );
+      }
+    scene->maxObs = 2 * nProb;
+    scene->obs = Alc_V( 0, scene->maxObs, sizeof(RayObs), __FILE__, __LINE__ );
+    scene->tmp = Alc_V( 0, scene->maxObs, sizeof(RayObs), __FILE__, __LINE__ );
+    scene->item = Alc_V( 0, scene->maxObs, sizeof(int), __FILE__, __LINE__ );
+    scene->node = Alc_V( 0, 2*scene->maxObs, sizeof(RayNode), __FILE__, __LINE__ );
+    }
+  scene->nObs = nProb;
+  for( j=0; j<nProb; j++ )
+    {
+    SetRayObs( scene->tmp + j, srf + probableObstr[j+1] );
+    scene->item[j] = j;
+    }
+  scene->nNode = 1;
+  BuildRayNode( scene, 0, 0, nProb );
+  for( j=0; j<nProb; j++ )       /* obstructions in leaf order */
+    scene->obs[j] = scene->tmp[scene->item[j]];
+
+  tol = 1.0e-9 * (srfN->rc + srfM->rc);
+  ntN = SetFan( srfN, cumN );
+  ntM = SetFan( srfM, cumM );
+  seed = seed ? seed : 1;
+  for( i=0; i<RAYLANES; i++ )    /* xorshift32 */
+    {
+    for( d=0; d<4; d++ )
+      {
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+      shift[i][d] = seed;
+      }
+    sumK[i] = sumKV[i] = 0.0;
+    }
+
+  for( ;; )
+    {
+    for( j=0; j<nRound; j++ )
+      {
+      double ox[RAYLANES], oy[RAYLANES], oz[RAYLANES];
+      double dx[RAYLANES], dy[RAYLANES], dz[RAYLANES], K[RAYLANES];
+      int hit[RAYLANES];
+      unsigned c=ip++, k=0;
+      while( c & 1 )             /* Gray code: next Sobol' point */
+        {
+        c >>= 1;
+        k++;
+        }
+      for( d=0; d<4; d++ )
+        x[d] ^= scene->sobol[d][k];
+
+      for( i=0; i<RAYLANES; i++ )   /* one ray per replicate */
+        {
+        Vec3 p1, p2;
+        double r2, c1, c2;
+        FanPoint( srfN, cumN, ntN, 2.3283064365386963e-10 * (x[0] ^ shift[i][0]),
+          2.3283064365386963e-10 * (x[1] ^ shift[i][1]), &p1 );
+        FanPoint( srfM, cumM, ntM, 2.3283064365386963e-10 * (x[2] ^ shift[i][2]),
+          2.3283064365386963e-10 * (x[3] ^ shift[i][3]), &p2 );
+        ox[i] = p1.x;
+        oy[i] = p1.y;
+        oz[i] = p1.z;
+        dx[i] = p2.x - p1.x;
+        dy[i] = p2.y - p1.y;
+        dz[i] = p2.z - p1.z;
+        r2 = dx[i] * dx[i] + dy[i] * dy[i] + dz[i] * dz[i];
+        c1 = srfN->dc.x * dx[i] + srfN->dc.y * dy[i] + srfN->dc.z * dz[i];
+        c2 = -(srfM->dc.x * dx[i] + srfM->dc.y * dy[i] + srfM->dc.z * dz[i]);
+        K[i] = (c1 > 0.0 && c2 > 0.0) ? c1 * c2 / (r2 * r2) : 0.0;
+        }
+      TracePacket( scene, ox, oy, oz, dx, dy, dz, tol, hit );
+      for( i=0; i<RAYLANES; i++ )
+        {
+        sumK[i] += K[i];
+        sumKV[i] += hit[i] ? 0.0 : K[i];
+        }
+      nRays += RAYLANES;
+      }
+
+    for( mean=0.0,i=0; i<RAYLANES; i++ )  /* visible fractions */
+      mean += sumK[i] > 0.0 ? sumKV[i] / sumK[i] : 1.0;
+    mean /= RAYLANES;
+    for( var=0.0,i=0; i<RAYLANES; i++ )
+      {
+      double f = (sumK[i] > 0.0 ? sumKV[i] / sumK[i] : 1.0) - mean;
+      var += f * f;
+      }
+    var /= (double)RAYLANES * (RAYLANES - 1);   /* variance of the mean */
+    if( RAYZ * RAYZ * AF0 * AF0 * MAX( var, varLast ) <= vfCtrl->epsAF * vfCtrl->epsAF )
+      break;
+    varLast = var;
+    nRound = nRays / RAYLANES;
+    if( nRays >= RAYMAX )
+      {
+      vfCtrl->totRays += nRays;
+#if( DEBUG > 1 )
+      fprintf( _ulog, " ViewRays: %d rays, std. error %g\n", nRays, AF0 * sqrt( var ) );
+#endif
+      return -1.0;
+      }
+    }
+  vfCtrl->totRays += nRays;
+
+  return AF0 * mean;
+
+  }  /* end ViewRays */
@@ -0,0 +1,42 @@
+#ifndef V3D_VIEWRAY_H
+#define V3D_VIEWRAY_H
+
+#include "view3d.h"
+
+/*  Ray casting estimate of obstructed view factors; see viewray.c.  */
+
+#define RAYLANES 8      /* rays per packet; also the number of replicates */
+
+typedef struct{         /* node of the obstruction hierarchy */
+  Vec3 min, max;        /* box enclosing its obstructions */
+  int first;            /* leaf: first obstruction; interior: first child */
+  int count;            /* leaf: number of obstructions; 0 = interior node */
+} RayNode;
+
+typedef struct{         /* obstruction prepared for the ray tests */
+  DirCos dc;            /* plane of the obstruction */
+  int nv;               /* number of vertices / edges */
+  double ex[MAXNV], ey[MAXNV], ez[MAXNV], ew[MAXNV];  /* edge planes;
+                           ex*x + ey*y + ez*z >= ew inside the polygon */
+  Vec3 ctd;             /* centroid */
+  Vec3 min, max;        /* box enclosing the vertices */
+} RayObs;
+
+typedef struct{         /* obstructions of one surface pair */
+  RayObs *obs;          /* obstructions [0:maxObs-1] in leaf order */
+  RayObs *tmp;          /* obstructions before sorting [0:maxObs-1] */
+  int *item;            /* obstructions sorted into leaves [0:maxObs-1] */
+  int nObs;             /* number of obstructions */
+  int maxObs;           /* number of obstructions allocated */
+  RayNode *node;        /* nodes [0:2*maxObs-1]; node 0 is the root */
+  int nNode;            /* number of nodes used */
+  unsigned sobol[4][32];  /* Sobol' direction numbers */
+} RayScene;
+
+RayScene *NewRayScene( void );
+double ViewRays( RayScene *scene, View3DControlData *vfCtrl, SRFDAT3D *srf,
+  SRFDATNM *srfN, SRFDATNM *srfM, const int *probableObstr, int nProb,
+  double AF0, unsigned seed );
+void FreeRayScene( RayScene *scene );
+
+#endif
@@ -12,31 +12,67 @@
 #include "viewunob.h"
 
 #include <stdio.h>
+#include <string.h> /* prototypes: memcmp, memcpy */
 #include <math.h>  /* prototypes: atan, cos, fabs, log, sqrt */
 #include "types.h"
 #include "view3d.h"
 #include "misc.h"
 #include "heap.h"
 #include "viewobs.h"
+#include "viewexact.h"
+#include "viewvec.h"
 
 #include "heap.h"
 
 #define PId2     1.570796326794896619   /* pi / 2 */
 #define PIinv    0.318309886183790672   /* 1 / pi */
+#define PIt2inv  0.159154943091895336   /* 1 / (2 * pi) */
 #define PIt4inv  0.079577471545947673   /* 1 / (4 * pi) */
+#define RECTTOL  1.0e-9  /* tolerance of rectangle shape and alignment */
+#define RECTEPS  1.0e-14 /* relative rounding error of closed form terms */
+#define MAXBATCH (MAXNV1*MAXNV1)  /* points per V1LIbatch() call in ViewALI() */
+#define MAXALI   64      /* size of the V1LIadapt() stack */
+#define MAXKEY   8       /* max number of (n1, n2) groups per division */
+#define FP32TOL  3.0e-5  /* rounding bound / sum of |terms|; fp32=1 */
+
+typedef struct{         /* interval of adaptive line integration */
+  Vec3 P[3];            /* start, middle and end points */
+  double dF[3];         /* corresponding dF values */
+  double h;             /* |P[2] - P[0]| / 6.0 */
+  int level;            /* level of subdivision */
+} ALIPart;
+
+typedef struct{         /* quadrature of one surface; see QuadFind() */
+  int nv;               /* number of vertices */
+  double area;          /* area of surface */
+  Vec3 v[MAXNV1];       /* vertices the quadrature was built from */
+  EdgeDir rc[MAXNV1];   /* edge direction cosines; set with dv[] */
+  int pt[4];            /* first SubSrf() point of nDiv-1 in the pool; -1 = none */
+  int npt[4];           /* number of those points; 0 = not built */
+  int dv[4];            /* first DivideEdges() element of nDiv-1; -1 = none */
+  int built;            /* edge divisions built: bit nDiv-1 */
+} QuadSrf;
+
+typedef struct{         /* pool of surface quadratures of one thread */
+  int *index;           /* QuadSrf of each surface number [0:maxNr]; -1 = none */
+  int maxNr;            /* largest index */
+  QuadSrf *srf;         /* surface quadratures [0:maxSrf] */
+  int nSrf, maxSrf;     /* number used / largest index */
+  double *x, *y, *z, *w;  /* Gaussian points and weights [0:maxPt] */
+  int nPt, maxPt;       /* number used / largest index */
+  EdgeDivision *dv;     /* edge divisions [0:maxDv] */
+  int nDv, maxDv;       /* number used / largest index */
+} QuadPool;
 
 /* The following variables are "global" to this file.
- * They are allocated and freed in ViewsInit(). */
-EdgeDir *_rc1; /* edge DirCos of surface 1 */
-EdgeDir *_rc2; /* edge DirCos of surface 2 */
-EdgeDivision **_dv1;  /* edge divisions of surface 1 */
-EdgeDivision **_dv2;  /* edge divisions of surface 2 */
-long _usedV1LIpart=0L;  /* number of calls to V1LIpart() */
+ * They are allocated and freed in ViewsInit(), once per thread. */
+V3D_TLS long _usedV1LIpart=0L;  /* number of calls to V1LIpart() */
+V3D_TLS QuadPool _qp;  /* quadrature points of the surfaces; QuadFind() */
 
 /* forward decls */
 
-static double View2AI( const int nss1, const DirCos *dc1, const Vec3 *pt1
-	, const double *area1, const int nss2, const DirCos *dc2, const Vec3 *pt2, const double *area2
+static double View2AI( const int nss1, const DirCos *dc1, const int k1
+	, const int nss2, const DirCos *dc2, const int k2
 );
 
 static double View2LI( const int nd1, const int nv1, const EdgeDir *rc1
@@ -50,21 +86,44 @@ static double View1LI( const int nd1, const int nv1, const EdgeDir *rc1
 static double V1LIpart( const Vec3 *pp, const Vec3 *b0, const Vec3 *b1
 	, const Vec3 *B, const double b2, int *flag
 );
+static void V1LIbatch( const int n, const Vec3 *pp, const int *e
+	, const Vec3 *b0, const Vec3 *b1, const Vec3 *B, const double *b2
+	, double *dF, int *flag
+);
 
 static double V1LIxact( const Vec3 *a0, const Vec3 *a1, const double a
 	, const Vec3 *b0, const Vec3 *b1, const double b
 );
-static double V1LIadapt( Vec3 Pold[3], double dFold[3], double h
+static double V1LIadapt( const Vec3 P0[3], const double dF0[3], double h
 	, const Vec3 *b0, const Vec3 *b1, const Vec3 *B, const double b2
-	, int level, View3DControlData *vfCtrl
+	, View3DControlData *vfCtrl
 );
 static double ViewALI( const int nv1
 	, const Vec3 *v1, const int nv2, const Vec3 *v2
 	, View3DControlData *vfCtrl
 );
 static int DivideEdges( int nd, int nv, Vec3 *vs, EdgeDir *rc, EdgeDivision **dv );
+static int QuadFind( const SRFDAT3X *srf );
+static int QuadPoints( const SRFDAT3X *srf, const int nDiv, int *n );
+static int QuadEdges( const SRFDAT3X *srf, const int nDiv );
+static EdgeDir *QuadEdgeSet( const int k, const int nDiv, EdgeDivision **dv );
+static void LaneSet( V2AILanes *b, const int k, const UnobPair *p );
+static void LaneSetF( V2AILanesF *b, const int k, const UnobPair *p,
+  const Vec3 *o, float r[4][MAXSS] );
+static int BatchFloat( UnobPair *pair, const int nPair );
+static int BatchPoints( const SRFDAT3X *srf, const int nDiv, const int row,
+  int *n, int memo[3] );
+static void *QuadGrow( void *a, int n, int *max, int size );
 static int GQParallelogram( const int nDiv, const Vec3 *vp, Vec3 *p, double *w );
 static int GQTriangle( const int nDiv, const Vec3 *vt, Vec3 *p, double *w );
+static int GETriangle( const Vec3 *vt, Vec3 *p, double *wHi, double *wLo,
+  double *wChk );
+static int GEParallelogram( const Vec3 *vp, Vec3 *p, double *wHi, double *wLo,
+  double *wChk );
+static int RectEdges( const SRFDAT3X *srf, DirCos *u, DirCos *w );
+static void RectRange( const SRFDAT3X *srf, const DirCos *d, double *r );
+static double RectPar( double x, double y, double z );
+static double RectPerp( double x, double y, double z );
 
 /***  ViewUnobstructed.c  ****************************************************/
 
@@ -72,13 +131,14 @@ static int GQTriangle( const int nDiv, const Vec3 *vt, Vec3 *p, double *w );
 
 double ViewUnobstructed( View3DControlData *vfCtrl, int row, int col )
   {
-  Vec3 pt1[16], pt2[16];
-  double area1[16], area2[16];
+  EdgeDivision *dv1[MAXNV1], *dv2[MAXNV1];  /* edge divisions in _qp */
+  EdgeDir *rc1, *rc2;
   SRFDAT3X *srf1;  /* pointer to surface 1 */
   SRFDAT3X *srf2;  /* pointer to surface 2 */
   double AF0,  /* estimate of AF */
      AF1;  /* improved estimate; one more edge division */
   int nmax, mmax;
+  int k1, k2;  /* pool offsets or QuadSrf of surfaces 1 and 2 */
   int nDiv;
 
 #if( DEBUG > 1 )
@@ -87,6 +147,12 @@ double ViewUnobstructed( View3DControlData *vfCtrl, int row, int col )
 
   srf1 = &vfCtrl->srf1T;
   srf2 = &vfCtrl->srf2T;
+  if( vfCtrl->unob == EXACT )    /* closed form */
+    {
+    nDiv = 7;                /* for bins[][] report */
+    if( ViewExact( srf1->nv, srf1->v, srf2->nv, srf2->v, vfCtrl->epsAF,
+        &AF1 ) ) goto done;
+    }
   if( vfCtrl->method < ALI )
     AF1 = 2.0 * srf1->area;
   if( vfCtrl->method == DAI )  /* double area integration */
@@ -97,9 +163,9 @@ double ViewUnobstructed( View3DControlData *vfCtrl, int row, int col )
     for( nDiv=1; nDiv<5; nDiv++ )
       {
       AF0 = AF1;
-      nmax = SubSrf( nDiv, srf1->nv, srf1->v, srf1->area, pt1, area1 );
-      mmax = SubSrf( nDiv, srf2->nv, srf2->v, srf2->area, pt2, area2 );
-      AF1 = View2AI( nmax, &srf1->dc, pt1, area1, mmax, &srf2->dc, pt2, area2 );
+      k1 = QuadPoints( srf1, nDiv, &nmax );
+      k2 = QuadPoints( srf2, nDiv, &mmax );
+      AF1 = View2AI( nmax, &srf1->dc, k1, mmax, &srf2->dc, k2 );
 #if( DEBUG > 1 )
       fprintf( _ulog, " %g", AF1 );
 #endif
@@ -114,8 +180,9 @@ double ViewUnobstructed( View3DControlData *vfCtrl, int row, int col )
     for( nDiv=1; nDiv<5; nDiv++ )
       {
       AF0 = AF1;
-      nmax = SubSrf( nDiv, srf1->nv, srf1->v, srf1->area, pt1, area1 );
-      AF1 = -View1AI( nmax, pt1, area1, &srf1->dc, srf2 );
+      k1 = QuadPoints( srf1, nDiv, &nmax );
+      AF1 = -View1AI( nmax, _qp.x + k1, _qp.y + k1, _qp.z + k1, _qp.w + k1,
+        &srf1->dc, srf2 );
 #if( DEBUG > 1 )
       fprintf( _ulog, " %g", AF1 );
 #endif
@@ -130,8 +197,8 @@ double ViewUnobstructed( View3DControlData *vfCtrl, int row, int col )
     for( nDiv=1; nDiv<5; nDiv++ )
       {
       AF0 = AF1;
-      DivideEdges( nDiv, srf1->nv, srf1->v, _rc1, _dv1 );
-      AF1 = View1LI( nDiv, srf1->nv, _rc1, _dv1, srf1->v, srf2->nv, srf2->v );
+      rc1 = QuadEdgeSet( QuadEdges( srf1, nDiv ), nDiv, dv1 );
+      AF1 = View1LI( nDiv, srf1->nv, rc1, dv1, srf1->v, srf2->nv, srf2->v );
 #if( DEBUG > 1 )
       fprintf( _ulog, " %g", AF1 );
 #endif
@@ -146,9 +213,11 @@ double ViewUnobstructed( View3DControlData *vfCtrl, int row, int col )
     for( nDiv=1; nDiv<5; nDiv++ )
       {
       AF0 = AF1;
-      DivideEdges( nDiv, srf1->nv, srf1->v, _rc1, _dv1 );
-      DivideEdges( nDiv, srf2->nv, srf2->v, _rc2, _dv2 );
-      AF1 = View2LI( nDiv, srf1->nv, _rc1, _dv1, nDiv, srf2->nv, _rc2, _dv2 );
+      k1 = QuadEdges( srf1, nDiv );
+      k2 = QuadEdges( srf2, nDiv );   /* may move the pool */
+      rc1 = QuadEdgeSet( k1, nDiv, dv1 );
+      rc2 = QuadEdgeSet( k2, nDiv, dv2 );
+      AF1 = View2LI( nDiv, srf1->nv, rc1, dv1, nDiv, srf2->nv, rc2, dv2 );
 #if( DEBUG > 1 )
       fprintf( _ulog, " %g", AF1 );
 #endif
@@ -191,36 +260,693 @@ done:
 
   }  /* end ViewUnobstructed */
 
+/***  ViewUnobBatch.c  *******************************************************/
+
+/*  Compute the AF of NPAIR unobstructed pairs of one row by double area
+ *  integration, as ViewUnobstructed() does for method DAI, but with one
+ *  number of divisions at a time for all the pairs not yet converged.
+ *  Pairs with fewer than V1AIBLOCK points on surface 2 are evaluated
+ *  V1AIBLOCK at a time by V2AIlanes(), grouped by their numbers of
+ *  points;  the results equal those of ViewUnobstructed().  The
+ *  surfaces must not be clipped, so that every pair finds the same
+ *  points of a surface in _qp.  With fp32=1 the pairs are first
+ *  estimated in single precision by BatchFloat();  those it does not
+ *  accept are then computed as above.  */
+
+void ViewUnobBatch( View3DControlData *vfCtrl, UnobPair *pair, int nPair )
+  {
+  V2AILanes lanes;      /* points of V1AIBLOCK pairs */
+  UnobPair *p, *lane[V1AIBLOCK];  /* pair of each lane */
+  double af[V1AIBLOCK];
+  int key[MAXKEY];      /* n1 * (MAXSS+1) + n2 of each group */
+  int memo[3];          /* points of the row surface; BatchPoints() */
+  int nKey, nLeft=nPair;
+  int nDiv, j, k, nl;
+
+  for( p=pair; p<pair+nPair; p++ )
+    {
+    p->nEdgeDiv = 0;
+    p->failViewALI = 0;
+    p->fp32 = 0;
+    }
+  if( vfCtrl->fp32 )
+    nLeft -= BatchFloat( pair, nPair );
+  for( p=pair; p<pair+nPair; p++ )
+    if( !p->nEdgeDiv )
+      p->AF = 2.0 * p->srf1.area;
+
+  for( nDiv=1; nDiv<5 && nLeft; nDiv++ )
+    {
+    nKey = 0;
+    memo[0] = -1;
+    for( p=pair; p<pair+nPair; p++ )
+      {
+      if( p->nEdgeDiv ) continue;   /* converged */
+      p->AF0 = p->AF;
+      p->k1 = BatchPoints( &p->srf1, nDiv, p->row, &p->n1, memo );
+      p->k2 = BatchPoints( &p->srf2, nDiv, p->row, &p->n2, memo );
+      k = p->n1 * (MAXSS+1) + p->n2;
+      for( j=0; j<nKey && key[j]!=k; j++ )
+        ;
+      if( p->n2 >= V1AIBLOCK || (j == nKey && nKey == MAXKEY) )
+        {
+        p->AF = View2AI( p->n1, &p->srf1.dc, p->k1, p->n2, &p->srf2.dc, p->k2 );
+        p->group = -1;
+        continue;
+        }
+      if( j == nKey )
+        key[nKey++] = k;
+      p->group = j;
+      }
+
+    for( j=0; j<nKey; j++ )   /* pairs of group j in lanes */
+      {
+      nl = 0;
+      for( p=pair; p<pair+nPair; p++ )
+        {
+        if( p->nEdgeDiv || p->group != j ) continue;
+        LaneSet( &lanes, nl, p );
+        lane[nl++] = p;
+        if( nl == V1AIBLOCK )
+          {
+          V2AIlanes( &lanes, p->n1, p->n2, af );
+          for( k=0; k<nl; k++ )
+            lane[k]->AF = af[k];
+          nl = 0;
+          }
+        }
+      if( nl )
+        {
+        for( k=nl; k<V1AIBLOCK; k++ )   /* pad with copies of lane 0 */
+          LaneSet( &lanes, k, lane[0] );
+        V2AIlanes( &lanes, lane[0]->n1, lane[0]->n2, af );
+        for( k=0; k<nl; k++ )
+          lane[k]->AF = af[k];
+        }
+      }
+
+    for( p=pair; p<pair+nPair; p++ )
+      if( p->nEdgeDiv == 0 && fabs(p->AF - p->AF0) < p->epsAF )
+        {
+        p->nEdgeDiv = nDiv;
+        nLeft--;
+        }
+    }
+
+  for( p=pair; p<pair+nPair && nLeft; p++ )  /* fix by ALI */
+    {
+    if( p->nEdgeDiv ) continue;
+#if( DEBUG == 1 )
+    fprintf( _ulog, " row %d, col %d,  Fix %s (r %.2f, s %.2f) AF0 %g Af1 %g\n",
+      p->row, p->col, methods[DAI], p->rcRatio, p->relSep, p->AF0, p->AF );
+#endif
+    vfCtrl->epsAF = p->epsAF;
+    vfCtrl->failViewALI = 0;
+    p->AF = ViewALI( p->srf1.nv, p->srf1.v, p->srf2.nv, p->srf2.v, vfCtrl );
+    p->failViewALI = vfCtrl->failViewALI;
+    p->nEdgeDiv = 5;
+    nLeft--;
+#if( DEBUG == 1 )
+    fprintf( _ulog, "AF %g\n", p->AF );
+#endif
+    }
+
+  }  /* end ViewUnobBatch */
+
+/***  BatchFloat.c  **********************************************************/
+
+/*  Estimate the AF of the pairs of ViewUnobBatch() in single precision,
+ *  V2AIFBLOCK at a time by V2AIlanesF().  The rounding bound of an
+ *  estimate is FP32TOL times the sum of the absolute values of its
+ *  terms;  the coordinates are taken relative to the centroid of the
+ *  row surface, one of the two surfaces of every pair, so that the
+ *  bound holds for any origin.  A pair is accepted (fp32 = 1) when the
+ *  change from the previous number of divisions plus both bounds is
+ *  below epsAF.  It is left for double precision
+ *  (fp32 = 2) when the change is within the bounds of epsAF, when
+ *  surface 2 has V1AIBLOCK or more points, or when it does not converge,
+ *  as for a result that is not finite.  Return the number accepted.  */
+
+static int BatchFloat( UnobPair *pair, const int nPair )
+  {
+  V2AILanesF lanes;     /* points of V2AIFBLOCK pairs */
+  UnobPair *p, *lane[V2AIFBLOCK];  /* pair of each lane */
+  double af[V2AIFBLOCK], ab[V2AIFBLOCK];
+  int key[MAXKEY];      /* n1 * (MAXSS+1) + n2 of each group */
+  float r[4][MAXSS];    /* points of the row surface relative to o */
+  const Vec3 *o;        /* centroid of the row surface */
+  int memo[3];          /* points of the row surface; BatchPoints() */
+  int nKey, nLeft=nPair, nDone=0;
+  int nDiv, i, j, k, nl;
+
+  o = pair->srf1.nr == pair->row ? &pair->srf1.ctd : &pair->srf2.ctd;
+  for( p=pair; p<pair+nPair; p++ )
+    {
+    p->AF = 2.0 * p->srf1.area;
+    p->err = 0.0;
+    }
+
+  for( nDiv=1; nDiv<5 && nLeft; nDiv++ )
+    {
+    nKey = 0;
+    memo[0] = -1;
+    for( p=pair; p<pair+nPair; p++ )
+      {
+      if( p->fp32 ) continue;   /* decided */
+      p->AF0 = p->AF;
+      p->err0 = p->err;
+      p->k1 = BatchPoints( &p->srf1, nDiv, p->row, &p->n1, memo );
+      p->k2 = BatchPoints( &p->srf2, nDiv, p->row, &p->n2, memo );
+      k = p->n1 * (MAXSS+1) + p->n2;
+      for( j=0; j<nKey && key[j]!=k; j++ )
+        ;
+      if( p->n2 >= V1AIBLOCK || (j == nKey && nKey == MAXKEY) )
+        {
+        p->fp32 = 2;
+        nLeft--;
+        continue;
+        }
+      if( j == nKey )
+        key[nKey++] = k;
+      p->group = j;
+      }
+    for( i=0; memo[0]>=0 && i<memo[2]; i++ )
+      {
+      r[0][i] = (float)(_qp.x[memo[1]+i] - o->x);
+      r[1][i] = (float)(_qp.y[memo[1]+i] - o->y);
+      r[2][i] = (float)(_qp.z[memo[1]+i] - o->z);
+      r[3][i] = (float)_qp.w[memo[1]+i];
+      }
+
+    for( j=0; j<nKey; j++ )   /* pairs of group j in lanes */
+      {
+      nl = 0;
+      for( p=pair; p<pair+nPair; p++ )
+        {
+        if( p->fp32 || p->group != j ) continue;
+        LaneSetF( &lanes, nl, p, o, r );
+        lane[nl++] = p;
+        if( nl == V2AIFBLOCK )
+          {
+          V2AIlanesF( &lanes, p->n1, p->n2, af, ab );
+          for( k=0; k<nl; k++ )
+            {
+            lane[k]->AF = af[k];
+            lane[k]->err = FP32TOL * ab[k];
+            }
+          nl = 0;
+          }
+        }
+      if( nl )
+        {
+        for( k=nl; k<V2AIFBLOCK; k++ )   /* pad with copies of lane 0 */
+          LaneSetF( &lanes, k, lane[0], o, r );
+        V2AIlanesF( &lanes, lane[0]->n1, lane[0]->n2, af, ab );
+        for( k=0; k<nl; k++ )
+          {
+          lane[k]->AF = af[k];
+          lane[k]->err = FP32TOL * ab[k];
+          }
+        }
+      }
+
+    for( p=pair; p<pair+nPair; p++ )
+      {
+      double d, e;
+      if( p->fp32 ) continue;
+      d = fabs(p->AF - p->AF0);
+      e = p->err + p->err0;
+      if( d + e < p->epsAF )         /* converged */
+        {
+        p->nEdgeDiv = nDiv;
+        p->fp32 = 1;
+        nDone++;
+        nLeft--;
+        }
+      else if( d - e < p->epsAF )    /* too close to tell */
+        {
+        p->fp32 = 2;
+        nLeft--;
+        }
+      }
+    }
+
+  for( p=pair; p<pair+nPair; p++ )
+    if( p->fp32 == 0 )   /* not converged */
+      p->fp32 = 2;
+
+  return nDone;
+
+  }  /* end BatchFloat */
+
+/***  BatchPoints.c  *********************************************************/
+
+/*  QuadPoints() of surface SRF of a pair of row ROW.  Those of the row
+ *  surface are kept in MEMO (surface number, offset, number) for the
+ *  following pairs of the row;  set MEMO[0] = -1 for a new NDIV.  */
+
+static int BatchPoints( const SRFDAT3X *srf, const int nDiv, const int row,
+  int *n, int memo[3] )
+  {
+  if( srf->nr != row )
+    return QuadPoints( srf, nDiv, n );
+  if( memo[0] != row )
+    {
+    memo[1] = QuadPoints( srf, nDiv, memo+2 );
+    memo[0] = row;
+    }
+  *n = memo[2];
+
+  return memo[1];
+
+  }  /* end BatchPoints */
+
+/***  LaneSet.c  *************************************************************/
+
+/*  Copy the points and normals of pair P to lane K of B.  */
+
+static void LaneSet( V2AILanes *b, const int k, const UnobPair *p )
+  {
+  int i;
+
+  for( i=0; i<p->n1; i++ )
+    {
+    b->x1[i][k] = _qp.x[p->k1+i];
+    b->y1[i][k] = _qp.y[p->k1+i];
+    b->z1[i][k] = _qp.z[p->k1+i];
+    b->w1[i][k] = _qp.w[p->k1+i];
+    }
+  for( i=0; i<p->n2; i++ )
+    {
+    b->x2[i][k] = _qp.x[p->k2+i];
+    b->y2[i][k] = _qp.y[p->k2+i];
+    b->z2[i][k] = _qp.z[p->k2+i];
+    b->w2[i][k] = _qp.w[p->k2+i];
+    }
+  b->u1x[k] = p->srf1.dc.x;
+  b->u1y[k] = p->srf1.dc.y;
+  b->u1z[k] = p->srf1.dc.z;
+  b->u2x[k] = p->srf2.dc.x;
+  b->u2y[k] = p->srf2.dc.y;
+  b->u2z[k] = p->srf2.dc.z;
+
+  }  /* end LaneSet */
+
+/***  LaneSetF.c  ************************************************************/
+
+/*  Copy the points and normals of pair P to lane K of B in single
+ *  precision, relative to point O.  The points of the row surface are
+ *  taken from R (x, y, z, w), already converted.  */
+
+static void LaneSetF( V2AILanesF *b, const int k, const UnobPair *p,
+  const Vec3 *o, float r[4][MAXSS] )
+  {
+  int i;
+
+  if( p->srf1.nr == p->row )
+    for( i=0; i<p->n1; i++ )
+      {
+      b->x1[i][k] = r[0][i];
+      b->y1[i][k] = r[1][i];
+      b->z1[i][k] = r[2][i];
+      b->w1[i][k] = r[3][i];
+      }
+  else
+    for( i=0; i<p->n1; i++ )
+      {
+      b->x1[i][k] = (float)(_qp.x[p->k1+i] - o->x);
+      b->y1[i][k] = (float)(_qp.y[p->k1+i] - o->y);
+      b->z1[i][k] = (float)(_qp.z[p->k1+i] - o->z);
+      b->w1[i][k] = (float)_qp.w[p->k1+i];
+      }
+  if( p->srf2.nr == p->row )
+    for( i=0; i<p->n2; i++ )
+      {
+      b->x2[i][k] = r[0][i];
+      b->y2[i][k] = r[1][i];
+      b->z2[i][k] = r[2][i];
+      b->w2[i][k] = r[3][i];
+      }
+  else
+    for( i=0; i<p->n2; i++ )
+      {
+      b->x2[i][k] = (float)(_qp.x[p->k2+i] - o->x);
+      b->y2[i][k] = (float)(_qp.y[p->k2+i] - o->y);
+      b->z2[i][k] = (float)(_qp.z[p->k2+i] - o->z);
+      b->w2[i][k] = (float)_qp.w[p->k2+i];
+      }
+  b->u1x[k] = (float)p->srf1.dc.x;
+  b->u1y[k] = (float)p->srf1.dc.y;
+  b->u1z[k] = (float)p->srf1.dc.z;
+  b->u2x[k] = (float)p->srf2.dc.x;
+  b->u2y[k] = (float)p->srf2.dc.y;
+  b->u2z[k] = (float)p->srf2.dc.z;
+
+  }  /* end LaneSetF */
+
+/***  ViewRect.c  ************************************************************/
+
+/*  Compute AF by the closed forms for two rectangles with aligned edges:
+ *  directly opposed or offset rectangles in parallel planes, and
+ *  rectangles in perpendicular planes with edges parallel to the line
+ *  of intersection of the planes.  Each is the sum of 16 corner terms
+ *  (superposition of rectangles with a common corner or edge).
+ *  Return -1.0 if the surfaces are not such rectangles, or if the
+ *  rounding error from cancellation of the terms may exceed EPSAF.  */
+
+double ViewRect( const SRFDAT3X *srf1, const SRFDAT3X *srf2, double epsAF )
+  {
+  const DirCos *dc1 = &srf1->dc, *dc2 = &srf2->dc;
+  DirCos u1, w1, u2, w2;  /* unit edge directions */
+  const DirCos *t;        /* direction of the line of intersection */
+  double x[2], y[2], p[2], q[2];  /* ranges of corner coordinates */
+  double z, g, sum=0.0, sumAbs=0.0;
+  int i, j, k, l, perp;
+
+  if( !RectEdges( srf1, &u1, &w1 ) || !RectEdges( srf2, &u2, &w2 ) )
+    return -1.0;
+
+  if( fabs( VDOT( (&u1), dc2 ) ) <= RECTTOL
+    && fabs( VDOT( (&w1), dc2 ) ) <= RECTTOL )  /* parallel planes */
+    {
+    z = VDOTW( (&srf2->ctd), dc1 );
+    if( z <= 0.0 || VDOT( dc1, dc2 ) >= 0.0 ) return -1.0;
+    if( fabs( VDOT( (&u2), (&w1) ) ) > RECTTOL
+      && fabs( VDOT( (&u2), (&u1) ) ) > RECTTOL ) return -1.0;
+    perp = 0;
+    RectRange( srf1, &u1, x );
+    RectRange( srf1, &w1, y );
+    RectRange( srf2, &u1, p );
+    RectRange( srf2, &w1, q );
+    }
+  else if( fabs( VDOT( dc1, dc2 ) ) <= RECTTOL )  /* perpendicular planes */
+    {
+    if( fabs( VDOT( (&u1), dc2 ) ) <= RECTTOL )
+      t = &u1;
+    else if( fabs( VDOT( (&w1), dc2 ) ) <= RECTTOL )
+      t = &w1;
+    else
+      return -1.0;
+    if( fabs( VDOT( (&u2), dc1 ) ) > RECTTOL
+      && fabs( VDOT( (&w2), dc1 ) ) > RECTTOL ) return -1.0;
+    perp = 1;
+    z = 0.0;
+    RectRange( srf1, dc2, x );   /* heights above plane 2 */
+    RectRange( srf1, t, y );
+    RectRange( srf2, t, p );
+    RectRange( srf2, dc1, q );   /* heights above plane 1 */
+    if( x[0] < -RECTTOL * x[1] || q[0] < -RECTTOL * q[1] ) return -1.0;
+    }
+  else
+    return -1.0;
+
+  for( i=0; i<2; i++ )
+    for( j=0; j<2; j++ )
+      for( k=0; k<2; k++ )
+        for( l=0; l<2; l++ )
+          {
+          if( perp )
+            g = RectPerp( x[i], y[j] - p[k], q[l] );
+          else
+            g = RectPar( x[i] - p[k], y[j] - q[l], z );
+          if( (i + j + k + l) & 1 )
+            sum -= g;
+          else
+            sum += g;
+          sumAbs += fabs( g );
+          }
+
+  if( RECTEPS * sumAbs * PIt2inv > epsAF ) return -1.0;
+
+  return sum * PIt2inv;
+
+  }  /* end ViewRect */
+
+/***  RectEdges.c  ***********************************************************/
+
+/*  Set the unit directions U and W of edges 0-1 and 0-3 of SRF.
+ *  Return 1 if SRF is a rectangle, else 0.  */
+
+static int RectEdges( const SRFDAT3X *srf, DirCos *u, DirCos *w )
+  {
+  const Vec3 *v = srf->v;
+  double a, b, tol;
+
+  if( srf->nv != 4 ) return 0;
+  VECTOR( (v), (v+1), u );
+  VECTOR( (v), (v+3), w );
+  a = VLEN( u );
+  b = VLEN( w );
+  tol = RECTTOL * (a + b);
+  if( fabs( v[2].x - v[1].x - w->x ) > tol
+    || fabs( v[2].y - v[1].y - w->y ) > tol
+    || fabs( v[2].z - v[1].z - w->z ) > tol ) return 0;
+  u->x /= a;  u->y /= a;  u->z /= a;  u->w = 0.0;
+  w->x /= b;  w->y /= b;  w->z /= b;  w->w = 0.0;
+  if( fabs( VDOT( u, w ) ) > RECTTOL ) return 0;
+
+  return 1;
+
+  }  /* end RectEdges */
+
+/***  RectRange.c  ***********************************************************/
+
+/*  Set R to the range of VDOTW(vertex, D) over the vertices of SRF.  */
+
+static void RectRange( const SRFDAT3X *srf, const DirCos *d, double *r )
+  {
+  int n;
+
+  r[0] = r[1] = VDOTW( (srf->v), d );
+  for( n=1; n<4; n++ )
+    {
+    double h = VDOTW( (srf->v+n), d );
+    if( h < r[0] ) r[0] = h;
+    if( h > r[1] ) r[1] = h;
+    }
+
+  }  /* end RectRange */
+
+/***  RectPar.c  *************************************************************/
+
+/*  Corner term for rectangles in parallel planes Z apart with corner
+ *  offsets X and Y (Howell, catalog C-11).  */
+
+static double RectPar( double x, double y, double z )
+  {
+  double a = sqrt( x*x + z*z ),
+         b = sqrt( y*y + z*z ),
+         r2 = x*x + y*y + z*z,
+         g = 0.0;
+
+  if( a > 0.0 ) g += y * a * atan( y / a );
+  if( b > 0.0 ) g += x * b * atan( x / b );
+  if( r2 > 0.0 ) g -= 0.5 * z * z * log( r2 );
+
+  return g;
+
+  }  /* end RectPar */
+
+/***  RectPerp.c  ************************************************************/
+
+/*  Corner term for rectangles in perpendicular planes:  X is the height
+ *  above plane 2, Z the height above plane 1 and Y the offset along the
+ *  line of intersection (Howell, catalog C-17).  */
+
+static double RectPerp( double x, double y, double z )
+  {
+  double a2 = x*x + z*z,
+         r2 = a2 + y*y,
+         g = 0.0;
+
+  if( a2 > 0.0 )
+    {
+    double a = sqrt( a2 );
+    g += y * a * atan( y / a );
+    }
+  if( r2 > 0.0 ) g -= 0.25 * (a2 - y*y) * log( r2 );
+
+  return g;
+
+  }  /* end RectPerp */
+
 /***  View2AI.c  *************************************************************/
 
 /*  Compute direct interchange area by double area integration.
- *  Surfaces described by their direction cosines and NSS1|2 vertices
- *  and associated areas for numberical integration.  */
+ *  Surfaces described by their direction cosines and NSS1|2 Gaussian
+ *  points and weights starting at K1|2 in the quadrature pool.  */
+
+double View2AI( const int nss1, const DirCos *dc1, const int k1,
+            const int nss2, const DirCos *dc2, const int k2 )
+  {
+  return V2AIsum( nss1, _qp.x + k1, _qp.y + k1, _qp.z + k1, _qp.w + k1, dc1,
+    nss2, _qp.x + k2, _qp.y + k2, _qp.z + k2, _qp.w + k2, dc2 );
 
-double View2AI( const int nss1, const DirCos *dc1, const Vec3 *pt1, const double *area1,
-            const int nss2, const DirCos *dc2, const Vec3 *pt2, const double *area2 )
+  }  /* end View2AI */
+
+/***  QuadFind.c  ************************************************************/
+
+/*  Return the QuadSrf of surface SRF in _qp, reset when SRF is not the
+ *  polygon it was built from (a clipped surface or a new problem).
+ *  The SubSrf() points and DivideEdges() elements of a surface depend
+ *  only on its vertices, so one set serves every pair of a row and of
+ *  the rows that follow.  A rebuilt surface reuses its pool space.  */
+
+static int QuadFind( const SRFDAT3X *srf )
+  {
+  QuadSrf *q;
+  int k, j;
+
+  if( srf->nr > _qp.maxNr )
+    {
+    j = _qp.maxNr;
+    while( _qp.maxNr < srf->nr )
+      _qp.index = QuadGrow( _qp.index, j+1, &_qp.maxNr, sizeof(int) );
+    for( j++; j<=_qp.maxNr; j++ )
+      _qp.index[j] = -1;
+    }
+  k = _qp.index[srf->nr];
+  if( k < 0 )
+    {
+    if( _qp.nSrf > _qp.maxSrf )
+      _qp.srf = QuadGrow( _qp.srf, _qp.nSrf, &_qp.maxSrf, sizeof(QuadSrf) );
+    k = _qp.index[srf->nr] = _qp.nSrf++;
+    q = _qp.srf + k;
+    q->nv = 0;
+    for( j=0; j<4; j++ )
+      q->pt[j] = q->dv[j] = -1;
+    }
+  q = _qp.srf + k;
+  if( q->nv != srf->nv || q->area != srf->area
+    || memcmp( q->v, srf->v, srf->nv * sizeof(Vec3) ) )
+    {
+    q->nv = srf->nv;
+    q->area = srf->area;
+    memcpy( q->v, srf->v, srf->nv * sizeof(Vec3) );
+    for( j=0; j<4; j++ )
+      q->npt[j] = 0;
+    q->built = 0;
+    }
+
+  return k;
+
+  }  /* end QuadFind */
+
+/***  QuadPoints.c  **********************************************************/
+
+/*  Return the pool offset of the N Gaussian points and weights of
+ *  surface SRF for NDIV divisions;  see SubSrf().  */
+
+static int QuadPoints( const SRFDAT3X *srf, const int nDiv, int *n )
+  {
+  int i = QuadFind( srf );   /* may move _qp.srf */
+  QuadSrf *q = _qp.srf + i;
+  int k = nDiv - 1;
+
+  if( q->npt[k] == 0 )
+    {
+    Vec3 pt[MAXSS];
+    double wt[MAXSS];
+    int j, nss;
+
+    if( q->pt[k] < 0 )   /* room for either shape */
+      {
+      i = _qp.nPt;
+      _qp.nPt += nDiv * nDiv;
+      if( _qp.nPt > _qp.maxPt+1 )
+        {
+        int max = _qp.maxPt;
+        _qp.x = QuadGrow( _qp.x, i, &max, sizeof(double) );
+        max = _qp.maxPt;
+        _qp.y = QuadGrow( _qp.y, i, &max, sizeof(double) );
+        max = _qp.maxPt;
+        _qp.z = QuadGrow( _qp.z, i, &max, sizeof(double) );
+        _qp.w = QuadGrow( _qp.w, i, &_qp.maxPt, sizeof(double) );
+        }
+      q->pt[k] = i;
+      }
+    nss = SubSrf( nDiv, q->nv, q->v, q->area, pt, wt );
+    for( j=0; j<nss; j++ )
+      {
+      _qp.x[q->pt[k]+j] = pt[j].x;
+      _qp.y[q->pt[k]+j] = pt[j].y;
+      _qp.z[q->pt[k]+j] = pt[j].z;
+      _qp.w[q->pt[k]+j] = wt[j];
+      }
+    q->npt[k] = nss;
+    }
+  *n = q->npt[k];
+
+  return q->pt[k];
+
+  }  /* end QuadPoints */
+
+/***  QuadEdges.c  ***********************************************************/
+
+/*  Return the QuadSrf of surface SRF with its edges divided into NDIV
+ *  elements;  see DivideEdges().  */
+
+static int QuadEdges( const SRFDAT3X *srf, const int nDiv )
   {
-  Vec3 V;
-  double r2, sumt, sum=0.0;
-  int i, j;
+  int k = QuadFind( srf );
+  QuadSrf *q = _qp.srf + k;
+  int bit = 1 << (nDiv - 1);
 
-  for( i=0; i<nss1; i++ )
+  if( !(q->built & bit) )
     {
-    for( j=0; j<nss2; j++ )
+    EdgeDivision *dv[MAXNV1];
+    if( q->dv[nDiv-1] < 0 )
       {
-      VECTOR( (pt1+i), (pt2+j), (&V) );
-      sumt = VDOT( (&V), dc1 ) * VDOT( (&V), dc2 );
-      r2 = VDOT( (&V), (&V) );
-      sumt *= area1[i] * area2[j] / ( r2 * r2 );
-      sum -= sumt;
+      int i = _qp.nDv;
+      _qp.nDv += MAXNV1 * nDiv;
+      if( _qp.nDv > _qp.maxDv+1 )
+        _qp.dv = QuadGrow( _qp.dv, i, &_qp.maxDv, sizeof(EdgeDivision) );
+      q->dv[nDiv-1] = i;
       }
+    QuadEdgeSet( k, nDiv, dv );
+    DivideEdges( nDiv, q->nv, q->v, q->rc, dv );
+    q->built |= bit;
     }
 
-  sum *= PIinv;             /* divide by pi */
+  return k;
 
-  return sum;
+  }  /* end QuadEdges */
 
-  }  /* end View2AI */
+/***  QuadEdgeSet.c  *********************************************************/
+
+/*  Point DV[i] to the NDIV elements of edge i of QuadSrf K;  return
+ *  its edge direction cosines.  The pointers last until the next
+ *  QuadFind().  */
+
+static EdgeDir *QuadEdgeSet( const int k, const int nDiv, EdgeDivision **dv )
+  {
+  QuadSrf *q = _qp.srf + k;
+  int i;
+
+  for( i=0; i<MAXNV1; i++ )
+    dv[i] = _qp.dv + q->dv[nDiv-1] + i * nDiv;
+
+  return q->rc;
+
+  }  /* end QuadEdgeSet */
+
+/***  QuadGrow.c  ************************************************************/
+
+/*  Return vector A [0:*MAX] of elements of SIZE bytes with *MAX doubled;
+ *  the first N elements are kept.  */
+
+static void *QuadGrow( void *a, int n, int *max, int size )
+  {
+  int newMax = 2 * *max + 1;
+  void *b = Alc_V( 0, newMax, size, __FILE__, __LINE__ );
+
+  memcpy( b, a, n * size );
+  Fre_V( a, 0, *max, size, __FILE__, __LINE__ );
+  *max = newMax;
+
+  return b;
+
+  }  /* end QuadGrow */
 
 /*  View1AI() is in viewobs.c  */
 
@@ -366,94 +1092,179 @@ double V1LIpart( const Vec3 *pp, const Vec3 *b0, const Vec3 *b1,
  * b2     length^2 of vector B;
  * *flag; return 1 if g=0; else return 0. */
   {
-  Vec3 S, T, SxB;
-  double s2, t2, sxb2;
-  double sum=0.0;
+  static const int e0=0;
+  double dF;
+
+  V1LIbatch( 1, pp, &e0, b0, b1, B, &b2, &dF, flag );
 
-  _usedV1LIpart += 1;  /* number of calls to V1LIpart() */
-  VECTOR( b0, pp, (&S) );
-  s2 = VDOT( (&S), (&S) );
-  if( s2 > EPS2 )
-    sum += VDOT( (&S), B ) * log( s2 );
+  return dF;
 
-  VECTOR( pp, b1, (&T) );
-  t2 = VDOT( (&T), (&T) );
-  if( t2 > EPS2 )
-    sum += VDOT( (&T), B ) * log( t2 );
+  }  /* end V1LIpart */
+
+/***  V1LIbatch.c  ***********************************************************/
+
+/*  Compute the V1LIpart() dF values of N points, PP[k], each to an
+ *  edge E[k] of polygon 2.  The geometry is computed for all points
+ *  before any of the log and atan evaluations, so that loop has no
+ *  branches and the compiler may vectorize it.  */
+
+void V1LIbatch( const int n, const Vec3 *pp, const int *e,
+  const Vec3 *b0, const Vec3 *b1, const Vec3 *B, const double *b2,
+  double *dF, int *flag )
+/* n      number of points;
+ * pp     points on polygon 1 [0:n-1];
+ * e      edge index of each point [0:n-1];
+ * b0     starts of edges of polygon 2;
+ * b1     ends of edges of polygon 2;
+ * B      vectors from b0 to b1;
+ * b2     length^2 of vectors B;
+ * dF     dF values [0:n-1];
+ * flag   1 if g=0; else 0 [0:n-1]. */
+  {
+  double s2[MAXBATCH], t2[MAXBATCH],  /* length^2 of S and T */
+    sb[MAXBATCH], tb[MAXBATCH],       /* S.B and T.B */
+    sxb2[MAXBATCH];                   /* |S x B|^2 */
+  int k;
 
-  VCROSS( (&S), B, (&SxB) );
-  sxb2 = VDOT( (&SxB), (&SxB) );
-  if( sxb2 > EPS2*b2 )
+#if( DEBUG > 0 )
+  if( n > MAXBATCH )
+    errorf( 3, __FILE__, __LINE__, "MAXBATCH too small", "" );
+#endif
+  _usedV1LIpart += n;  /* number of calls to V1LIpart() */
+  for( k=0; k<n; k++ )   /* geometry */
     {
-    double h = s2 + t2 - b2;
-    double g = sqrt( sxb2 );
-    if( g > EPS2 )
+    const Vec3 *pb = B + e[k];
+    Vec3 S, T, SxB;
+    VECTOR( (b0+e[k]), (pp+k), (&S) );
+    VECTOR( (pp+k), (b1+e[k]), (&T) );
+    VCROSS( (&S), pb, (&SxB) );
+    s2[k] = VDOT( (&S), (&S) );
+    t2[k] = VDOT( (&T), (&T) );
+    sb[k] = VDOT( (&S), pb );
+    tb[k] = VDOT( (&T), pb );
+    sxb2[k] = VDOT( (&SxB), (&SxB) );
+    }
+
+  for( k=0; k<n; k++ )   /* logs and angles */
+    {
+    double bb = b2[e[k]];
+    double sum=0.0;
+
+    if( s2[k] > EPS2 )
+      sum += sb[k] * log( s2[k] );
+    if( t2[k] > EPS2 )
+      sum += tb[k] * log( t2[k] );
+
+    if( sxb2[k] > EPS2*bb )
       {
-      double omega = PId2 - atan( 0.5 * h / g );
-      sum += 2.0 * ( g * omega - b2 );
+      double h = s2[k] + t2[k] - bb;
+      double g = sqrt( sxb2[k] );
+      if( g > EPS2 )
+        {
+        double omega = PId2 - atan( 0.5 * h / g );
+        sum += 2.0 * ( g * omega - bb );
+        }
+      else
+        errorf( 3, __FILE__, __LINE__, "View1LI failed, call George", "" );
+      flag[k] = 0;
       }
     else
-      errorf( 3, __FILE__, __LINE__, "View1LI failed, call George", "" );
-    *flag = 0;
-    }
-  else
-    {
-    sum -= 2.0 * b2;
-    *flag = 1;
+      {
+      sum -= 2.0 * bb;
+      flag[k] = 1;
+      }
+    dF[k] = sum;
     }
 
-  return sum;
-
-  }  /* end V1LIpart */
+  }  /* end V1LIbatch */
 
 /***  V1LIadapt.c  ***********************************************************/
 
 /*  Compute line integral by adaptive Simpson integration.
- *  This is a recursive calculation!  */
-
-double V1LIadapt( Vec3 Pold[3], double dFold[3], double h, const Vec3 *b0,
-  const Vec3 *b1, const Vec3 *B, const double b2, int level, View3DControlData *vfCtrl )
-/* Pold   3 vertices on edge of polygon 1;
- * dFold  corresponding dF values;
- * h      |Pold[2] - Pold[0]| / 6.0;
+ *  The intervals still to be refined are kept on a stack, first half
+ *  on top, and the two new points of each interval are evaluated by
+ *  one call to V1LIbatch().  */
+
+double V1LIadapt( const Vec3 P0[3], const double dF0[3], double h,
+  const Vec3 *b0, const Vec3 *b1, const Vec3 *B, const double b2,
+  View3DControlData *vfCtrl )
+/* P0     3 vertices on edge of polygon 1;
+ * dF0    corresponding dF values;
+ * h      |P0[2] - P0[0]| / 6.0;
  * b0     pointer to start of edge on polygon 2;
  * b1     pointer to end of edge on polygon 2;
  * B      vector from p0 to p1 (edge of polygon 2);
- * b2     length^2 of vector B;
- * *flag; return 1 if g=0; else return 0. */
+ * b2     length^2 of vector B. */
   {
-  Vec3 P[5];
-  double dF[5];
-  double F3,  /* F using 3-point Simpson integration */
-     F5;  /* F using 5-point Simpson integration */
-  int flag, j;
+  static const int e0[2]={0,0};
+  ALIPart stack[MAXALI];
+  int nStack=0;
+  double sum=0.0;
+  int j;
 
   for( j=0; j<3; j++ )
     {
-    VCOPY( (Pold+j), (P+j+j) );
-    dF[j+j] = dFold[j];
+    VCOPY( (P0+j), (stack[0].P+j) );
+    stack[0].dF[j] = dF0[j];
     }
-  F3 = h * (dF[0] + 4.0*dF[2] + dF[4]);
-
-  vfCtrl->usedV1LIadapt += 2;
-  VMID( (P+0), (P+2), (P+1) );
-  dF[1] = V1LIpart( P+1, b0, b1, B, b2, &flag );
+  stack[0].h = h;
+  stack[0].level = 0;
+  nStack = 1;
 
-  VMID( (P+2), (P+4), (P+3) );
-  dF[3] = V1LIpart( P+3, b0, b1, B, b2, &flag );
-  h *= 0.5;
-  F5 = h * (dF[0] + 4.0*dF[1] + 2.0*dF[2] + 4.0*dF[3] + dF[4]);
-
-  if( fabs( F5 - F3 ) > vfCtrl->epsAF )    /* test convergence */
+  while( nStack )
     {
-    if( ++level > vfCtrl->maxRecursALI )   /* limit maximum recursions */
-      vfCtrl->failViewALI = 1;
-    else             /* one more level of adaptive integration */
-      F5 = V1LIadapt( P+0, dF+0, h, b0, b1, B, b2, level, vfCtrl )
-         + V1LIadapt( P+2, dF+2, h, b0, b1, B, b2, level, vfCtrl );
+    ALIPart *s = stack + --nStack;
+    Vec3 P[5], Q[2];
+    double dF[5], dQ[2];
+    double F3,  /* F using 3-point Simpson integration */
+       F5;  /* F using 5-point Simpson integration */
+    int flag[2], level=s->level;
+
+    for( j=0; j<3; j++ )
+      {
+      VCOPY( (s->P+j), (P+j+j) );
+      dF[j+j] = s->dF[j];
+      }
+    h = s->h;
+    F3 = h * (dF[0] + 4.0*dF[2] + dF[4]);
+
+    vfCtrl->usedV1LIadapt += 2;
+    VMID( (P+0), (P+2), (Q+0) );
+    VMID( (P+2), (P+4), (Q+1) );
+    V1LIbatch( 2, Q, e0, b0, b1, B, &b2, dQ, flag );
+    VCOPY( (Q+0), (P+1) );
+    VCOPY( (Q+1), (P+3) );
+    dF[1] = dQ[0];
+    dF[3] = dQ[1];
+    h *= 0.5;
+    F5 = h * (dF[0] + 4.0*dF[1] + 2.0*dF[2] + 4.0*dF[3] + dF[4]);
+
+    if( fabs( F5 - F3 ) > vfCtrl->epsAF )    /* test convergence */
+      {
+      if( ++level > vfCtrl->maxRecursALI     /* limit maximum recursions */
+        || nStack + 2 > MAXALI )
+        vfCtrl->failViewALI = 1;
+      else             /* one more level of adaptive integration */
+        {
+        for( j=1; j>=0; j-- )   /* second half, then first half on top */
+          {
+          ALIPart *t = stack + nStack++;
+          int k;
+          for( k=0; k<3; k++ )
+            {
+            VCOPY( (P+j+j+k), (t->P+k) );
+            t->dF[k] = dF[j+j+k];
+            }
+          t->h = h;
+          t->level = level;
+          }
+        continue;
+        }
+      }
+    sum += F5;
     }
 
-  return F5;
+  return sum;
 
   }  /* end V1LIadapt */
 
@@ -512,7 +1323,11 @@ double V1LIxact( const Vec3 *a0, const Vec3 *a1, const double a,
 /***  ViewALI.c  *************************************************************/
 
 /*  Compute direct interchange area by adaptive single line integral
- *  (Mitalas-Stephensen) method */
+ *  (Mitalas-Stephensen) method.  Each vertex of polygon 1 is shared by
+ *  two of its edges;  its dF value to each edge of polygon 2 is
+ *  computed once, with all (vertex, edge) combinations in one batch,
+ *  followed by one batch of the edge midpoints for the edge pairs
+ *  which need adaptive integration.  */
 
 double ViewALI( const int nv1, const Vec3 *v1,
             const int nv2, const Vec3 *v2, View3DControlData *vfCtrl )
@@ -524,12 +1339,22 @@ double ViewALI( const int nv1, const Vec3 *v1,
   {
   Vec3 A[MAXNV1]; /* edges of polygon 1 */
   double a[MAXNV1]; /* lengths of polygon 1 edges */
+  Vec3 b0[MAXNV1], b1[MAXNV1], B[MAXNV1]; /* edges of polygon 2 */
+  double b[MAXNV1], b2[MAXNV1]; /* lengths and length^2 of polygon 2 edges */
+  double dot[MAXBATCH]; /* dot products of edges i and j */
+  int vtx[MAXBATCH];    /* batch index of vertex i to edge j; -1 if unused */
+  int mid[MAXBATCH];    /* batch index of midpoint of i to edge j */
+  Vec3 P[MAXBATCH];     /* batch points */
+  int e[MAXBATCH];      /* batch edges */
+  double dF[MAXBATCH], dM[MAXBATCH];
+  int flag[MAXBATCH], flagM[MAXBATCH];
+  int nP, nM;           /* number of points in the batches */
   double sum, sumt; /* double because of large +/- operations */
   int i, im1,    /* surface 1 edge index */
      j, jm1;    /* surface 2 edge index */
 
 #if( DEBUG > 0 )
-  if( nv1>MAXNV1 )
+  if( nv1>MAXNV1 || nv2>MAXNV1 )
     errorf( 2, __FILE__, __LINE__, "MAXNV1 too small ", "" );
 #endif
 #if( DEBUG > 1 )
@@ -547,62 +1372,100 @@ double ViewALI( const int nv1, const Vec3 *v1,
     }
 
   jm1 = nv2 - 1;
-  for( sum=0.0,j=0; j<nv2; jm1=j++ )   /* for all edges of polygon 2 */
+  for( j=0; j<nv2; jm1=j++ )   /* for all edges of polygon 2 */
     {
-    Vec3 B;  /* edge of polygon 2 */
-    double b, b2;    /* length  and length^2 of edge */
-    double dot;      /* dot product of edges i and j */
-
-    VECTOR( (v2+jm1), (v2+j), (&B) );
-    b2 = VDOT( (&B), (&B) );
-    b = sqrt( b2 );
+    VCOPY( (v2+jm1), (b0+j) );
+    VCOPY( (v2+j), (b1+j) );
+    VECTOR( (v2+jm1), (v2+j), (B+j) );
+    b2[j] = VDOT( (B+j), (B+j) );
+    b[j] = sqrt( b2[j] );
 #if( DEBUG > 0 )
-    if( b < EPS )
-      errorf( 2, __FILE__, __LINE__, "small edge (b) ", FltStr(b,6), "" );
+    if( b[j] < EPS )
+      errorf( 2, __FILE__, __LINE__, "small edge (b) ", FltStr(b[j],6), "" );
 #endif
+    }
 
+  for( i=0; i<nv1*nv2; i++ )
+    vtx[i] = -1;
+  for( nP=0,j=0; j<nv2; j++ )    /* vertices needed for each edge j */
+    {
     im1 = nv1 - 1;
-    for( i=0; i<nv1; im1=i++ )     /* for all edges of polygon 1 */
+    for( i=0; i<nv1; im1=i++ )
       {
-      Vec3 V[3];  /* vertices of edge i */
-      double dF[3];
-      int flag1, flag2;
-
-#if( DEBUG > 2 )
-      fprintf( _ulog, "Srf1 %d-%d (%f %f %f) to (%f %f %f)\n", i, ip1,
-        v1[i].x, v1[i].y, v1[i].z, v1[ip1].x, v1[ip1].y, v1[ip1].z );
-      fprintf( _ulog, "Srf2 %d-%d (%f %f %f) to (%f %f %f)\n", j, jp1,
-        v2[j].x, v2[j].y, v2[j].z, v2[jp1].x, v2[jp1].y, v2[jp1].z );
-#endif
-      dot = VDOT( (&B), (A+i) ) / ( b * a[i] );
-      if( fabs(dot) <= EPS ) continue;
+      int k = j*nv1;
+      dot[k+i] = VDOT( (B+j), (A+i) ) / ( b[j] * a[i] );
 #if( DEBUG > 1 )
       fprintf( _ulog, " ViewALI: j=%d i=%d b %f a %f dot %f\n",
-        j, i, b, a[i], dot );
+        j, i, b[j], a[i], dot[k+i] );
 #endif
-      VCOPY( (v1+im1), (V+0) );
-      dF[0] = V1LIpart( V+0, v2+jm1, v2+j, &B, b2, &flag1 );
+      if( fabs(dot[k+i]) <= EPS ) continue;
+      if( vtx[k+im1] < 0 )
+        {
+        VCOPY( (v1+im1), (P+nP) );
+        e[nP] = j;
+        vtx[k+im1] = nP++;
+        }
+      if( vtx[k+i] < 0 )
+        {
+        VCOPY( (v1+i), (P+nP) );
+        e[nP] = j;
+        vtx[k+i] = nP++;
+        }
+      }
+    }
+  if( nP )
+    V1LIbatch( nP, P, e, b0, b1, B, b2, dF, flag );
+  vfCtrl->usedV1LIadapt += nP;
 
-      VCOPY( (v1+i), (V+2) );
-      dF[2] = V1LIpart( V+2, v2+jm1, v2+j, &B, b2, &flag2 );
-      vfCtrl->usedV1LIadapt += 2;
+  for( nM=0,j=0; j<nv2; j++ )    /* midpoints for adaptive integration */
+    {
+    im1 = nv1 - 1;
+    for( i=0; i<nv1; im1=i++ )
+      {
+      int k = j*nv1;
+      if( fabs(dot[k+i]) <= EPS ) continue;
+      if( flag[vtx[k+im1]] + flag[vtx[k+i]] == 2 ) continue;
+      VMID( (v1+im1), (v1+i), (P+nM) );
+      e[nM] = j;
+      mid[k+i] = nM++;
+      }
+    }
+  if( nM )
+    V1LIbatch( nM, P, e, b0, b1, B, b2, dM, flagM );
+  vfCtrl->usedV1LIadapt += nM;
 
-      if( flag1 + flag2 == 2 )    /* analytic integration */
+  for( sum=0.0,j=0; j<nv2; j++ )
+    {
+    im1 = nv1 - 1;
+    for( i=0; i<nv1; im1=i++ )     /* for all edges of polygon 1 */
+      {
+      int k = j*nv1;
+      int k0, k2;
+
+      if( fabs(dot[k+i]) <= EPS ) continue;
+      k0 = vtx[k+im1];
+      k2 = vtx[k+i];
+      if( flag[k0] + flag[k2] == 2 )    /* analytic integration */
         {
-        sumt = V1LIxact( v1+im1, v1+i, a[i], v2+jm1, v2+j, b );
+        sumt = V1LIxact( v1+im1, v1+i, a[i], b0+j, b1+j, b[j] );
         }
       else                        /* adaptive integration */
         {
-        VMID( (V+0), (V+2), (V+1) );
-        dF[1] = V1LIpart( V+1, v2+jm1, v2+j, &B, b2, &flag1 );
-        vfCtrl->usedV1LIadapt += 1;
-        sumt = V1LIadapt( V, dF, a[i]/6.0, v2+jm1, v2+j,
-                          &B, b2, 0, vfCtrl ) / b;
+        Vec3 V[3];  /* vertices of edge i */
+        double dV[3];
+        VCOPY( (v1+im1), (V+0) );
+        VMID( (v1+im1), (v1+i), (V+1) );
+        VCOPY( (v1+i), (V+2) );
+        dV[0] = dF[k0];
+        dV[1] = dM[mid[k+i]];
+        dV[2] = dF[k2];
+        sumt = V1LIadapt( V, dV, a[i]/6.0, b0+j, b1+j,
+                          B+j, b2[j], vfCtrl ) / b[j];
         }
-      sum += dot * sumt;
+      sum += dot[k+i] * sumt;
 #if( DEBUG > 1 )
       fprintf( _ulog, "ALI: i %d j %d dot %f t %f sum %f\n",
-        j, i, dot, sumt, sum );
+        j, i, dot[k+i], sumt, sum );
 #endif
       }  /* end i loop */
     }  /* end j loop */
@@ -618,35 +1481,43 @@ double ViewALI( const int nv1, const Vec3 *v1,
 
 /***  ViewsInit.c  ***********************************************************/
 
-/*  Allocate / free arrays local to this file based on INIT.
- *  Initialize Gaussian integration coefficients.
- *  Store G coefficients in vectors emulating triangular arrays.  */
+/*  Allocate / free arrays local to this file based on INIT:
+ *  the pool of surface quadratures, to be grown as needed.  */
 
 void ViewsInit( int maxDiv, int init )
   {
-  static int maxRC1;    /* max number of values in RC1 */
-  static int maxRC2;    /* max number of values in RC2 */
-  static int maxDV1;    /* max number of values in DV1 */
-  static int maxDV2;    /* max number of values in DV2 */
+  int j;
 
   if( init )
     {
-    maxRC1 = MAXNV1;
-    _rc1 = Alc_V( 0, maxRC1, sizeof(EdgeDir), __FILE__, __LINE__ );
-    maxDV1 = maxDiv - 1;
-    _dv1 = Alc_MC( 0, maxRC1, 0, maxDV1, sizeof(EdgeDivision), __FILE__, __LINE__ );
-    maxRC2 = _maxNVT;  // MAXNVT @@@ needs work; 2005/11/02;
-    _rc2 = Alc_V( 0, maxRC2, sizeof(EdgeDir), __FILE__, __LINE__ );
-    maxDV2 = maxDiv - 1;
-    _dv2 = Alc_MC( 0, maxRC2, 0, maxDV2, sizeof(EdgeDivision), __FILE__, __LINE__ );
+    _qp.maxNr = 255;
+    _qp.index = Alc_V( 0, _qp.maxNr, sizeof(int), __FILE__, __LINE__ );
+    for( j=0; j<=_qp.maxNr; j++ )
+      _qp.index[j] = -1;
+    _qp.nSrf = 0;
+    _qp.maxSrf = 255;
+    _qp.srf = Alc_V( 0, _qp.maxSrf, sizeof(QuadSrf), __FILE__, __LINE__ );
+    _qp.nPt = 0;
+    _qp.maxPt = maxDiv * maxDiv * 128 - 1;  /* grown by QuadPoints() */
+    _qp.x = Alc_V( 0, _qp.maxPt, sizeof(double), __FILE__, __LINE__ );
+    _qp.y = Alc_V( 0, _qp.maxPt, sizeof(double), __FILE__, __LINE__ );
+    _qp.z = Alc_V( 0, _qp.maxPt, sizeof(double), __FILE__, __LINE__ );
+    _qp.w = Alc_V( 0, _qp.maxPt, sizeof(double), __FILE__, __LINE__ );
+    _qp.nDv = 0;
+    _qp.maxDv = MAXNV1 * maxDiv * 256 - 1;  /* grown by QuadEdges() */
+    _qp.dv = Alc_V( 0, _qp.maxDv, sizeof(EdgeDivision), __FILE__, __LINE__ );
     }
 
-  else
+  else if( _qp.index )   /* not already freed */
     {
-    Fre_MC( _dv2, 0, maxRC2, 0, maxDV2, sizeof(EdgeDivision), __FILE__, __LINE__ );
-    Fre_V( _rc2, 0, maxRC2, sizeof(EdgeDir), __FILE__, __LINE__ );
-    Fre_MC( _dv1, 0, maxRC1, 0, maxDV1, sizeof(EdgeDivision), __FILE__, __LINE__ );
-    Fre_V( _rc1, 0, maxRC1, sizeof(EdgeDir), __FILE__, __LINE__ );
+    Fre_V( _qp.dv, 0, _qp.maxDv, sizeof(EdgeDivision), __FILE__, __LINE__ );
+    Fre_V( _qp.w, 0, _qp.maxPt, sizeof(double), __FILE__, __LINE__ );
+    Fre_V( _qp.z, 0, _qp.maxPt, sizeof(double), __FILE__, __LINE__ );
+    Fre_V( _qp.y, 0, _qp.maxPt, sizeof(double), __FILE__, __LINE__ );
+    Fre_V( _qp.x, 0, _qp.maxPt, sizeof(double), __FILE__, __LINE__ );
+    Fre_V( _qp.srf, 0, _qp.maxSrf, sizeof(QuadSrf), __FILE__, __LINE__ );
+    Fre_V( _qp.index, 0, _qp.maxNr, sizeof(int), __FILE__, __LINE__ );
+    _qp.index = NULL;
 #ifdef LOGGING
     fprintf( _ulog, "Total line integral points evaluated:    %8lu\n",
       _usedV1LIpart );
@@ -655,13 +1526,13 @@ void ViewsInit( int maxDiv, int init )
 
   }  /* end ViewsInit */
 
-  const double _gqx[10] = {    /* Gaussian ordinates */
+static const double _gqx[10] = {    /* Gaussian ordinates */
      0.500000000, 0.211324865, 0.788675135, 0.112701665, 0.500000000,
      0.887298335, 0.069431844, 0.330009478, 0.669990522, 0.930568156 };
-  const double _gqw[10] = {    /* Gaussian weights */
+static const double _gqw[10] = {    /* Gaussian weights */
      1.000000000, 0.500000000, 0.500000000, 0.277777778, 0.444444444,
      0.277777778, 0.173927423, 0.326072577, 0.326072577, 0.173927423 };
-  const int _offset[4] = { 0, 1, 3, 6 };
+static const int _offset[4] = { 0, 1, 3, 6 };
 
 /***  DivideEdges.c  *********************************************************/
 
@@ -824,6 +1695,167 @@ int SubSrf( const int nDiv, const int nv, const Vec3 *Sv, const double area,
 
   }  /* end SubSrf */
 
+/***  SubSrfE.c  *************************************************************/
+
+/*  Set embedded integration values for triangle or rectangle:  one set
+ *  of points with a high order weighting, WHI, and lower order
+ *  weightings, WLO and WCHK, so that all estimates use the same view
+ *  points.  WCHK guards against WHI and WLO agreeing by chance where
+ *  a shadow edge crosses the surface; for a triangle WCHK = WLO.  */
+
+int SubSrfE( const int nv, const Vec3 *Sv, const double area,
+  Vec3 *Gpt, double *wHi, double *wLo, double *wChk )
+/* nv   - number of vertices, 3 or 4
+ * Sv   - coordinates of vertices
+ * area - of triangle or rectangle
+ * Gpt  - coordinates of integration points; MAXEMB points
+ * wHi  - high order weights
+ * wLo  - low order weights
+ * wChk - check weights */
+  {
+  int nSubSrf;       /* number of integration points */
+  int n;
+
+  if( nv == 3 )
+    nSubSrf = GETriangle( Sv, Gpt, wHi, wLo, wChk );
+  else
+    nSubSrf = GEParallelogram( Sv, Gpt, wHi, wLo, wChk );
+
+  for( n=0; n<nSubSrf; n++ )
+    {
+    wHi[n] *= area;
+    wLo[n] *= area;
+    wChk[n] *= area;
+    }
+
+  return nSubSrf;
+
+  }  /* end SubSrfE */
+
+/***  GETriangle.c  **********************************************************/
+
+/*  Embedded integration values for a triangle:  the 7-point, degree 5
+ *  Radon rule and a 19-point, degree 8 rule which includes the same
+ *  7 points (Laurie, ACM TOMS 8, 1982, p210).  */
+
+int GETriangle( const Vec3 *vt, Vec3 *p, double *wHi, double *wLo,
+  double *wChk )
+/* vt   - vertices of triangle
+ * p    - coordinates of integration points
+ * wHi  - 19-point weights
+ * wLo  - 7-point weights
+ * wChk - check weights; same as wLo */
+  {
+  static const double gx[19][5] = {  /* ordinates, 19- & 7-point weights */
+     {0.333333333333, 0.333333333333, 0.333333333333, 0.037861091201, 0.225000000000 },
+     {0.059715871790, 0.470142064105, 0.470142064105, 0.078357352244, 0.132394152789 },
+     {0.470142064105, 0.059715871790, 0.470142064105, 0.078357352244, 0.132394152789 },
+     {0.470142064105, 0.470142064105, 0.059715871790, 0.078357352244, 0.132394152789 },
+     {0.797426985353, 0.101286507323, 0.101286507323, 0.037620425413, 0.125939180545 },
+     {0.101286507323, 0.797426985353, 0.101286507323, 0.037620425413, 0.125939180545 },
+     {0.101286507323, 0.101286507323, 0.797426985353, 0.037620425413, 0.125939180545 },
+     {0.941038278231, 0.029480860885, 0.029480860885, 0.013444267375, 0.0 },
+     {0.029480860885, 0.941038278231, 0.029480860885, 0.013444267375, 0.0 },
+     {0.029480860885, 0.029480860885, 0.941038278231, 0.013444267375, 0.0 },
+     {0.535795346451, 0.232102326775, 0.232102326775, 0.116271479657, 0.0 },
+     {0.232102326775, 0.535795346451, 0.232102326775, 0.116271479657, 0.0 },
+     {0.232102326775, 0.232102326775, 0.535795346451, 0.116271479657, 0.0 },
+     {0.738416812340, 0.232102326775, 0.029480860885, 0.037509722455, 0.0 },
+     {0.738416812340, 0.029480860885, 0.232102326775, 0.037509722455, 0.0 },
+     {0.232102326775, 0.738416812340, 0.029480860885, 0.037509722455, 0.0 },
+     {0.232102326775, 0.029480860885, 0.738416812340, 0.037509722455, 0.0 },
+     {0.029480860885, 0.738416812340, 0.232102326775, 0.037509722455, 0.0 },
+     {0.029480860885, 0.232102326775, 0.738416812340, 0.037509722455, 0.0 }
+                             };
+  int j;
+
+  for( j=0; j<19; j++,p++ )
+    {
+    p->x = gx[j][0] * vt[0].x + gx[j][1] * vt[1].x + gx[j][2] * vt[2].x;
+    p->y = gx[j][0] * vt[0].y + gx[j][1] * vt[1].y + gx[j][2] * vt[2].y;
+    p->z = gx[j][0] * vt[0].z + gx[j][1] * vt[1].z + gx[j][2] * vt[2].z;
+    wHi[j] = gx[j][3];
+    wLo[j] = wChk[j] = gx[j][4];
+    }
+
+  return 19;
+
+  }  /* end GETriangle */
+
+/***  GEParallelogram.c  *****************************************************/
+
+/*  Embedded integration values for a parallelogram:  the 17-point,
+ *  degree 7 rule of Genz & Malik (J. Comp. Appl. Math. 6, 1980, p295),
+ *  its degree 5 rule on the first 13 of those points, and a degree 3
+ *  check rule on the center and the last 4 points.
+ *  Ordinates are given on [-1,1] x [-1,1].  */
+
+int GEParallelogram( const Vec3 *vp, Vec3 *p, double *wHi, double *wLo,
+  double *wChk )
+/* vp   - vertices of parallelogram
+ * p    - coordinates of integration points
+ * wHi  - degree 7 weights
+ * wLo  - degree 5 weights
+ * wChk - degree 3 weights */
+  {
+#define GM2 0.358568582800318  /* sqrt(9/70) */
+#define GM3 0.948683298050514  /* sqrt(9/10) */
+#define GM5 0.688247201611685  /* sqrt(9/19) */
+  static const double gx[17][5] = {  /* ordinates, degree 7, 5 & 3 weights */
+     {  0.0,  0.0, -0.193872885231, -1.331961591221,  0.296296296296 },
+     {  GM2,  0.0,  0.149367474471,  0.504115226337,  0.0 },
+     { -GM2,  0.0,  0.149367474471,  0.504115226337,  0.0 },
+     {  0.0,  GM2,  0.149367474471,  0.504115226337,  0.0 },
+     {  0.0, -GM2,  0.149367474471,  0.504115226337,  0.0 },
+     {  GM3,  0.0,  0.051821368694,  0.044581618656,  0.0 },
+     { -GM3,  0.0,  0.051821368694,  0.044581618656,  0.0 },
+     {  0.0,  GM3,  0.051821368694,  0.044581618656,  0.0 },
+     {  0.0, -GM3,  0.051821368694,  0.044581618656,  0.0 },
+     {  GM3,  GM3,  0.010161052685,  0.034293552812,  0.0 },
+     { -GM3,  GM3,  0.010161052685,  0.034293552812,  0.0 },
+     {  GM3, -GM3,  0.010161052685,  0.034293552812,  0.0 },
+     { -GM3, -GM3,  0.010161052685,  0.034293552812,  0.0 },
+     {  GM5,  GM5,  0.087118325459,  0.0,            0.175925925926 },
+     { -GM5,  GM5,  0.087118325459,  0.0,            0.175925925926 },
+     {  GM5, -GM5,  0.087118325459,  0.0,            0.175925925926 },
+     { -GM5, -GM5,  0.087118325459,  0.0, 0.175925925926 }
+                             };
+  Vec3 v0,  /* vector from v[0] to v[3] */
+       v1,  /* vector from v[1] to v[2] */
+       v2;  /* vector from pt0 to pt1 */
+  Vec3 pt0, pt1; /* points on v0 and v1 */
+  double s, t;   /* ordinates on [0,1] x [0,1] */
+  int j;
+
+  VECTOR( (vp+0), (vp+3), (&v0) );
+  VECTOR( (vp+1), (vp+2), (&v1) );
+
+  for( j=0; j<17; j++,p++ )
+    {
+    s = 0.5 * (1.0 + gx[j][0]);
+    t = 0.5 * (1.0 + gx[j][1]);
+    pt0.x = vp[0].x + v0.x * t;
+    pt0.y = vp[0].y + v0.y * t;
+    pt0.z = vp[0].z + v0.z * t;
+    pt1.x = vp[1].x + v1.x * t;
+    pt1.y = vp[1].y + v1.y * t;
+    pt1.z = vp[1].z + v1.z * t;
+    VECTOR( (&pt0), (&pt1), (&v2) );
+    p->x = pt0.x + v2.x * s;
+    p->y = pt0.y + v2.y * s;
+    p->z = pt0.z + v2.z * s;
+    wHi[j] = gx[j][2];    /* not correct for a */
+    wLo[j] = gx[j][3];    /* general quadrilateral */
+    wChk[j] = gx[j][4];
+    }
+
+  return 17;
+#undef GM2
+#undef GM3
+#undef GM5
+
+  }  /* end GEParallelogram */
+
 /***  GQTriangle.c  **********************************************************/
 
 /*  Gaussian integration values for a triangle, 1 <= nDiv <= 4.
@@ -3,11 +3,34 @@
 
 #include "view3d.h"
 
+typedef struct{         /* unobstructed 2AI pair of a row batch */
+  SRFDAT3X srf1, srf2;  /* vfCtrl->srf1T and srf2T set by ViewMethod() */
+  double epsAF;         /* convergence for this AF */
+  double rcRatio;       /* vfCtrl->rcRatio; for the log */
+  double relSep;        /* vfCtrl->relSep; for the log */
+  double AF;            /* computed AF */
+  double AF0;           /* previous estimate of AF */
+  double err, err0;     /* rounding bounds of AF and AF0; fp32=1 */
+  int row, col;         /* row N and column M */
+  int nEdgeDiv;         /* number of divisions used; 5 = fixed by ALI */
+  int failViewALI;      /* 1 = ALI did not converge */
+  int k1, k2;           /* pool offsets of the current points */
+  int n1, n2;           /* numbers of those points */
+  int group;            /* V2AIlanes() group; -1 = none */
+  int fp32;             /* 1 = single precision AF accepted,
+                           2 = AF recomputed in double precision */
+} UnobPair;
+
 double ViewUnobstructed( View3DControlData *vfCtrl, int row, int col );
+void ViewUnobBatch( View3DControlData *vfCtrl, UnobPair *pair, int nPair );
+double ViewRect( const SRFDAT3X *srf1, const SRFDAT3X *srf2, double epsAF );
 void ViewsInit( int maxDiv, int init );
 
 int SubSrf( const int nDiv, const int nv, const Vec3 *v, const double area,
   Vec3 *pt, double *wt );
+#define MAXEMB 19  /* max number of points of an embedded rule */
+int SubSrfE( const int nv, const Vec3 *v, const double area,
+  Vec3 *pt, double *wHi, double *wLo, double *wChk );
 
 #endif
 
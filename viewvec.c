@@ -0,0 +1,689 @@
+/*subfile:  ViewVec.c  *******************************************************/
+
+/*  Vector kernels for the view factor area and contour integrals.
+ *
+ *  V1AIsum() evaluates the contour integral of V1AIpart() for a batch
+ *  of edges, typically all edges of all unshaded polygons seen from one
+ *  view point.  The edges are processed in blocks of V1AIBLOCK;  each
+ *  step of a block is a short loop across the block with no branches,
+ *  which the compiler vectorizes, including the square root.  The
+ *  ATAN of V1AIpart() is replaced by the equivalent ATAN2, computed by
+ *  the Cephes rational approximation with the usual octant reduction;
+ *  the error is a few units in the last place.
+ *
+ *  V2AIsum() and V1AIarea() are the double and single area integration
+ *  kernels of View2AI() and View1AI():  the Gaussian points are held as
+ *  structures of arrays and the loops run across blocks of V1AIBLOCK
+ *  points of one surface, padded with points of zero weight.  With
+ *  fewer points than a block the scalar loops are faster and are used.
+ *  V2AIlanes() instead runs across V1AIBLOCK surface pairs, one per
+ *  lane, for the pairs of a row with few points;  see ViewUnobBatch().
+ *  V2AIlanesF() is its single precision version for fp32=1, with twice
+ *  as many lanes.
+ *
+ *  The same C code is compiled for SSE2 (the x86-64 baseline), AVX2
+ *  and AVX-512;  the version is chosen at run time by the processor
+ *  features.  No fused multiply-add is used, and the block sums are
+ *  added in the same order for every version, so the results do not
+ *  depend on the version.  */
+
+#ifdef _DEBUG
+# define DEBUG 1
+#else
+# define DEBUG 0
+#endif
+
+#define V3D_BUILD
+#include "viewvec.h"
+
+#include <stdio.h>
+#include <math.h>   /* prototypes: sqrt, atan, fabsf */
+#include "types.h"
+#include "view3d.h"
+
+#define PId2     1.570796326794896619   /* pi / 2 */
+#define PIt2inv  0.159154943091895346   /* 1 / (2 * pi) */
+#define PIinv    0.318309886183790672   /* 1 / pi */
+#define V2AICHUNK (4*V1AIBLOCK)  /* points per V2AIsumBody() chunk */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define V1AI_DISPATCH 1   /* select by processor features */
+# define V1AI_INLINE static inline __attribute__((always_inline))
+# pragma GCC optimize ("fp-contract=off")  /* same results with FMA */
+#else
+# define V1AI_DISPATCH 0
+# define V1AI_INLINE static
+#endif
+
+/***  Atan2Block.c  **********************************************************/
+
+/*  Compute G[i] = ATAN2(Y[i], X[i]) for a block of V1AIBLOCK values
+ *  with Y[i] > 0;  0 < G[i] < PI.  Cephes atan():  reduce to
+ *  |t| <= tan(pi/8), then atan(t) = t + t^3 P(t^2) / Q(t^2).  */
+
+V1AI_INLINE void Atan2Block( const double y[], const double x[], double g[] )
+  {
+  static const double P0=-8.750608600031904122785e-1,
+    P1=-1.615753718733365076637e1, P2=-7.500855792314704667340e1,
+    P3=-1.228866684490136173410e2, P4=-6.485021904942025371773e1,
+    Q0=2.485846490142306297962e1, Q1=1.650270098316988542046e2,
+    Q2=4.328810604912902668951e2, Q3=4.853903996359136964868e2,
+    Q4=1.945506571482613964425e2;
+  static const double T3P8=2.41421356237309504880, /* tan(3pi/8) */
+    PId4=0.785398163397448309616, MOREBITS=6.123233995736765886130e-17;
+  int i;
+
+  for( i=0; i<V1AIBLOCK; i++ )
+    {
+    double ax = fabs( x[i] );   /* atan2 = pi/2 -/+ atan(ax/y) */
+    double p, q, t, z, off;
+    int big = ax > T3P8 * y[i], mid = ax > 0.66 * y[i];
+    off = big ? PId2 : (mid ? PId4 : 0.0);
+    p = big ? -y[i] : (mid ? ax - y[i] : ax);
+    q = big ? ax : (mid ? ax + y[i] : y[i]);
+    t = p / q;                  /* one divide for the reduction */
+    z = t * t;
+    p = (((P0 * z + P1) * z + P2) * z + P3) * z + P4;
+    q = ((((z + Q0) * z + Q1) * z + Q2) * z + Q3) * z + Q4;
+    z = t + t * z * p / q;
+    z += big ? MOREBITS : (mid ? 0.5 * MOREBITS : 0.0);
+    z += off;                 /* atan(|x|/y) */
+    g[i] = x[i] < 0.0 ? PId2 + z : PId2 - z;
+    }
+
+  }  /* end Atan2Block */
+
+/***  V1AIblock.c  ***********************************************************/
+
+/*  Add the contour integral terms of V1AIBLOCK edges to SUM[].
+ *  Edge i runs from (AX[i],AY[i],Z) to (BX[i],BY[i],Z) relative to the
+ *  view point;  U is the unit normal of the view point surface.  */
+
+V1AI_INLINE void V1AIblock( const double ax[], const double ay[],
+  const double bx[], const double by[], const double z, const DirCos *u,
+  double sum[] )
+  {
+  double uc[V1AIBLOCK], cl[V1AIBLOCK], ab[V1AIBLOCK], g[V1AIBLOCK];
+  double ux=u->x, uy=u->y, uz=u->z;
+  int i;
+
+  for( i=0; i<V1AIBLOCK; i++ )
+    {
+    double cx = ay[i] * z - z * by[i];  /* C = A cross B */
+    double cy = z * bx[i] - ax[i] * z;
+    double cz = ax[i] * by[i] - ay[i] * bx[i];
+    double c2 = cx * cx + cy * cy + cz * cz;
+    uc[i] = ux * cx + uy * cy + uz * cz;     /* U dot C */
+    ab[i] = ax[i] * bx[i] + ay[i] * by[i] + z * z;  /* A dot B */
+    cl[i] = sqrt( fabs( c2 > EPS2 * EPS2 ? c2 : 1.0 ) );  /* | C | */
+    uc[i] = (c2 > EPS2 * EPS2) & (fabs(uc[i]) > EPS2) ? uc[i] : 0.0;
+    }
+  Atan2Block( cl, ab, g );
+  for( i=0; i<V1AIBLOCK; i++ )
+    sum[i] += uc[i] * g[i] / cl[i];
+
+  }  /* end V1AIblock */
+
+/***  V1AIsumBody.c  *********************************************************/
+
+/*  Sum the contour integral over NE edges;  see V1AIsum().  */
+
+V1AI_INLINE double V1AIsumBody( const int ne, const double ax[],
+  const double ay[], const double bx[], const double by[], const double z,
+  const DirCos *u )
+  {
+  double sum[V1AIBLOCK];
+  double tx[4][V1AIBLOCK];  /* last partial block */
+  double total=0.0;
+  int i, n;
+
+  for( i=0; i<V1AIBLOCK; i++ )
+    sum[i] = 0.0;
+  for( n=0; n+V1AIBLOCK<=ne; n+=V1AIBLOCK )
+    V1AIblock( ax+n, ay+n, bx+n, by+n, z, u, sum );
+  if( n < ne )
+    {
+    for( i=0; i<V1AIBLOCK; i++ )  /* pad with null edges */
+      if( n+i < ne )
+        {
+        tx[0][i] = ax[n+i];
+        tx[1][i] = ay[n+i];
+        tx[2][i] = bx[n+i];
+        tx[3][i] = by[n+i];
+        }
+      else
+        tx[0][i] = tx[1][i] = tx[2][i] = tx[3][i] = 0.0;
+    V1AIblock( tx[0], tx[1], tx[2], tx[3], z, u, sum );
+    }
+  for( i=0; i<V1AIBLOCK; i++ )
+    total += sum[i];
+
+  return total * PIt2inv;
+
+  }  /* end V1AIsumBody */
+
+/***  V2AIblock.c  ***********************************************************/
+
+/*  Add the double area integration terms of point (X1,Y1,Z1) with
+ *  weight W1 and a block of V1AIBLOCK points (X2,Y2,Z2) with weights W2
+ *  to SUM[];  U1 and U2 are the unit normals of the two surfaces.  */
+
+V1AI_INLINE void V2AIblock( const double x1, const double y1,
+  const double z1, const double w1, const double x2[], const double y2[],
+  const double z2[], const double w2[], const DirCos *u1, const DirCos *u2,
+  double sum[] )
+  {
+  double ux=u1->x, uy=u1->y, uz=u1->z, wx=u2->x, wy=u2->y, wz=u2->z;
+  int i;
+
+  for( i=0; i<V1AIBLOCK; i++ )
+    {
+    double vx = x2[i] - x1, vy = y2[i] - y1, vz = z2[i] - z1;
+    double r2 = vx * vx + vy * vy + vz * vz;
+    double t = (vx * ux + vy * uy + vz * uz) * (vx * wx + vy * wy + vz * wz);
+    sum[i] += t * (w1 * w2[i] / (r2 * r2));
+    }
+
+  }  /* end V2AIblock */
+
+/***  V2AIsumBody.c  *********************************************************/
+
+/*  Double area integration over N1 x N2 points;  see V2AIsum().  The
+ *  points of surface 2 are taken in chunks of up to V2AICHUNK, the
+ *  last block padded with points of zero weight.  Fewer points than
+ *  one block are summed by V2AIscalar().  */
+
+V1AI_INLINE double V2AIsumBody( const int n1, const double x1[],
+  const double y1[], const double z1[], const double w1[], const DirCos *u1,
+  const int n2, const double x2[], const double y2[], const double z2[],
+  const double w2[], const DirCos *u2 )
+  {
+  double px[V2AICHUNK], py[V2AICHUNK], pz[V2AICHUNK], pw[V2AICHUNK];
+  double sum[V1AIBLOCK];
+  double total=0.0;
+  int i, j, j0, k, n;
+
+  if( n2 < V1AIBLOCK )   /* too few points for a block */
+    return V2AIscalar( n1, x1, y1, z1, w1, u1, n2, x2, y2, z2, w2, u2 );
+  for( k=0; k<V1AIBLOCK; k++ )
+    sum[k] = 0.0;
+  for( j0=0; j0<n2; j0+=V2AICHUNK )
+    {
+    for( n=0,j=j0; n<V2AICHUNK && j<n2; n++,j++ )
+      {
+      px[n] = x2[j];
+      py[n] = y2[j];
+      pz[n] = z2[j];
+      pw[n] = w2[j];
+      }
+    for( ; n % V1AIBLOCK; n++ )   /* pad with points of zero weight */
+      {
+      px[n] = px[0];
+      py[n] = py[0];
+      pz[n] = pz[0];
+      pw[n] = 0.0;
+      }
+    for( i=0; i<n1; i++ )
+      for( k=0; k<n; k+=V1AIBLOCK )
+        V2AIblock( x1[i], y1[i], z1[i], w1[i], px+k, py+k, pz+k, pw+k,
+          u1, u2, sum );
+    }
+  for( k=0; k<V1AIBLOCK; k++ )
+    total += sum[k];
+
+  return -total * PIinv;
+
+  }  /* end V2AIsumBody */
+
+/***  V2AIlanesBody.c  *******************************************************/
+
+/*  Double area integration of V1AIBLOCK surface pairs, one per lane,
+ *  with N1 x N2 points each;  see V2AIlanes().  */
+
+V1AI_INLINE void V2AIlanesBody( const V2AILanes *b, const int n1,
+  const int n2, double af[] )
+  {
+  double sum[V1AIBLOCK];
+  int i, j, k;
+
+  for( k=0; k<V1AIBLOCK; k++ )
+    sum[k] = 0.0;
+  for( i=0; i<n1; i++ )
+    for( j=0; j<n2; j++ )
+      for( k=0; k<V1AIBLOCK; k++ )
+        {
+        double vx = b->x2[j][k] - b->x1[i][k], vy = b->y2[j][k] - b->y1[i][k],
+          vz = b->z2[j][k] - b->z1[i][k];
+        double r2 = vx * vx + vy * vy + vz * vz;
+        double t = (vx * b->u1x[k] + vy * b->u1y[k] + vz * b->u1z[k])
+                 * (vx * b->u2x[k] + vy * b->u2y[k] + vz * b->u2z[k]);
+        sum[k] -= t * (b->w1[i][k] * b->w2[j][k] / ( r2 * r2 ));
+        }
+  for( k=0; k<V1AIBLOCK; k++ )
+    af[k] = sum[k] * PIinv;
+
+  }  /* end V2AIlanesBody */
+
+/***  V2AIlanesFBody.c  ******************************************************/
+
+/*  V2AIlanesBody() in single precision for V2AIFBLOCK pairs;  also
+ *  return the sums of the absolute values of the terms in AB[].  */
+
+V1AI_INLINE void V2AIlanesFBody( const V2AILanesF *b, const int n1,
+  const int n2, double af[], double ab[] )
+  {
+  float sum[V2AIFBLOCK], sab[V2AIFBLOCK];
+  int i, j, k;
+
+  for( k=0; k<V2AIFBLOCK; k++ )
+    sum[k] = sab[k] = 0.0f;
+  for( i=0; i<n1; i++ )
+    for( j=0; j<n2; j++ )
+      for( k=0; k<V2AIFBLOCK; k++ )
+        {
+        float vx = b->x2[j][k] - b->x1[i][k], vy = b->y2[j][k] - b->y1[i][k],
+          vz = b->z2[j][k] - b->z1[i][k];
+        float r2 = vx * vx + vy * vy + vz * vz;
+        float t = (vx * b->u1x[k] + vy * b->u1y[k] + vz * b->u1z[k])
+                * (vx * b->u2x[k] + vy * b->u2y[k] + vz * b->u2z[k]);
+        float d = t * (b->w1[i][k] * b->w2[j][k] / ( r2 * r2 ));
+        sum[k] -= d;
+        sab[k] += fabsf( d );
+        }
+  for( k=0; k<V2AIFBLOCK; k++ )
+    {
+    af[k] = sum[k] * PIinv;
+    ab[k] = sab[k] * PIinv;
+    }
+
+  }  /* end V2AIlanesFBody */
+
+/***  V1AIareaBlock.c  *******************************************************/
+
+/*  Add the V1AIpart() terms of the edge from A to B to F[] for a block
+ *  of V1AIBLOCK view points (QX,QY,QZ);  U is the unit normal of the
+ *  view point surface.  */
+
+V1AI_INLINE void V1AIareaBlock( const double qx[], const double qy[],
+  const double qz[], const Vec3 *a, const Vec3 *b, const DirCos *u,
+  double f[] )
+  {
+  double uc[V1AIBLOCK], cl[V1AIBLOCK], ab[V1AIBLOCK], g[V1AIBLOCK];
+  double ux=u->x, uy=u->y, uz=u->z;
+  double vax=a->x, vay=a->y, vaz=a->z, vbx=b->x, vby=b->y, vbz=b->z;
+  int i;
+
+  for( i=0; i<V1AIBLOCK; i++ )
+    {
+    double ax = vax - qx[i], ay = vay - qy[i], az = vaz - qz[i];
+    double bx = vbx - qx[i], by = vby - qy[i], bz = vbz - qz[i];
+    double cx = ay * bz - az * by;  /* C = A cross B */
+    double cy = az * bx - ax * bz;
+    double cz = ax * by - ay * bx;
+    double c2 = cx * cx + cy * cy + cz * cz;
+    uc[i] = ux * cx + uy * cy + uz * cz;      /* U dot C */
+    ab[i] = ax * bx + ay * by + az * bz;      /* A dot B */
+    cl[i] = sqrt( fabs( c2 > EPS2 * EPS2 ? c2 : 1.0 ) );  /* | C | */
+    uc[i] = (c2 > EPS2 * EPS2) & (fabs(uc[i]) > EPS2) ? uc[i] : 0.0;
+    }
+  Atan2Block( cl, ab, g );
+  for( i=0; i<V1AIBLOCK; i++ )
+    f[i] += uc[i] * g[i] / cl[i];
+
+  }  /* end V1AIareaBlock */
+
+/***  V1AIareaBody.c  ********************************************************/
+
+/*  Single area integration over NP points;  see V1AIarea().  The points
+ *  are taken in blocks, the last padded with points of zero weight.
+ *  Fewer points than one block are summed by V1AIareaScalar().  */
+
+V1AI_INLINE double V1AIareaBody( const int np, const double px[],
+  const double py[], const double pz[], const double w[], const DirCos *u,
+  const int nv, const Vec3 v[] )
+  {
+  double sum[V1AIBLOCK], f[V1AIBLOCK];
+  double tx[4][V1AIBLOCK];  /* last partial block */
+  double total=0.0;
+  int i, k, n;
+
+  if( np < V1AIBLOCK )   /* too few points for a block */
+    return V1AIareaScalar( np, px, py, pz, w, u, nv, v );
+  for( i=0; i<V1AIBLOCK; i++ )
+    sum[i] = 0.0;
+  for( n=0; n<np; n+=V1AIBLOCK )
+    {
+    const double *qx=px+n, *qy=py+n, *qz=pz+n, *qw=w+n;
+    if( n + V1AIBLOCK > np )
+      {
+      for( i=0; i<V1AIBLOCK; i++ )  /* pad with points of zero weight */
+        {
+        int j = n+i < np ? n+i : np-1;
+        tx[0][i] = px[j];
+        tx[1][i] = py[j];
+        tx[2][i] = pz[j];
+        tx[3][i] = n+i < np ? w[j] : 0.0;
+        }
+      qx = tx[0];  qy = tx[1];  qz = tx[2];  qw = tx[3];
+      }
+    for( i=0; i<V1AIBLOCK; i++ )
+      f[i] = 0.0;
+    for( k=0; k<nv; k++ )     /* edge from v[k-1] to v[k] */
+      V1AIareaBlock( qx, qy, qz, v + (k ? k-1 : nv-1), v + k, u, f );
+    for( i=0; i<V1AIBLOCK; i++ )
+      sum[i] += qw[i] * (f[i] * PIt2inv);
+    }
+  for( i=0; i<V1AIBLOCK; i++ )
+    total += sum[i];
+
+  return total;
+
+  }  /* end V1AIareaBody */
+
+/*  The versions of the kernels for each instruction set.  */
+
+#define V1AI_ARGS const int ne, const double ax[], const double ay[], \
+  const double bx[], const double by[], const double z, const DirCos *u
+#define V2AI_ARGS const int n1, const double x1[], const double y1[], \
+  const double z1[], const double w1[], const DirCos *u1, const int n2, \
+  const double x2[], const double y2[], const double z2[], \
+  const double w2[], const DirCos *u2
+#define V2LANES_ARGS const V2AILanes *b, const int n1, const int n2, \
+  double af[]
+#define V2LANESF_ARGS const V2AILanesF *b, const int n1, const int n2, \
+  double af[], double ab[]
+#define V1AREA_ARGS const int np, const double px[], const double py[], \
+  const double pz[], const double w[], const DirCos *u, const int nv, \
+  const Vec3 v[]
+#define V1AI_VERSIONS( ISA ) \
+  static double V1AIsum##ISA( V1AI_ARGS ) \
+    { return V1AIsumBody( ne, ax, ay, bx, by, z, u ); } \
+  static double V2AIsum##ISA( V2AI_ARGS ) \
+    { return V2AIsumBody( n1, x1, y1, z1, w1, u1, n2, x2, y2, z2, w2, u2 ); } \
+  static double V1AIarea##ISA( V1AREA_ARGS ) \
+    { return V1AIareaBody( np, px, py, pz, w, u, nv, v ); } \
+  static void V2AIlanes##ISA( V2LANES_ARGS ) \
+    { V2AIlanesBody( b, n1, n2, af ); } \
+  static void V2AIlanesF##ISA( V2LANESF_ARGS ) \
+    { V2AIlanesFBody( b, n1, n2, af, ab ); }
+
+V1AI_VERSIONS( SSE2 )
+
+#if( V1AI_DISPATCH )
+#pragma GCC push_options
+#pragma GCC target ("avx2")
+V1AI_VERSIONS( AVX2 )
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target ("avx512f")
+V1AI_VERSIONS( AVX512 )
+#pragma GCC pop_options
+#endif
+
+typedef double (*V1AIfunc)( V1AI_ARGS );
+typedef double (*V2AIfunc)( V2AI_ARGS );
+typedef double (*V1AREAfunc)( V1AREA_ARGS );
+typedef void (*V2LANESfunc)( V2LANES_ARGS );
+typedef void (*V2LANESFfunc)( V2LANESF_ARGS );
+
+static V1AIfunc _V1AIsum=NULL;  /* selected versions; set once */
+static V2AIfunc _V2AIsum=NULL;
+static V1AREAfunc _V1AIarea=NULL;
+static V2LANESfunc _V2AIlanes=NULL;
+static V2LANESFfunc _V2AIlanesF=NULL;
+
+/***  V1AIsetISA.c  **********************************************************/
+
+/*  Select the version of V1AIsum(), V2AIsum(), V2AIlanes(),
+ *  V2AIlanesF() and V1AIarea():  V1AI_SCALAR, V1AI_SSE2, V1AI_AVX2,
+ *  V1AI_AVX512, or -1 for the best supported by the processor.  A version
+ *  the processor does not support is replaced by the next lower one.
+ *  Return the version selected.  */
+
+int V1AIsetISA( const int isa )
+  {
+  int best = V1AI_SSE2;
+
+#if( V1AI_DISPATCH )
+  __builtin_cpu_init();
+  if( __builtin_cpu_supports( "avx2" ) )
+    best = V1AI_AVX2;
+  if( __builtin_cpu_supports( "avx512f" ) )
+    best = V1AI_AVX512;
+#endif
+  if( isa >= 0 && isa < best )
+    best = isa;
+
+  switch( best )
+    {
+    case V1AI_SCALAR:
+      _V2AIsum = V2AIscalar;
+      _V1AIarea = V1AIareaScalar;
+      _V2AIlanes = V2AIlanesSSE2;  /* same result */
+      _V2AIlanesF = V2AIlanesFSSE2;
+      _V1AIsum = V1AIscalar;
+      break;
+#if( V1AI_DISPATCH )
+    case V1AI_AVX512:
+      _V2AIsum = V2AIsumAVX512;
+      _V1AIarea = V1AIareaAVX512;
+      _V2AIlanes = V2AIlanesAVX512;
+      _V2AIlanesF = V2AIlanesFAVX512;
+      _V1AIsum = V1AIsumAVX512;
+      break;
+    case V1AI_AVX2:
+      _V2AIsum = V2AIsumAVX2;
+      _V1AIarea = V1AIareaAVX2;
+      _V2AIlanes = V2AIlanesAVX2;
+      _V2AIlanesF = V2AIlanesFAVX2;
+      _V1AIsum = V1AIsumAVX2;
+      break;
+#endif
+    default:
+      _V2AIsum = V2AIsumSSE2;
+      _V1AIarea = V1AIareaSSE2;
+      _V2AIlanes = V2AIlanesSSE2;
+      _V2AIlanesF = V2AIlanesFSSE2;
+      _V1AIsum = V1AIsumSSE2;
+    }
+
+  return best;
+
+  }  /* end V1AIsetISA */
+
+/***  V1AIname.c  ************************************************************/
+
+/*  Return the name of a V1AIsum() version.  */
+
+const char *V1AIname( const int isa )
+  {
+  static const char *name[] = { "scalar", "SSE2", "AVX2", "AVX-512" };
+
+  return isa >= 0 && isa <= V1AI_AVX512 ? name[isa] : "?";
+
+  }  /* end V1AIname */
+
+/***  V1AIsum.c  *************************************************************/
+
+/*  Compute the radiation shape factor between an infinitesimal surface
+ *  and the region bounded by NE directed edges in the z=0 plane by the
+ *  contour integral method of V1AIpart().  Edge n runs from
+ *  (AX[n],AY[n],Z) to (BX[n],BY[n],Z), coordinates relative to the
+ *  view point;  U is the unit normal of the infinitesimal surface.
+ *  The edges may belong to any number of polygons.  */
+
+double V1AIsum( const int ne, const double ax[], const double ay[],
+  const double bx[], const double by[], const double z, const DirCos *u )
+  {
+  if( !_V1AIsum )   /* same result from every thread */
+    V1AIsetISA( -1 );
+
+  return _V1AIsum( ne, ax, ay, bx, by, z, u );
+
+  }  /* end V1AIsum */
+
+/***  V1AIscalar.c  **********************************************************/
+
+/*  V1AIsum() computed one edge at a time with the library ATAN, as in
+ *  V1AIpart();  the reference for vbench.c.  */
+
+double V1AIscalar( const int ne, const double ax[], const double ay[],
+  const double bx[], const double by[], const double z, const DirCos *u )
+  {
+  double sum=0.0;
+  int n;
+
+  for( n=0; n<ne; n++ )
+    {
+    double cx = ay[n] * z - z * by[n];  /* C = A cross B */
+    double cy = z * bx[n] - ax[n] * z;
+    double cz = ax[n] * by[n] - ay[n] * bx[n];
+    double UdotC = u->x * cx + u->y * cy + u->z * cz;
+    if( fabs(UdotC) > EPS2 )
+      {
+      double Clen = sqrt( cx * cx + cy * cy + cz * cz );
+      if( Clen > EPS2 )
+        {   /* gamma = angle between A and B; 0 < gamma < 180 */
+        double gamma = PId2 - atan( (ax[n] * bx[n] + ay[n] * by[n] + z * z) / Clen );
+        sum += UdotC * gamma / Clen;
+        }
+      }
+    }
+
+  return sum * PIt2inv;
+
+  }  /* end V1AIscalar */
+
+/***  V2AIsum.c  *************************************************************/
+
+/*  Compute the direct interchange area of two surfaces by double area
+ *  integration.  Surface 1 has N1 Gaussian points (X1,Y1,Z1) with
+ *  weights (areas) W1 and unit normal U1;  likewise surface 2.  */
+
+double V2AIsum( const int n1, const double x1[], const double y1[],
+  const double z1[], const double w1[], const DirCos *u1, const int n2,
+  const double x2[], const double y2[], const double z2[],
+  const double w2[], const DirCos *u2 )
+  {
+  if( !_V2AIsum )
+    V1AIsetISA( -1 );
+
+  return _V2AIsum( n1, x1, y1, z1, w1, u1, n2, x2, y2, z2, w2, u2 );
+
+  }  /* end V2AIsum */
+
+/***  V2AIlanes.c  ***********************************************************/
+
+/*  Compute the direct interchange areas AF[k] of V1AIBLOCK surface
+ *  pairs by double area integration, pair k in lane k of B:  N1 points
+ *  of surface 1 and N2 of surface 2 with their weights and the unit
+ *  normals.  Each lane adds its terms in the order of V2AIscalar(), so
+ *  AF[k] equals V2AIsum() of pair k when N2 < V1AIBLOCK.  */
+
+void V2AIlanes( const V2AILanes *b, const int n1, const int n2, double af[] )
+  {
+  if( !_V2AIlanes )
+    V1AIsetISA( -1 );
+
+  _V2AIlanes( b, n1, n2, af );
+
+  }  /* end V2AIlanes */
+
+/***  V2AIlanesF.c  **********************************************************/
+
+/*  V2AIlanes() in single precision for V2AIFBLOCK pairs.  AB[k] is the
+ *  sum of the absolute values of the terms of AF[k], the scale of its
+ *  rounding error.  */
+
+void V2AIlanesF( const V2AILanesF *b, const int n1, const int n2,
+  double af[], double ab[] )
+  {
+  if( !_V2AIlanesF )
+    V1AIsetISA( -1 );
+
+  _V2AIlanesF( b, n1, n2, af, ab );
+
+  }  /* end V2AIlanesF */
+
+/***  V1AIarea.c  ************************************************************/
+
+/*  Compute the direct interchange area of a surface with NP Gaussian
+ *  points (PX,PY,PZ), weights (areas) W and unit normal U, and the
+ *  polygon of NV vertices V, by single area integration:  the sum of
+ *  W times the V1AIpart() shape factor of each point.  */
+
+double V1AIarea( const int np, const double px[], const double py[],
+  const double pz[], const double w[], const DirCos *u, const int nv,
+  const Vec3 v[] )
+  {
+  if( !_V1AIarea )
+    V1AIsetISA( -1 );
+
+  return _V1AIarea( np, px, py, pz, w, u, nv, v );
+
+  }  /* end V1AIarea */
+
+/***  V2AIscalar.c  **********************************************************/
+
+/*  V2AIsum() computed one point pair at a time, as View2AI() was.  */
+
+double V2AIscalar( const int n1, const double x1[], const double y1[],
+  const double z1[], const double w1[], const DirCos *u1, const int n2,
+  const double x2[], const double y2[], const double z2[],
+  const double w2[], const DirCos *u2 )
+  {
+  double sum=0.0;
+  int i, j;
+
+  for( i=0; i<n1; i++ )
+    for( j=0; j<n2; j++ )
+      {
+      double vx = x2[j] - x1[i], vy = y2[j] - y1[i], vz = z2[j] - z1[i];
+      double r2 = vx * vx + vy * vy + vz * vz;
+      double t = (vx * u1->x + vy * u1->y + vz * u1->z)
+               * (vx * u2->x + vy * u2->y + vz * u2->z);
+      sum -= t * (w1[i] * w2[j] / ( r2 * r2 ));
+      }
+
+  return sum * PIinv;
+
+  }  /* end V2AIscalar */
+
+/***  V1AIareaScalar.c  ******************************************************/
+
+/*  V1AIarea() computed one point at a time with the library ATAN.  */
+
+double V1AIareaScalar( const int np, const double px[], const double py[],
+  const double pz[], const double w[], const DirCos *u, const int nv,
+  const Vec3 v[] )
+  {
+  double total=0.0;
+  int i, k;
+
+  for( i=0; i<np; i++ )
+    {
+    double sum=0.0;
+    for( k=0; k<nv; k++ )
+      {
+      const Vec3 *a = v + (k ? k-1 : nv-1), *b = v + k;
+      double ax = a->x - px[i], ay = a->y - py[i], az = a->z - pz[i];
+      double bx = b->x - px[i], by = b->y - py[i], bz = b->z - pz[i];
+      double cx = ay * bz - az * by;  /* C = A cross B */
+      double cy = az * bx - ax * bz;
+      double cz = ax * by - ay * bx;
+      double UdotC = u->x * cx + u->y * cy + u->z * cz;
+      if( fabs(UdotC) > EPS2 )
+        {
+        double Clen = sqrt( cx * cx + cy * cy + cz * cz );
+        if( Clen > EPS2 )
+          sum += UdotC * (PId2 - atan( (ax * bx + ay * by + az * bz) / Clen ))
+               / Clen;
+        }
+      }
+    total += w[i] * (sum * PIt2inv);
+    }
+
+  return total;
+
+  }  /* end V1AIareaScalar */
@@ -0,0 +1,61 @@
+#ifndef V3D_VIEWVEC_H
+#define V3D_VIEWVEC_H
+
+#include "view3d.h"
+
+/*  Vector kernels for the view factor area and contour integrals;
+ *  see viewvec.c.  */
+
+#define V1AIBLOCK 8     /* edges per block of the V1AIsum() kernel */
+
+typedef struct{         /* V1AIBLOCK surface pairs for V2AIlanes() */
+  double x1[MAXSS][V1AIBLOCK], y1[MAXSS][V1AIBLOCK], z1[MAXSS][V1AIBLOCK];
+  double w1[MAXSS][V1AIBLOCK];  /* points [i][lane] and weights, surface 1 */
+  double x2[MAXSS][V1AIBLOCK], y2[MAXSS][V1AIBLOCK], z2[MAXSS][V1AIBLOCK];
+  double w2[MAXSS][V1AIBLOCK];  /* likewise surface 2 */
+  double u1x[V1AIBLOCK], u1y[V1AIBLOCK], u1z[V1AIBLOCK];  /* unit normals */
+  double u2x[V1AIBLOCK], u2y[V1AIBLOCK], u2z[V1AIBLOCK];
+} V2AILanes;
+
+#define V2AIFBLOCK (2*V1AIBLOCK)  /* pairs per V2AIlanesF() call */
+
+typedef struct{         /* V2AIFBLOCK surface pairs for V2AIlanesF() */
+  float x1[MAXSS][V2AIFBLOCK], y1[MAXSS][V2AIFBLOCK], z1[MAXSS][V2AIFBLOCK];
+  float w1[MAXSS][V2AIFBLOCK];  /* points [i][lane] and weights, surface 1 */
+  float x2[MAXSS][V2AIFBLOCK], y2[MAXSS][V2AIFBLOCK], z2[MAXSS][V2AIFBLOCK];
+  float w2[MAXSS][V2AIFBLOCK];  /* likewise surface 2 */
+  float u1x[V2AIFBLOCK], u1y[V2AIFBLOCK], u1z[V2AIFBLOCK];  /* unit normals */
+  float u2x[V2AIFBLOCK], u2y[V2AIFBLOCK], u2z[V2AIFBLOCK];
+} V2AILanesF;
+
+#define V1AI_SCALAR 0   /* instruction sets for V1AIsetISA() */
+#define V1AI_SSE2   1
+#define V1AI_AVX2   2
+#define V1AI_AVX512 3
+
+V3D_API double V1AIsum( const int ne, const double ax[], const double ay[],
+  const double bx[], const double by[], const double z, const DirCos *u );
+V3D_API int V1AIsetISA( const int isa );
+V3D_API const char *V1AIname( const int isa );
+V3D_API double V1AIscalar( const int ne, const double ax[], const double ay[],
+  const double bx[], const double by[], const double z, const DirCos *u );
+V3D_API double V2AIsum( const int n1, const double x1[], const double y1[],
+  const double z1[], const double w1[], const DirCos *u1, const int n2,
+  const double x2[], const double y2[], const double z2[],
+  const double w2[], const DirCos *u2 );
+V3D_API double V2AIscalar( const int n1, const double x1[], const double y1[],
+  const double z1[], const double w1[], const DirCos *u1, const int n2,
+  const double x2[], const double y2[], const double z2[],
+  const double w2[], const DirCos *u2 );
+V3D_API void V2AIlanes( const V2AILanes *b, const int n1, const int n2,
+  double af[] );
+V3D_API void V2AIlanesF( const V2AILanesF *b, const int n1, const int n2,
+  double af[], double ab[] );
+V3D_API double V1AIarea( const int np, const double px[], const double py[],
+  const double pz[], const double w[], const DirCos *u, const int nv,
+  const Vec3 v[] );
+V3D_API double V1AIareaScalar( const int np, const double px[],
+  const double py[], const double pz[], const double w[], const DirCos *u,
+  const int nv, const Vec3 v[] );
+
+#endif